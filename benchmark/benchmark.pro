@@ -0,0 +1,31 @@
+#
+#  QCustomPlot Plot Examples - headless benchmark
+#
+#  Renders every demo of the examples collection offscreen and reports frame timings as JSON.
+#  Run with: ./plot-examples-benchmark --frames 300 --output results.json
+#
+
+QT       += core gui
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets printsupport
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = plot-examples-benchmark
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+SOURCES += main.cpp \
+           ../mainwindow.cpp \
+           ../qcustomplot.cpp \
+           ../axistag.cpp
+
+HEADERS  += ../mainwindow.h \
+            ../qcustomplot.h \
+            ../axistag.h
+
+FORMS    += ../mainwindow.ui
+
+RESOURCES += \
+    ../images.qrc
@@ -0,0 +1,254 @@
+/***************************************************************************
+**                                                                        **
+**  QCustomPlot, an easy to use, modern plotting widget for Qt            **
+**  Copyright (C) 2011-2018 Emanuel Eichhammer                            **
+**                                                                        **
+**  This program is free software: you can redistribute it and/or modify  **
+**  it under the terms of the GNU General Public License as published by  **
+**  the Free Software Foundation, either version 3 of the License, or     **
+**  (at your option) any later version.                                   **
+**                                                                        **
+**  This program is distributed in the hope that it will be useful,       **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  along with this program.  If not, see http://www.gnu.org/licenses/.   **
+**                                                                        **
+****************************************************************************
+**           Author: Emanuel Eichhammer                                   **
+**  Website/Contact: http://www.qcustomplot.com/                          **
+**             Date: 25.06.18                                             **
+**          Version: 2.0.1                                                **
+****************************************************************************/
+
+/************************************************************************************************************
+**                                                                                                         **
+**  Headless benchmark of the QCustomPlot examples.                                                        **
+**                                                                                                         **
+**  All demos of MainWindow are set up with a simulated clock, so no timers run and the real time demos    **
+**  produce the same data in every run. Each demo plot is then rendered offscreen N times via              **
+**  QCustomPlot::toPainter into a QImage. Real time demos are advanced by one frame (fixed time step)       **
+**  before each rendering. The results (ms/frame percentiles, processed data points, peak memory growth)    **
+**  are written as JSON to stdout or to the file given with --output. The peak memory of the whole process  **
+**  is reported once at the top level.                                                                     **
+**                                                                                                         **
+*************************************************************************************************************/
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#ifdef Q_OS_UNIX
+#  include <sys/resource.h>
+#endif
+#include "mainwindow.h"
+
+namespace {
+
+/*
+  Returns the peak resident set size of this process in kilobytes, or -1 if it can't be determined
+  on this platform.
+*/
+qint64 peakMemoryKb()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+#  ifdef Q_OS_MAC
+        return usage.ru_maxrss/1024; // bytes on macOS
+#  else
+        return usage.ru_maxrss; // kilobytes on Linux
+#  endif
+    }
+#endif
+    return -1;
+}
+
+/*
+  Returns the number of data points currently held by all plottables of plot.
+*/
+qint64 plottablePoints(QCustomPlot *plot)
+{
+    qint64 result = 0;
+    for (int i=0; i<plot->plottableCount(); ++i)
+    {
+        QCPAbstractPlottable *plottable = plot->plottable(i);
+        if (QCPPlottableInterface1D *interface1d = plottable->interface1D())
+            result += interface1d->dataCount();
+        else if (QCPColorMap *colorMap = qobject_cast<QCPColorMap*>(plottable))
+            result += qint64(colorMap->data()->keySize())*qint64(colorMap->data()->valueSize());
+    }
+    return result;
+}
+
+/*
+  Returns the value at the percentile p (0..100) of the sorted values, using the nearest-rank method.
+*/
+double percentile(const QVector<double> &sortedValues, double p)
+{
+    if (sortedValues.isEmpty())
+        return 0;
+    int rank = qCeil(p/100.0*sortedValues.size());
+    return sortedValues.at(qBound(0, rank-1, sortedValues.size()-1));
+}
+
+QJsonObject statistics(QVector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    double sum = 0;
+    foreach (double value, values)
+        sum += value;
+    QJsonObject result;
+    result.insert(QLatin1String("min"), values.isEmpty() ? 0 : values.first());
+    result.insert(QLatin1String("mean"), values.isEmpty() ? 0 : sum/values.size());
+    result.insert(QLatin1String("p50"), percentile(values, 50));
+    result.insert(QLatin1String("p90"), percentile(values, 90));
+    result.insert(QLatin1String("p99"), percentile(values, 99));
+    result.insert(QLatin1String("max"), values.isEmpty() ? 0 : values.last());
+    return result;
+}
+
+/*
+  Renders plot frames times into an offscreen image of the given size. If update is set, the demo
+  is advanced by one frame (simulated time step timeStep) before each rendering.
+*/
+QJsonObject benchmarkPlot(MainWindow *window, QCustomPlot *plot, const std::function<void()> &update, int frames, double timeStep, const QSize &size)
+{
+    plot->resize(size);
+    plot->setViewport(QRect(QPoint(0, 0), size));
+    const qint64 peakMemoryBeforeKb = peakMemoryKb();
+    plot->setProfiling(true);
+    plot->replot();
+
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    QVector<double> frameMs, updateMs, renderMs;
+    qint64 points = 0, samplingPointsIn = 0, samplingPointsOut = 0;
+    for (int frame=0; frame<frames; ++frame)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        if (update)
+        {
+            window->setSimulatedTime((frame+1)*timeStep);
+            update(); // adds data and replots, like a timer tick in the interactive application
+            const QCPReplotProfile profile = plot->replotProfile();
+            samplingPointsIn += profile.samplingPointsIn;
+            samplingPointsOut += profile.samplingPointsOut;
+        }
+        const qint64 updateNsecs = timer.nsecsElapsed();
+        image.fill(Qt::white);
+        QCPPainter painter(&image);
+        plot->toPainter(&painter, size.width(), size.height());
+        painter.end();
+        const qint64 frameNsecs = timer.nsecsElapsed();
+
+        frameMs.append(frameNsecs/1.0e6);
+        updateMs.append(updateNsecs/1.0e6);
+        renderMs.append((frameNsecs-updateNsecs)/1.0e6);
+        points += plottablePoints(plot);
+    }
+
+    QJsonObject result;
+    result.insert(QLatin1String("name"), plot->parentWidget() ? plot->parentWidget()->windowTitle() : plot->objectName());
+    result.insert(QLatin1String("realtime"), bool(update));
+    result.insert(QLatin1String("frames"), frames);
+    result.insert(QLatin1String("msPerFrame"), statistics(frameMs));
+    if (update)
+        result.insert(QLatin1String("msPerUpdate"), statistics(updateMs));
+    result.insert(QLatin1String("msPerRender"), statistics(renderMs));
+    result.insert(QLatin1String("pointsProcessed"), double(points));
+    result.insert(QLatin1String("samplingPointsIn"), double(samplingPointsIn));
+    result.insert(QLatin1String("samplingPointsOut"), double(samplingPointsOut));
+    // the process peak only grows, so report by how much this demo raised it (zero if it stayed below an earlier demo's peak):
+    const qint64 peakMemoryAfterKb = peakMemoryKb();
+    result.insert(QLatin1String("peakMemoryGrowthKb"), peakMemoryBeforeKb < 0 || peakMemoryAfterKb < 0 ? -1.0 : double(peakMemoryAfterKb-peakMemoryBeforeKb));
+    return result;
+}
+
+} // end of anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication a(argc, argv);
+    QApplication::setApplicationName(QLatin1String("plot-examples-benchmark"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QLatin1String("Renders all QCustomPlot example demos offscreen and reports frame timings as JSON."));
+    parser.addHelpOption();
+    QCommandLineOption framesOption(QLatin1String("frames"), QLatin1String("Number of frames rendered per demo."), QLatin1String("n"), QLatin1String("200"));
+    QCommandLineOption widthOption(QLatin1String("width"), QLatin1String("Width of the rendered image."), QLatin1String("pixels"), QLatin1String("800"));
+    QCommandLineOption heightOption(QLatin1String("height"), QLatin1String("Height of the rendered image."), QLatin1String("pixels"), QLatin1String("400"));
+    QCommandLineOption timeStepOption(QLatin1String("time-step"), QLatin1String("Simulated time between two frames of real time demos."), QLatin1String("seconds"), QLatin1String("0.02"));
+    QCommandLineOption filterOption(QLatin1String("filter"), QLatin1String("Only run demos whose name contains this text."), QLatin1String("text"));
+    QCommandLineOption outputOption(QLatin1String("output"), QLatin1String("Write the JSON report to this file instead of stdout."), QLatin1String("file"));
+    parser.addOption(framesOption);
+    parser.addOption(widthOption);
+    parser.addOption(heightOption);
+    parser.addOption(timeStepOption);
+    parser.addOption(filterOption);
+    parser.addOption(outputOption);
+    parser.process(a);
+
+    const int frames = qMax(1, parser.value(framesOption).toInt());
+    const QSize size(qMax(1, parser.value(widthOption).toInt()), qMax(1, parser.value(heightOption).toInt()));
+    const double timeStep = parser.value(timeStepOption).toDouble();
+    const QString filter = parser.value(filterOption);
+
+    qsrand(1); // makes the data generated during demo setup deterministic
+    QElapsedTimer setupTimer;
+    setupTimer.start();
+    MainWindow window(0, true);
+    const double setupMs = setupTimer.nsecsElapsed()/1.0e6;
+
+    QList<QCustomPlot*> plots = window.findChildren<QCustomPlot*>();
+    QHash<QCustomPlot*, std::function<void()> > updates;
+    foreach (const MainWindow::RealtimeDemo &demo, window.realtimeDemos())
+        updates.insert(demo.plot, demo.update);
+
+    QJsonArray demos;
+    foreach (QCustomPlot *plot, plots)
+    {
+        const QString name = plot->parentWidget() ? plot->parentWidget()->windowTitle() : plot->objectName();
+        if (!filter.isEmpty() && !name.contains(filter, Qt::CaseInsensitive))
+            continue;
+        demos.append(benchmarkPlot(&window, plot, updates.value(plot), frames, timeStep, size));
+    }
+
+    QJsonObject report;
+    report.insert(QLatin1String("qtVersion"), QLatin1String(qVersion()));
+    report.insert(QLatin1String("frames"), frames);
+    report.insert(QLatin1String("width"), size.width());
+    report.insert(QLatin1String("height"), size.height());
+    report.insert(QLatin1String("timeStep"), timeStep);
+    report.insert(QLatin1String("setupMs"), setupMs);
+    report.insert(QLatin1String("demos"), demos);
+    report.insert(QLatin1String("peakMemoryKb"), double(peakMemoryKb()));
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+
+    if (parser.isSet(outputOption))
+    {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly|QIODevice::Truncate))
+        {
+            qWarning() << "Can't open output file" << file.fileName();
+            return 1;
+        }
+        file.write(json);
+    } else
+    {
+        QFile out;
+        out.open(stdout, QIODevice::WriteOnly);
+        out.write(json);
+    }
+    return 0;
+}
@@ -49,10 +49,23 @@
 #include <QMetaEnum>
 #include <bitset>
 
-MainWindow::MainWindow(QWidget *parent) :
+/*!
+  Creates the main window and sets up all demos.
+
+  If simulatedClock is true, the real time demos don't start their timers and the demo clock
+  (demoTime) only advances via setSimulatedTime. Random data of the real time demos is
+  then generated with a fixed seed, so repeated runs produce identical frames. This is used by the
+  headless benchmark (see benchmark/), which drives the demos returned by realtimeDemos itself.
+*/
+MainWindow::MainWindow(QWidget *parent, bool simulatedClock) :
     QMainWindow(parent),
-    ui(new Ui::MainWindow)
+    ui(new Ui::MainWindow),
+    _simulatedClock(simulatedClock),
+    _simulatedTime(0),
+    _demoEpoch(simulatedClock ? QCPAxisTickerDateTime::dateTimeToKey(QDateTime(QDate(2020, 1, 1), QTime(0, 0), Qt::UTC)) : QCPAxisTickerDateTime::dateTimeToKey(QDateTime::currentDateTime())),
+    _random(simulatedClock ? 42 : QRandomGenerator::global()->generate())
 {
+    _demoClock.start();
     ui->setupUi(this);
     setGeometry(200, 200, 800, 600);
 
@@ -518,7 +531,7 @@ void MainWindow::setupDateDemo(int row, int col, bool openGl)
     // set locale to english, so we get english month names:
     plot->setLocale(QLocale(QLocale::English, QLocale::UnitedKingdom));
     // seconds of current time, we'll use it as starting point in time for data:
-    double now = QDateTime::currentDateTime().toTime_t();
+    double now = qFloor(demoDateTimeKey());
     srand(8); // set the random seed, so we always get the same random data
     // create multiple graphs:
     for (int gi=0; gi<5; ++gi)
@@ -871,7 +884,6 @@ void MainWindow::setupLogarithmicDemo(int row, int col, bool openGl)
 
 void MainWindow::setupRealtimeDataDemo(int row, int col, bool openGl)
 {
-    QTimer *timer = new QTimer();
     QWidget *widget = new QWidget();
     widget->setWindowTitle("Real Time Data Demo");
     widget->setMinimumHeight(400);
@@ -904,17 +916,15 @@ void MainWindow::setupRealtimeDataDemo(int row, int col, bool openGl)
     connect(plot->xAxis, SIGNAL(rangeChanged(QCPRange)), plot->xAxis2, SLOT(setRange(QCPRange)));
     connect(plot->yAxis, SIGNAL(rangeChanged(QCPRange)), plot->yAxis2, SLOT(setRange(QCPRange)));
 
-    connect(timer, &QTimer::timeout,
-            [=]() {
-        static QTime timeData(QTime::currentTime());
+    addRealtimeDemo(plot, 0, [=]() {
         // calculate two new data points:
-        double key = timeData.elapsed()/1000.0; // time elapsed since start of demo, in seconds
+        double key = demoTime(); // time elapsed since start of demo, in seconds
         static double lastPointKeyData = 0;
         if (key-lastPointKeyData > 0.002) // at most add point every 2 ms
         {
             // add data to lines:
-            plot->graph(0)->addData(key, qSin(key)+qrand()/(double)RAND_MAX*1*qSin(key/0.3843));
-            plot->graph(1)->addData(key, qCos(key)+qrand()/(double)RAND_MAX*0.5*qSin(key/0.4364));
+            plot->graph(0)->addData(key, qSin(key)+_random.generateDouble()*1*qSin(key/0.3843));
+            plot->graph(1)->addData(key, qCos(key)+_random.generateDouble()*0.5*qSin(key/0.4364));
             // rescale value (vertical) axis to fit the current data:
             //ui->customPlot->graph(0)->rescaleValueAxis();
             //ui->customPlot->graph(1)->rescaleValueAxis(true);
@@ -942,16 +952,13 @@ void MainWindow::setupRealtimeDataDemo(int row, int col, bool openGl)
             lastFpsKeyData = key;
             frameCountData = 0;
         }
-    }
-    );
-    timer->start(0); // Interval 0 means to refresh as fast as possible
+    });
 
 }
 
 void MainWindow::setupRealtimeThresholdDemo(int row, int col, bool openGl)
 {
 
-    QTimer *timer = new QTimer();
     QWidget *widget = new QWidget();
     widget->setWindowTitle("Real Time Threshold Demo");
     widget->setMinimumHeight(400);
@@ -1016,18 +1023,16 @@ void MainWindow::setupRealtimeThresholdDemo(int row, int col, bool openGl)
     // setup a timer that repeatedly calls MainWindow::realtimeDataSlot:
     //    connect(&dataTimer, SIGNAL(timeout()), this, SLOT(realtimeDataSlot()));
 
-    connect(timer, &QTimer::timeout,
-            [=]() {
-        static QTime time(QTime::currentTime());
+    addRealtimeDemo(plot, 0, [=]() {
         // calculate two new data points:
-        double key = time.elapsed()/1000.0; // time elapsed since start of demo, in seconds
+        double key = demoTime(); // time elapsed since start of demo, in seconds
         static double lastPointKey = 0;
         static double lastPointValue = 0;
         if (key-lastPointKey > 0.002) // at most add point every 2 ms
         {
 
             // add data to lines:
-            double val = qSin(key)+qrand()/(double)RAND_MAX*1*qSin(key/0.3843);
+            double val = qSin(key)+_random.generateDouble()*1*qSin(key/0.3843);
             if(val < -1.0) {
                 if(lastPointValue < -1.0)
                     plot->graph(1)->addData(key, val);
@@ -1117,14 +1122,11 @@ void MainWindow::setupRealtimeThresholdDemo(int row, int col, bool openGl)
             lastFpsKey = key;
             frameCount = 0;
         }
-    }
-    );
-    timer->start(0); // Interval 0 means to refresh as fast as possible
+    });
 }
 
 void MainWindow::setupRealtimeBrushDemo(int row, int col, bool openGl)
 {
-    QTimer *timer = new QTimer();
     QWidget *widget = new QWidget();
     widget->setWindowTitle("Real Time Brush Demo");
     widget->setMinimumHeight(400);
@@ -1187,18 +1189,16 @@ void MainWindow::setupRealtimeBrushDemo(int row, int col, bool openGl)
     // setup a timer that repeatedly calls MainWindow::realtimeDataSlot:
     //    connect(&dataTimer, SIGNAL(timeout()), this, SLOT(realtimeDataSlot()));
 
-    connect(timer, &QTimer::timeout,
-            [=]() {
-        static QTime timeBrush(QTime::currentTime());
+    addRealtimeDemo(plot, 0, [=]() {
         // calculate two new data points:
-        double key = timeBrush.elapsed()/1000.0; // time elapsed since start of demo, in seconds
+        double key = demoTime(); // time elapsed since start of demo, in seconds
         static double lastPointKeyBrush = 0;
         if (key-lastPointKeyBrush > 0.002) // at most add point every 2 ms
         {
 
             // add data to lines:
-            plot->graph(0)->addData(key, qSin(key)+qrand()/(double)RAND_MAX*1*qSin(key/0.3843));
-            plot->graph(1)->addData(key, qCos(key)+qrand()/(double)RAND_MAX*0.5*qSin(key/0.4364));
+            plot->graph(0)->addData(key, qSin(key)+_random.generateDouble()*1*qSin(key/0.3843));
+            plot->graph(1)->addData(key, qCos(key)+_random.generateDouble()*0.5*qSin(key/0.4364));
             // rescale value (vertical) axis to fit the current data:
             //ui->customPlot->graph(0)->rescaleValueAxis();
             //ui->customPlot->graph(1)->rescaleValueAxis(true);
@@ -1226,9 +1226,7 @@ void MainWindow::setupRealtimeBrushDemo(int row, int col, bool openGl)
             lastFpsKeyBrush = key;
             frameCountBrush = 0;
         }
-    }
-    );
-    timer->start(0); // Interval 0 means to refresh as fast as possible
+    });
 }
 
 void MainWindow::setupRealtimeEcgDemo(int row, int col, bool openGl)
@@ -1240,6 +1238,7 @@ void MainWindow::setupRealtimeEcgDemo(int row, int col, bool openGl)
 
     QCustomPlot *plot = new QCustomPlot();
     plot->setOpenGl(openGl);
+    plot->setPlottingHint(QCP::phCacheAxes); // reuse the rendering of axes and grids as long as they don't change
     QStatusBar *bar = new QStatusBar();
 
     QVBoxLayout *layout = new QVBoxLayout();
@@ -1258,20 +1257,16 @@ void MainWindow::setupRealtimeEcgDemo(int row, int col, bool openGl)
     plot->xAxis->setRange(0, 10);
     plot->xAxis2->setRange(10, 20);
 
-    QTimer *timer =new QTimer();
-    connect(timer, &QTimer::timeout,
-            [=]() {
-
-        static QTime timeEcg(QTime::currentTime());
+    addRealtimeDemo(plot, 0, [=]() {
         // calculate two new data points:
-        double keyTime = timeEcg.elapsed()/1000.0; // time elapsed since start of demo, in seconds
+        double keyTime = demoTime(); // time elapsed since start of demo, in seconds
 
         double key = std::fmod(keyTime,20);
 
         static bool plottingBlue = true;
 
         // add data to lines:
-        double val = qSin(keyTime)+qrand()/(double)RAND_MAX*1*qSin(keyTime/0.3843);
+        double val = qSin(keyTime)+_random.generateDouble()*1*qSin(keyTime/0.3843);
         plot->graph(0)->addData(key, val);
         plot->graph(1)->addData(key, val);
 
@@ -1297,9 +1292,7 @@ void MainWindow::setupRealtimeEcgDemo(int row, int col, bool openGl)
         // make key axis range scroll with the data (at a constant range size of 8):
         plot->yAxis->rescale();
         plot->replot();
-    }
-    );
-    timer->start(0);
+    });
 
 }
 
@@ -1684,10 +1677,8 @@ void MainWindow::setupItemDemo(int row, int col, bool openGl)
     // setup a timer that repeatedly calls MainWindow::bracketDataSlot:
     //    connect(&dataTimer, SIGNAL(timeout()), this, SLOT(bracketDataSlot()));
 
-    QTimer *timer = new QTimer();
-    connect(timer, &QTimer::timeout,
-            [=]() {
-        double secs = QCPAxisTickerDateTime::dateTimeToKey(QDateTime::currentDateTime());
+    addRealtimeDemo(plot, 0, [=]() {
+        double secs = demoDateTimeKey();
 
         // update data to make phase move:
         int n = 500;
@@ -1720,9 +1711,7 @@ void MainWindow::setupItemDemo(int row, int col, bool openGl)
             lastFpsKeyItem = key;
             frameCountItem = 0;
         }
-    }
-    );
-    timer->start(0); // Interval 0 means to refresh as fast as possible
+    });
     //    dataTimer.start(0); // Interval 0 means to refresh as fast as possible
 }
 
@@ -1972,6 +1961,7 @@ void MainWindow::setupColorMapDemo(int row, int col, bool openGl)
 
     QCustomPlot *plot = new QCustomPlot();
     plot->setOpenGl(openGl);
+    plot->setPlottingHint(QCP::phCacheAxes); // reuse the rendering of axes and grids as long as they don't change
     QStatusBar *bar = new QStatusBar();
 
     QVBoxLayout *layout = new QVBoxLayout();
@@ -1995,7 +1985,8 @@ void MainWindow::setupColorMapDemo(int row, int col, bool openGl)
     int ny = 200;
     colorMap->data()->setSize(nx, ny); // we want the color map to have nx * ny data points
     colorMap->data()->setRange(QCPRange(-4, 4), QCPRange(-4, 4)); // and span the coordinate range -4..4 in both key (x) and value (y) dimensions
-    // now we assign some data, by accessing the QCPColorMapData instance of the color map:
+    // now we calculate the data as a row-major matrix and assign it to the QCPColorMapData instance of the color map in one call:
+    QVector<double> values(nx*ny);
     double x, y, z;
     for (int xIndex=0; xIndex<nx; ++xIndex)
     {
@@ -2004,9 +1995,10 @@ void MainWindow::setupColorMapDemo(int row, int col, bool openGl)
             colorMap->data()->cellToCoord(xIndex, yIndex, &x, &y);
             double r = 3*qSqrt(x*x+y*y)+1e-2;
             z = 2*x*(qCos(r+2)/r-qSin(r+2)/r); // the B field strength of dipole radiation (modulo physical constants)
-            colorMap->data()->setCell(xIndex, yIndex, z);
+            values[yIndex*nx+xIndex] = z;
         }
     }
+    colorMap->data()->setCells(0, 0, nx, ny, values.constData());
 
     // add a color scale:
     QCPColorScale *colorScale = new QCPColorScale(plot);
@@ -2185,9 +2177,7 @@ void MainWindow::setupAxisTagDemo(int row, int col, bool openGl)
     //    connect(&mDataTimer, SIGNAL(timeout()), this, SLOT(timerSlot()));
     //    mDataTimer.start(40);
 
-    QTimer *timer = new QTimer();
-    connect(timer, &QTimer::timeout,
-            [=]() {
+    addRealtimeDemo(plot, 40, [=]() {
 
         mGraph1->addData(mGraph1->dataCount(), qSin(mGraph1->dataCount()/50.0)+qSin(mGraph1->dataCount()/50.0/0.3843)*0.25);
         mGraph2->addData(mGraph2->dataCount(), qCos(mGraph2->dataCount()/50.0)+qSin(mGraph2->dataCount()/50.0/0.4364)*0.15);
@@ -2207,9 +2197,7 @@ void MainWindow::setupAxisTagDemo(int row, int col, bool openGl)
         mTag2->setText(QString::number(graph2Value, 'f', 2));
 
         plot->replot();
-    }
-    );
-    timer->start(40);
+    });
 }
 
 void MainWindow::setupHistoryDemo(int row, int col, bool openGl)
@@ -2305,11 +2293,9 @@ void MainWindow::setupHistoryDemo(int row, int col, bool openGl)
 
     }
 
-    QTimer *timer = new QTimer();
-    connect(timer, &QTimer::timeout,
-            [=]() {
+    addRealtimeDemo(plot, 250, [=]() {
 
-        double secs = QCPAxisTickerDateTime::dateTimeToKey(QDateTime::currentDateTime());
+        double secs = demoDateTimeKey();
         int n = 500;
         double phase = secs*5;
         double k = 3;
@@ -2318,7 +2304,7 @@ void MainWindow::setupHistoryDemo(int row, int col, bool openGl)
         for (int i=0; i<n; ++i)
         {
             x[i] = i/(double)(n-1)*34 - 17;
-            y[i] = QRandomGenerator::global()->bounded(3.0) * qAbs(qExp(-x[i]*QRandomGenerator::global()->bounded(100.0)*x[i]/20.0)*qSin(k*x[i]+phase));
+            y[i] = _random.bounded(3.0) * qAbs(qExp(-x[i]*_random.bounded(100.0)*x[i]/20.0)*qSin(k*x[i]+phase));
         }
 
         for(int j=0; j<nbCurves-1; j++) {
@@ -2328,11 +2314,7 @@ void MainWindow::setupHistoryDemo(int row, int col, bool openGl)
         plot->graph(nbCurves-1)->setData(x, y);
 
         plot->replot();
-    }
-
-    );
-
-    timer->start(250);
+    });
 
 }
 
@@ -2345,6 +2327,7 @@ void MainWindow::setupBitFieldDemo(int row, int col, bool openGl)
 
     QCustomPlot *plot = new QCustomPlot();
     plot->setOpenGl(openGl);
+    plot->setPlottingHint(QCP::phCacheAxes); // reuse the rendering of axes and grids as long as they don't change
     QStatusBar *bar = new QStatusBar();
 
     QVBoxLayout *layout = new QVBoxLayout();
@@ -2398,10 +2381,8 @@ void MainWindow::setupBitFieldDemo(int row, int col, bool openGl)
         rightGraph->setLineStyle(QCPGraph::lsStepLeft);
     }
 
-    QTimer *timer = new QTimer();
-    connect(timer, &QTimer::timeout,
-            [=]() {
-        double secs = QCPAxisTickerDateTime::dateTimeToKey(QDateTime::currentDateTime());
+    addRealtimeDemo(plot, 100, [=]() {
+        double secs = demoDateTimeKey();
         static quint32 value = 0;
         textValue->setText(QString::number(value) + QString(" - ") + QString::number( value, 16 ));
         std::bitset<32> bits(value);
@@ -2422,11 +2403,62 @@ void MainWindow::setupBitFieldDemo(int row, int col, bool openGl)
         value++;
         plot->replot();
 
-    }
-    );
-    timer->start(100);
+    });
+
 
+}
 
+/*!
+  Returns the time in seconds since the demos were set up. With a simulated clock, returns the
+  time last passed to setSimulatedTime.
+*/
+double MainWindow::demoTime() const
+{
+    if (_simulatedClock)
+        return _simulatedTime;
+    else
+        return _demoClock.elapsed()/1000.0;
+}
+
+/*!
+  Returns the current demo time as a date time key (seconds since epoch, see
+  QCPAxisTickerDateTime::dateTimeToKey). With a simulated clock, the demo time starts at a fixed
+  date.
+*/
+double MainWindow::demoDateTimeKey() const
+{
+    return _demoEpoch + demoTime();
+}
+
+/*!
+  Sets the simulated demo clock to seconds since the demos were set up. If the window was created
+  with a simulated clock, demoTime returns this value and demoDateTimeKey returns it as an offset
+  to the fixed demo epoch (2020-01-01 UTC). The clock isn't advanced automatically, the caller
+  (the benchmark) sets it before each frame. Without a simulated clock, the value is stored but
+  ignored, demoTime keeps following the elapsed wall time.
+*/
+void MainWindow::setSimulatedTime(double seconds)
+{
+    _simulatedTime = seconds;
+}
+
+/*!
+  Registers update as the per-frame function of the real time demo shown in plot. Unless the
+  window uses a simulated clock, a timer is started that calls update every interval
+  milliseconds (interval 0 means to refresh as fast as possible).
+*/
+void MainWindow::addRealtimeDemo(QCustomPlot *plot, int interval, const std::function<void()> &update)
+{
+    RealtimeDemo demo;
+    demo.plot = plot;
+    demo.update = update;
+    _realtimeDemos.append(demo);
+    if (!_simulatedClock)
+    {
+        QTimer *timer = new QTimer(this);
+        connect(timer, &QTimer::timeout, update);
+        timer->start(interval);
+    }
 }
 
 void MainWindow::setupPlayground(QCustomPlot *customPlot)
@@ -44,6 +44,9 @@
 
 #include <QMainWindow>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <functional>
 #include "qcustomplot.h" // the header file of QCustomPlot. Don't forget to add it to your project, if you use an IDE, so it gets compiled.
 #include "axistag.h"
 
@@ -56,9 +59,24 @@ class MainWindow : public QMainWindow
   Q_OBJECT
   
 public:
-  explicit MainWindow(QWidget *parent = nullptr);
+  /*!
+    A real time demo plot together with the function that advances it by one frame (adds new data,
+    adjusts ranges and replots). In the interactive application, the function is called by a timer.
+  */
+  struct RealtimeDemo
+  {
+    QCustomPlot *plot;
+    std::function<void()> update;
+  };
+
+  explicit MainWindow(QWidget *parent = nullptr, bool simulatedClock = false);
   ~MainWindow();
   
+  QList<RealtimeDemo> realtimeDemos() const { return _realtimeDemos; }
+  double demoTime() const;
+  double demoDateTimeKey() const;
+  void setSimulatedTime(double seconds);
+  
   void setupDemo(bool openGl);
   void setupQuadraticDemo(int row, int col, bool openGl);
   void setupSimpleDemo(int row, int col, bool openGl);
@@ -91,8 +109,16 @@ public:
 private slots:
   
 private:
+  void addRealtimeDemo(QCustomPlot *plot, int interval, const std::function<void()> &update);
+
   Ui::MainWindow *ui;
   QGridLayout *_loGrid;
+  QList<RealtimeDemo> _realtimeDemos;
+  bool _simulatedClock;
+  double _simulatedTime;
+  double _demoEpoch;
+  QElapsedTimer _demoClock;
+  QRandomGenerator _random;
 };
 
 #endif // MAINWINDOW_H
@@ -570,7 +570,8 @@ void QCPPainter::makeNonCosmetic()
 QCPAbstractPaintBuffer::QCPAbstractPaintBuffer(const QSize &size, double devicePixelRatio) :
     mSize(size),
     mDevicePixelRatio(devicePixelRatio),
-    mInvalidated(true)
+    mInvalidated(true),
+    mContentsUndefined(true)
 {
 }
 
@@ -592,6 +593,7 @@ void QCPAbstractPaintBuffer::setSize(const QSize &size)
     {
         mSize = size;
         reallocateBuffer();
+        mContentsUndefined = true;
     }
 }
 
@@ -631,6 +633,7 @@ void QCPAbstractPaintBuffer::setDevicePixelRatio(double ratio)
 #ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
         mDevicePixelRatio = ratio;
         reallocateBuffer();
+        mContentsUndefined = true;
 #else
         qDebug() << Q_FUNC_INFO << "Device pixel ratios not supported for Qt versions before 5.4";
         mDevicePixelRatio = 1.0;
@@ -647,6 +650,12 @@ void QCPAbstractPaintBuffer::setDevicePixelRatio(double ratio)
 
   This paint buffer is the default and fall-back paint buffer which uses software rendering and
   QPixmap as internal buffer. It is used if \ref QCustomPlot::setOpenGl is false.
+
+  The internal pixmap may be larger than the configured \ref setSize. When the buffer grows, the
+  pixmap capacity is increased geometrically, and when it shrinks, the existing pixmap is kept as
+  long as it isn't excessively large. This way, continuous resizing of the parent QCustomPlot (e.g.
+  while dragging a splitter) only causes a small number of pixmap allocations. Only the part of the
+  pixmap that corresponds to the current size is cleared (\ref clear) and drawn (\ref draw).
 */
 
 /*!
@@ -675,35 +684,196 @@ QCPPainter *QCPPaintBufferPixmap::startPainting()
 void QCPPaintBufferPixmap::draw(QCPPainter *painter) const
 {
     if (painter && painter->isActive())
-        painter->drawPixmap(0, 0, mBuffer);
-    else
+    {
+        const QSize usedSize = deviceSize();
+        if (mBuffer.size() == usedSize)
+            painter->drawPixmap(0, 0, mBuffer);
+        else
+            painter->drawPixmap(QPointF(0, 0), mBuffer, QRectF(QPointF(0, 0), usedSize)); // buffer has spare capacity, only draw the part in use
+    } else
         qDebug() << Q_FUNC_INFO << "invalid or inactive painter passed";
 }
 
 /* inherits documentation from base class */
 void QCPPaintBufferPixmap::clear(const QColor &color)
 {
-    mBuffer.fill(color);
+    if (mBuffer.isNull())
+        return;
+    if (mBuffer.size() == deviceSize())
+    {
+        mBuffer.fill(color);
+    } else // buffer has spare capacity, only fill the part in use
+    {
+        QPainter painter(&mBuffer);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.fillRect(QRect(QPoint(0, 0), mSize), color);
+    }
 }
 
 /* inherits documentation from base class */
 void QCPPaintBufferPixmap::reallocateBuffer()
 {
     setInvalidated();
+#ifndef QCP_DEVICEPIXELRATIO_SUPPORTED
     if (!qFuzzyCompare(1.0, mDevicePixelRatio))
     {
-#ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
-        mBuffer = QPixmap(mSize*mDevicePixelRatio);
-        mBuffer.setDevicePixelRatio(mDevicePixelRatio);
-#else
         qDebug() << Q_FUNC_INFO << "Device pixel ratios not supported for Qt versions before 5.4";
         mDevicePixelRatio = 1.0;
-        mBuffer = QPixmap(mSize);
+    }
 #endif
-    } else
+    const QSize requiredSize = deviceSize();
+    if (requiredSize.isEmpty())
+    {
+        mBuffer = QPixmap();
+        return;
+    }
+
+    // keep the current pixmap if it is large enough and not excessively oversized:
+    if (!mBuffer.isNull() &&
+#ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
+        qFuzzyCompare(mBuffer.devicePixelRatio(), mDevicePixelRatio) &&
+#endif
+        mBuffer.width() >= requiredSize.width() && mBuffer.height() >= requiredSize.height() &&
+        qint64(mBuffer.width())*qint64(mBuffer.height()) <= 4*qint64(requiredSize.width())*qint64(requiredSize.height()))
+    {
+        return;
+    }
+
+    // grow geometrically when enlarging an existing buffer, so continuous resizing doesn't reallocate on every step:
+    QSize newSize = requiredSize;
+    if (!mBuffer.isNull())
+    {
+        if (requiredSize.width() > mBuffer.width())
+            newSize.setWidth(qMax(requiredSize.width(), qRound(mBuffer.width()*1.5)));
+        if (requiredSize.height() > mBuffer.height())
+            newSize.setHeight(qMax(requiredSize.height(), qRound(mBuffer.height()*1.5)));
+    }
+    mBuffer = QPixmap(newSize);
+#ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
+    mBuffer.setDevicePixelRatio(mDevicePixelRatio);
+#endif
+    mBuffer.fill(Qt::transparent); // makes sure the pixmap has an alpha channel even if the first clear is elided
+}
+
+/*! \internal
+
+  Returns the size in device pixels of the part of the internal pixmap that is in use, i.e. the
+  buffer size (\ref setSize) multiplied by the device pixel ratio.
+*/
+QSize QCPPaintBufferPixmap::deviceSize() const
+{
+    return mSize*mDevicePixelRatio;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPDrawCache
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPDrawCache
+  \brief Holds the pixmap of a layerable's previous rendering, for reuse in subsequent replots
+
+  Layerables whose appearance only depends on a limited set of parameters (e.g. \ref QCPAxis and
+  \ref QCPGrid, if the plotting hint \ref QCP::phCacheAxes is set) can render themselves into a
+  QCPDrawCache instead of directly onto the layer's painter. On the next replot, the cached pixmap
+  is drawn again, as long as the parameters haven't changed.
+
+  The parameters are represented by a parameter hash, a QByteArray which the layerable generates
+  from all properties that influence its appearance. Before drawing, the layerable checks with \ref
+  isValid whether the cache was rendered with the same parameter hash and for the same rectangle.
+  If not, it obtains a painter with \ref startPainting, draws itself with that painter and finishes
+  with \ref donePainting. Finally, \ref draw transfers the cached pixmap to the layer's painter.
+*/
+
+/*!
+  Creates an empty draw cache. \ref isValid returns false until the cache was rendered with \ref
+  startPainting and \ref donePainting.
+*/
+QCPDrawCache::QCPDrawCache()
+{
+}
+
+/*!
+  Returns whether the cache holds a rendering of the area \a rect, created with the same \a
+  parameterHash. In that case the layerable may call \ref draw without rendering itself again.
+*/
+bool QCPDrawCache::isValid(const QRect &rect, const QByteArray &parameterHash) const
+{
+    return !mPixmap.isNull() && mRect == rect && mParameterHash == parameterHash;
+}
+
+/*!
+  Prepares the internal pixmap for the area \a rect (in logical pixels of the plot) at the given \a
+  devicePixelRatio, clears it and returns a painter which draws onto it. The painter uses the same
+  coordinate system as the layer painter, i.e. the layerable may draw with its usual pixel
+  coordinates. Painter modes and render hints (including the antialiasing state) are taken from \a
+  templatePainter. Drawing is clipped to \a rect.
+
+  The returned painter must be passed to \ref donePainting after drawing, which also deletes it.
+
+  Returns 0 if \a rect is empty.
+*/
+QCPPainter *QCPDrawCache::startPainting(const QRect &rect, double devicePixelRatio, const QCPPainter *templatePainter)
+{
+    mParameterHash.clear();
+    mRect = rect;
+    if (rect.isEmpty())
     {
-        mBuffer = QPixmap(mSize);
+        mPixmap = QPixmap();
+        return 0;
     }
+#ifndef QCP_DEVICEPIXELRATIO_SUPPORTED
+    devicePixelRatio = 1.0;
+#endif
+    const QSize deviceSize = rect.size()*devicePixelRatio;
+    if (mPixmap.size() != deviceSize)
+        mPixmap = QPixmap(deviceSize);
+#ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
+    mPixmap.setDevicePixelRatio(devicePixelRatio);
+#endif
+    mPixmap.fill(Qt::transparent);
+
+    QCPPainter *result = new QCPPainter(&mPixmap);
+    result->setModes(templatePainter->modes());
+    result->setRenderHints(templatePainter->renderHints() & ~QPainter::Antialiasing);
+    result->translate(-rect.topLeft());
+    result->setClipRect(rect);
+    result->setAntialiasing(templatePainter->antialiasing()); // also applies the antialiasing pixel shift of QCPPainter
+    return result;
+}
+
+/*!
+  Finishes rendering into the cache which was started with \ref startPainting, and deletes \a
+  painter. The cache is then considered valid for the \a parameterHash (see \ref isValid).
+*/
+void QCPDrawCache::donePainting(QCPPainter *painter, const QByteArray &parameterHash)
+{
+    delete painter;
+    mParameterHash = parameterHash;
+}
+
+/*!
+  Draws the cached pixmap with \a painter, at the position of the rectangle which was passed to
+  \ref startPainting.
+*/
+void QCPDrawCache::draw(QCPPainter *painter) const
+{
+    if (mPixmap.isNull())
+        return;
+    const bool antialiasingBackup = painter->antialiasing();
+    painter->setAntialiasing(false); // makes sure the pixmap isn't shifted by half a pixel
+    painter->drawPixmap(mRect.topLeft(), mPixmap);
+    painter->setAntialiasing(antialiasingBackup);
+}
+
+/*!
+  Releases the cached pixmap. The next call to \ref isValid returns false.
+*/
+void QCPDrawCache::clear()
+{
+    mPixmap = QPixmap();
+    mParameterHash.clear();
+    mRect = QRect();
 }
 
 
@@ -958,6 +1128,346 @@ void QCPPaintBufferGlFbo::reallocateBuffer()
 /* end of 'src/paintbuffer.cpp' */
 
 
+/* including file 'src/labelatlas.cpp'                                       */
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPLabelAtlas
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPLabelAtlas
+  \brief A process-wide cache of rendered tick labels and glyphs
+
+  When the plotting hint \ref QCP::phCacheLabels is set, axes draw their tick labels as pixmaps
+  which are kept in this atlas, so a label is only rendered once, as long as its text and
+  appearance don't change. The atlas is shared by all axes of all QCustomPlot instances in the
+  process, so axes with the same tick label font and color share their rendered labels.
+
+  Labels are looked up by a key which consists of all parameters that influence the rendering (font,
+  color, rotation, device pixel ratio, etc.) and the text. The labels are evicted in least recently
+  used order when their pixmaps exceed the capacity, see \ref setCapacity.
+
+  Additionally, the atlas holds glyph sets: the rendered glyphs of the characters numeric labels
+  consist of (digits, decimal and group separators and signs). Unrotated numeric labels are composed
+  from these glyphs (\ref drawComposed), so new numbers, e.g. on a scrolling axis, neither require
+  text layout nor new pixmaps.
+
+  The atlas is accessed with \ref instance. Like all pixmap operations, it may only be used in the
+  GUI thread.
+*/
+
+QCPLabelAtlas *QCPLabelAtlas::mInstance = 0;
+
+/*!
+  Returns the process-wide label atlas. It is created on the first call, and destroyed together
+  with the application object.
+*/
+QCPLabelAtlas *QCPLabelAtlas::instance()
+{
+    if (!mInstance)
+    {
+        mInstance = new QCPLabelAtlas;
+        qAddPostRoutine(&QCPLabelAtlas::destroyInstance); // the pixmaps must be freed before the application object is gone
+    }
+    return mInstance;
+}
+
+/*! \internal
+
+  Constructs the atlas with a capacity of 4 MB. Use \ref instance to access the atlas.
+*/
+QCPLabelAtlas::QCPLabelAtlas() :
+    mCapacity(0)
+{
+    setCapacity(4096);
+}
+
+QCPLabelAtlas::~QCPLabelAtlas()
+{
+    clear();
+}
+
+/*!
+  Sets the maximum memory the pixmaps of the cached labels may occupy, in kilobytes. When a new
+  label would exceed this capacity, the least recently used labels are evicted. Labels larger than
+  the capacity aren't cached at all.
+
+  The glyph sets aren't counted, they are small and their number is limited separately.
+*/
+void QCPLabelAtlas::setCapacity(int kilobytes)
+{
+    mCapacity = qBound(0, kilobytes, (std::numeric_limits<int>::max)()/1024);
+    mLabels.setMaxCost(mCapacity*1024);
+}
+
+/*!
+  Returns the label cached with \a key, or 0 if there is none. The returned pointer is only valid
+  until the next label is inserted.
+*/
+const QCPLabelAtlas::Label *QCPLabelAtlas::label(const QByteArray &key) const
+{
+    return mLabels.object(key);
+}
+
+/*!
+  Inserts a copy of \a label with \a key into the atlas, replacing an existing label with the same
+  key. Copying is cheap, since the pixmap is implicitly shared.
+*/
+void QCPLabelAtlas::insertLabel(const QByteArray &key, const Label &label)
+{
+    const int cost = qMax(1, label.pixmap.width()*label.pixmap.height()*4);
+    mLabels.insert(key, new Label(label), cost);
+}
+
+/*!
+  Returns the glyph set stored with \a key, or 0 if there is none. Use \ref createGlyphSet to
+  create it in that case. The returned pointer is only valid until the next glyph set is created.
+*/
+const QCPLabelAtlas::GlyphSet *QCPLabelAtlas::glyphSet(const QByteArray &key) const
+{
+    return mGlyphSets.value(key, 0);
+}
+
+/*!
+  Renders the glyphs of the characters that numeric labels consist of with \a font and \a color at
+  \a devicePixelRatio, and stores them with \a key. \a key must identify these three parameters.
+
+  If too many glyph sets are stored already, all glyph sets are discarded first, so pointers
+  returned by earlier \ref glyphSet calls become invalid.
+*/
+const QCPLabelAtlas::GlyphSet *QCPLabelAtlas::createGlyphSet(const QByteArray &key, const QFont &font, const QColor &color, double devicePixelRatio)
+{
+    if (mGlyphSets.size() >= 64) // glyph sets of fonts/colors which are no longer in use accumulate otherwise
+    {
+        qDeleteAll(mGlyphSets);
+        mGlyphSets.clear();
+    }
+    delete mGlyphSets.take(key);
+
+    const QString characters = QLatin1String("0123456789.,-+ ");
+    GlyphSet *glyphs = new GlyphSet;
+    memset(glyphs->glyphIndex, -1, sizeof(glyphs->glyphIndex));
+    QFontMetricsF metrics(font);
+    glyphs->height = qCeil(metrics.height());
+    glyphs->ascent = qCeil(metrics.ascent());
+    for (int i=0; i<characters.size(); ++i)
+    {
+        const QChar character = characters.at(i);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+        const double advance = metrics.horizontalAdvance(character);
+#else
+        const double advance = metrics.width(character);
+#endif
+        const QSize size(qCeil(advance)+2, glyphs->height); // one pixel padding on each side for antialiasing
+        QPixmap pixmap;
+        if (!qFuzzyCompare(1.0, devicePixelRatio))
+        {
+            pixmap = QPixmap(size*devicePixelRatio);
+#ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
+            pixmap.setDevicePixelRatio(devicePixelRatio);
+#endif
+        } else
+            pixmap = QPixmap(size);
+        pixmap.fill(Qt::transparent);
+        QCPPainter glyphPainter(&pixmap);
+        glyphPainter.setFont(font);
+        glyphPainter.setPen(color);
+        glyphPainter.drawText(QPointF(1, glyphs->ascent), QString(character));
+        glyphPainter.end();
+
+        glyphs->glyphIndex[character.unicode()] = i;
+        glyphs->pixmaps.append(pixmap);
+        glyphs->advances.append(advance);
+    }
+    mGlyphSets.insert(key, glyphs);
+    return glyphs;
+}
+
+/*!
+  Discards all cached labels and glyph sets.
+*/
+void QCPLabelAtlas::clear()
+{
+    mLabels.clear();
+    qDeleteAll(mGlyphSets);
+    mGlyphSets.clear();
+}
+
+/*!
+  Returns whether \a text can be composed from the glyphs of \a glyphs, i.e. whether all of its
+  characters have glyphs. If so, the width of the composed label in pixels is written to \a width.
+
+  \see drawComposed
+*/
+bool QCPLabelAtlas::composedWidth(const GlyphSet *glyphs, const QString &text, int *width)
+{
+    double result = 0;
+    const int length = text.size();
+    const QChar *characters = text.constData();
+    for (int i=0; i<length; ++i)
+    {
+        const ushort code = characters[i].unicode();
+        if (code >= 128 || glyphs->glyphIndex[code] < 0)
+            return false;
+        result += glyphs->advances.at(glyphs->glyphIndex[code]);
+    }
+    *width = qCeil(result);
+    return true;
+}
+
+/*!
+  Draws \a text with \a painter by composing it from the glyphs of \a glyphs. \a topLeft is the top
+  left corner of the text, like for QPainter::drawText with a rectangle. All characters of \a text
+  must have glyphs, see \ref composedWidth.
+*/
+void QCPLabelAtlas::drawComposed(QCPPainter *painter, const QPointF &topLeft, const GlyphSet *glyphs, const QString &text)
+{
+    double x = topLeft.x()-1; // glyph pixmaps have one pixel padding on the left side
+    const int length = text.size();
+    const QChar *characters = text.constData();
+    for (int i=0; i<length; ++i)
+    {
+        const int index = glyphs->glyphIndex[characters[i].unicode()];
+        painter->drawPixmap(QPointF(x, topLeft.y()), glyphs->pixmaps.at(index));
+        x += glyphs->advances.at(index);
+    }
+}
+
+/*! \internal
+
+  Destroys the atlas instance. This is registered as post routine of the application object in
+  \ref instance.
+*/
+void QCPLabelAtlas::destroyInstance()
+{
+    delete mInstance;
+    mInstance = 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPCachedText
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPCachedText
+  \brief Caches the layout and the rendering of one text
+
+  Text elements and items typically draw the same text frame after frame, or change it only
+  occasionally (e.g. a value display). Measuring text with QFontMetrics::boundingRect and laying it
+  out in QPainter::drawText is expensive compared to drawing a pixmap, so layerables which draw text
+  keep one instance of this class per text they draw.
+
+  \ref boundingRect measures a text and returns the cached result as long as font, flags, text and
+  the size of the layout rect stay the same. \ref draw additionally renders the text into a pixmap
+  once, and then only blits that pixmap, until the text or its color change. Since the pixmap can't
+  be transformed without losing quality, it is only used for painters with at most a translation
+  and without the QCPPainter::pmNoCaching mode (exports), otherwise the text is drawn directly.
+*/
+
+/*!
+  Creates an empty text cache.
+*/
+QCPCachedText::QCPCachedText() :
+    mFlags(0),
+    mDpi(0),
+    mBoundingRectValid(false),
+    mPixmapRatio(1),
+    mPixmapValid(false)
+{
+}
+
+/*!
+  Returns the bounding rect of \a text drawn with \a font and \a flags into \a rect, like
+  QFontMetrics::boundingRect(rect, flags, text). If \a device is non-zero, the font metrics of that
+  paint device are used.
+
+  The text is only measured again if the font, the flags, the text, the resolution of \a device or
+  the size of \a rect changed since the last call. A changed position of \a rect only translates the
+  cached result.
+*/
+QRect QCPCachedText::boundingRect(const QFont &font, const QRect &rect, int flags, const QString &text, QPaintDevice *device)
+{
+    const int dpi = device ? device->logicalDpiY() : 0;
+    if (!mBoundingRectValid || flags != mFlags || dpi != mDpi || rect.size() != mSize || text != mText || font != mFont)
+    {
+        const QFontMetrics metrics = device ? QFontMetrics(font, device) : QFontMetrics(font);
+        mBoundingRect = metrics.boundingRect(QRect(QPoint(0, 0), rect.size()), flags, text);
+        mFont = font;
+        mSize = rect.size();
+        mFlags = flags;
+        mDpi = dpi;
+        mText = text;
+        mBoundingRectValid = true;
+        mPixmapValid = false;
+    }
+    return mBoundingRect.translated(rect.topLeft());
+}
+
+/*!
+  Draws \a text with the font and pen color of \a painter and \a flags into \a rect, like
+  QPainter::drawText(rect, flags, text). If \a boundingRect is non-zero, it receives the bounding
+  rect of the drawn text.
+
+  If \a usePixmap is true and the painter allows it (see the class documentation), the text is drawn
+  from a cached pixmap. Callers typically pass whether the plotting hint \ref QCP::phCacheLabels is
+  set.
+*/
+void QCPCachedText::draw(QCPPainter *painter, const QRect &rect, int flags, const QString &text, bool usePixmap, QRect *boundingRect)
+{
+    const QRect textRect = this->boundingRect(painter->font(), rect, flags, text, painter->device());
+    if (boundingRect)
+        *boundingRect = textRect;
+    if (text.isEmpty())
+        return;
+    if (!usePixmap || !painter->device() || painter->modes().testFlag(QCPPainter::pmNoCaching) || painter->transform().type() > QTransform::TxTranslate)
+    {
+        painter->drawText(rect, flags, text);
+        return;
+    }
+
+    const int padding = 2; // the bounding rect may be slightly smaller than the glyphs, e.g. for italic fonts
+    const QColor color = painter->pen().color();
+    double ratio = 1;
+#ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
+#  ifdef QCP_DEVICEPIXELRATIO_FLOAT
+    ratio = painter->device()->devicePixelRatioF();
+#  else
+    ratio = painter->device()->devicePixelRatio();
+#  endif
+#endif
+    if (!mPixmapValid || color != mPixmapColor || ratio != mPixmapRatio)
+    {
+        mPixmap = QPixmap((textRect.size()+QSize(2*padding, 2*padding))*ratio);
+#ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
+        mPixmap.setDevicePixelRatio(ratio);
+#endif
+        mPixmap.fill(Qt::transparent);
+        QPainter pixmapPainter(&mPixmap);
+        pixmapPainter.setRenderHints(painter->renderHints());
+        pixmapPainter.setFont(painter->font());
+        pixmapPainter.setPen(color);
+        pixmapPainter.drawText(QRect(QPoint(padding, padding), textRect.size()), flags, text);
+        pixmapPainter.end();
+        mPixmapColor = color;
+        mPixmapRatio = ratio;
+        mPixmapValid = true;
+    }
+    painter->drawPixmap(textRect.topLeft()-QPoint(padding, padding), mPixmap);
+}
+
+/*!
+  Discards the cached measurement and pixmap, e.g. to free the pixmap memory.
+*/
+void QCPCachedText::clear()
+{
+    mBoundingRectValid = false;
+    mPixmapValid = false;
+    mPixmap = QPixmap();
+    mText.clear();
+}
+
+/* end of 'src/labelatlas.cpp' */
+
+
 /* including file 'src/layer.cpp', size 37304                                */
 /* commit ce344b3f96a62e5f652585e55f1ae7c7883cd45b 2018-06-25 01:03:39 +0200 */
 
@@ -1125,15 +1635,30 @@ void QCPLayer::setMode(QCPLayer::LayerMode mode)
 */
 void QCPLayer::draw(QCPPainter *painter)
 {
+    const bool profiling = mParentPlot->mProfiling && mParentPlot->mReplotting;
+    QElapsedTimer profileTimer;
     foreach (QCPLayerable *child, mChildren)
     {
         if (child->realVisibility())
         {
+            if (profiling)
+                profileTimer.start();
             painter->save();
             painter->setClipRect(child->clipRect().translated(0, -1));
             child->applyDefaultAntialiasingHint(painter);
-            child->draw(painter);
+            QCPAbstractPlottable *plottable = qobject_cast<QCPAbstractPlottable*>(child);
+            if (plottable && plottable->rangePreviewActive() && !painter->modes().testFlag(QCPPainter::pmNoCaching))
+                plottable->drawRangePreview(painter);
+            else
+                child->draw(painter);
             painter->restore();
+            if (profiling)
+            {
+                QString name = QLatin1String(child->metaObject()->className());
+                if (!child->objectName().isEmpty())
+                    name += QLatin1Char(' ') + child->objectName();
+                mParentPlot->mCurrentProfile.layerableTimings.append(QCPReplotProfile::Timing(name, mName, profileTimer.nsecsElapsed()));
+            }
         }
     }
 }
@@ -1164,6 +1689,33 @@ void QCPLayer::drawToPaintBuffer()
         qDebug() << Q_FUNC_INFO << "no valid paint buffer associated with this layer";
 }
 
+/*! \internal
+
+  Returns the region that is guaranteed to be covered with fully opaque content when this layer is
+  drawn. It is the union of the \ref QCPLayerable::opaqueRect of all visible children, each
+  restricted to the clip rect it is drawn with.
+
+  This is used to avoid clearing paint buffers that are going to be completely overwritten.
+
+  \see QCustomPlot::setupPaintBuffers
+*/
+QRegion QCPLayer::opaqueRegion() const
+{
+    QRegion result;
+    if (!mVisible)
+        return result;
+    foreach (QCPLayerable *child, mChildren)
+    {
+        if (child->realVisibility())
+        {
+            const QRect rect = child->opaqueRect() & child->clipRect().translated(0, -1);
+            if (!rect.isEmpty())
+                result += rect;
+        }
+    }
+    return result;
+}
+
 /*!
   If the layer mode (\ref setMode) is set to \ref lmBuffered, this method allows replotting only
   the layerables on this specific layer, without the need to replot all other layers (as a call to
@@ -1183,7 +1735,12 @@ void QCPLayer::replot()
     {
         if (!mPaintBuffer.isNull())
         {
-            mPaintBuffer.data()->clear(Qt::transparent);
+            const QRect bufferRect(QPoint(0, 0), mPaintBuffer.data()->size());
+            if (mPaintBuffer.data()->mContentsUndefined || !opaqueRegion().contains(bufferRect & bufferRect.translated(0, -1)))
+            {
+                mPaintBuffer.data()->clear(Qt::transparent);
+                mPaintBuffer.data()->mContentsUndefined = false;
+            }
             drawToPaintBuffer();
             mPaintBuffer.data()->setInvalidated(false);
             mParentPlot->update();
@@ -1213,6 +1770,7 @@ void QCPLayer::addChild(QCPLayerable *layerable, bool prepend)
             mChildren.append(layerable);
         if (!mPaintBuffer.isNull())
             mPaintBuffer.data()->setInvalidated();
+        mParentPlot->mLayerableIndexValid = false;
     } else
         qDebug() << Q_FUNC_INFO << "layerable is already child of this layer" << reinterpret_cast<quintptr>(layerable);
 }
@@ -1232,6 +1790,7 @@ void QCPLayer::removeChild(QCPLayerable *layerable)
     {
         if (!mPaintBuffer.isNull())
             mPaintBuffer.data()->setInvalidated();
+        mParentPlot->mLayerableIndexValid = false;
     } else
         qDebug() << Q_FUNC_INFO << "layerable is not child of this layer" << reinterpret_cast<quintptr>(layerable);
 }
@@ -1641,14 +2200,48 @@ QRect QCPLayerable::clipRect() const
 
 /*! \internal
 
-  This event is called when the layerable shall be selected, as a consequence of a click by the
-  user. Subclasses should react to it by setting their selection state appropriately. The default
-  implementation does nothing.
-
-  \a event is the mouse event that caused the selection. \a additive indicates, whether the user
-  was holding the multi-select-modifier while performing the selection (see \ref
-  QCustomPlot::setMultiSelectModifier). if \a additive is true, the selection state must be toggled
-  (i.e. become selected when unselected and unselected when selected).
+  Returns the rectangle (in pixel coordinates of the paint buffer) which this layerable is
+  guaranteed to cover completely with fully opaque content when its \ref draw method is called.
+
+  QCustomPlot uses this information to skip clearing paint buffers whose entire area is going to be
+  overwritten anyway (see \ref QCustomPlot::setupPaintBuffers). Reimplementations must therefore be
+  conservative: if in doubt, return a smaller rect. The default implementation returns an empty
+  rect, meaning no opaque coverage is guaranteed.
+*/
+QRect QCPLayerable::opaqueRect() const
+{
+    return QRect();
+}
+
+/*! \internal
+
+  Returns the rectangle (in pixel coordinates) which contains all points where this layerable's
+  \ref selectTest may report a hit, not including the selection tolerance. In other words, \ref
+  selectTest must return -1 or a distance larger than the selection tolerance for all points which
+  are further than the selection tolerance away from the returned rect. \a foundBounds indicates
+  whether such a rect is known. If it is false, the returned rect must not be used.
+
+  QCustomPlot uses the bounds to build a spatial index over all layerables, so \ref
+  QCustomPlot::layerableListAt only needs to call \ref selectTest of layerables near the queried
+  position. The default implementation sets \a foundBounds to false, so the layerable is always
+  tested.
+*/
+QRectF QCPLayerable::selectTestBounds(bool &foundBounds) const
+{
+    foundBounds = false;
+    return QRectF();
+}
+
+/*! \internal
+
+  This event is called when the layerable shall be selected, as a consequence of a click by the
+  user. Subclasses should react to it by setting their selection state appropriately. The default
+  implementation does nothing.
+
+  \a event is the mouse event that caused the selection. \a additive indicates, whether the user
+  was holding the multi-select-modifier while performing the selection (see \ref
+  QCustomPlot::setMultiSelectModifier). if \a additive is true, the selection state must be toggled
+  (i.e. become selected when unselected and unselected when selected).
 
   Every selectEvent is preceded by a call to \ref selectTest, which has returned positively (i.e.
   returned a value greater than 0 and less than the selection tolerance of the parent QCustomPlot).
@@ -3021,7 +3614,8 @@ void QCPSelectionRect::draw(QCPPainter *painter)
 */
 QCPMarginGroup::QCPMarginGroup(QCustomPlot *parentPlot) :
     QObject(parentPlot),
-    mParentPlot(parentPlot)
+    mParentPlot(parentPlot),
+    mPassMarginsPass(-1)
 {
     mChildren.insert(QCP::msLeft, QList<QCPLayoutElement*>());
     mChildren.insert(QCP::msRight, QList<QCPLayoutElement*>());
@@ -3093,6 +3687,34 @@ int QCPMarginGroup::commonMargin(QCP::MarginSide side) const
     return result;
 }
 
+/*! \internal
+
+  Returns the common margin for \a side (see \ref commonMargin), calculating it only once per
+  layout pass of the parent plot.
+
+  Every layout element of the margin group requests the common margin during the margin phase of
+  the layout update, so without memoization, the automatic margins of all elements would be
+  calculated once per element, i.e. quadratically in the number of elements. Within one pass, the
+  result can't change, because the automatic margins don't depend on the margins set during the
+  pass.
+*/
+int QCPMarginGroup::passCommonMargin(QCP::MarginSide side)
+{
+    if (!mParentPlot)
+        return commonMargin(side);
+    if (mPassMarginsPass != mParentPlot->mLayoutPass)
+    {
+        mPassMargins.clear();
+        mPassMarginsPass = mParentPlot->mLayoutPass;
+    }
+    QHash<QCP::MarginSide, int>::const_iterator it = mPassMargins.constFind(side);
+    if (it != mPassMargins.constEnd())
+        return it.value();
+    const int result = commonMargin(side);
+    mPassMargins.insert(side, result);
+    return result;
+}
+
 /*! \internal
 
   Adds \a element to the internal list of child elements, for the margin \a side.
@@ -3430,7 +4052,7 @@ void QCPLayoutElement::update(UpdatePhase phase)
                 if (mAutoMargins.testFlag(side)) // this side's margin shall be calculated automatically
                 {
                     if (mMarginGroups.contains(side))
-                        QCP::setMarginValue(newMargins, side, mMarginGroups[side]->commonMargin(side)); // this side is part of a margin group, so get the margin value from that group
+                        QCP::setMarginValue(newMargins, side, mMarginGroups[side]->passCommonMargin(side)); // this side is part of a margin group, so get the margin value from that group
                     else
                         QCP::setMarginValue(newMargins, side, calculateAutoMargin(side)); // this side is not part of a group, so calculate the value directly
                     // apply minimum margin restrictions:
@@ -4577,8 +5199,25 @@ void QCPLayoutGrid::updateLayout()
 
     int totalRowSpacing = (rowCount()-1) * mRowSpacing;
     int totalColSpacing = (columnCount()-1) * mColumnSpacing;
-    QVector<int> colWidths = getSectionSizes(maxColWidths, minColWidths, mColumnStretchFactors.toVector(), mRect.width()-totalColSpacing);
-    QVector<int> rowHeights = getSectionSizes(maxRowHeights, minRowHeights, mRowStretchFactors.toVector(), mRect.height()-totalRowSpacing);
+
+    // the section sizes only need to be recalculated if the available space, the size constraints
+    // of the elements or the stretch factors have changed since the last call:
+    QVector<double> sectionInput;
+    sectionInput.reserve(4+2*(minColWidths.size()+minRowHeights.size())+mColumnStretchFactors.size()+mRowStretchFactors.size());
+    sectionInput << columnCount() << rowCount() << mRect.width()-totalColSpacing << mRect.height()-totalRowSpacing;
+    for (int i=0; i<minColWidths.size(); ++i)
+        sectionInput << minColWidths.at(i) << maxColWidths.at(i);
+    for (int i=0; i<minRowHeights.size(); ++i)
+        sectionInput << minRowHeights.at(i) << maxRowHeights.at(i);
+    sectionInput << mColumnStretchFactors.toVector() << mRowStretchFactors.toVector();
+    if (sectionInput != mSectionInput)
+    {
+        mColumnWidths = getSectionSizes(maxColWidths, minColWidths, mColumnStretchFactors.toVector(), mRect.width()-totalColSpacing);
+        mRowHeights = getSectionSizes(maxRowHeights, minRowHeights, mRowStretchFactors.toVector(), mRect.height()-totalRowSpacing);
+        mSectionInput = sectionInput;
+    }
+    const QVector<int> &colWidths = mColumnWidths;
+    const QVector<int> &rowHeights = mRowHeights;
 
     // go through cells and set rects accordingly:
     int yOffset = mRect.top();
@@ -5438,6 +6077,271 @@ void QCPLineEnding::draw(QCPPainter *painter, const QCPVector2D &pos, double ang
 /* end of 'src/lineending.cpp' */
 
 
+/* including file 'src/axis/numberformatter.cpp'                            */
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPNumberFormatter
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPNumberFormatter
+  \brief Converts numbers to strings like QLocale::toString, without temporary strings
+
+  Axis tickers create a tick label for every new tick coordinate. QLocale::toString allocates
+  several temporary strings per number and looks up the locale's symbols for every call. This
+  class fetches the symbols of a locale once (\ref setLocale) and renders numbers digit by digit
+  into a stack buffer (\ref format), so only the returned QString is allocated.
+
+  The result is identical to <tt>QLocale::toString(value, formatChar, precision)</tt> with the
+  format characters 'e', 'E', 'f', 'g' and 'G', including group separators, exponent padding and
+  the number options of the locale. The digits are obtained by scaling the value with an exact
+  power of ten and rounding it to an integer of at most 15 digits. Values for which this can't be
+  decided reliably (e.g. more than 15 significant digits, or a value lying on a rounding tie) are
+  passed on to QLocale::toString by \ref toString.
+
+  QCPAxisTicker uses this class for the default numeric tick labels.
+*/
+
+/*!
+  Creates a number formatter for the C locale.
+*/
+QCPNumberFormatter::QCPNumberFormatter() :
+    mGroupDigits(false),
+    mZeroPadExponent(true),
+    mTrailingZeroes(false)
+{
+    setLocale(QLocale::c());
+}
+
+/*!
+  Sets the locale whose symbols (digits, decimal point, group separator, signs and exponent
+  character) and number options are used by \ref toString and \ref format.
+
+  The symbols are fetched from \a locale once in this method, so changing the locale is
+  comparatively expensive and should only happen when it actually differs from \ref locale.
+*/
+void QCPNumberFormatter::setLocale(const QLocale &locale)
+{
+    mLocale = locale;
+    mZeroDigit = locale.zeroDigit();
+    mDecimalPoint = locale.decimalPoint();
+    mGroupSeparator = locale.groupSeparator();
+    mExponential = locale.exponential();
+    mPlusSign = locale.positiveSign();
+    mMinusSign = locale.negativeSign();
+    mGroupDigits = !locale.numberOptions().testFlag(QLocale::OmitGroupSeparator);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 7, 0)
+    mZeroPadExponent = !locale.numberOptions().testFlag(QLocale::OmitLeadingZeroInExponent);
+    mTrailingZeroes = locale.numberOptions().testFlag(QLocale::IncludeTrailingZeroesAfterDot);
+#endif
+}
+
+/*!
+  Returns \a value converted to a string, in the same way as <tt>QLocale::toString(value,
+  formatChar, precision)</tt> with the locale set by \ref setLocale.
+
+  \see format
+*/
+QString QCPNumberFormatter::toString(double value, QChar formatChar, int precision) const
+{
+    QVarLengthArray<QChar, 64> buffer;
+    if (format(value, formatChar.toLatin1(), precision, buffer))
+        return QString(buffer.constData(), buffer.size());
+    else
+        return mLocale.toString(value, formatChar.toLatin1(), precision);
+}
+
+/*!
+  Appends the string representation of \a value to \a buffer, with the format character \a
+  formatChar ('e', 'E', 'f', 'g' or 'G') and \a precision as defined by QLocale::toString.
+
+  Returns false and leaves \a buffer unchanged if the value can't be formatted without
+  QLocale::toString (see the class documentation), or if \a value isn't finite.
+*/
+bool QCPNumberFormatter::format(double value, char formatChar, int precision, QVarLengthArray<QChar, 64> &buffer) const
+{
+    const bool capital = formatChar == 'E' || formatChar == 'G';
+    const char form = capital ? char(formatChar+('a'-'A')) : formatChar;
+    if ((form != 'e' && form != 'f' && form != 'g') || !qIsFinite(value))
+        return false;
+    if (precision < 0)
+    {
+        if (precision != -1)
+            return false;
+        precision = 6;
+    }
+
+    // generate the significant digits and the position of the decimal point relative to them:
+    char digits[20];
+    int digitCount, decimalPoint;
+    if (value == 0) // also -0.0, which QLocale displays without sign
+    {
+        digits[0] = '0';
+        digitCount = 1;
+        decimalPoint = 1;
+    } else if (!roundDigits(qAbs(value), form, precision, digits, &digitCount, &decimalPoint))
+        return false;
+
+    const int start = buffer.size();
+    if (value < 0)
+        buffer.append(mMinusSign);
+    char work[64];
+    int length = 0;
+    if (form == 'e' || (form == 'g' && (decimalPoint-1 < -4 || decimalPoint > precision))) // exponent form
+    {
+        const int minimumDigits = form == 'e' ? precision+1 : (mTrailingZeroes ? precision : 0);
+        for (int i=0; i<digitCount; ++i)
+            work[length++] = digits[i];
+        while (length < minimumDigits && length < 64)
+            work[length++] = '0';
+        appendDigits(buffer, work, 1);
+        if (length > 1)
+        {
+            buffer.append(mDecimalPoint);
+            appendDigits(buffer, work+1, length-1);
+        }
+        const int exponent = decimalPoint-1;
+        buffer.append(capital ? mExponential.toUpper() : mExponential);
+        buffer.append(exponent < 0 ? mMinusSign : mPlusSign);
+        char exponentDigits[4];
+        int exponentDigitCount = 0;
+        for (int remaining = qAbs(exponent); remaining > 0 || exponentDigitCount < (mZeroPadExponent ? 2 : 1); remaining /= 10)
+            exponentDigits[3-exponentDigitCount++] = char('0'+remaining%10);
+        appendDigits(buffer, exponentDigits+4-exponentDigitCount, exponentDigitCount);
+    } else // decimal form
+    {
+        int point = decimalPoint;
+        if (point < 0) // leading zeros after the decimal point
+        {
+            while (length < -point)
+                work[length++] = '0';
+            point = 0;
+        }
+        for (int i=0; i<digitCount; ++i)
+            work[length++] = digits[i];
+        while (length < point) // trailing zeros before the decimal point
+            work[length++] = '0';
+        if (form == 'f')
+        {
+            while (length-point < precision && length < 64)
+                work[length++] = '0';
+        } else if (mTrailingZeroes)
+        {
+            while (length < precision && length < 64)
+                work[length++] = '0';
+        }
+        if (point == 0)
+            buffer.append(mZeroDigit);
+        for (int i=0; i<point; ++i)
+        {
+            if (mGroupDigits && i > 0 && (point-i)%3 == 0)
+                buffer.append(mGroupSeparator);
+            appendDigits(buffer, work+i, 1);
+        }
+        if (point < length)
+        {
+            buffer.append(mDecimalPoint);
+            appendDigits(buffer, work+point, length-point);
+        }
+    }
+    if (capital) // QLocale upper-cases the whole string in this case
+    {
+        for (int i=start; i<buffer.size(); ++i)
+            buffer[i] = buffer.at(i).toUpper();
+    }
+    return true;
+}
+
+/*! \internal
+
+  Rounds the positive, finite \a value to the digits required by the format \a formatChar ('e',
+  'f' or 'g', lower case) and \a precision. The digits are written as latin1 characters to \a
+  digits without trailing zeros, their number to \a digitCount. \a decimalPoint receives the
+  position of the decimal point relative to the first digit (e.g. 2 for 12.5, -1 for 0.0125).
+
+  The value is scaled by an exact power of ten, such that the digits to keep form the integer part,
+  and then rounded. The scaling introduces an error of at most half a unit in the last place, so if
+  the fractional part is too close to 0.5 to determine the rounding direction, or more than 15
+  digits are required, this method returns false.
+*/
+bool QCPNumberFormatter::roundDigits(double value, char formatChar, int precision, char *digits, int *digitCount, int *decimalPoint) const
+{
+    static const double powersOfTen[23] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                           1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22}; // all exactly representable
+    const int significantDigits = formatChar == 'e' ? precision+1 : qMax(precision, 1); // not used for 'f'
+    int exponent = qFloor(std::log10(value)); // decimal exponent of the first digit, may be off by one close to powers of ten
+    qint64 rounded = 0;
+    bool done = false;
+    for (int attempt=0; attempt<3 && !done; ++attempt)
+    {
+        const int shift = formatChar == 'f' ? precision : significantDigits-1-exponent;
+        if (shift > 22 || shift < -22)
+            return false;
+        const double scaled = shift >= 0 ? value*powersOfTen[shift] : value/powersOfTen[-shift];
+        if (!(scaled < 1e15))
+            return false;
+        const double floored = std::floor(scaled);
+        const double fraction = scaled-floored;
+        if (qAbs(fraction-0.5) < scaled*4e-16) // too close to a rounding tie to decide with the scaled value
+            return false;
+        rounded = qint64(floored) + (fraction > 0.5 ? 1 : 0);
+        if (formatChar == 'f')
+        {
+            done = true;
+        } else
+        {
+            qint64 lowest = 1;
+            for (int i=1; i<significantDigits; ++i)
+                lowest *= 10;
+            if (rounded < lowest) // exponent estimate was too large
+            {
+                --exponent;
+            } else if (rounded >= lowest*10)
+            {
+                if (floored < lowest*10) // rounding carried into an additional digit, e.g. 9.997 -> 10.00
+                {
+                    rounded /= 10;
+                    ++exponent;
+                    done = true;
+                } else // exponent estimate was too small
+                    ++exponent;
+            } else
+                done = true;
+        }
+    }
+    if (!done || rounded == 0) // zero only happens for 'f' with values below the precision, whose sign handling is left to QLocale
+        return false;
+
+    char reversed[20];
+    int count = 0;
+    while (rounded > 0)
+    {
+        reversed[count++] = char('0'+rounded%10);
+        rounded /= 10;
+    }
+    *decimalPoint = formatChar == 'f' ? count-precision : exponent+1;
+    int firstDigit = 0;
+    while (firstDigit < count-1 && reversed[firstDigit] == '0') // trailing zeros are dropped, like QLocale does before formatting
+        ++firstDigit;
+    *digitCount = count-firstDigit;
+    for (int i=0; i<*digitCount; ++i)
+        digits[i] = reversed[count-1-i];
+    return true;
+}
+
+/*! \internal
+
+  Appends the \a count latin1 digits in \a digits to \a buffer, mapped to the digits of the
+  locale (\ref setLocale).
+*/
+void QCPNumberFormatter::appendDigits(QVarLengthArray<QChar, 64> &buffer, const char *digits, int count) const
+{
+    const ushort zero = mZeroDigit.unicode();
+    for (int i=0; i<count; ++i)
+        buffer.append(QChar(ushort(zero+(digits[i]-'0'))));
+}
+/* end of 'src/axis/numberformatter.cpp' */
+
+
 /* including file 'src/axis/axisticker.cpp', size 18664                      */
 /* commit ce344b3f96a62e5f652585e55f1ae7c7883cd45b 2018-06-25 01:03:39 +0200 */
 
@@ -5495,6 +6399,13 @@ void QCPLineEnding::draw(QCPPainter *painter, const QCPVector2D &pos, double ang
 
   See the documentation of all these virtual methods in QCPAxisTicker for detailed information
   about the parameters and expected return values.
+
+  \note The built-in tickers cache the generated ticks and labels (see \ref setCaching), except for
+  QCPAxisTickerText. Caching is disabled for instances constructed directly via the QCPAxisTicker
+  constructor, so own subclasses of QCPAxisTicker behave as before unless they opt in. However, a
+  subclass of one of the built-in tickers (e.g. of QCPAxisTickerDateTime) inherits its enabled
+  caching. If the ticks or labels of such a subclass depend on own members, it must either call
+  \ref invalidateCache whenever they change, or disable caching with \ref setCaching.
 */
 
 /*!
@@ -5504,7 +6415,14 @@ void QCPLineEnding::draw(QCPPainter *painter, const QCPVector2D &pos, double ang
 QCPAxisTicker::QCPAxisTicker() :
     mTickStepStrategy(tssReadability),
     mTickCount(5),
-    mTickOrigin(0)
+    mTickOrigin(0),
+    mCachingEnabled(false),
+    mCacheValid(false),
+    mCachedSubTicksValid(false),
+    mCachedLabelsValid(false),
+    mUseLabelPool(false),
+    mCachedPrecision(0),
+    mLabelPoolTickStep(0)
 {
 }
 
@@ -5520,6 +6438,7 @@ QCPAxisTicker::~QCPAxisTicker()
 void QCPAxisTicker::setTickStepStrategy(QCPAxisTicker::TickStepStrategy strategy)
 {
     mTickStepStrategy = strategy;
+    invalidateCache();
 }
 
 /*!
@@ -5533,11 +6452,29 @@ void QCPAxisTicker::setTickStepStrategy(QCPAxisTicker::TickStepStrategy strategy
 void QCPAxisTicker::setTickCount(int count)
 {
     if (count > 0)
+    {
         mTickCount = count;
-    else
+        invalidateCache();
+    } else
         qDebug() << Q_FUNC_INFO << "tick count must be greater than zero:" << count;
 }
 
+/*!
+  Sets whether \ref generate caches the generated ticks and labels. If enabled, a call with the same
+  range and formatting parameters as the previous call returns the previous result, and the labels
+  of ticks which stay visible when the range is panned are reused (see \ref generate).
+
+  Caching is disabled for plain QCPAxisTicker instances and own subclasses of QCPAxisTicker, and
+  enabled by the built-in ticker subclasses (except QCPAxisTickerText) as well as for the default
+  ticker of QCPAxis. Only enable it for tickers which call \ref invalidateCache whenever a
+  parameter changes that influences the ticks or labels.
+*/
+void QCPAxisTicker::setCaching(bool enabled)
+{
+    mCachingEnabled = enabled;
+    invalidateCache();
+}
+
 /*!
   Sets the mathematical coordinate (or "offset") of the zeroth tick. This tick coordinate is just a
   concept and doesn't need to be inside the currently visible axis range.
@@ -5549,6 +6486,7 @@ void QCPAxisTicker::setTickCount(int count)
 void QCPAxisTicker::setTickOrigin(double origin)
 {
     mTickOrigin = origin;
+    invalidateCache();
 }
 
 /*!
@@ -5563,9 +6501,30 @@ void QCPAxisTicker::setTickOrigin(double origin)
   The output parameters \a subTicks and \a tickLabels are optional (set them to 0 if not needed)
   and are respectively filled with sub tick coordinates, and tick label strings belonging to \a
   ticks by index.
+
+  If caching is enabled (\ref setCaching), the result is cached: If the range and the formatting
+  parameters are the same as in the previous call, the previous result is returned without generating anything. If only the range changed
+  but the tick step stayed the same (e.g. a scrolling or panned axis), the labels of ticks which
+  were already created at this tick step are taken from a label pool, so only the labels of ticks
+  entering the range for the first time are created (see \ref createLabelVector). Subclasses whose
+  ticks or labels depend on own parameters must call \ref invalidateCache when these parameters
+  change.
 */
 void QCPAxisTicker::generate(const QCPRange &range, const QLocale &locale, QChar formatChar, int precision, QVector<double> &ticks, QVector<double> *subTicks, QVector<QString> *tickLabels)
 {
+    const bool sameParameters = mCachingEnabled && mCacheValid && formatChar == mCachedFormatChar && precision == mCachedPrecision && locale == mCachedLocale;
+    if (sameParameters && range == mCachedRange && (!subTicks || mCachedSubTicksValid) && (!tickLabels || mCachedLabelsValid))
+    {
+        ticks = mCachedTicks;
+        if (subTicks)
+            *subTicks = mCachedSubTicks;
+        if (tickLabels)
+            *tickLabels = mCachedLabels;
+        return;
+    }
+    if (!sameParameters)
+        mLabelPool.clear();
+
     // generate (major) ticks:
     double tickStep = getTickStep(range);
     ticks = createTickVector(tickStep, range);
@@ -5586,7 +6545,42 @@ void QCPAxisTicker::generate(const QCPRange &range, const QLocale &locale, QChar
     trimTicks(range, ticks, false);
     // generate labels for visible ticks if requested:
     if (tickLabels)
+    {
+        if (tickStep != mLabelPoolTickStep || mLabelPool.size() > 1000) // labels of other tick steps may differ, and the pool shouldn't grow unbounded
+            mLabelPool.clear();
+        mLabelPoolTickStep = tickStep;
+        mUseLabelPool = mCachingEnabled;
         *tickLabels = createLabelVector(ticks, locale, formatChar, precision);
+        mUseLabelPool = false;
+    }
+
+    if (mCachingEnabled)
+    {
+        mCacheValid = true;
+        mCachedRange = range;
+        mCachedLocale = locale;
+        mCachedFormatChar = formatChar;
+        mCachedPrecision = precision;
+        mCachedTicks = ticks;
+        mCachedSubTicksValid = subTicks;
+        mCachedSubTicks = subTicks ? *subTicks : QVector<double>();
+        mCachedLabelsValid = tickLabels;
+        mCachedLabels = tickLabels ? *tickLabels : QVector<QString>();
+    }
+}
+
+/*!
+  Discards the ticks and labels cached by \ref generate, so the next call generates everything
+  anew. This is called by the setters of QCPAxisTicker and its subclasses. Subclasses with own
+  parameters that influence the ticks or labels must call it when these parameters change.
+*/
+void QCPAxisTicker::invalidateCache()
+{
+    mCacheValid = false;
+    mCachedTicks.clear();
+    mCachedSubTicks.clear();
+    mCachedLabels.clear();
+    mLabelPool.clear();
 }
 
 /*! \internal
@@ -5674,10 +6668,15 @@ int QCPAxisTicker::getSubTickCount(double tickStep)
   enabled in the QCPAxis number format (\ref QCPAxis::setNumberFormat), the exponential part will
   be formatted accordingly using multiplication symbol and superscript during rendering of the
   label automatically.
+
+  The default implementation produces the same string as QLocale::toString, but uses a
+  QCPNumberFormatter which avoids the temporary strings and symbol lookups of QLocale per label.
 */
 QString QCPAxisTicker::getTickLabel(double tick, const QLocale &locale, QChar formatChar, int precision)
 {
-    return locale.toString(tick, formatChar.toLatin1(), precision);
+    if (locale != mNumberFormatter.locale())
+        mNumberFormatter.setLocale(locale);
+    return mNumberFormatter.toString(tick, formatChar, precision);
 }
 
 /*! \internal
@@ -5738,7 +6737,9 @@ QVector<double> QCPAxisTicker::createTickVector(double tickStep, const QCPRange
 
   Returns a vector containing all tick label strings corresponding to the tick coordinates provided
   in \a ticks. The default implementation calls \ref getTickLabel to generate the respective
-  strings.
+  strings. If called from \ref generate, labels are looked up in and added to the label pool, so a
+  tick label is only created once as long as the tick step and formatting parameters stay the
+  same.
 
   It is possible but uncommon for QCPAxisTicker subclasses to reimplement this method, as
   reimplementing \ref getTickLabel often achieves the intended result easier.
@@ -5747,8 +6748,27 @@ QVector<QString> QCPAxisTicker::createLabelVector(const QVector<double> &ticks,
 {
     QVector<QString> result;
     result.reserve(ticks.size());
-    for (int i=0; i<ticks.size(); ++i)
-        result.append(getTickLabel(ticks.at(i), locale, formatChar, precision));
+    if (mUseLabelPool) // the pool only contains labels of the current tick step and formatting parameters, so ticks at equal coordinates have equal labels
+    {
+        for (int i=0; i<ticks.size(); ++i)
+        {
+            const double tick = ticks.at(i);
+            QMap<double, QString>::const_iterator it = mLabelPool.constFind(tick);
+            if (it != mLabelPool.constEnd())
+            {
+                result.append(it.value());
+            } else
+            {
+                const QString label = getTickLabel(tick, locale, formatChar, precision);
+                mLabelPool.insert(tick, label);
+                result.append(label);
+            }
+        }
+    } else
+    {
+        for (int i=0; i<ticks.size(); ++i)
+            result.append(getTickLabel(ticks.at(i), locale, formatChar, precision));
+    }
     return result;
 }
 
@@ -5855,6 +6875,27 @@ double QCPAxisTicker::cleanMantissa(double input) const
     }
     return input;
 }
+
+/*! \internal
+
+  Appends the decimal digits of the non-negative \a value to \a buffer, padded with leading zeros
+  to at least \a fieldWidth digits. This is used by tickers which render their tick labels
+  character by character into a stack buffer, instead of assembling them from temporary strings.
+*/
+void QCPAxisTicker::appendDigits(QVarLengthArray<QChar, 64> &buffer, qint64 value, int fieldWidth)
+{
+    char digits[20];
+    int digitCount = 0;
+    do
+    {
+        digits[digitCount++] = char('0'+value%10);
+        value /= 10;
+    } while (value > 0 && digitCount < 20);
+    for (int i=digitCount; i<fieldWidth; ++i)
+        buffer.append(QLatin1Char('0'));
+    while (digitCount > 0)
+        buffer.append(QLatin1Char(digits[--digitCount]));
+}
 /* end of 'src/axis/axisticker.cpp' */
 
 
@@ -5907,9 +6948,17 @@ double QCPAxisTicker::cleanMantissa(double input) const
 QCPAxisTickerDateTime::QCPAxisTickerDateTime() :
     mDateTimeFormat(QLatin1String("hh:mm:ss\ndd.MM.yy")),
     mDateTimeSpec(Qt::LocalTime),
-    mDateStrategy(dsNone)
-{
+    mDateStrategy(dsNone),
+    mFormatCompiled(false),
+    mFormatHasAmPm(false),
+    mTextsValid(false),
+    mUtcOffsetInterval(0),
+    mUtcOffset(0),
+    mUtcOffsetValid(false)
+{
+    mCachingEnabled = true;
     setTickCount(4);
+    compileDateTimeFormat();
 }
 
 /*!
@@ -5923,6 +6972,8 @@ QCPAxisTickerDateTime::QCPAxisTickerDateTime() :
 void QCPAxisTickerDateTime::setDateTimeFormat(const QString &format)
 {
     mDateTimeFormat = format;
+    compileDateTimeFormat();
+    invalidateCache();
 }
 
 /*!
@@ -5938,6 +6989,8 @@ void QCPAxisTickerDateTime::setDateTimeFormat(const QString &format)
 void QCPAxisTickerDateTime::setDateTimeSpec(Qt::TimeSpec spec)
 {
     mDateTimeSpec = spec;
+    mUtcOffsetValid = false;
+    invalidateCache();
 }
 
 /*!
@@ -6046,12 +7099,30 @@ int QCPAxisTickerDateTime::getSubTickCount(double tickStep)
   Generates a date/time tick label for tick coordinate \a tick, based on the currently set format
   (\ref setDateTimeFormat) and time spec (\ref setDateTimeSpec).
 
+  If the format was compiled successfully (see \ref compileDateTimeFormat), the label is rendered
+  directly from the tick coordinate with integer arithmetic by \ref renderTickLabel, so no
+  QDateTime is constructed per tick. Otherwise, and for dates outside the years 1 to 9999, the
+  label is created by QLocale::toString.
+
   \seebaseclassmethod
 */
 QString QCPAxisTickerDateTime::getTickLabel(double tick, const QLocale &locale, QChar formatChar, int precision)
 {
     Q_UNUSED(precision)
     Q_UNUSED(formatChar)
+# if QT_VERSION >= QT_VERSION_CHECK(4, 7, 0)
+    if (mFormatCompiled && qAbs(tick) < 1e12 && (mDateTimeSpec == Qt::LocalTime || mDateTimeSpec == Qt::UTC || mDateTimeSpec == Qt::OffsetFromUTC))
+    {
+        if (!mTextsValid || locale != mTextsLocale)
+            updateLocaleTexts(locale);
+        if (mTextsValid)
+        {
+            QVarLengthArray<QChar, 64> buffer;
+            if (renderTickLabel(qint64(tick*1000.0), buffer)) // same truncation as in keyToDateTime
+                return QString(buffer.constData(), buffer.size());
+        }
+    }
+# endif
     return locale.toString(keyToDateTime(tick).toTimeSpec(mDateTimeSpec), mDateTimeFormat);
 }
 
@@ -6098,36 +7169,314 @@ QVector<double> QCPAxisTickerDateTime::createTickVector(double tickStep, const Q
     return result;
 }
 
-/*!
-  A convenience method which turns \a key (in seconds since Epoch 1. Jan 1970, 00:00 UTC) into a
-  QDateTime object. This can be used to turn axis coordinates to actual QDateTimes.
+/*! \internal
 
-  The accuracy achieved by this method is one millisecond, irrespective of the used Qt version (it
-  works around the lack of a QDateTime::fromMSecsSinceEpoch in Qt 4.6)
+  Parses the date time format (\ref setDateTimeFormat) once into the token list \a
+  mFormatTokens, following the pattern rules of QLocale::toString. Quoted and unrecognized
+  characters become literal tokens referring to \a mFormatLiterals.
 
-  \see dateTimeToKey
+  If the format contains patterns that can't be rendered by \ref renderTickLabel (currently only
+  the time zone "t"), \a mFormatCompiled is set to false and tick labels are created by
+  QLocale::toString instead.
 */
-QDateTime QCPAxisTickerDateTime::keyToDateTime(double key)
+void QCPAxisTickerDateTime::compileDateTimeFormat()
 {
-# if QT_VERSION < QT_VERSION_CHECK(4, 7, 0)
-    return QDateTime::fromTime_t(key).addMSecs((key-(qint64)key)*1000);
-# else
-    return QDateTime::fromMSecsSinceEpoch(key*1000.0);
-# endif
-}
+    mFormatTokens.clear();
+    mFormatLiterals.clear();
+    mFormatCompiled = true;
+    mFormatHasAmPm = false;
+    const QString &format = mDateTimeFormat;
+    const int size = format.size();
+    int i = 0;
+    while (i < size)
+    {
+        const QChar c = format.at(i);
+        int repeat = 1;
+        while (i+repeat < size && format.at(i+repeat) == c)
+            ++repeat;
+        FormatToken token;
+        token.type = ftLiteral;
+        token.start = mFormatLiterals.size();
+        token.length = 0;
+        switch (c.unicode())
+        {
+        case '\'':
+        {
+            ++i;
+            if (i < size && format.at(i) == QLatin1Char('\'')) // '' outside of quoted text is a single quote
+            {
+                mFormatLiterals.append(QLatin1Char('\''));
+                ++i;
+            } else
+            {
+                while (i < size)
+                {
+                    if (format.at(i) == QLatin1Char('\''))
+                    {
+                        if (i+1 < size && format.at(i+1) == QLatin1Char('\'')) // '' inside quoted text is an escaped quote
+                        {
+                            mFormatLiterals.append(QLatin1Char('\''));
+                            i += 2;
+                        } else
+                            break;
+                    } else
+                        mFormatLiterals.append(format.at(i++));
+                }
+                if (i < size) // skip closing quote
+                    ++i;
+            }
+            repeat = 0;
+            break;
+        }
+        case 'd':
+        {
+            repeat = qMin(repeat, 4);
+            const FormatTokenType types[4] = {ftDay, ftDay2, ftDayShortName, ftDayLongName};
+            token.type = types[repeat-1];
+            break;
+        }
+        case 'M':
+        {
+            repeat = qMin(repeat, 4);
+            const FormatTokenType types[4] = {ftMonth, ftMonth2, ftMonthShortName, ftMonthLongName};
+            token.type = types[repeat-1];
+            break;
+        }
+        case 'y':
+        {
+            if (repeat >= 4)
+            {
+                repeat = 4;
+                token.type = ftYear4;
+            } else if (repeat >= 2)
+            {
+                repeat = 2;
+                token.type = ftYear2;
+            } else
+                mFormatLiterals.append(c);
+            break;
+        }
+        case 'h': repeat = qMin(repeat, 2); token.type = repeat == 1 ? ftHour : ftHour2; break;
+        case 'H': repeat = qMin(repeat, 2); token.type = repeat == 1 ? ftHour24 : ftHour24_2; break;
+        case 'm': repeat = qMin(repeat, 2); token.type = repeat == 1 ? ftMinute : ftMinute2; break;
+        case 's': repeat = qMin(repeat, 2); token.type = repeat == 1 ? ftSecond : ftSecond2; break;
+        case 'z':
+        {
+            repeat = repeat >= 3 ? 3 : 1;
+            token.type = repeat == 1 ? ftMillisecond : ftMillisecond3;
+            break;
+        }
+        case 'a':
+        case 'A':
+        {
+            const QChar p = c == QLatin1Char('a') ? QLatin1Char('p') : QLatin1Char('P');
+            repeat = i+1 < size && format.at(i+1) == p ? 2 : 1;
+            token.type = c == QLatin1Char('a') ? ftAmPmLower : ftAmPmUpper;
+            mFormatHasAmPm = true;
+            break;
+        }
+        case 't':
+        {
+            mFormatCompiled = false;
+            repeat = 1;
+            break;
+        }
+        default:
+        {
+            for (int k=0; k<repeat; ++k)
+                mFormatLiterals.append(c);
+            break;
+        }
+        }
+        i += repeat;
 
-/*! \overload
+        if (token.type == ftLiteral)
+        {
+            token.length = mFormatLiterals.size()-token.start;
+            if (token.length == 0)
+                continue;
+            if (!mFormatTokens.isEmpty() && mFormatTokens.last().type == ftLiteral) // merge adjacent literal text
+            {
+                mFormatTokens.last().length += token.length;
+                continue;
+            }
+        }
+        mFormatTokens.append(token);
+    }
+}
 
-  A convenience method which turns a QDateTime object into a double value that corresponds to
-  seconds since Epoch (1. Jan 1970, 00:00 UTC). This is the format used as axis coordinates by
-  QCPAxisTickerDateTime.
+/*! \internal
 
-  The accuracy achieved by this method is one millisecond, irrespective of the used Qt version (it
-  works around the lack of a QDateTime::toMSecsSinceEpoch in Qt 4.6)
+  Fetches the day and month names as well as the AM/PM texts of \a locale, which are needed by
+  \ref renderTickLabel. This happens once per locale change, and not for every tick label.
 
-  \see keyToDateTime
+  Locales which don't use the latin digits for numbers can't be rendered by \ref renderTickLabel,
+  so \a mTextsValid stays false for them.
 */
-double QCPAxisTickerDateTime::dateTimeToKey(const QDateTime dateTime)
+void QCPAxisTickerDateTime::updateLocaleTexts(const QLocale &locale)
+{
+    mTextsLocale = locale;
+    mTextsValid = locale.zeroDigit() == QLatin1Char('0');
+    if (!mTextsValid)
+        return;
+    for (int i=0; i<7; ++i)
+    {
+        mDayNames[0][i] = locale.dayName(i+1, QLocale::ShortFormat);
+        mDayNames[1][i] = locale.dayName(i+1, QLocale::LongFormat);
+    }
+    for (int i=0; i<12; ++i)
+    {
+        mMonthNames[0][i] = locale.monthName(i+1, QLocale::ShortFormat);
+        mMonthNames[1][i] = locale.monthName(i+1, QLocale::LongFormat);
+    }
+    mAmPmTexts[0][0] = locale.amText().toLower();
+    mAmPmTexts[0][1] = locale.pmText().toLower();
+    mAmPmTexts[1][0] = locale.amText().toUpper();
+    mAmPmTexts[1][1] = locale.pmText().toUpper();
+}
+
+/*! \internal
+
+  Returns the offset in milliseconds that must be added to the UTC time \a msecs (since Epoch) to
+  obtain the wall clock time in the configured time spec (\ref setDateTimeSpec).
+
+  For Qt::LocalTime, determining the offset requires a QDateTime conversion. Since time zone
+  transitions happen on quarter hours, the offset is cached for the quarter hour interval of the
+  last request, so all ticks within the same quarter hour share one conversion.
+*/
+qint64 QCPAxisTickerDateTime::utcOffset(qint64 msecs)
+{
+    if (mDateTimeSpec != Qt::LocalTime)
+        return 0;
+    const qint64 intervalLength = 15*60*1000;
+    const qint64 interval = msecs >= 0 ? msecs/intervalLength : -((-msecs-1)/intervalLength)-1;
+    if (!mUtcOffsetValid || interval != mUtcOffsetInterval)
+    {
+# if QT_VERSION >= QT_VERSION_CHECK(4, 7, 0)
+        const QDateTime localTime = QDateTime::fromMSecsSinceEpoch(msecs).toLocalTime();
+        mUtcOffset = QDateTime(localTime.date(), localTime.time(), Qt::UTC).toMSecsSinceEpoch()-msecs;
+# else
+        mUtcOffset = 0;
+# endif
+        mUtcOffsetInterval = interval;
+        mUtcOffsetValid = true;
+    }
+    return mUtcOffset;
+}
+
+/*! \internal
+
+  Renders the tick label of the time \a msecs (milliseconds since Epoch, UTC) into \a buffer,
+  by executing the token list created by \ref compileDateTimeFormat. The calendar date is
+  calculated from the day number with integer arithmetic (proleptic Gregorian calendar, as used by
+  QDate).
+
+  Returns false if the date lies outside the years 1 to 9999, which QLocale::toString formats
+  differently (e.g. with a sign).
+*/
+bool QCPAxisTickerDateTime::renderTickLabel(qint64 msecs, QVarLengthArray<QChar, 64> &buffer)
+{
+    const qint64 msecsPerDay = 86400*1000;
+    const qint64 wallMsecs = msecs+utcOffset(msecs);
+    const qint64 days = wallMsecs >= 0 ? wallMsecs/msecsPerDay : -((-wallMsecs-1)/msecsPerDay)-1;
+    const int msecsOfDay = int(wallMsecs-days*msecsPerDay);
+
+    // civil date from day number, see H. Hinnant, "chrono-Compatible Low-Level Date Algorithms":
+    const qint64 shiftedDays = days+719468; // days since 0000-03-01
+    const qint64 era = (shiftedDays >= 0 ? shiftedDays : shiftedDays-146096)/146097;
+    const int dayOfEra = int(shiftedDays-era*146097);
+    const int yearOfEra = (dayOfEra - dayOfEra/1460 + dayOfEra/36524 - dayOfEra/146096)/365;
+    const int dayOfYear = dayOfEra-(365*yearOfEra + yearOfEra/4 - yearOfEra/100);
+    const int shiftedMonth = (5*dayOfYear+2)/153;
+    const int day = dayOfYear-(153*shiftedMonth+2)/5+1;
+    const int month = shiftedMonth < 10 ? shiftedMonth+3 : shiftedMonth-9;
+    const qint64 year = yearOfEra+era*400+(month <= 2 ? 1 : 0);
+    if (year < 1 || year > 9999)
+        return false;
+    const int dayOfWeek = int(((days+3)%7+7)%7)+1; // 1 = Monday, like QDate::dayOfWeek (1. Jan 1970 was a Thursday)
+
+    const int hour = msecsOfDay/3600000;
+    const int minute = msecsOfDay/60000%60;
+    const int second = msecsOfDay/1000%60;
+    const int millisecond = msecsOfDay%1000;
+    int displayHour = hour;
+    if (mFormatHasAmPm)
+    {
+        if (displayHour > 12)
+            displayHour -= 12;
+        else if (displayHour == 0)
+            displayHour = 12;
+    }
+
+    const QString *text = 0;
+    for (int i=0; i<mFormatTokens.size(); ++i)
+    {
+        const FormatToken &token = mFormatTokens.at(i);
+        switch (token.type)
+        {
+        case ftLiteral: buffer.append(mFormatLiterals.constData()+token.start, token.length); break;
+        case ftDay: appendDigits(buffer, day, 1); break;
+        case ftDay2: appendDigits(buffer, day, 2); break;
+        case ftDayShortName: text = &mDayNames[0][dayOfWeek-1]; break;
+        case ftDayLongName: text = &mDayNames[1][dayOfWeek-1]; break;
+        case ftMonth: appendDigits(buffer, month, 1); break;
+        case ftMonth2: appendDigits(buffer, month, 2); break;
+        case ftMonthShortName: text = &mMonthNames[0][month-1]; break;
+        case ftMonthLongName: text = &mMonthNames[1][month-1]; break;
+        case ftYear2: appendDigits(buffer, year%100, 2); break;
+        case ftYear4: appendDigits(buffer, year, 4); break;
+        case ftHour: appendDigits(buffer, displayHour, 1); break;
+        case ftHour2: appendDigits(buffer, displayHour, 2); break;
+        case ftHour24: appendDigits(buffer, hour, 1); break;
+        case ftHour24_2: appendDigits(buffer, hour, 2); break;
+        case ftMinute: appendDigits(buffer, minute, 1); break;
+        case ftMinute2: appendDigits(buffer, minute, 2); break;
+        case ftSecond: appendDigits(buffer, second, 1); break;
+        case ftSecond2: appendDigits(buffer, second, 2); break;
+        case ftMillisecond: appendDigits(buffer, millisecond, 1); break;
+        case ftMillisecond3: appendDigits(buffer, millisecond, 3); break;
+        case ftAmPmLower: text = &mAmPmTexts[0][hour < 12 ? 0 : 1]; break;
+        case ftAmPmUpper: text = &mAmPmTexts[1][hour < 12 ? 0 : 1]; break;
+        }
+        if (text)
+        {
+            buffer.append(text->constData(), text->size());
+            text = 0;
+        }
+    }
+    return true;
+}
+
+/*!
+  A convenience method which turns \a key (in seconds since Epoch 1. Jan 1970, 00:00 UTC) into a
+  QDateTime object. This can be used to turn axis coordinates to actual QDateTimes.
+
+  The accuracy achieved by this method is one millisecond, irrespective of the used Qt version (it
+  works around the lack of a QDateTime::fromMSecsSinceEpoch in Qt 4.6)
+
+  \see dateTimeToKey
+*/
+QDateTime QCPAxisTickerDateTime::keyToDateTime(double key)
+{
+# if QT_VERSION < QT_VERSION_CHECK(4, 7, 0)
+    return QDateTime::fromTime_t(key).addMSecs((key-(qint64)key)*1000);
+# else
+    return QDateTime::fromMSecsSinceEpoch(key*1000.0);
+# endif
+}
+
+/*! \overload
+
+  A convenience method which turns a QDateTime object into a double value that corresponds to
+  seconds since Epoch (1. Jan 1970, 00:00 UTC). This is the format used as axis coordinates by
+  QCPAxisTickerDateTime.
+
+  The accuracy achieved by this method is one millisecond, irrespective of the used Qt version (it
+  works around the lack of a QDateTime::toMSecsSinceEpoch in Qt 4.6)
+
+  \see keyToDateTime
+*/
+double QCPAxisTickerDateTime::dateTimeToKey(const QDateTime dateTime)
 {
 # if QT_VERSION < QT_VERSION_CHECK(4, 7, 0)
     return dateTime.toTime_t()+dateTime.time().msec()/1000.0;
@@ -6206,18 +7555,19 @@ QCPAxisTickerTime::QCPAxisTickerTime() :
     mSmallestUnit(tuSeconds),
     mBiggestUnit(tuHours)
 {
+    mCachingEnabled = true;
     setTickCount(4);
-    mFieldWidth[tuMilliseconds] = 3;
-    mFieldWidth[tuSeconds] = 2;
-    mFieldWidth[tuMinutes] = 2;
-    mFieldWidth[tuHours] = 2;
-    mFieldWidth[tuDays] = 1;
-
     mFormatPattern[tuMilliseconds] = QLatin1String("%z");
     mFormatPattern[tuSeconds] = QLatin1String("%s");
     mFormatPattern[tuMinutes] = QLatin1String("%m");
     mFormatPattern[tuHours] = QLatin1String("%h");
     mFormatPattern[tuDays] = QLatin1String("%d");
+    setFieldWidth(tuMilliseconds, 3);
+    setFieldWidth(tuSeconds, 2);
+    setFieldWidth(tuMinutes, 2);
+    setFieldWidth(tuHours, 2);
+    setFieldWidth(tuDays, 1);
+    setTimeFormat(mTimeFormat);
 }
 
 /*!
@@ -6242,24 +7592,58 @@ void QCPAxisTickerTime::setTimeFormat(const QString &format)
 {
     mTimeFormat = format;
 
-    // determine smallest and biggest unit in format, to optimize unit replacement and allow biggest
-    // unit to consume remaining time of a tick value and grow beyond its modulo (e.g. min > 59)
+    // split format into literal text and unit patterns once, so getTickLabel doesn't need to search
+    // and replace the patterns for every tick:
+    mFormatTokens.clear();
+    bool hasUnit[tuDays+1] = {false, false, false, false, false};
+    for (int i=0; i<mTimeFormat.size(); ++i)
+    {
+        int unit = -1;
+        if (mTimeFormat.at(i) == QLatin1Char('%') && i+1 < mTimeFormat.size())
+        {
+            switch (mTimeFormat.at(i+1).unicode())
+            {
+            case 'z': unit = tuMilliseconds; break;
+            case 's': unit = tuSeconds; break;
+            case 'm': unit = tuMinutes; break;
+            case 'h': unit = tuHours; break;
+            case 'd': unit = tuDays; break;
+            }
+        }
+        if (unit >= 0)
+        {
+            FormatToken token = {unit, i, 2};
+            mFormatTokens.append(token);
+            hasUnit[unit] = true;
+            ++i;
+        } else if (!mFormatTokens.isEmpty() && mFormatTokens.last().unit < 0) // extend literal text token
+        {
+            ++mFormatTokens.last().length;
+        } else
+        {
+            FormatToken token = {-1, i, 1};
+            mFormatTokens.append(token);
+        }
+    }
+
+    // determine smallest and biggest unit in format, to allow biggest unit to consume remaining time
+    // of a tick value and grow beyond its modulo (e.g. min > 59)
     mSmallestUnit = tuMilliseconds;
     mBiggestUnit = tuMilliseconds;
     bool hasSmallest = false;
     for (int i = tuMilliseconds; i <= tuDays; ++i)
     {
-        TimeUnit unit = static_cast<TimeUnit>(i);
-        if (mTimeFormat.contains(mFormatPattern.value(unit)))
+        if (hasUnit[i])
         {
             if (!hasSmallest)
             {
-                mSmallestUnit = unit;
+                mSmallestUnit = static_cast<TimeUnit>(i);
                 hasSmallest = true;
             }
-            mBiggestUnit = unit;
+            mBiggestUnit = static_cast<TimeUnit>(i);
         }
     }
+    invalidateCache();
 }
 
 /*!
@@ -6272,6 +7656,8 @@ void QCPAxisTickerTime::setTimeFormat(const QString &format)
 void QCPAxisTickerTime::setFieldWidth(QCPAxisTickerTime::TimeUnit unit, int width)
 {
     mFieldWidth[unit] = qMax(width, 1);
+    mTokenFieldWidth[unit] = mFieldWidth[unit];
+    invalidateCache();
 }
 
 /*! \internal
@@ -6358,6 +7744,10 @@ int QCPAxisTickerTime::getSubTickCount(double tickStep)
   Returns the tick label corresponding to the provided \a tick and the configured format and field
   widths (\ref setTimeFormat, \ref setFieldWidth).
 
+  The tick is rounded to the smallest unit in the format and then split into the units with
+  integer arithmetic. The label is assembled in a stack buffer from the token list prepared by
+  \ref setTimeFormat.
+
   \seebaseclassmethod
 */
 QString QCPAxisTickerTime::getTickLabel(double tick, const QLocale &locale, QChar formatChar, int precision)
@@ -6365,33 +7755,49 @@ QString QCPAxisTickerTime::getTickLabel(double tick, const QLocale &locale, QCha
     Q_UNUSED(precision)
     Q_UNUSED(formatChar)
     Q_UNUSED(locale)
+    static const qint64 unitMsecs[tuDays+1] = {1, 1000, 60*1000, 3600*1000, 86400*1000};
     bool negative = tick < 0;
     if (negative) tick *= -1;
-    double values[tuDays+1]; // contains the msec/sec/min/... value with its respective modulo (e.g. minute 0..59)
-    double restValues[tuDays+1]; // contains the msec/sec/min/... value as if it's the largest available unit and thus consumes the remaining time
-
-    restValues[tuMilliseconds] = tick*1000;
-    values[tuMilliseconds] = modf(restValues[tuMilliseconds]/1000, &restValues[tuSeconds])*1000;
-    values[tuSeconds] = modf(restValues[tuSeconds]/60, &restValues[tuMinutes])*60;
-    values[tuMinutes] = modf(restValues[tuMinutes]/60, &restValues[tuHours])*60;
-    values[tuHours] = modf(restValues[tuHours]/24, &restValues[tuDays])*24;
-    // no need to set values[tuDays] because days are always a rest value (there is no higher unit so it consumes all remaining time)
+    const double smallestUnits = tick*1000.0/unitMsecs[mSmallestUnit];
+    if (!(smallestUnits < 1e18)) // also catches NaN, value can't be represented in qint64
+        return QString();
 
-    QString result = mTimeFormat;
+    qint64 values[tuDays+1]; // contains the msec/sec/min/... value with its respective modulo (e.g. minute 0..59), the biggest unit consumes the remaining time
+    qint64 rest = qRound64(smallestUnits);
     for (int i = mSmallestUnit; i <= mBiggestUnit; ++i)
     {
-        TimeUnit iUnit = static_cast<TimeUnit>(i);
-        replaceUnit(result, iUnit, qRound(iUnit == mBiggestUnit ? restValues[iUnit] : values[iUnit]));
+        if (i == mBiggestUnit)
+        {
+            values[i] = rest;
+        } else
+        {
+            const qint64 modulo = unitMsecs[i+1]/unitMsecs[i];
+            values[i] = rest%modulo;
+            rest /= modulo;
+        }
     }
+
+    QVarLengthArray<QChar, 64> buffer;
     if (negative)
-        result.prepend(QLatin1Char('-'));
-    return result;
+        buffer.append(QLatin1Char('-'));
+    for (int i=0; i<mFormatTokens.size(); ++i)
+    {
+        const FormatToken &token = mFormatTokens.at(i);
+        if (token.unit < 0)
+            buffer.append(mTimeFormat.constData()+token.start, token.length);
+        else
+            appendDigits(buffer, values[token.unit], mTokenFieldWidth[token.unit]);
+    }
+    return QString(buffer.constData(), buffer.size());
 }
 
 /*! \internal
 
   Replaces all occurrences of the format pattern belonging to \a unit in \a text with the specified
   \a value, using the field width as specified with \ref setFieldWidth for the \a unit.
+
+  \ref getTickLabel doesn't use this method anymore, it renders the precompiled format tokens
+  instead. It is kept for subclasses which build their labels from the format patterns.
 */
 void QCPAxisTickerTime::replaceUnit(QString &text, QCPAxisTickerTime::TimeUnit unit, int value) const
 {
@@ -6438,6 +7844,7 @@ QCPAxisTickerFixed::QCPAxisTickerFixed() :
     mTickStep(1.0),
     mScaleStrategy(ssNone)
 {
+    mCachingEnabled = true;
 }
 
 /*!
@@ -6452,8 +7859,10 @@ QCPAxisTickerFixed::QCPAxisTickerFixed() :
 void QCPAxisTickerFixed::setTickStep(double step)
 {
     if (step > 0)
+    {
         mTickStep = step;
-    else
+        invalidateCache();
+    } else
         qDebug() << Q_FUNC_INFO << "tick step must be greater than zero:" << step;
 }
 
@@ -6467,6 +7876,7 @@ void QCPAxisTickerFixed::setTickStep(double step)
 void QCPAxisTickerFixed::setScaleStrategy(QCPAxisTickerFixed::ScaleStrategy strategy)
 {
     mScaleStrategy = strategy;
+    invalidateCache();
 }
 
 /*! \internal
@@ -6552,6 +7962,7 @@ double QCPAxisTickerFixed::getTickStep(const QCPRange &range)
 QCPAxisTickerText::QCPAxisTickerText() :
     mSubTickCount(0)
 {
+    // caching stays disabled, since the ticks can be modified directly via the reference returned by ticks()
 }
 
 /*! \overload
@@ -6752,6 +8163,7 @@ QCPAxisTickerPi::QCPAxisTickerPi() :
     mFractionStyle(fsUnicodeFractions),
     mPiTickStep(0)
 {
+    mCachingEnabled = true;
     setTickCount(4);
 }
 
@@ -6765,6 +8177,7 @@ QCPAxisTickerPi::QCPAxisTickerPi() :
 void QCPAxisTickerPi::setPiSymbol(QString symbol)
 {
     mPiSymbol = symbol;
+    invalidateCache();
 }
 
 /*!
@@ -6776,6 +8189,7 @@ void QCPAxisTickerPi::setPiSymbol(QString symbol)
 void QCPAxisTickerPi::setPiValue(double pi)
 {
     mPiValue = pi;
+    invalidateCache();
 }
 
 /*!
@@ -6789,6 +8203,7 @@ void QCPAxisTickerPi::setPiValue(double pi)
 void QCPAxisTickerPi::setPeriodicity(int multiplesOfPi)
 {
     mPeriodicity = qAbs(multiplesOfPi);
+    invalidateCache();
 }
 
 /*!
@@ -6798,6 +8213,7 @@ void QCPAxisTickerPi::setPeriodicity(int multiplesOfPi)
 void QCPAxisTickerPi::setFractionStyle(QCPAxisTickerPi::FractionStyle style)
 {
     mFractionStyle = style;
+    invalidateCache();
 }
 
 /*! \internal
@@ -7041,6 +8457,7 @@ QCPAxisTickerLog::QCPAxisTickerLog() :
     mSubTickCount(8), // generates 10 intervals
     mLogBaseLnInv(1.0/qLn(mLogBase))
 {
+    mCachingEnabled = true;
 }
 
 /*!
@@ -7053,6 +8470,7 @@ void QCPAxisTickerLog::setLogBase(double base)
     {
         mLogBase = base;
         mLogBaseLnInv = 1.0/qLn(mLogBase);
+        invalidateCache();
     } else
         qDebug() << Q_FUNC_INFO << "log base has to be greater than zero:" << base;
 }
@@ -7070,8 +8488,10 @@ void QCPAxisTickerLog::setLogBase(double base)
 void QCPAxisTickerLog::setSubTickCount(int subTicks)
 {
     if (subTicks >= 0)
+    {
         mSubTickCount = subTicks;
-    else
+        invalidateCache();
+    } else
         qDebug() << Q_FUNC_INFO << "sub tick count can't be negative:" << subTicks;
 }
 
@@ -7268,9 +8688,27 @@ void QCPGrid::draw(QCPPainter *painter)
 {
     if (!mParentAxis) { qDebug() << Q_FUNC_INFO << "invalid parent axis"; return; }
 
-    if (mParentAxis->subTicks() && mSubGridVisible)
-        drawSubGridLines(painter);
-    drawGridLines(painter);
+    if (mParentPlot->plottingHints().testFlag(QCP::phCacheAxes) && !painter->modes().testFlag(QCPPainter::pmNoCaching))
+    {
+        const QRect cacheRect = gridCacheRect();
+        const QByteArray cacheHash = generateGridCacheHash(painter);
+        if (!mGridCache.isValid(cacheRect, cacheHash))
+        {
+            QCPPainter *cachePainter = mGridCache.startPainting(cacheRect, mParentPlot->bufferDevicePixelRatio(), painter);
+            if (!cachePainter)
+                return;
+            if (mParentAxis->subTicks() && mSubGridVisible)
+                drawSubGridLines(cachePainter);
+            drawGridLines(cachePainter);
+            mGridCache.donePainting(cachePainter, cacheHash);
+        }
+        mGridCache.draw(painter);
+    } else
+    {
+        if (mParentAxis->subTicks() && mSubGridVisible)
+            drawSubGridLines(painter);
+        drawGridLines(painter);
+    }
 }
 
 /*! \internal
@@ -7346,6 +8784,38 @@ void QCPGrid::drawGridLines(QCPPainter *painter) const
     }
 }
 
+/*! \internal
+
+  Returns a hash of all parameters that influence the appearance of the grid when drawn with \a
+  painter, i.e. the range, scale type and tick vectors of the parent axis, the axis rect geometry,
+  the pens and the antialiasing settings. It is used in \ref draw to determine whether the grid
+  cache may be reused, if the plotting hint \ref QCP::phCacheAxes is set.
+*/
+QByteArray QCPGrid::generateGridCacheHash(const QCPPainter *painter) const
+{
+    QByteArray result;
+    QDataStream stream(&result, QIODevice::WriteOnly);
+    stream << mParentPlot->bufferDevicePixelRatio() << int(painter->modes()) << painter->antialiasing()
+           << int(mParentPlot->antialiasedElements()) << int(mParentPlot->notAntialiasedElements())
+           << mAntialiased << mAntialiasedSubGrid << mAntialiasedZeroLine << mPen << mSubGridPen << mZeroLinePen
+           << mParentAxis->mAxisRect->rect() << mParentAxis->mRange.lower << mParentAxis->mRange.upper
+           << int(mParentAxis->mScaleType) << mParentAxis->mRangeReversed << mParentAxis->mTickVector;
+    if (mParentAxis->subTicks() && mSubGridVisible)
+        stream << mParentAxis->mSubTickVector;
+    return result;
+}
+
+/*! \internal
+
+  Returns the rectangle which is covered by the grid cache, i.e. the axis rect enlarged by the
+  widest grid pen.
+*/
+QRect QCPGrid::gridCacheRect() const
+{
+    const int margin = qCeil(qMax(mPen.widthF(), qMax(mSubGridPen.widthF(), mZeroLinePen.widthF()))) + 2;
+    return mParentAxis->mAxisRect->rect().adjusted(-margin, -margin, margin, margin).intersected(clipRect().translated(0, -1));
+}
+
 /*! \internal
 
   Draws the sub grid lines with the specified painter.
@@ -7557,6 +9027,7 @@ QCPAxis::QCPAxis(QCPAxisRect *parent, AxisType type) :
 {
     setParent(parent);
     mGrid->setVisible(false);
+    mTicker->setCaching(true); // the default ticker is a plain QCPAxisTicker, which has no parameters besides those of its setters
     setAntialiased(false);
     setLayer(mParentPlot->currentLayer()); // it's actually on that layer already, but we want it in front of the grid, so we place it on there again
 
@@ -9017,7 +10488,10 @@ void QCPAxis::draw(QCPPainter *painter)
     mAxisPainter->tickPositions = tickPositions;
     mAxisPainter->tickLabels = tickLabels;
     mAxisPainter->subTickPositions = subTickPositions;
-    mAxisPainter->draw(painter);
+    if (mParentPlot->plottingHints().testFlag(QCP::phCacheAxes) && !painter->modes().testFlag(QCPPainter::pmNoCaching))
+        mAxisPainter->drawCached(painter);
+    else
+        mAxisPainter->draw(painter);
 }
 
 /*! \internal
@@ -9033,9 +10507,14 @@ void QCPAxis::setupTickVectors()
     if (!mParentPlot) return;
     if ((!mTicks && !mTickLabels && !mGrid->visible()) || mRange.size() <= 0) return;
 
+    QElapsedTimer profileTimer;
+    if (mParentPlot->mProfiling)
+        profileTimer.start();
     QVector<QString> oldLabels = mTickVectorLabels;
     mTicker->generate(mRange, mParentPlot->locale(), mNumberFormatChar, mNumberPrecision, mTickVector, mSubTicks ? &mSubTickVector : 0, mTickLabels ? &mTickVectorLabels : 0);
     mCachedMarginValid &= mTickVectorLabels == oldLabels; // if labels have changed, margin might have changed, too
+    if (mParentPlot->mProfiling && mParentPlot->mReplotting)
+        mParentPlot->mCurrentProfile.tickGenerationNsecs += profileTimer.nsecsElapsed();
 }
 
 /*! \internal
@@ -9212,8 +10691,7 @@ QCPAxisPainterPrivate::QCPAxisPainterPrivate(QCustomPlot *parentPlot) :
     offset(0),
     abbreviateDecimalPowers(false),
     reversedEndings(false),
-    mParentPlot(parentPlot),
-    mLabelCache(16) // cache at most 16 (tick) labels
+    mParentPlot(parentPlot)
 {
 }
 
@@ -9230,12 +10708,7 @@ QCPAxisPainterPrivate::~QCPAxisPainterPrivate()
 */
 void QCPAxisPainterPrivate::draw(QCPPainter *painter)
 {
-    QByteArray newHash = generateLabelParameterHash();
-    if (newHash != mLabelParameterHash)
-    {
-        mLabelCache.clear();
-        mLabelParameterHash = newHash;
-    }
+    updateLabelKeys();
 
     QPoint origin;
     switch (type)
@@ -9423,6 +10896,7 @@ void QCPAxisPainterPrivate::draw(QCPPainter *painter)
 */
 int QCPAxisPainterPrivate::size() const
 {
+    updateLabelKeys();
     int result = 0;
 
     // get length of tick marks pointing outwards:
@@ -9456,35 +10930,147 @@ int QCPAxisPainterPrivate::size() const
 
 /*! \internal
 
-  Clears the internal label cache. Upon the next \ref draw, all labels will be created new. This
-  method is called automatically in \ref draw, if any parameters have changed that invalidate the
-  cached labels, such as font, color, etc.
+  Draws the axis with the specified \a painter like \ref draw, but reuses the rendering of the
+  previous call, if none of the parameters which influence the appearance of the axis have changed
+  (see \ref generateAxisCacheHash). Otherwise the axis is drawn into the internal axis cache, which
+  is then drawn with \a painter.
+
+  This is used by QCPAxis if the plotting hint \ref QCP::phCacheAxes is set. The selection boxes
+  stay valid when the cached rendering is reused, since they only depend on the same parameters.
+*/
+void QCPAxisPainterPrivate::drawCached(QCPPainter *painter)
+{
+    const QRect cacheRect = axisCacheRect();
+    const QByteArray cacheHash = generateAxisCacheHash(painter);
+    if (!mAxisCache.isValid(cacheRect, cacheHash))
+    {
+        QCPPainter *cachePainter = mAxisCache.startPainting(cacheRect, mParentPlot->bufferDevicePixelRatio(), painter);
+        if (!cachePainter)
+            return;
+        draw(cachePainter);
+        mAxisCache.donePainting(cachePainter, cacheHash);
+    }
+    mAxisCache.draw(painter);
+}
+
+/*! \internal
+
+  Clears the label cache, i.e. the process-wide \ref QCPLabelAtlas. Upon the next \ref draw, all
+  labels will be created new. It's not necessary to call this method when label parameters such as
+  font or color change, because they are part of the keys of the cached labels.
 */
 void QCPAxisPainterPrivate::clearCache()
 {
-    mLabelCache.clear();
+    QCPLabelAtlas::instance()->clear();
 }
 
 /*! \internal
 
-  Returns a hash that allows uniquely identifying whether the label parameters have changed such
-  that the cached labels must be refreshed (\ref clearCache). It is used in \ref draw. If the
-  return value of this method hasn't changed since the last redraw, the respective label parameters
-  haven't changed and cached labels may be used.
+  Returns a hash of all parameters that influence the rendering of a tick label with a given text.
+  It is the prefix of the keys under which the tick labels of this axis are stored in the \ref
+  QCPLabelAtlas, so axes with equal parameters share their cached labels. The axis type is part of
+  the hash, because the cached draw offset of a label (\ref getTickLabelDrawOffset) depends on it.
 */
 QByteArray QCPAxisPainterPrivate::generateLabelParameterHash() const
+{
+    // the fields are separated, so e.g. rotation 1 with side 0 can't produce the same key as rotation 10:
+    QByteArray result;
+    result.append(QByteArray::number((int)type)+';');
+    result.append(QByteArray::number(mParentPlot->bufferDevicePixelRatio())+';');
+    result.append(QByteArray::number(tickLabelRotation)+';');
+    result.append(QByteArray::number((int)tickLabelSide)+';');
+    result.append(QByteArray::number((int)substituteExponent)+';');
+    result.append(QByteArray::number((int)numberMultiplyCross)+';');
+    result.append(QByteArray::number((int)abbreviateDecimalPowers)+';');
+    result.append(tickLabelColor.name().toLatin1()+QByteArray::number(tickLabelColor.alpha(), 16)+';');
+    result.append(tickLabelFont.toString().toLatin1());
+    result.append('\0'); // separates the parameters from the label text
+    return result;
+}
+
+/*! \internal
+
+  Returns the key of the glyph set in the \ref QCPLabelAtlas from which the numeric tick labels of
+  this axis are composed. Unlike \ref generateLabelParameterHash, it only contains the parameters
+  which influence individual glyphs, i.e. font, color and device pixel ratio.
+*/
+QByteArray QCPAxisPainterPrivate::generateGlyphSetKey() const
 {
     QByteArray result;
-    result.append(QByteArray::number(mParentPlot->bufferDevicePixelRatio()));
-    result.append(QByteArray::number(tickLabelRotation));
-    result.append(QByteArray::number((int)tickLabelSide));
-    result.append(QByteArray::number((int)substituteExponent));
-    result.append(QByteArray::number((int)numberMultiplyCross));
-    result.append(tickLabelColor.name().toLatin1()+QByteArray::number(tickLabelColor.alpha(), 16));
+    result.append(QByteArray::number(mParentPlot->bufferDevicePixelRatio())+';');
+    result.append(tickLabelColor.name().toLatin1()+QByteArray::number(tickLabelColor.alpha(), 16)+';');
     result.append(tickLabelFont.toString().toLatin1());
     return result;
 }
 
+/*! \internal
+
+  Returns a hash of all parameters that influence the appearance of the axis when drawn with \a
+  painter, i.e. the axis range (via the tick and sub tick pixel positions), the tick labels, all
+  pens, fonts and colors, as well as the axis rect and viewport geometry. It is used in \ref
+  drawCached to determine whether the axis cache may be reused.
+*/
+QByteArray QCPAxisPainterPrivate::generateAxisCacheHash(const QCPPainter *painter) const
+{
+    QByteArray result;
+    QDataStream stream(&result, QIODevice::WriteOnly);
+    stream << generateLabelParameterHash() << int(painter->modes()) << painter->antialiasing()
+           << int(type) << basePen << labelPadding << labelFont << labelColor << label << tickLabelPadding
+           << tickLengthIn << tickLengthOut << subTickLengthIn << subTickLengthOut << tickPen << subTickPen
+           << axisRect << viewportRect << offset << abbreviateDecimalPowers << reversedEndings
+           << int(lowerEnding.style()) << lowerEnding.width() << lowerEnding.length() << lowerEnding.inverted()
+           << int(upperEnding.style()) << upperEnding.width() << upperEnding.length() << upperEnding.inverted()
+           << tickPositions << subTickPositions << tickLabels;
+    return result;
+}
+
+/*! \internal
+
+  Returns the rectangle which is covered by the axis cache (see \ref drawCached). It reaches from
+  the axis backbone outward to the viewport border, and inward as far as the ticks and line endings
+  may extend. For tick labels inside the axis rect (\ref QCPAxis::lsInside), the complete axis rect
+  is included. Along the axis, it spans the axis rect plus a margin for tick labels, the axis label
+  and line endings that protrude beyond the axis ends, so plots with many axis rects don't allocate
+  a viewport-sized cache per axis.
+*/
+QRect QCPAxisPainterPrivate::axisCacheRect() const
+{
+    int inward = 0;
+    if (tickLabelSide == QCPAxis::lsInside)
+        inward = qMax(axisRect.width(), axisRect.height());
+    else
+        inward = qMax(0, qMax(tickLengthIn, subTickLengthIn)) + qCeil(qMax(lowerEnding.boundingDistance(), upperEnding.boundingDistance())) + qCeil(basePen.widthF()) + 2;
+
+    // margin beyond the axis ends: tick labels are at most one label extent off their tick (e.g. when rotated), the axis label is centered on the axis:
+    const bool horizontal = QCPAxis::orientation(type) == Qt::Horizontal;
+    int along = qCeil(qMax(lowerEnding.boundingDistance(), upperEnding.boundingDistance())) + qCeil(basePen.widthF()) + 2;
+    if (!tickLabels.isEmpty())
+    {
+        updateLabelKeys();
+        QSize tickLabelsSize(0, 0);
+        for (int i=0; i<tickLabels.size(); ++i)
+            getMaxTickLabelSize(tickLabelFont, tickLabels.at(i), &tickLabelsSize);
+        along += qMax(tickLabelsSize.width(), tickLabelsSize.height());
+    }
+    if (!label.isEmpty())
+    {
+        QFontMetrics fontMetrics(labelFont);
+        const int labelWidth = fontMetrics.boundingRect(0, 0, 0, 0, Qt::TextDontClip | Qt::AlignHCenter | Qt::AlignVCenter, label).width();
+        along += qMax(0, (labelWidth-(horizontal ? axisRect.width() : axisRect.height()))/2+1);
+    }
+
+    const int intOffset = int(offset);
+    QRect result;
+    switch (type)
+    {
+    case QCPAxis::atLeft:   result = QRect(QPoint(viewportRect.left(), axisRect.top()-along), QPoint(axisRect.left()-intOffset+inward, axisRect.bottom()+along)); break;
+    case QCPAxis::atRight:  result = QRect(QPoint(axisRect.right()+intOffset-inward, axisRect.top()-along), QPoint(viewportRect.right(), axisRect.bottom()+along)); break;
+    case QCPAxis::atTop:    result = QRect(QPoint(axisRect.left()-along, viewportRect.top()), QPoint(axisRect.right()+along, axisRect.top()-intOffset+inward)); break;
+    case QCPAxis::atBottom: result = QRect(QPoint(axisRect.left()-along, axisRect.bottom()+intOffset-inward), QPoint(axisRect.right()+along, viewportRect.bottom())); break;
+    }
+    return result.intersected(viewportRect.translated(0, -1)); // layers clip to the viewport translated by one pixel upward, see QCPLayer::draw
+}
+
 /*! \internal
 
   Draws a single tick label with the provided \a painter, utilizing the internal label cache to
@@ -9519,44 +11105,68 @@ void QCPAxisPainterPrivate::placeTickLabel(QCPPainter *painter, double position,
     }
     if (mParentPlot->plottingHints().testFlag(QCP::phCacheLabels) && !painter->modes().testFlag(QCPPainter::pmNoCaching)) // label caching enabled
     {
-        CachedLabel *cachedLabel = mLabelCache.take(text); // attempt to get label from cache
-        if (!cachedLabel)  // no cached label existed, create it
+        QPointF labelOffset;
+        QSizeF labelSize;
+        int composedWidth = 0;
+        const QCPLabelAtlas::GlyphSet *glyphs = composableGlyphs(text, &composedWidth);
+        QCPLabelAtlas::Label label;
+        if (glyphs) // numeric label, compose it from glyphs without any text layout
+        {
+            TickLabelData labelData;
+            labelData.totalBounds = QRect(0, 0, composedWidth, glyphs->height);
+            labelData.rotatedTotalBounds = labelData.totalBounds;
+            labelOffset = getTickLabelDrawOffset(labelData);
+            labelSize = labelData.totalBounds.size();
+        } else
         {
-            cachedLabel = new CachedLabel;
-            TickLabelData labelData = getTickLabelData(painter->font(), text);
-            cachedLabel->offset = getTickLabelDrawOffset(labelData)+labelData.rotatedTotalBounds.topLeft();
-            if (!qFuzzyCompare(1.0, mParentPlot->bufferDevicePixelRatio()))
+            QCPLabelAtlas *atlas = QCPLabelAtlas::instance();
+            const QByteArray key = mLabelParameterHash + text.toUtf8();
+            if (const QCPLabelAtlas::Label *cachedLabel = atlas->label(key)) // attempt to get label from cache
+            {
+                label = *cachedLabel;
+            } else // no cached label existed, create it
             {
-                cachedLabel->pixmap = QPixmap(labelData.rotatedTotalBounds.size()*mParentPlot->bufferDevicePixelRatio());
+                TickLabelData labelData = getTickLabelData(painter->font(), text);
+                label.offset = getTickLabelDrawOffset(labelData)+labelData.rotatedTotalBounds.topLeft();
+                if (!qFuzzyCompare(1.0, mParentPlot->bufferDevicePixelRatio()))
+                {
+                    label.pixmap = QPixmap(labelData.rotatedTotalBounds.size()*mParentPlot->bufferDevicePixelRatio());
 #ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
 #  ifdef QCP_DEVICEPIXELRATIO_FLOAT
-                cachedLabel->pixmap.setDevicePixelRatio(mParentPlot->devicePixelRatioF());
+                    label.pixmap.setDevicePixelRatio(mParentPlot->devicePixelRatioF());
 #  else
-                cachedLabel->pixmap.setDevicePixelRatio(mParentPlot->devicePixelRatio());
+                    label.pixmap.setDevicePixelRatio(mParentPlot->devicePixelRatio());
 #  endif
 #endif
-            } else
-                cachedLabel->pixmap = QPixmap(labelData.rotatedTotalBounds.size());
-            cachedLabel->pixmap.fill(Qt::transparent);
-            QCPPainter cachePainter(&cachedLabel->pixmap);
-            cachePainter.setPen(painter->pen());
-            drawTickLabel(&cachePainter, -labelData.rotatedTotalBounds.topLeft().x(), -labelData.rotatedTotalBounds.topLeft().y(), labelData);
+                } else
+                    label.pixmap = QPixmap(labelData.rotatedTotalBounds.size());
+                label.pixmap.fill(Qt::transparent);
+                QCPPainter cachePainter(&label.pixmap);
+                cachePainter.setPen(painter->pen());
+                drawTickLabel(&cachePainter, -labelData.rotatedTotalBounds.topLeft().x(), -labelData.rotatedTotalBounds.topLeft().y(), labelData);
+                cachePainter.end();
+                atlas->insertLabel(key, label);
+            }
+            labelOffset = label.offset;
+            labelSize = QSizeF(label.pixmap.size())/mParentPlot->bufferDevicePixelRatio();
         }
         // if label would be partly clipped by widget border on sides, don't draw it (only for outside tick labels):
         bool labelClippedByBorder = false;
         if (tickLabelSide == QCPAxis::lsOutside)
         {
             if (QCPAxis::orientation(type) == Qt::Horizontal)
-                labelClippedByBorder = labelAnchor.x()+cachedLabel->offset.x()+cachedLabel->pixmap.width()/mParentPlot->bufferDevicePixelRatio() > viewportRect.right() || labelAnchor.x()+cachedLabel->offset.x() < viewportRect.left();
+                labelClippedByBorder = labelAnchor.x()+labelOffset.x()+labelSize.width() > viewportRect.right() || labelAnchor.x()+labelOffset.x() < viewportRect.left();
             else
-                labelClippedByBorder = labelAnchor.y()+cachedLabel->offset.y()+cachedLabel->pixmap.height()/mParentPlot->bufferDevicePixelRatio() > viewportRect.bottom() || labelAnchor.y()+cachedLabel->offset.y() < viewportRect.top();
+                labelClippedByBorder = labelAnchor.y()+labelOffset.y()+labelSize.height() > viewportRect.bottom() || labelAnchor.y()+labelOffset.y() < viewportRect.top();
         }
         if (!labelClippedByBorder)
         {
-            painter->drawPixmap(labelAnchor+cachedLabel->offset, cachedLabel->pixmap);
-            finalSize = cachedLabel->pixmap.size()/mParentPlot->bufferDevicePixelRatio();
+            if (glyphs)
+                QCPLabelAtlas::drawComposed(painter, labelAnchor+labelOffset, glyphs, text);
+            else
+                painter->drawPixmap(labelAnchor+labelOffset, label.pixmap);
+            finalSize = labelSize.toSize();
         }
-        mLabelCache.insert(text, cachedLabel); // return label to cache or insert for the first time if newly created
     } else // label caching disabled, draw text directly on surface:
     {
         TickLabelData labelData = getTickLabelData(painter->font(), text);
@@ -9660,19 +11270,30 @@ QCPAxisPainterPrivate::TickLabelData QCPAxisPainterPrivate::getTickLabelData(con
     if (useBeautifulPowers)
     {
         // split text into parts of number/symbol that will be drawn normally and part that will be drawn as exponent:
-        result.basePart = text.left(ePos);
         result.suffixPart = text.mid(eLast+1); // also drawn normally but after exponent
         // in log scaling, we want to turn "1*10^n" into "10^n", else add multiplication sign and decimal base:
-        if (abbreviateDecimalPowers && result.basePart == QLatin1String("1"))
+        if (abbreviateDecimalPowers && ePos == 1 && text.at(0) == QLatin1Char('1'))
+        {
             result.basePart = QLatin1String("10");
-        else
-            result.basePart += (numberMultiplyCross ? QString(QChar(215)) : QString(QChar(183))) + QLatin1String("10");
-        result.expPart = text.mid(ePos+1, eLast-ePos);
-        // clip "+" and leading zeros off expPart:
-        while (result.expPart.length() > 2 && result.expPart.at(1) == QLatin1Char('0')) // length > 2 so we leave one zero when numberFormatChar is 'e'
-            result.expPart.remove(1, 1);
-        if (!result.expPart.isEmpty() && result.expPart.at(0) == QLatin1Char('+'))
-            result.expPart.remove(0, 1);
+        } else
+        {
+            result.basePart = text.left(ePos);
+            result.basePart.append(QChar(numberMultiplyCross ? 215 : 183));
+            result.basePart.append(QLatin1String("10"));
+        }
+        // clip "+" and leading zeros off the exponent, in one pass over text instead of repeatedly removing characters:
+        int expBegin = ePos+1;
+        int zeros = 0;
+        while (eLast-expBegin-zeros > 1 && text.at(expBegin+1+zeros) == QLatin1Char('0')) // keeps one digit, so we leave one zero when numberFormatChar is 'e'
+            ++zeros;
+        if (text.at(expBegin) == QLatin1Char('+'))
+        {
+            result.expPart = text.mid(expBegin+1+zeros, eLast-expBegin-zeros);
+        } else // take the sign (or first digit) and the remaining digits in one substring, by starting at the last skipped character
+        {
+            result.expPart = text.mid(expBegin+zeros, eLast-expBegin-zeros+1);
+            result.expPart[0] = text.at(expBegin);
+        }
         // prepare smaller font for exponent:
         result.expFont = font;
         if (result.expFont.pointSize() > 0)
@@ -9680,10 +11301,11 @@ QCPAxisPainterPrivate::TickLabelData QCPAxisPainterPrivate::getTickLabelData(con
         else
             result.expFont.setPixelSize(result.expFont.pixelSize()*0.75);
         // calculate bounding rects of base part(s), exponent part and total one:
-        result.baseBounds = QFontMetrics(result.baseFont).boundingRect(0, 0, 0, 0, Qt::TextDontClip, result.basePart);
+        const QFontMetrics baseMetrics(result.baseFont);
+        result.baseBounds = baseMetrics.boundingRect(0, 0, 0, 0, Qt::TextDontClip, result.basePart);
         result.expBounds = QFontMetrics(result.expFont).boundingRect(0, 0, 0, 0, Qt::TextDontClip, result.expPart);
         if (!result.suffixPart.isEmpty())
-            result.suffixBounds = QFontMetrics(result.baseFont).boundingRect(0, 0, 0, 0, Qt::TextDontClip, result.suffixPart);
+            result.suffixBounds = baseMetrics.boundingRect(0, 0, 0, 0, Qt::TextDontClip, result.suffixPart);
         result.totalBounds = result.baseBounds.adjusted(0, 0, result.expBounds.width()+result.suffixBounds.width()+2, 0); // +2 consists of the 1 pixel spacing between base and exponent (see drawTickLabel) and an extra pixel to include AA
     } else // useBeautifulPowers == false
     {
@@ -9818,10 +11440,16 @@ void QCPAxisPainterPrivate::getMaxTickLabelSize(const QFont &font, const QString
 {
     // note: this function must return the same tick label sizes as the placeTickLabel function.
     QSize finalSize;
-    if (mParentPlot->plottingHints().testFlag(QCP::phCacheLabels) && mLabelCache.contains(text)) // label caching enabled and have cached label
+    const bool cacheLabels = mParentPlot->plottingHints().testFlag(QCP::phCacheLabels);
+    int composedWidth = 0;
+    const QCPLabelAtlas::GlyphSet *glyphs = cacheLabels ? composableGlyphs(text, &composedWidth) : 0;
+    const QCPLabelAtlas::Label *cachedLabel = cacheLabels && !glyphs ? QCPLabelAtlas::instance()->label(mLabelParameterHash + text.toUtf8()) : 0;
+    if (glyphs) // label caching enabled and label can be composed from glyphs
+    {
+        finalSize = QSize(composedWidth, glyphs->height);
+    } else if (cachedLabel) // label caching enabled and have cached label
     {
-        const CachedLabel *cachedLabel = mLabelCache.object(text);
-        finalSize = cachedLabel->pixmap.size()/mParentPlot->bufferDevicePixelRatio();
+        finalSize = (QSizeF(cachedLabel->pixmap.size())/mParentPlot->bufferDevicePixelRatio()).toSize();
     } else // label caching disabled or no label with this text cached:
     {
         TickLabelData labelData = getTickLabelData(font, text);
@@ -9834,6 +11462,56 @@ void QCPAxisPainterPrivate::getMaxTickLabelSize(const QFont &font, const QString
     if (finalSize.height() > tickLabelsSize->height())
         tickLabelsSize->setHeight(finalSize.height());
 }
+
+/*! \internal
+
+  Updates the keys under which the labels and glyphs of this axis are stored in the \ref
+  QCPLabelAtlas, see \ref generateLabelParameterHash and \ref generateGlyphSetKey. This is called
+  at the beginning of \ref draw and \ref size.
+*/
+void QCPAxisPainterPrivate::updateLabelKeys() const
+{
+    mLabelParameterHash = generateLabelParameterHash();
+    mGlyphSetKey = generateGlyphSetKey();
+}
+
+/*! \internal
+
+  Returns the font numeric tick labels are composed with. Like the base font in \ref
+  getTickLabelData, it is slightly enlarged to work around rounding issues of QFontMetrics.
+*/
+QFont QCPAxisPainterPrivate::composedLabelFont() const
+{
+    QFont result = tickLabelFont;
+    if (result.pointSizeF() > 0)
+        result.setPointSizeF(result.pointSizeF()+0.05);
+    return result;
+}
+
+/*! \internal
+
+  If the tick label \a text can be composed from the glyph set of this axis in the \ref
+  QCPLabelAtlas, returns the glyph set and writes the width of the composed label to \a width.
+  Otherwise returns 0.
+
+  Labels can be composed if they aren't rotated and only consist of digits, separators and signs.
+  In particular, labels in exponential notation are rendered as a whole, because they may need to
+  be transformed to beautiful powers (see \ref getTickLabelData).
+*/
+const QCPLabelAtlas::GlyphSet *QCPAxisPainterPrivate::composableGlyphs(const QString &text, int *width) const
+{
+    if (!qFuzzyIsNull(tickLabelRotation))
+        return 0;
+    QCPLabelAtlas *atlas = QCPLabelAtlas::instance();
+    const QCPLabelAtlas::GlyphSet *glyphs = atlas->glyphSet(mGlyphSetKey);
+    if (!glyphs)
+        glyphs = atlas->createGlyphSet(mGlyphSetKey, composedLabelFont(), tickLabelColor, mParentPlot->bufferDevicePixelRatio());
+    if (QCPLabelAtlas::composedWidth(glyphs, text, width))
+        return glyphs;
+    else
+        return 0;
+}
+
 /* end of 'src/axis/axis.cpp' */
 
 
@@ -11239,6 +12917,81 @@ void QCPAbstractPlottable::applyScattersAntialiasingHint(QCPPainter *painter) co
     applyAntialiasingHint(painter, mAntialiasedScatters, QCP::aeScatters);
 }
 
+/*! \internal
+
+  Returns whether the axis rect of this plottable currently shows a range preview, i.e. whether
+  this plottable should be drawn with \ref drawRangePreview instead of \ref draw. See \ref
+  QCPAxisRect::setRangePreview.
+*/
+bool QCPAbstractPlottable::rangePreviewActive() const
+{
+    if (!mKeyAxis || !mValueAxis)
+        return false;
+    QCPAxisRect *axisRect = mKeyAxis.data()->axisRect();
+    return axisRect->mRangePreviewActive && mValueAxis.data()->axisRect() == axisRect;
+}
+
+/*! \internal
+
+  Draws this plottable during a range preview (see \ref QCPAxisRect::setRangePreview). The first
+  call renders the plottable with \ref draw into a pixmap covering the clip rect, and remembers
+  the axis ranges at that time. All calls then draw that pixmap, scaled and translated such that
+  the rendered data appears at the position it has with the current axis ranges. Since the mapping
+  between the old and new pixel positions is linear for both linear and logarithmic axes, it is
+  determined by the old and new pixel positions of the remembered range bounds.
+
+  If the mapping can't be determined, e.g. because an axis scale type changed, the plottable is
+  drawn normally.
+*/
+void QCPAbstractPlottable::drawRangePreview(QCPPainter *painter)
+{
+    QCPAxis *keyAxis = mKeyAxis.data();
+    QCPAxis *valueAxis = mValueAxis.data();
+    if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
+
+    if (mRangePreviewPixmap.isNull())
+    {
+        const QRect rect = clipRect();
+        if (rect.isEmpty())
+            return;
+        const double devicePixelRatio = mParentPlot->bufferDevicePixelRatio();
+        mRangePreviewPixmap = QPixmap(rect.size()*devicePixelRatio);
+#ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
+        mRangePreviewPixmap.setDevicePixelRatio(devicePixelRatio);
+#endif
+        mRangePreviewPixmap.fill(Qt::transparent);
+        QCPPainter pixmapPainter(&mRangePreviewPixmap);
+        pixmapPainter.setRenderHint(QPainter::HighQualityAntialiasing);
+        pixmapPainter.setModes(painter->modes());
+        pixmapPainter.translate(-rect.topLeft());
+        pixmapPainter.setClipRect(rect.translated(0, -1));
+        applyDefaultAntialiasingHint(&pixmapPainter);
+        draw(&pixmapPainter);
+        pixmapPainter.end();
+        mRangePreviewPixmapPos = rect.topLeft();
+        mRangePreviewKeyRange = keyAxis->range();
+        mRangePreviewValueRange = valueAxis->range();
+        mRangePreviewLowerPixel = coordsToPixels(mRangePreviewKeyRange.lower, mRangePreviewValueRange.lower);
+        mRangePreviewUpperPixel = coordsToPixels(mRangePreviewKeyRange.upper, mRangePreviewValueRange.upper);
+    }
+
+    // affine mapping from the pixel positions at the time the pixmap was rendered to the current ones:
+    const QPointF lowerPixel = coordsToPixels(mRangePreviewKeyRange.lower, mRangePreviewValueRange.lower);
+    const QPointF upperPixel = coordsToPixels(mRangePreviewKeyRange.upper, mRangePreviewValueRange.upper);
+    const QPointF oldDiff = mRangePreviewUpperPixel-mRangePreviewLowerPixel;
+    const double scaleX = qFuzzyIsNull(oldDiff.x()) ? 0 : (upperPixel.x()-lowerPixel.x())/oldDiff.x();
+    const double scaleY = qFuzzyIsNull(oldDiff.y()) ? 0 : (upperPixel.y()-lowerPixel.y())/oldDiff.y();
+    const double offsetX = lowerPixel.x()-scaleX*mRangePreviewLowerPixel.x();
+    const double offsetY = lowerPixel.y()-scaleY*mRangePreviewLowerPixel.y();
+    if (qFuzzyIsNull(scaleX) || qFuzzyIsNull(scaleY) || !qIsFinite(scaleX) || !qIsFinite(scaleY) || !qIsFinite(offsetX) || !qIsFinite(offsetY))
+    {
+        draw(painter);
+        return;
+    }
+    painter->setTransform(QTransform(scaleX, 0, 0, scaleY, offsetX, offsetY), true);
+    painter->drawPixmap(mRangePreviewPixmapPos, mRangePreviewPixmap);
+}
+
 /* inherits documentation from base class */
 void QCPAbstractPlottable::selectEvent(QMouseEvent *event, bool additive, const QVariant &details, bool *selectionStateChanged)
 {
@@ -12555,30 +14308,207 @@ QCP::Interaction QCPAbstractItem::selectionCategory() const
 /* end of 'src/item.cpp' */
 
 
-/* including file 'src/core.cpp', size 126207                                */
-/* commit ce344b3f96a62e5f652585e55f1ae7c7883cd45b 2018-06-25 01:03:39 +0200 */
+/* including file 'src/profiler.cpp'                                         */
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-//////////////////// QCustomPlot
+//////////////////// QCPReplotProfile
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-/*! \class QCustomPlot
+/*! \class QCPReplotProfile
+  \brief Holds the timings and counters that were recorded during one replot
 
-  \brief The central class of the library. This is the QWidget which displays the plot and
-  interacts with the user.
+  If profiling is enabled with \ref QCustomPlot::setProfiling, the QCustomPlot instance measures
+  how much time the individual phases of each \ref QCustomPlot::replot take. After every replot,
+  the result is available via \ref QCustomPlot::replotProfile and is emitted with the signal \ref
+  QCustomPlot::replotProfiled.
 
-  For tutorials on how to use QCustomPlot, see the website\n
-  http://www.qcustomplot.com/
+  All times are given in nanoseconds, measured with QElapsedTimer (so the actual resolution depends
+  on the platform's monotonic clock). The recorded quantities are:
+
+  \li \a replotNsecs: the total time of the replot, including all phases listed below.
+  \li \a updateLayoutNsecs: the layout phase (\ref QCustomPlot::updateLayout), which includes
+  margin calculation and tick generation.
+  \li \a tickGenerationNsecs: the part of the layout phase spent generating tick vectors and tick
+  labels (\ref QCPAxisTicker::generate) of all axes.
+  \li \a setupPaintBuffersNsecs: the preparation (allocation, resizing, clearing) of the paint
+  buffers.
+  \li \a compositeNsecs: the time the widget's paint event took to join the paint buffers onto the
+  widget surface. If the replot refreshes the widget immediately (\ref QCP::phImmediateRefresh,
+  the default), this is part of the same replot. Otherwise the composite happens later, and this
+  member of the most recent profile (\ref QCustomPlot::replotProfile) is updated when it happens.
+  \li \a samplingPointsIn and \a samplingPointsOut: the number of data points that entered and
+  left the line data sampling of all graphs (see \ref QCPGraph::setAdaptiveSampling). A large
+  ratio indicates that adaptive sampling is effective.
+  \li \a layerTimings: the time spent drawing each layer into its paint buffer, in layer order.
+  \li \a layerableTimings: the time spent in the draw call of each visible layerable, in drawing
+  order. The name of a layerable is its class name, followed by its object name if it has one.
 */
 
-/* start of documentation of inline functions */
+/*!
+  Creates an empty profile, with all timings and counters set to zero.
+*/
+QCPReplotProfile::QCPReplotProfile() :
+    replotNsecs(0),
+    updateLayoutNsecs(0),
+    tickGenerationNsecs(0),
+    setupPaintBuffersNsecs(0),
+    compositeNsecs(0),
+    samplingPointsIn(0),
+    samplingPointsOut(0)
+{
+}
 
-/*! \fn QCPSelectionRect *QCustomPlot::selectionRect() const
+/*!
+  Returns the \a count layerables with the highest draw time, sorted by descending draw time.
+*/
+QList<QCPReplotProfile::Timing> QCPReplotProfile::slowestLayerables(int count) const
+{
+    QList<Timing> result = layerableTimings;
+    std::stable_sort(result.begin(), result.end(), lessThanSlower);
+    while (result.size() > count)
+        result.removeLast();
+    return result;
+}
 
-  Allows access to the currently used QCPSelectionRect instance (or subclass thereof), that is used
-  to handle and draw selection rect interactions (see \ref setSelectionRectMode).
 
-  \see setSelectionRect
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPProfilerHud
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPProfilerHud
+  \brief An on-plot display of the most recent replot profile
+
+  This layerable draws the timings of the most recent \ref QCPReplotProfile of its parent plot as
+  a small text box in the top left corner of the viewport. It is meant to help tuning plots while
+  they are running in their real environment.
+
+  To use it, just create an instance with the plot as parent:
+  \code
+  new QCPProfilerHud(customPlot);
+  \endcode
+  The HUD places itself on the "overlay" layer and enables profiling on the parent plot (\ref
+  QCustomPlot::setProfiling). Since the HUD is drawn as part of a replot, it always shows the
+  profile of the preceding replot. To remove the HUD, delete it.
+*/
+
+/*!
+  Creates a new profiler HUD on the "overlay" layer of \a parentPlot, and enables profiling on \a
+  parentPlot.
+*/
+QCPProfilerHud::QCPProfilerHud(QCustomPlot *parentPlot) :
+    QCPLayerable(parentPlot, QLatin1String("overlay")),
+    mFont(QFont(QLatin1String("Monospace"), 8)),
+    mTextColor(Qt::white),
+    mBrush(QColor(0, 0, 0, 160)),
+    mLayerableCount(5)
+{
+    mFont.setStyleHint(QFont::TypeWriter);
+    if (parentPlot)
+        parentPlot->setProfiling(true);
+}
+
+QCPProfilerHud::~QCPProfilerHud()
+{
+}
+
+/*!
+  Sets the font of the HUD text.
+*/
+void QCPProfilerHud::setFont(const QFont &font)
+{
+    mFont = font;
+}
+
+/*!
+  Sets the color of the HUD text.
+*/
+void QCPProfilerHud::setTextColor(const QColor &color)
+{
+    mTextColor = color;
+}
+
+/*!
+  Sets the brush that fills the background of the HUD text box. Use \c Qt::NoBrush for no fill.
+*/
+void QCPProfilerHud::setBrush(const QBrush &brush)
+{
+    mBrush = brush;
+}
+
+/*!
+  Sets how many of the layerables with the highest draw time are listed in the HUD.
+*/
+void QCPProfilerHud::setLayerableCount(int count)
+{
+    mLayerableCount = qMax(0, count);
+}
+
+/* inherits documentation from base class */
+void QCPProfilerHud::applyDefaultAntialiasingHint(QCPPainter *painter) const
+{
+    painter->setAntialiasing(false);
+}
+
+/* inherits documentation from base class */
+void QCPProfilerHud::draw(QCPPainter *painter)
+{
+    if (!mParentPlot) return;
+    const QCPReplotProfile profile = mParentPlot->replotProfile();
+    QStringList lines;
+    if (!mParentPlot->profiling())
+        lines << QLatin1String("profiling disabled");
+    else if (profile.isEmpty())
+        lines << QLatin1String("no replot profiled yet");
+    else
+    {
+        lines << QString(QLatin1String("replot    %1 ms")).arg(profile.replotNsecs/1.0e6, 0, 'f', 3);
+        lines << QString(QLatin1String("layout    %1 ms (ticks %2 ms)")).arg(profile.updateLayoutNsecs/1.0e6, 0, 'f', 3).arg(profile.tickGenerationNsecs/1.0e6, 0, 'f', 3);
+        lines << QString(QLatin1String("buffers   %1 ms")).arg(profile.setupPaintBuffersNsecs/1.0e6, 0, 'f', 3);
+        lines << QString(QLatin1String("composite %1 ms")).arg(profile.compositeNsecs/1.0e6, 0, 'f', 3);
+        lines << QString(QLatin1String("sampling  %1 -> %2 points")).arg(profile.samplingPointsIn).arg(profile.samplingPointsOut);
+        foreach (const QCPReplotProfile::Timing &timing, profile.layerTimings)
+            lines << QString(QLatin1String("layer %1: %2 ms")).arg(timing.name).arg(timing.nsecs/1.0e6, 0, 'f', 3);
+        foreach (const QCPReplotProfile::Timing &timing, profile.slowestLayerables(mLayerableCount))
+            lines << QString(QLatin1String("  %1 (%2): %3 ms")).arg(timing.name).arg(timing.layerName).arg(timing.nsecs/1.0e6, 0, 'f', 3);
+    }
+
+    painter->setFont(mFont);
+    const QString text = lines.join(QLatin1String("\n"));
+    const QRect textRect = painter->fontMetrics().boundingRect(0, 0, 0, 0, Qt::TextDontClip|Qt::AlignLeft|Qt::AlignTop, text);
+    const QRect boxRect = textRect.adjusted(-4, -4, 4, 4).translated(mParentPlot->viewport().topLeft()+QPoint(8, 8));
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(mBrush);
+    painter->drawRect(boxRect);
+    painter->setPen(mTextColor);
+    painter->drawText(boxRect.adjusted(4, 4, -4, -4), Qt::TextDontClip|Qt::AlignLeft|Qt::AlignTop, text);
+}
+/* end of 'src/profiler.cpp' */
+
+
+/* including file 'src/core.cpp', size 126207                                */
+/* commit ce344b3f96a62e5f652585e55f1ae7c7883cd45b 2018-06-25 01:03:39 +0200 */
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCustomPlot
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCustomPlot
+
+  \brief The central class of the library. This is the QWidget which displays the plot and
+  interacts with the user.
+
+  For tutorials on how to use QCustomPlot, see the website\n
+  http://www.qcustomplot.com/
+*/
+
+/* start of documentation of inline functions */
+
+/*! \fn QCPSelectionRect *QCustomPlot::selectionRect() const
+
+  Allows access to the currently used QCPSelectionRect instance (or subclass thereof), that is used
+  to handle and draw selection rect interactions (see \ref setSelectionRectMode).
+
+  \see setSelectionRect
 */
 
 /*! \fn QCPLayoutGrid *QCustomPlot::plotLayout() const
@@ -12760,6 +14690,15 @@ QCP::Interaction QCPAbstractItem::selectionCategory() const
   \see replot, beforeReplot
 */
 
+/*! \fn void QCustomPlot::replotProfiled(const QCPReplotProfile &profile)
+
+  This signal is emitted at the end of every replot, if profiling is enabled (\ref setProfiling).
+  The \a profile holds the timings and counters that were recorded during the replot. It is
+  emitted before \ref afterReplot.
+
+  \see replotProfile
+*/
+
 /* end of documentation of signals */
 /* start of documentation of public members */
 
@@ -12888,17 +14827,28 @@ QCustomPlot::QCustomPlot(QWidget *parent) :
     mSelectionRectMode(QCP::srmNone),
     mSelectionRect(0),
     mOpenGl(false),
+    mProfiling(false),
     mMouseHasMoved(false),
     mMouseEventLayerable(0),
     mMouseSignalLayerable(0),
     mReplotting(false),
     mReplotQueued(false),
+    mLayoutPass(0),
+    mLayerableIndexValid(false),
+    mRenderStride(1),
+    mExactReplotNsecs(0),
+    mGraphRenderNsecs(0),
+    mGraphsDecimated(false),
+    mRefiningReplot(false),
+    mRefinementTimer(new QTimer(this)),
     mOpenGlMultisamples(16),
     mOpenGlAntialiasedElementsBackup(QCP::aeNone),
     mOpenGlCacheLabelsBackup(true)
 {
     setAttribute(Qt::WA_NoMousePropagation);
     setAttribute(Qt::WA_OpaquePaintEvent);
+    mRefinementTimer->setSingleShot(true);
+    connect(mRefinementTimer, SIGNAL(timeout()), this, SLOT(refineReplot()));
     setFocusPolicy(Qt::ClickFocus);
     setMouseTracking(true);
     QLocale currentLocale = locale();
@@ -13364,6 +15314,7 @@ void QCustomPlot::setOpenGl(bool enabled, int multisampling)
     }
     // recreate all paint buffers:
     mPaintBuffers.clear();
+    mPaintBufferPool.clear();
     setupPaintBuffers();
 #else
     Q_UNUSED(enabled)
@@ -13371,6 +15322,26 @@ void QCustomPlot::setOpenGl(bool enabled, int multisampling)
 #endif
 }
 
+/*!
+  Enables or disables the recording of replot timings. If \a enabled is true, every \ref replot
+  measures the time spent in its individual phases (layout, tick generation, paint buffer setup,
+  drawing of each layer and layerable, and compositing of the paint buffers onto the widget) and
+  counts the data points processed by the graph line sampling. The result is stored in a \ref
+  QCPReplotProfile which can be retrieved with \ref replotProfile, and is emitted via the signal
+  \ref replotProfiled.
+
+  Profiling is disabled by default. Its overhead is small but not zero, since the draw call of
+  every layerable is timed individually.
+
+  To see the profile on the plot itself, create a \ref QCPProfilerHud.
+*/
+void QCustomPlot::setProfiling(bool enabled)
+{
+    mProfiling = enabled;
+    if (!mProfiling)
+        mReplotProfile = QCPReplotProfile();
+}
+
 /*!
   Sets the viewport of this QCustomPlot. Usually users of QCustomPlot don't need to change the
   viewport manually.
@@ -14427,6 +16398,14 @@ void QCustomPlot::deselectAll()
   If a layer is in mode \ref QCPLayer::lmBuffered (\ref QCPLayer::setMode), it is also possible to
   replot only that specific layer via \ref QCPLayer::replot. See the documentation there for
   details.
+
+  If the plotting hint \ref QCP::phProgressiveRendering is set and drawing the graphs at full
+  detail is expected to take longer than a frame, graphs are drawn from every n-th data point only,
+  with n chosen such that they are expected to be drawn within a frame. The plot is then refined in
+  subsequent event loop iterations, each step drawing four times as many data points, until the
+  exact result is shown. Calling \ref replot in the meantime with unchanged axis ranges continues
+  the refinement, while a change of any axis range cancels it and starts over with the coarse
+  stride. Exports via \ref savePdf, \ref toPixmap etc. always draw all data points.
 */
 void QCustomPlot::replot(QCustomPlot::RefreshPriority refreshPriority)
 {
@@ -14444,21 +16423,87 @@ void QCustomPlot::replot(QCustomPlot::RefreshPriority refreshPriority)
         return;
     mReplotting = true;
     mReplotQueued = false;
+    mLayerableIndexValid = false; // layerable bounds are rebuilt on the next layerableListAt call
+
+    const bool refinementPending = mRefinementTimer->isActive();
+    mRefinementTimer->stop(); // this replot either performs the pending refinement step or makes it obsolete
     emit beforeReplot();
 
+    // progressive rendering: replots with changed ranges start coarse if drawing the graphs at full detail is expected to take longer than a frame,
+    // refinement replots and replots that interrupt a pending refinement of unchanged ranges continue from the current stride:
+    if (mPlottingHints.testFlag(QCP::phProgressiveRendering))
+    {
+        const qint64 frameNsecs = 16000000;
+        QVector<double> ranges;
+        foreach (QCPAxisRect *rect, axisRects())
+        {
+            foreach (QCPAxis *axis, rect->axes())
+                ranges << axis->range().lower << axis->range().upper;
+        }
+        if (!mRefiningReplot)
+        {
+            if (refinementPending && mRenderStride > 1 && ranges == mRefinementRanges)
+            {
+                mRenderStride = qMax(1, mRenderStride/4); // advance the refinement, so replots from outside can't keep it from reaching full detail
+            } else
+            {
+                mRenderStride = 1;
+                while (mExactReplotNsecs/mRenderStride > frameNsecs && mRenderStride < 4096)
+                    mRenderStride *= 4;
+            }
+        }
+        mRefinementRanges = ranges;
+    } else
+        mRenderStride = 1;
+    mGraphRenderNsecs = 0;
+    mGraphsDecimated = false;
+
+    QElapsedTimer profileTimer;
+    if (mProfiling)
+    {
+        mCurrentProfile = QCPReplotProfile();
+        profileTimer.start();
+    }
+
     updateLayout();
+    if (mProfiling)
+        mCurrentProfile.updateLayoutNsecs = profileTimer.nsecsElapsed();
     // draw all layered objects (grid, axes, plottables, items, legend,...) into their buffers:
     setupPaintBuffers();
+    if (mProfiling)
+        mCurrentProfile.setupPaintBuffersNsecs = profileTimer.nsecsElapsed()-mCurrentProfile.updateLayoutNsecs;
     foreach (QCPLayer *layer, mLayers)
-        layer->drawToPaintBuffer();
+    {
+        if (mProfiling)
+        {
+            QElapsedTimer layerTimer;
+            layerTimer.start();
+            layer->drawToPaintBuffer();
+            mCurrentProfile.layerTimings.append(QCPReplotProfile::Timing(layer->name(), layer->name(), layerTimer.nsecsElapsed()));
+        } else
+            layer->drawToPaintBuffer();
+    }
     for (int i=0; i<mPaintBuffers.size(); ++i)
         mPaintBuffers.at(i)->setInvalidated(false);
 
+    // every pass updates the estimate of the full detail graph drawing time, so continuous coarse replots (e.g. while dragging) adapt to range changes in both directions.
+    // Only decimated passes are extrapolated by the stride, everything else in the replot doesn't depend on it:
+    mExactReplotNsecs = mGraphsDecimated ? mGraphRenderNsecs*mRenderStride : mGraphRenderNsecs;
+    if (mRenderStride > 1 && mGraphsDecimated)
+        mRefinementTimer->start(); // refine in the next event loop iteration
+
     if ((refreshPriority == rpRefreshHint && mPlottingHints.testFlag(QCP::phImmediateRefresh)) || refreshPriority==rpImmediateRefresh)
         repaint();
     else
         update();
 
+    if (mProfiling)
+    {
+        mCurrentProfile.replotNsecs = profileTimer.nsecsElapsed();
+        mReplotProfile = mCurrentProfile;
+        emit replotProfiled(mReplotProfile);
+    }
+
     emit afterReplot();
     mReplotting = false;
 }
@@ -14757,11 +16802,16 @@ void QCustomPlot::paintEvent(QPaintEvent *event)
     if (painter.isActive())
     {
         painter.setRenderHint(QPainter::HighQualityAntialiasing); // to make Antialiasing look good if using the OpenGL graphicssystem
+        QElapsedTimer profileTimer;
+        if (mProfiling)
+            profileTimer.start();
         if (mBackgroundBrush.style() != Qt::NoBrush)
             painter.fillRect(mViewport, mBackgroundBrush);
         drawBackground(&painter);
         for (int bufferIndex = 0; bufferIndex < mPaintBuffers.size(); ++bufferIndex)
             mPaintBuffers.at(bufferIndex)->draw(&painter);
+        if (mProfiling) // during immediate refresh the composite is part of the replot being profiled, otherwise it belongs to the last completed one
+            (mReplotting ? mCurrentProfile : mReplotProfile).compositeNsecs = profileTimer.nsecsElapsed();
     }
 }
 
@@ -15028,9 +17078,15 @@ void QCustomPlot::draw(QCPPainter *painter)
 
   Here, the layout elements calculate their positions and margins, and prepare for the following
   draw call.
+
+  Every call starts a new layout pass. Results which can't change during a pass, like the common
+  margins of a QCPMarginGroup, are calculated only once per pass. Layouts only redistribute their
+  sections if the available space or the size constraints of their elements changed (see
+  QCPLayoutGrid::updateLayout).
 */
 void QCustomPlot::updateLayout()
 {
+    ++mLayoutPass; // invalidates results memoized during the previous pass, e.g. in QCPMarginGroup
     // run through layout phases:
     mPlotLayout->update(QCPLayoutElement::upPreparation);
     mPlotLayout->update(QCPLayoutElement::upMargins);
@@ -15086,10 +17142,15 @@ void QCustomPlot::drawBackground(QCPPainter *painter)
   QCPLayer::lmLogical layers to a mutual paint buffer and creates dedicated paint buffers for
   layers in \ref QCPLayer::lmBuffered mode.
 
-  This method uses \ref createPaintBuffer to create new paint buffers.
+  This method uses \ref acquirePaintBuffer to obtain new paint buffers, and buffers that are no
+  longer needed are handed back to a small pool via \ref releasePaintBuffer, so changing layer
+  modes back and forth doesn't reallocate buffers.
 
   After this method, the paint buffers are empty (filled with \c Qt::transparent) and invalidated
-  (so an attempt to replot only a single buffered layer causes a full replot).
+  (so an attempt to replot only a single buffered layer causes a full replot). Clearing is skipped
+  for buffers whose associated layers are known to cover the entire drawn area with opaque content
+  (see \ref QCPLayer::opaqueRegion), since their previous contents are overwritten anyway. Buffers
+  that were reallocated since their last clear are always cleared.
 
   This method is called in every \ref replot call, prior to actually drawing the layers (into their
   associated paint buffer). If the paint buffers don't need changing/reallocating, this method
@@ -15099,8 +17160,9 @@ void QCustomPlot::setupPaintBuffers()
 {
     int bufferIndex = 0;
     if (mPaintBuffers.isEmpty())
-        mPaintBuffers.append(QSharedPointer<QCPAbstractPaintBuffer>(createPaintBuffer()));
+        mPaintBuffers.append(acquirePaintBuffer());
 
+    QVector<QRegion> opaqueRegions(2*mLayers.size()+1); // upper bound for number of buffers
     for (int layerIndex = 0; layerIndex < mLayers.size(); ++layerIndex)
     {
         QCPLayer *layer = mLayers.at(layerIndex);
@@ -15111,24 +17173,34 @@ void QCustomPlot::setupPaintBuffers()
         {
             ++bufferIndex;
             if (bufferIndex >= mPaintBuffers.size())
-                mPaintBuffers.append(QSharedPointer<QCPAbstractPaintBuffer>(createPaintBuffer()));
+                mPaintBuffers.append(acquirePaintBuffer());
             layer->mPaintBuffer = mPaintBuffers.at(bufferIndex).toWeakRef();
+            opaqueRegions[bufferIndex] += layer->opaqueRegion();
             if (layerIndex < mLayers.size()-1 && mLayers.at(layerIndex+1)->mode() == QCPLayer::lmLogical) // not last layer, and next one is logical, so prepare another buffer for next layerables
             {
                 ++bufferIndex;
                 if (bufferIndex >= mPaintBuffers.size())
-                    mPaintBuffers.append(QSharedPointer<QCPAbstractPaintBuffer>(createPaintBuffer()));
+                    mPaintBuffers.append(acquirePaintBuffer());
             }
+            continue;
         }
+        opaqueRegions[bufferIndex] += layer->opaqueRegion();
     }
-    // remove unneeded buffers:
+    // move unneeded buffers to pool:
     while (mPaintBuffers.size()-1 > bufferIndex)
-        mPaintBuffers.removeLast();
-    // resize buffers to viewport size and clear contents:
+        releasePaintBuffer(mPaintBuffers.takeLast());
+    // resize buffers to viewport size and clear contents, unless they will be completely overwritten. Layerables are clipped to the
+    // viewport translated by one pixel upward (see QCPLayer::draw), so the bottom pixel row is never drawn and keeps its cleared state:
+    const QRect bufferRect(QPoint(0, 0), viewport().size());
+    const QRect drawnRect = bufferRect & bufferRect.translated(0, -1);
     for (int i=0; i<mPaintBuffers.size(); ++i)
     {
         mPaintBuffers.at(i)->setSize(viewport().size()); // won't do anything if already correct size
-        mPaintBuffers.at(i)->clear(Qt::transparent);
+        if (mPaintBuffers.at(i)->mContentsUndefined || !opaqueRegions.at(i).contains(drawnRect))
+        {
+            mPaintBuffers.at(i)->clear(Qt::transparent);
+            mPaintBuffers.at(i)->mContentsUndefined = false;
+        }
         mPaintBuffers.at(i)->setInvalidated();
     }
 }
@@ -15157,6 +17229,41 @@ QCPAbstractPaintBuffer *QCustomPlot::createPaintBuffer()
         return new QCPPaintBufferPixmap(viewport().size(), mBufferDevicePixelRatio);
 }
 
+/*! \internal
+
+  Returns a paint buffer for use by \ref setupPaintBuffers. If a previously released buffer of the
+  current backend is available in the pool (see \ref releasePaintBuffer), it is reused and adapted
+  to the current device pixel ratio. Otherwise a new buffer is created with \ref createPaintBuffer.
+*/
+QSharedPointer<QCPAbstractPaintBuffer> QCustomPlot::acquirePaintBuffer()
+{
+    if (!mPaintBufferPool.isEmpty())
+    {
+        QSharedPointer<QCPAbstractPaintBuffer> buffer = mPaintBufferPool.takeFirst();
+        buffer->setDevicePixelRatio(mBufferDevicePixelRatio);
+        buffer->setInvalidated();
+        return buffer;
+    }
+    return QSharedPointer<QCPAbstractPaintBuffer>(createPaintBuffer());
+}
+
+/*! \internal
+
+  Hands the no longer needed paint \a buffer back to the pool, so a subsequent \ref
+  acquirePaintBuffer can reuse its allocation. The pool only keeps the most recently released
+  buffers, older ones are freed.
+
+  The pool is emptied whenever the paint buffer backend changes (\ref setOpenGl).
+*/
+void QCustomPlot::releasePaintBuffer(const QSharedPointer<QCPAbstractPaintBuffer> &buffer)
+{
+    if (buffer.isNull())
+        return;
+    mPaintBufferPool.prepend(buffer);
+    while (mPaintBufferPool.size() > 2)
+        mPaintBufferPool.removeLast();
+}
+
 /*!
   This method returns whether any of the paint buffers held by this QCustomPlot instance are
   invalidated.
@@ -15259,6 +17366,54 @@ void QCustomPlot::freeOpenGl()
 #endif
 }
 
+/*! \internal
+
+  Performs the next refinement step of progressive rendering (see \ref QCP::phProgressiveRendering).
+  The data stride of the last replot is reduced by a factor of four and the plot is replotted. If
+  the stride is still greater than one, \ref replot schedules the next step for the following event
+  loop iteration, so user input is processed in between. A replot requested from outside in the
+  meantime also advances the refinement if the axis ranges are unchanged, otherwise it starts over.
+*/
+void QCustomPlot::refineReplot()
+{
+    if (mRenderStride <= 1)
+        return;
+    mRenderStride = qMax(1, mRenderStride/4);
+    mRefiningReplot = true;
+    replot(rpQueuedRefresh);
+    mRefiningReplot = false;
+}
+
+/*! \internal
+
+  Compares the horizontal centers of the bounds of \a a and \a b. Used to split the layerable
+  bounding volume hierarchy, see \ref buildLayerableIndexNode.
+*/
+bool QCustomPlot::lessThanBoundsCenterX(const LayerableBounds &a, const LayerableBounds &b)
+{
+    return a.bounds.left()+a.bounds.right() < b.bounds.left()+b.bounds.right();
+}
+
+/*! \internal
+
+  Compares the vertical centers of the bounds of \a a and \a b. Used to split the layerable
+  bounding volume hierarchy, see \ref buildLayerableIndexNode.
+*/
+bool QCustomPlot::lessThanBoundsCenterY(const LayerableBounds &a, const LayerableBounds &b)
+{
+    return a.bounds.top()+a.bounds.bottom() < b.bounds.top()+b.bounds.bottom();
+}
+
+/*! \internal
+
+  Returns whether \a a is drawn after \a b, i.e. lies above it. Used to sort the candidates in
+  \ref layerableListAt from top to bottom.
+*/
+bool QCustomPlot::greaterThanOrder(const LayerableBounds &a, const LayerableBounds &b)
+{
+    return a.order > b.order;
+}
+
 /*! \internal
 
   This method is used by \ref QCPAxisRect::removeAxis to report removed axes to the QCustomPlot
@@ -15554,6 +17709,7 @@ void QCustomPlot::updateLayerIndices() const
 {
     for (int i=0; i<mLayers.size(); ++i)
         mLayers.at(i)->mIndex = i;
+    mLayerableIndexValid = false;
 }
 
 /*! \internal
@@ -15599,31 +17755,138 @@ QCPLayerable *QCustomPlot::layerableAt(const QPointF &pos, bool onlySelectable,
   QCPAxis::SelectablePart). If the layerable is a plottable, \a selectionDetails contains a \ref
   QCPDataSelection instance with the single data point which is closest to \a pos.
 
+  Only layerables whose bounds (\ref QCPLayerable::selectTestBounds) come within the selection
+  tolerance of \a pos are tested, the candidates are found with a bounding volume hierarchy that is
+  rebuilt on the first call after a replot or a change of the layers.
+
   \see layerableAt, layoutElementAt, axisRectAt
 */
 QList<QCPLayerable*> QCustomPlot::layerableListAt(const QPointF &pos, bool onlySelectable, QList<QVariant> *selectionDetails) const
 {
-    QList<QCPLayerable*> result;
-    for (int layerIndex=mLayers.size()-1; layerIndex>=0; --layerIndex)
+    if (!mLayerableIndexValid)
+        updateLayerableIndex();
+
+    // collect candidates from the bounding volume hierarchy, and the layerables without bounds:
+    const double tolerance = selectionTolerance();
+    QVector<LayerableBounds> candidates = mUnboundedLayerables;
+    QVarLengthArray<int, 64> nodeStack;
+    if (!mLayerableIndexNodes.isEmpty())
+        nodeStack.append(0);
+    while (nodeStack.size() > 0)
     {
-        const QList<QCPLayerable*> layerables = mLayers.at(layerIndex)->children();
-        for (int i=layerables.size()-1; i>=0; --i)
+        const LayerableIndexNode &node = mLayerableIndexNodes.at(nodeStack[nodeStack.size()-1]);
+        nodeStack.resize(nodeStack.size()-1);
+        if (!node.bounds.adjusted(-tolerance, -tolerance, tolerance, tolerance).contains(pos))
+            continue;
+        if (node.left < 0)
         {
-            if (!layerables.at(i)->realVisibility())
-                continue;
-            QVariant details;
-            double dist = layerables.at(i)->selectTest(pos, onlySelectable, selectionDetails ? &details : 0);
-            if (dist >= 0 && dist < selectionTolerance())
+            for (int i=node.begin; i<node.end; ++i)
             {
-                result.append(layerables.at(i));
-                if (selectionDetails)
-                    selectionDetails->append(details);
+                if (mLayerableBounds.at(i).bounds.adjusted(-tolerance, -tolerance, tolerance, tolerance).contains(pos))
+                    candidates.append(mLayerableBounds.at(i));
             }
+        } else
+        {
+            nodeStack.append(node.left);
+            nodeStack.append(node.right);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), greaterThanOrder); // top-most layerable first
+
+    QList<QCPLayerable*> result;
+    for (int i=0; i<candidates.size(); ++i)
+    {
+        QCPLayerable *layerable = candidates.at(i).layerable;
+        if (!layerable->realVisibility())
+            continue;
+        QVariant details;
+        double dist = layerable->selectTest(pos, onlySelectable, selectionDetails ? &details : 0);
+        if (dist >= 0 && dist < selectionTolerance())
+        {
+            result.append(layerable);
+            if (selectionDetails)
+                selectionDetails->append(details);
         }
     }
     return result;
 }
 
+/*! \internal
+
+  Rebuilds the spatial index used by \ref layerableListAt. The bounds of all layerables are queried
+  via \ref QCPLayerable::selectTestBounds. Layerables with bounds are organized in a bounding volume
+  hierarchy (see \ref buildLayerableIndexNode), the others are kept in a list and always tested.
+*/
+void QCustomPlot::updateLayerableIndex() const
+{
+    mLayerableBounds.clear();
+    mUnboundedLayerables.clear();
+    mLayerableIndexNodes.clear();
+    int order = 0;
+    for (int layerIndex=0; layerIndex<mLayers.size(); ++layerIndex)
+    {
+        const QList<QCPLayerable*> layerables = mLayers.at(layerIndex)->children();
+        for (int i=0; i<layerables.size(); ++i)
+        {
+            LayerableBounds entry;
+            entry.layerable = layerables.at(i);
+            entry.order = order++;
+            bool foundBounds = false;
+            entry.bounds = entry.layerable->selectTestBounds(foundBounds).normalized();
+            if (foundBounds)
+                mLayerableBounds.append(entry);
+            else
+                mUnboundedLayerables.append(entry);
+        }
+    }
+    if (!mLayerableBounds.isEmpty())
+        buildLayerableIndexNode(0, mLayerableBounds.size());
+    mLayerableIndexValid = true;
+}
+
+/*! \internal
+
+  Appends a node of the layerable bounding volume hierarchy for the entries \a begin to \a end
+  (exclusive) of mLayerableBounds and returns its index. Nodes with more than four entries are
+  split at the median of the entry centers along the longer side of the node bounds, which
+  reorders the entries within the range.
+*/
+int QCustomPlot::buildLayerableIndexNode(int begin, int end) const
+{
+    LayerableIndexNode node;
+    double left = mLayerableBounds.at(begin).bounds.left();
+    double right = mLayerableBounds.at(begin).bounds.right();
+    double top = mLayerableBounds.at(begin).bounds.top();
+    double bottom = mLayerableBounds.at(begin).bounds.bottom();
+    for (int i=begin+1; i<end; ++i) // not QRectF::united, because it ignores bounds of zero size
+    {
+        const QRectF &bounds = mLayerableBounds.at(i).bounds;
+        left = qMin(left, bounds.left());
+        right = qMax(right, bounds.right());
+        top = qMin(top, bounds.top());
+        bottom = qMax(bottom, bounds.bottom());
+    }
+    node.bounds = QRectF(QPointF(left, top), QPointF(right, bottom));
+    node.begin = begin;
+    node.end = end;
+    node.left = -1;
+    node.right = -1;
+    const int nodeIndex = mLayerableIndexNodes.size();
+    mLayerableIndexNodes.append(node);
+
+    if (end-begin > 4)
+    {
+        const int middle = begin+(end-begin)/2;
+        std::nth_element(mLayerableBounds.begin()+begin, mLayerableBounds.begin()+middle, mLayerableBounds.begin()+end,
+                         right-left > bottom-top ? lessThanBoundsCenterX : lessThanBoundsCenterY);
+        const int leftIndex = buildLayerableIndexNode(begin, middle);
+        const int rightIndex = buildLayerableIndexNode(middle, end);
+        mLayerableIndexNodes[nodeIndex].left = leftIndex; // no reference held across the recursion, appending may reallocate
+        mLayerableIndexNodes[nodeIndex].right = rightIndex;
+    }
+    return nodeIndex;
+}
+
 /*!
   Saves the plot to a rastered image file \a fileName in the image format \a format. The plot is
   sized to \a width and \a height in pixels and scaled with \a scale. (width 100 and scale 2.0 lead
@@ -15933,6 +18196,11 @@ void QCPColorGradient::setPeriodic(bool enabled)
 
   The QRgb values that are placed in \a scanLine have their r, g and b components premultiplied
   with alpha (see QImage::Format_ARGB32_Premultiplied).
+
+  On x86 processors, the linear mapping of non-periodic gradients uses SSE2 instructions to process
+  several data points at once. This method may be called concurrently from multiple threads, once
+  the color buffer is up to date (i.e. after a first call to \ref colorize or \ref color since the
+  last change of the gradient).
 */
 void QCPColorGradient::colorize(const double *data, const QCPRange &range, QRgb *scanLine, int n, int dataIndexFactor, bool logarithmic)
 {
@@ -15950,6 +18218,7 @@ void QCPColorGradient::colorize(const double *data, const QCPRange &range, QRgb
     if (mColorBufferInvalidated)
         updateColorBuffer();
 
+    const QRgb *colorBuffer = mColorBuffer.constData();
     if (!logarithmic)
     {
         const double posToIndexFactor = (mLevelCount-1)/range.size();
@@ -15960,41 +18229,72 @@ void QCPColorGradient::colorize(const double *data, const QCPRange &range, QRgb
                 int index = (int)((data[dataIndexFactor*i]-range.lower)*posToIndexFactor) % mLevelCount;
                 if (index < 0)
                     index += mLevelCount;
-                scanLine[i] = mColorBuffer.at(index);
+                scanLine[i] = colorBuffer[index];
             }
         } else
         {
-            for (int i=0; i<n; ++i)
+            int i = 0;
+#ifdef QCP_SSE2
+            // process four values per iteration. The index is clamped in the floating point domain, where
+            // max(x, 0) also maps NaN to index 0, like the scalar conversion below does:
+            const __m128d lowerV = _mm_set1_pd(range.lower);
+            const __m128d factorV = _mm_set1_pd(posToIndexFactor);
+            const __m128d zeroV = _mm_setzero_pd();
+            const __m128d maxIndexV = _mm_set1_pd(mLevelCount-1);
+            int indices[4];
+            for (; i+4<=n; i+=4)
+            {
+                __m128d lo, hi;
+                if (dataIndexFactor == 1)
+                {
+                    lo = _mm_loadu_pd(data+i);
+                    hi = _mm_loadu_pd(data+i+2);
+                } else
+                {
+                    lo = _mm_set_pd(data[dataIndexFactor*(i+1)], data[dataIndexFactor*i]);
+                    hi = _mm_set_pd(data[dataIndexFactor*(i+3)], data[dataIndexFactor*(i+2)]);
+                }
+                lo = _mm_min_pd(_mm_max_pd(_mm_mul_pd(_mm_sub_pd(lo, lowerV), factorV), zeroV), maxIndexV);
+                hi = _mm_min_pd(_mm_max_pd(_mm_mul_pd(_mm_sub_pd(hi, lowerV), factorV), zeroV), maxIndexV);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(indices), _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi)));
+                scanLine[i] = colorBuffer[indices[0]];
+                scanLine[i+1] = colorBuffer[indices[1]];
+                scanLine[i+2] = colorBuffer[indices[2]];
+                scanLine[i+3] = colorBuffer[indices[3]];
+            }
+#endif
+            for (; i<n; ++i)
             {
                 int index = (data[dataIndexFactor*i]-range.lower)*posToIndexFactor;
                 if (index < 0)
                     index = 0;
                 else if (index >= mLevelCount)
                     index = mLevelCount-1;
-                scanLine[i] = mColorBuffer.at(index);
+                scanLine[i] = colorBuffer[index];
             }
         }
     } else // logarithmic == true
     {
+        const double logPosToIndexFactor = (mLevelCount-1)/qLn(range.upper/range.lower);
         if (mPeriodic)
         {
             for (int i=0; i<n; ++i)
             {
-                int index = (int)(qLn(data[dataIndexFactor*i]/range.lower)/qLn(range.upper/range.lower)*(mLevelCount-1)) % mLevelCount;
+                int index = (int)(qLn(data[dataIndexFactor*i]/range.lower)*logPosToIndexFactor) % mLevelCount;
                 if (index < 0)
                     index += mLevelCount;
-                scanLine[i] = mColorBuffer.at(index);
+                scanLine[i] = colorBuffer[index];
             }
         } else
         {
             for (int i=0; i<n; ++i)
             {
-                int index = qLn(data[dataIndexFactor*i]/range.lower)/qLn(range.upper/range.lower)*(mLevelCount-1);
+                int index = qLn(data[dataIndexFactor*i]/range.lower)*logPosToIndexFactor;
                 if (index < 0)
                     index = 0;
                 else if (index >= mLevelCount)
                     index = mLevelCount-1;
-                scanLine[i] = mColorBuffer.at(index);
+                scanLine[i] = colorBuffer[index];
             }
         }
     }
@@ -16026,87 +18326,54 @@ void QCPColorGradient::colorize(const double *data, const unsigned char *alpha,
         qDebug() << Q_FUNC_INFO << "null pointer given as scanLine";
         return;
     }
-    if (mColorBufferInvalidated)
-        updateColorBuffer();
 
-    if (!logarithmic)
+    // colorize without alpha first, then premultiply the colors with the alpha values in a second pass:
+    colorize(data, range, scanLine, n, dataIndexFactor, logarithmic);
+    premultiplyAlpha(alpha, scanLine, n, dataIndexFactor);
+}
+
+/*!
+  Multiplies the n colors in \a scanLine with the alpha values in \a alpha, which are accessed in
+  steps of \a alphaIndexFactor. The r, g and b components of the colors in \a scanLine must
+  already be premultiplied with their own alpha, and the result is premultiplied as well (see
+  QImage::Format_ARGB32_Premultiplied).
+
+  This is used by \ref colorize for data with an alpha map, and by \ref QCPColorMap for
+  colorizing cells with a lookup table.
+*/
+void QCPColorGradient::premultiplyAlpha(const unsigned char *alpha, QRgb *scanLine, int n, int alphaIndexFactor)
+{
+    int i = 0;
+#ifdef QCP_SSE2
+    if (alphaIndexFactor == 1)
     {
-        const double posToIndexFactor = (mLevelCount-1)/range.size();
-        if (mPeriodic)
-        {
-            for (int i=0; i<n; ++i)
-            {
-                int index = (int)((data[dataIndexFactor*i]-range.lower)*posToIndexFactor) % mLevelCount;
-                if (index < 0)
-                    index += mLevelCount;
-                if (alpha[dataIndexFactor*i] == 255)
-                {
-                    scanLine[i] = mColorBuffer.at(index);
-                } else
-                {
-                    const QRgb rgb = mColorBuffer.at(index);
-                    const float alphaF = alpha[dataIndexFactor*i]/255.0f;
-                    scanLine[i] = qRgba(qRed(rgb)*alphaF, qGreen(rgb)*alphaF, qBlue(rgb)*alphaF, qAlpha(rgb)*alphaF);
-                }
-            }
-        } else
+        // process four pixels per iteration, skipping the multiplication if they are all opaque. The
+        // division by 255 is exact for the products of two 8 bit values: x/255 == (x+1+(x>>8))>>8
+        const __m128i zeroV = _mm_setzero_si128();
+        const __m128i oneV = _mm_set1_epi16(1);
+        for (; i+4<=n; i+=4)
         {
-            for (int i=0; i<n; ++i)
-            {
-                int index = (data[dataIndexFactor*i]-range.lower)*posToIndexFactor;
-                if (index < 0)
-                    index = 0;
-                else if (index >= mLevelCount)
-                    index = mLevelCount-1;
-                if (alpha[dataIndexFactor*i] == 255)
-                {
-                    scanLine[i] = mColorBuffer.at(index);
-                } else
-                {
-                    const QRgb rgb = mColorBuffer.at(index);
-                    const float alphaF = alpha[dataIndexFactor*i]/255.0f;
-                    scanLine[i] = qRgba(qRed(rgb)*alphaF, qGreen(rgb)*alphaF, qBlue(rgb)*alphaF, qAlpha(rgb)*alphaF);
-                }
-            }
+            const quint32 alphas = quint32(alpha[i]) | quint32(alpha[i+1]) << 8 | quint32(alpha[i+2]) << 16 | quint32(alpha[i+3]) << 24;
+            if (alphas == 0xFFFFFFFF)
+                continue;
+            const __m128i colors = _mm_loadu_si128(reinterpret_cast<const __m128i*>(scanLine+i));
+            __m128i lo = _mm_unpacklo_epi8(colors, zeroV); // channels of pixels i and i+1 as 16 bit values
+            __m128i hi = _mm_unpackhi_epi8(colors, zeroV); // channels of pixels i+2 and i+3 as 16 bit values
+            lo = _mm_mullo_epi16(lo, _mm_set_epi16(alpha[i+1], alpha[i+1], alpha[i+1], alpha[i+1], alpha[i], alpha[i], alpha[i], alpha[i]));
+            hi = _mm_mullo_epi16(hi, _mm_set_epi16(alpha[i+3], alpha[i+3], alpha[i+3], alpha[i+3], alpha[i+2], alpha[i+2], alpha[i+2], alpha[i+2]));
+            lo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(lo, oneV), _mm_srli_epi16(lo, 8)), 8);
+            hi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(hi, oneV), _mm_srli_epi16(hi, 8)), 8);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(scanLine+i), _mm_packus_epi16(lo, hi));
         }
-    } else // logarithmic == true
+    }
+#endif
+    for (; i<n; ++i)
     {
-        if (mPeriodic)
+        const int a = alpha[alphaIndexFactor*i];
+        if (a != 255)
         {
-            for (int i=0; i<n; ++i)
-            {
-                int index = (int)(qLn(data[dataIndexFactor*i]/range.lower)/qLn(range.upper/range.lower)*(mLevelCount-1)) % mLevelCount;
-                if (index < 0)
-                    index += mLevelCount;
-                if (alpha[dataIndexFactor*i] == 255)
-                {
-                    scanLine[i] = mColorBuffer.at(index);
-                } else
-                {
-                    const QRgb rgb = mColorBuffer.at(index);
-                    const float alphaF = alpha[dataIndexFactor*i]/255.0f;
-                    scanLine[i] = qRgba(qRed(rgb)*alphaF, qGreen(rgb)*alphaF, qBlue(rgb)*alphaF, qAlpha(rgb)*alphaF);
-                }
-            }
-        } else
-        {
-            for (int i=0; i<n; ++i)
-            {
-                int index = qLn(data[dataIndexFactor*i]/range.lower)/qLn(range.upper/range.lower)*(mLevelCount-1);
-                if (index < 0)
-                    index = 0;
-                else if (index >= mLevelCount)
-                    index = mLevelCount-1;
-                if (alpha[dataIndexFactor*i] == 255)
-                {
-                    scanLine[i] = mColorBuffer.at(index);
-                } else
-                {
-                    const QRgb rgb = mColorBuffer.at(index);
-                    const float alphaF = alpha[dataIndexFactor*i]/255.0f;
-                    scanLine[i] = qRgba(qRed(rgb)*alphaF, qGreen(rgb)*alphaF, qBlue(rgb)*alphaF, qAlpha(rgb)*alphaF);
-                }
-            }
+            const QRgb rgb = scanLine[i];
+            scanLine[i] = qRgba(qRed(rgb)*a/255, qGreen(rgb)*a/255, qBlue(rgb)*a/255, qAlpha(rgb)*a/255);
         }
     }
 }
@@ -16836,8 +19103,14 @@ QCPAxisRect::QCPAxisRect(QCustomPlot *parentPlot, bool setupDefaultAxes) :
     mRangeZoom(Qt::Horizontal|Qt::Vertical),
     mRangeZoomFactorHorz(0.85),
     mRangeZoomFactorVert(0.85),
-    mDragging(false)
-{
+    mRangePreview(false),
+    mDragging(false),
+    mRangePreviewActive(false),
+    mRangePreviewTimer(new QTimer(this))
+{
+    mRangePreviewTimer->setSingleShot(true);
+    mRangePreviewTimer->setInterval(250);
+    connect(mRangePreviewTimer, SIGNAL(timeout()), this, SLOT(finishRangePreview()));
     mInsetLayout->initializeParentPlot(mParentPlot);
     mInsetLayout->setParentLayerable(this);
     mInsetLayout->setParent(this);
@@ -17302,6 +19575,16 @@ QList<QCPLayoutElement*> QCPAxisRect::elements(bool recursive) const
     return result;
 }
 
+/* inherits documentation from base class */
+QRect QCPAxisRect::opaqueRect() const
+{
+    // only a solid, fully opaque background brush is guaranteed to cover the axis rect:
+    if (mBackgroundBrush.style() == Qt::SolidPattern && mBackgroundBrush.color().alpha() == 255)
+        return mRect;
+    else
+        return QRect();
+}
+
 /* inherits documentation from base class */
 void QCPAxisRect::applyDefaultAntialiasingHint(QCPPainter *painter) const
 {
@@ -17692,6 +19975,64 @@ void QCPAxisRect::setRangeZoomFactor(double factor)
     mRangeZoomFactorVert = factor;
 }
 
+/*!
+  Sets whether range dragging and range zooming by the user show a preview of the plottables.
+
+  If enabled, the plottables of this axis rect are rendered into pixmaps once when a drag or zoom
+  gesture starts. During the gesture, the replots draw these pixmaps translated and scaled to the
+  current axis ranges, instead of drawing the plottables again. Axes, grids, items and all other
+  layerables are drawn normally. This keeps the interaction responsive for plottables with large
+  amounts of data.
+
+  When the mouse button is released, or when the user pauses the gesture for a moment, the
+  plottables are drawn regularly again with a full replot. Since the preview only shows what was
+  visible at the start of the gesture, areas that are dragged or zoomed into view remain empty and
+  data changes are not shown until then.
+
+  \see setRangeDrag, setRangeZoom
+*/
+void QCPAxisRect::setRangePreview(bool enabled)
+{
+    mRangePreview = enabled;
+    if (!mRangePreview)
+        finishRangePreview();
+}
+
+/*! \internal
+
+  Called by the drag and zoom interactions when they change the axis ranges. If \ref
+  setRangePreview is enabled, makes the plottables of this axis rect draw their range preview in
+  the following replots, and (re)starts the timer which ends the preview when the gesture pauses.
+
+  \see finishRangePreview
+*/
+void QCPAxisRect::startRangePreview()
+{
+    if (!mRangePreview)
+        return;
+    mRangePreviewActive = true;
+    mRangePreviewTimer->start();
+}
+
+/*! \internal
+
+  Ends a range preview started with \ref startRangePreview. The preview pixmaps of the plottables
+  are discarded and the plot is replotted at full quality. This happens when the mouse button is
+  released, or when no drag or zoom event arrived for a moment. In the latter case, a continued
+  gesture starts a new preview with pixmaps rendered at the current axis ranges.
+*/
+void QCPAxisRect::finishRangePreview()
+{
+    mRangePreviewTimer->stop();
+    if (!mRangePreviewActive)
+        return;
+    mRangePreviewActive = false;
+    QList<QCPAbstractPlottable*> plottableList = plottables();
+    for (int i=0; i<plottableList.size(); ++i)
+        plottableList.at(i)->mRangePreviewPixmap = QPixmap();
+    mParentPlot->replot();
+}
+
 /*! \internal
 
   Draws the background of this axis rect. It may consist of a background fill (a QBrush) and a
@@ -17901,6 +20242,7 @@ void QCPAxisRect::mouseMoveEvent(QMouseEvent *event, const QPointF &startPos)
         {
             if (mParentPlot->noAntialiasingOnDrag())
                 mParentPlot->setNotAntialiasedElements(QCP::aeAll);
+            startRangePreview();
             mParentPlot->replot(QCustomPlot::rpQueuedReplot);
         }
 
@@ -17918,6 +20260,7 @@ void QCPAxisRect::mouseReleaseEvent(QMouseEvent *event, const QPointF &startPos)
         mParentPlot->setAntialiasedElements(mAADragBackup);
         mParentPlot->setNotAntialiasedElements(mNotAADragBackup);
     }
+    finishRangePreview();
 }
 
 /*! \internal
@@ -17961,6 +20304,7 @@ void QCPAxisRect::wheelEvent(QWheelEvent *event)
                         mRangeZoomVertAxis.at(i)->scaleRange(factor, mRangeZoomVertAxis.at(i)->pixelToCoord(event->pos().y()));
                 }
             }
+            startRangePreview();
             mParentPlot->replot();
         }
     }
@@ -19160,14 +21504,13 @@ void QCPTextElement::draw(QCPPainter *painter)
 {
     painter->setFont(mainFont());
     painter->setPen(QPen(mainTextColor()));
-    painter->drawText(mRect, mTextFlags, mText, &mTextBoundingRect);
+    mDrawnText.draw(painter, mRect, mTextFlags, mText, mParentPlot->plottingHints().testFlag(QCP::phCacheLabels), &mTextBoundingRect);
 }
 
 /* inherits documentation from base class */
 QSize QCPTextElement::minimumOuterSizeHint() const
 {
-    QFontMetrics metrics(mFont);
-    QSize result(metrics.boundingRect(0, 0, 0, 0, mTextFlags, mText).size());
+    QSize result(mSizeHintText.boundingRect(mFont, QRect(), mTextFlags, mText).size());
     result.rwidth() += mMargins.left()+mMargins.right();
     result.rheight() += mMargins.top()+mMargins.bottom();
     return result;
@@ -19176,8 +21519,7 @@ QSize QCPTextElement::minimumOuterSizeHint() const
 /* inherits documentation from base class */
 QSize QCPTextElement::maximumOuterSizeHint() const
 {
-    QFontMetrics metrics(mFont);
-    QSize result(metrics.boundingRect(0, 0, 0, 0, mTextFlags, mText).size());
+    QSize result(mSizeHintText.boundingRect(mFont, QRect(), mTextFlags, mText).size());
     result.setWidth(QWIDGETSIZE_MAX);
     result.rheight() += mMargins.top()+mMargins.bottom();
     return result;
@@ -20116,7 +22458,8 @@ QCPGraphData::QCPGraphData(double key, double value) :
   To directly create a graph inside a plot, you can also use the simpler QCustomPlot::addGraph function.
 */
 QCPGraph::QCPGraph(QCPAxis *keyAxis, QCPAxis *valueAxis) :
-    QCPAbstractPlottable1D<QCPGraphData>(keyAxis, valueAxis)
+    QCPAbstractPlottable1D<QCPGraphData>(keyAxis, valueAxis),
+    mHitTestOrigin(0)
 {
     // special handling for QCPGraphs to maintain the simple graph interface:
     mParentPlot->registerGraph(this);
@@ -20361,12 +22704,27 @@ QCPRange QCPGraph::getValueRange(bool &foundRange, QCP::SignDomain inSignDomain,
 /* inherits documentation from base class */
 void QCPGraph::draw(QCPPainter *painter)
 {
+    mHitTestParams.clear(); // data may have changed since the last replot, hit test index is rebuilt on the next pointDistance call
     if (!mKeyAxis || !mValueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
     if (mKeyAxis.data()->range().size() <= 0 || mDataContainer->isEmpty()) return;
     if (mLineStyle == lsNone && mScatterStyle.isNone()) return;
 
     QVector<QPointF> lines, scatters; // line and (if necessary) scatter pixel coordinates will be stored here while iterating over segments
 
+    // coarse replots of progressive rendering only use every n-th data point, exports always draw all:
+    const bool exporting = painter->modes().testFlag(QCPPainter::pmNoCaching);
+    const int stride = exporting ? 1 : mParentPlot->mRenderStride;
+    QElapsedTimer renderTimer;
+    renderTimer.start();
+    if (stride > 1)
+    {
+        // getLines and getScatters only subsample ranges that exceed twice the stride, so this tells whether a refinement would change anything:
+        QCPGraphDataContainer::const_iterator visibleBegin, visibleEnd;
+        getVisibleDataBounds(visibleBegin, visibleEnd, QCPDataRange(0, dataCount()));
+        if (visibleEnd-visibleBegin > 2*stride)
+            mParentPlot->mGraphsDecimated = true;
+    }
+
     // loop over and draw segments of unselected/selected data:
     QList<QCPDataRange> selectedSegments, unselectedSegments, allSegments;
     getDataSegments(selectedSegments, unselectedSegments);
@@ -20376,7 +22734,7 @@ void QCPGraph::draw(QCPPainter *painter)
         bool isSelectedSegment = i >= unselectedSegments.size();
         // get line pixel points appropriate to line style:
         QCPDataRange lineDataRange = isSelectedSegment ? allSegments.at(i) : allSegments.at(i).adjusted(-1, 1); // unselected segments extend lines to bordering selected data point (safe to exceed total data bounds in first/last segment, getLines takes care)
-        getLines(&lines, lineDataRange);
+        getLines(&lines, lineDataRange, stride);
 
         // check data validity if flag set:
 #ifdef QCUSTOMPLOT_CHECK_DATA
@@ -20416,7 +22774,7 @@ void QCPGraph::draw(QCPPainter *painter)
             finalScatterStyle = mSelectionDecorator->getFinalScatterStyle(mScatterStyle);
         if (!finalScatterStyle.isNone())
         {
-            getScatters(&scatters, allSegments.at(i));
+            getScatters(&scatters, allSegments.at(i), stride);
             drawScatterPlot(painter, scatters, finalScatterStyle);
         }
     }
@@ -20424,6 +22782,9 @@ void QCPGraph::draw(QCPPainter *painter)
     // draw other selection decoration that isn't just line/scatter pens and brushes:
     if (mSelectionDecorator)
         mSelectionDecorator->drawDecoration(painter, selection());
+
+    if (!exporting)
+        mParentPlot->mGraphRenderNsecs += renderTimer.nsecsElapsed(); // progressive rendering estimates the stride from the graph drawing time only
 }
 
 /* inherits documentation from base class */
@@ -20481,7 +22842,7 @@ void QCPGraph::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const
 
   \see getScatters
 */
-void QCPGraph::getLines(QVector<QPointF> *lines, const QCPDataRange &dataRange) const
+void QCPGraph::getLines(QVector<QPointF> *lines, const QCPDataRange &dataRange, int stride) const
 {
     if (!lines) return;
     QCPGraphDataContainer::const_iterator begin, end;
@@ -20494,7 +22855,15 @@ void QCPGraph::getLines(QVector<QPointF> *lines, const QCPDataRange &dataRange)
 
     QVector<QCPGraphData> lineData;
     if (mLineStyle != lsNone)
-        getOptimizedLineData(&lineData, begin, end);
+    {
+        if (stride > 1 && end-begin > 2*stride)
+        {
+            QVector<QCPGraphData> subsample;
+            getSubsampledData(&subsample, begin, end, stride);
+            getOptimizedLineData(&lineData, subsample.constBegin(), subsample.constEnd());
+        } else
+            getOptimizedLineData(&lineData, begin, end);
+    }
 
     if (mKeyAxis->rangeReversed() != (mKeyAxis->orientation() == Qt::Vertical)) // make sure key pixels are sorted ascending in lineData (significantly simplifies following processing)
         std::reverse(lineData.begin(), lineData.end());
@@ -20522,7 +22891,7 @@ void QCPGraph::getLines(QVector<QPointF> *lines, const QCPDataRange &dataRange)
   function to check for valid indices in \a dataRange, e.g. when extending ranges coming from \ref
   getDataSegments.
 */
-void QCPGraph::getScatters(QVector<QPointF> *scatters, const QCPDataRange &dataRange) const
+void QCPGraph::getScatters(QVector<QPointF> *scatters, const QCPDataRange &dataRange, int stride) const
 {
     if (!scatters) return;
     QCPAxis *keyAxis = mKeyAxis.data();
@@ -20538,7 +22907,19 @@ void QCPGraph::getScatters(QVector<QPointF> *scatters, const QCPDataRange &dataR
     }
 
     QVector<QCPGraphData> data;
-    getOptimizedScatterData(&data, begin, end);
+    if (stride > 1 && end-begin > 2*stride)
+    {
+        // only use scatters that aren't skipped due to scatter skip:
+        const int scatterModulo = mScatterSkip+1;
+        int beginIndex = begin-mDataContainer->constBegin();
+        while (begin != end && beginIndex % scatterModulo != 0)
+        {
+            ++beginIndex;
+            ++begin;
+        }
+        getSubsampledData(&data, begin, end, stride*scatterModulo);
+    } else
+        getOptimizedScatterData(&data, begin, end);
 
     if (mKeyAxis->rangeReversed() != (mKeyAxis->orientation() == Qt::Vertical)) // make sure key pixels are sorted ascending in data (significantly simplifies following processing)
         std::reverse(data.begin(), data.end());
@@ -20567,6 +22948,29 @@ void QCPGraph::getScatters(QVector<QPointF> *scatters, const QCPDataRange &dataR
     }
 }
 
+/*! \internal
+
+  Returns every \a stride-th data point from \a begin up to \a end in \a data, as well as the last
+  data point before \a end, so the subsample spans the same key range.
+
+  This is used for the coarse replots of progressive rendering (see \ref
+  QCP::phProgressiveRendering), in which \ref getLines and \ref getScatters are called with a \a
+  stride greater than one.
+*/
+void QCPGraph::getSubsampledData(QVector<QCPGraphData> *data, const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end, int stride) const
+{
+    if (!data) return;
+    data->clear();
+    const int count = end-begin;
+    if (count <= 0 || stride < 1)
+        return;
+    data->reserve(count/stride+2);
+    for (int i=0; i<count; i+=stride)
+        data->append(*(begin+i));
+    if ((count-1) % stride != 0)
+        data->append(*(end-1));
+}
+
 /*! \internal
 
   Takes raw data points in plot coordinates as \a data, and returns a vector containing pixel
@@ -20991,6 +23395,12 @@ void QCPGraph::getOptimizedLineData(QVector<QCPGraphData> *lineData, const QCPGr
         lineData->resize(dataCount);
         std::copy(begin, end, lineData->begin());
     }
+
+    if (mParentPlot->mProfiling && mParentPlot->mReplotting)
+    {
+        mParentPlot->mCurrentProfile.samplingPointsIn += dataCount;
+        mParentPlot->mCurrentProfile.samplingPointsOut += lineData->size();
+    }
 }
 
 /*! \internal
@@ -21636,6 +24046,14 @@ int QCPGraph::findIndexAboveY(const QVector<QPointF> *data, double y) const
   the graph has a line representation, the returned distance may be smaller than the distance to
   the \a closestData point, since the distance to the graph line is also taken into account.
 
+  Only the data points and line parts within the selection tolerance (\ref
+  QCustomPlot::setSelectionTolerance) around \a pixelPoint in key direction are considered. The
+  query uses the hit test index (see \ref updateHitTestIndex), so its cost doesn't depend on the
+  number of data points, except for the data points sharing the pixel columns closest to \a
+  pixelPoint. The distance to the graph line is determined with a precision of one pixel. If no data
+  point lies within the selection tolerance, \a closestData is the closest of the data points
+  neighbouring the key of \a pixelPoint.
+
   If either the graph has no data or if the line style is \ref lsNone and the scatter style's shape
   is \ref QCPScatterStyle::ssNone (i.e. there is no visual representation of the graph), returns -1.0.
 */
@@ -21646,45 +24064,205 @@ double QCPGraph::pointDistance(const QPointF &pixelPoint, QCPGraphDataContainer:
         return -1.0;
     if (mLineStyle == lsNone && mScatterStyle.isNone())
         return -1.0;
+    QCPAxis *keyAxis = mKeyAxis.data();
+    if (!keyAxis || !mValueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return -1.0; }
+
+    if (mHitTestParams != hitTestParams())
+        updateHitTestIndex();
+
+    const bool keyIsX = keyAxis->orientation() == Qt::Horizontal;
+    const double pixelKey = keyIsX ? pixelPoint.x() : pixelPoint.y();
+    const double pixelValue = keyIsX ? pixelPoint.y() : pixelPoint.x();
+    const double tolerance = mParentPlot->selectionTolerance();
+    const int centerColumn = qFloor(pixelKey)-mHitTestOrigin;
+    const int maxOffset = qCeil(tolerance)+1;
+    const int dataCount = mDataContainer->size();
 
-    // calculate minimum distances to graph data points and find closestData iterator:
+    // visit columns from the one containing pixelPoint outwards, so later columns can be skipped by their bounds:
     double minDistSqr = (std::numeric_limits<double>::max)();
-    // determine which key range comes into question, taking selection tolerance around pos into account:
-    double posKeyMin, posKeyMax, dummy;
-    pixelsToCoords(pixelPoint-QPointF(mParentPlot->selectionTolerance(), mParentPlot->selectionTolerance()), posKeyMin, dummy);
-    pixelsToCoords(pixelPoint+QPointF(mParentPlot->selectionTolerance(), mParentPlot->selectionTolerance()), posKeyMax, dummy);
-    if (posKeyMin > posKeyMax)
-        qSwap(posKeyMin, posKeyMax);
-    // iterate over found data points and then choose the one with the shortest distance to pos:
-    QCPGraphDataContainer::const_iterator begin = mDataContainer->findBegin(posKeyMin, true);
-    QCPGraphDataContainer::const_iterator end = mDataContainer->findEnd(posKeyMax, true);
-    for (QCPGraphDataContainer::const_iterator it=begin; it!=end; ++it)
+    double minLineDistSqr = (std::numeric_limits<double>::max)();
+    for (int offset=0; offset<=maxOffset; ++offset)
     {
-        const double currentDistSqr = QCPVector2D(coordsToPixels(it->key, it->value)-pixelPoint).lengthSquared();
-        if (currentDistSqr < minDistSqr)
+        for (int side=0; side<(offset == 0 ? 1 : 2); ++side)
         {
-            minDistSqr = currentDistSqr;
-            closestData = it;
+            const int columnIndex = side == 0 ? centerColumn+offset : centerColumn-offset;
+            if (columnIndex < 0 || columnIndex >= mHitTestColumns.size())
+                continue;
+            const HitTestColumn &column = mHitTestColumns.at(columnIndex);
+            const double columnLower = columnIndex+mHitTestOrigin;
+            const double keyDist = pixelKey < columnLower ? columnLower-pixelKey : qMax(0.0, pixelKey-(columnLower+1));
+            if (keyDist > tolerance)
+                continue;
+            // distance to graph line, the line passes through every value pixel between lineMin and lineMax within this column:
+            if (column.lineMin <= column.lineMax)
+            {
+                const double valueDist = pixelValue < column.lineMin ? column.lineMin-pixelValue : qMax(0.0, pixelValue-column.lineMax);
+                minLineDistSqr = qMin(minLineDistSqr, keyDist*keyDist+valueDist*valueDist);
+            }
+            // distance to data points, only calculated exactly if the bounds of the column's points come closer than the closest point so far:
+            if (column.dataBegin < column.dataEnd && column.pointMin <= column.pointMax)
+            {
+                const double valueDist = pixelValue < column.pointMin ? column.pointMin-pixelValue : qMax(0.0, pixelValue-column.pointMax);
+                if (keyDist*keyDist+valueDist*valueDist >= minDistSqr)
+                    continue;
+                QCPGraphDataContainer::const_iterator begin = mDataContainer->constBegin()+column.dataBegin;
+                QCPGraphDataContainer::const_iterator end = mDataContainer->constBegin()+qMin(column.dataEnd, dataCount);
+                for (QCPGraphDataContainer::const_iterator it=begin; it<end; ++it)
+                {
+                    const double currentDistSqr = QCPVector2D(coordsToPixels(it->key, it->value)-pixelPoint).lengthSquared();
+                    if (currentDistSqr < minDistSqr)
+                    {
+                        minDistSqr = currentDistSqr;
+                        closestData = it;
+                    }
+                }
+            }
+        }
+    }
+
+    // no data point within the tolerance (e.g. pixelPoint on a line segment between distant points), use the data points neighbouring the queried key:
+    if (closestData == mDataContainer->constEnd())
+    {
+        const double key = keyAxis->pixelToCoord(pixelKey);
+        QCPGraphDataContainer::const_iterator begin = mDataContainer->findBegin(key, true);
+        QCPGraphDataContainer::const_iterator end = mDataContainer->findEnd(key, true);
+        for (QCPGraphDataContainer::const_iterator it=begin; it!=end; ++it)
+        {
+            const double currentDistSqr = QCPVector2D(coordsToPixels(it->key, it->value)-pixelPoint).lengthSquared();
+            if (currentDistSqr < minDistSqr)
+            {
+                minDistSqr = currentDistSqr;
+                closestData = it;
+            }
         }
     }
 
-    // calculate distance to graph line if there is one (if so, will probably be smaller than distance to closest data point):
+    // distance to graph line will probably be smaller than distance to closest data point:
+    if (mLineStyle != lsNone)
+        minDistSqr = qMin(minDistSqr, minLineDistSqr);
+
+    return qSqrt(minDistSqr);
+}
+
+/*! \internal
+
+  Returns the parameters which determine the hit test index built by \ref updateHitTestIndex, i.e.
+  the pixel mapping of the axes, the selection tolerance, the line style and the data count. The
+  index is rebuilt whenever they differ from the ones stored with the index.
+*/
+QVector<double> QCPGraph::hitTestParams() const
+{
+    QCPAxis *keyAxis = mKeyAxis.data();
+    QCPAxis *valueAxis = mValueAxis.data();
+    QVector<double> result;
+    if (!keyAxis || !valueAxis)
+        return result;
+    const QRect axisRect = keyAxis->axisRect()->rect();
+    result << keyAxis->range().lower << keyAxis->range().upper << keyAxis->scaleType() << keyAxis->rangeReversed()
+           << valueAxis->range().lower << valueAxis->range().upper << valueAxis->scaleType() << valueAxis->rangeReversed()
+           << axisRect.left() << axisRect.top() << axisRect.width() << axisRect.height()
+           << mParentPlot->selectionTolerance() << mLineStyle << mDataContainer->size();
+    return result;
+}
+
+/*! \internal
+
+  Builds the hit test index used by \ref pointDistance. The key pixel range of the axis rect,
+  extended by the selection tolerance, is divided into columns of one pixel width. For each column,
+  the index stores the index range and the value pixel bounds of the data points whose key falls
+  into the column, as well as the value pixel range covered by the graph line within the column.
+
+  The index is built lazily on the first hit test after a replot (\ref draw invalidates it) or after
+  a change of the axes, so replots without hit tests in between don't pay for it. Building it takes
+  one pass over the data points in the visible key range.
+*/
+void QCPGraph::updateHitTestIndex() const
+{
+    mHitTestColumns.clear();
+    mHitTestParams = hitTestParams();
+    QCPAxis *keyAxis = mKeyAxis.data();
+    QCPAxis *valueAxis = mValueAxis.data();
+    if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
+
+    const bool keyIsX = keyAxis->orientation() == Qt::Horizontal;
+    const QRect axisRect = keyAxis->axisRect()->rect();
+    const int margin = qCeil(mParentPlot->selectionTolerance())+1;
+    mHitTestOrigin = (keyIsX ? axisRect.left() : axisRect.top())-margin;
+    const int columnCount = (keyIsX ? axisRect.width() : axisRect.height())+2*margin;
+    const double inf = (std::numeric_limits<double>::max)();
+    HitTestColumn emptyColumn;
+    emptyColumn.dataBegin = 0;
+    emptyColumn.dataEnd = 0;
+    emptyColumn.pointMin = emptyColumn.lineMin = inf;
+    emptyColumn.pointMax = emptyColumn.lineMax = -inf;
+    mHitTestColumns.fill(emptyColumn, qMax(0, columnCount));
+    if (mHitTestColumns.isEmpty())
+        return;
+
+    // data points in key range of the columns:
+    QCPRange keyRange(keyAxis->pixelToCoord(mHitTestOrigin), keyAxis->pixelToCoord(mHitTestOrigin+columnCount));
+    keyRange.normalize();
+    QCPGraphDataContainer::const_iterator begin = mDataContainer->findBegin(keyRange.lower, false);
+    QCPGraphDataContainer::const_iterator end = mDataContainer->findEnd(keyRange.upper, false);
+    for (QCPGraphDataContainer::const_iterator it=begin; it!=end; ++it)
+    {
+        const int columnIndex = qFloor(keyAxis->coordToPixel(it->key))-mHitTestOrigin;
+        if (columnIndex < 0 || columnIndex >= columnCount)
+            continue;
+        HitTestColumn &column = mHitTestColumns[columnIndex];
+        const int dataIndex = it-mDataContainer->constBegin();
+        if (column.dataBegin == column.dataEnd)
+            column.dataBegin = dataIndex;
+        column.dataEnd = dataIndex+1; // key to pixel mapping is monotonic, so the data points of a column are contiguous
+        const double valuePixel = valueAxis->coordToPixel(it->value);
+        if (valuePixel < column.pointMin)
+            column.pointMin = valuePixel;
+        if (valuePixel > column.pointMax)
+            column.pointMax = valuePixel;
+    }
+
+    // line segments, clipped to each column they cross:
     if (mLineStyle != lsNone)
     {
-        // line displayed, calculate distance to line segments:
         QVector<QPointF> lineData;
         getLines(&lineData, QCPDataRange(0, dataCount()));
-        QCPVector2D p(pixelPoint);
         const int step = mLineStyle==lsImpulse ? 2 : 1; // impulse plot differs from other line styles in that the lineData points are only pairwise connected
         for (int i=0; i<lineData.size()-1; i+=step)
         {
-            const double currentDistSqr = p.distanceSquaredToLine(lineData.at(i), lineData.at(i+1));
-            if (currentDistSqr < minDistSqr)
-                minDistSqr = currentDistSqr;
+            double key1 = keyIsX ? lineData.at(i).x() : lineData.at(i).y();
+            double value1 = keyIsX ? lineData.at(i).y() : lineData.at(i).x();
+            double key2 = keyIsX ? lineData.at(i+1).x() : lineData.at(i+1).y();
+            double value2 = keyIsX ? lineData.at(i+1).y() : lineData.at(i+1).x();
+            if (qIsNaN(key1) || qIsNaN(value1) || qIsNaN(key2) || qIsNaN(value2))
+                continue;
+            if (key1 > key2)
+            {
+                qSwap(key1, key2);
+                qSwap(value1, value2);
+            }
+            if (key2 < mHitTestOrigin || key1 >= mHitTestOrigin+columnCount) // segment entirely outside the columns, e.g. the impulse of an off-screen point
+                continue;
+            const int firstColumn = int(qBound(0.0, std::floor(key1)-mHitTestOrigin, double(columnCount-1))); // bounded in floating point, line ends may lie far outside the axis rect
+            const int lastColumn = int(qBound(0.0, std::floor(key2)-mHitTestOrigin, double(columnCount-1)));
+            const double slope = key2 > key1 ? (value2-value1)/(key2-key1) : 0;
+            for (int columnIndex=firstColumn; columnIndex<=lastColumn; ++columnIndex)
+            {
+                HitTestColumn &column = mHitTestColumns[columnIndex];
+                double lower = value1, upper = value2;
+                if (key2 > key1) // value at the intersection of the segment with the column borders
+                {
+                    lower = value1+(qMax(key1, double(columnIndex+mHitTestOrigin))-key1)*slope;
+                    upper = value1+(qMin(key2, double(columnIndex+mHitTestOrigin+1))-key1)*slope;
+                }
+                if (lower > upper)
+                    qSwap(lower, upper);
+                if (lower < column.lineMin)
+                    column.lineMin = lower;
+                if (upper > column.lineMax)
+                    column.lineMax = upper;
+            }
         }
     }
-
-    return qSqrt(minDistSqr);
 }
 
 /*! \internal
@@ -23907,13 +26485,22 @@ QCPDataSelection QCPBars::selectTestRect(const QRectF &rect, bool onlySelectable
     QCPBarsDataContainer::const_iterator visibleBegin, visibleEnd;
     getVisibleDataBounds(visibleBegin, visibleEnd);
 
+    int currentSegmentBegin = -1; // -1 means we're currently not in a segment that's contained in rect
     for (QCPBarsDataContainer::const_iterator it=visibleBegin; it!=visibleEnd; ++it)
     {
-        if (rect.intersects(getBarRect(it->key, it->value)))
-            result.addDataRange(QCPDataRange(it-mDataContainer->constBegin(), it-mDataContainer->constBegin()+1), false);
+        const bool contained = rect.intersects(getBarRect(it->key, it->value));
+        if (contained && currentSegmentBegin == -1) // start segment
+            currentSegmentBegin = it-mDataContainer->constBegin();
+        else if (!contained && currentSegmentBegin != -1) // segment just ended
+        {
+            result.addDataRange(QCPDataRange(currentSegmentBegin, it-mDataContainer->constBegin()), false);
+            currentSegmentBegin = -1;
+        }
     }
-    result.simplify();
-    return result;
+    // process potential last segment:
+    if (currentSegmentBegin != -1)
+        result.addDataRange(QCPDataRange(currentSegmentBegin, visibleEnd-mDataContainer->constBegin()), false);
+    return result; // segments are added in ascending order and are separated, so no simplify is necessary
 }
 
 /*!
@@ -25042,10 +27629,31 @@ QVector<QLineF> QCPStatisticalBox::getWhiskerBarLines(QCPStatisticalBoxDataConta
   true current minimum and maximum. The method QCPColorMap::rescaleDataRange offers a convenience
   parameter \a recalculateDataBounds which may be set to true to automatically call \ref
   recalculateDataBounds internally.
+
+  For scrolling displays such as spectrograms or waterfall plots, where one new line of cells is
+  added per update and the oldest line is dropped, the data may be stored circularly (\ref
+  setCircular). New lines are then added with \ref appendKeyLine, which only writes and recolorizes
+  the new line instead of shifting the entire data array.
+
+  The cells are stored as double by default. Large maps of integer data, such as camera or
+  detector images, can be stored more compactly as 8 or 16 bit integers or as float, see \ref
+  setCellType.
 */
 
 /* start of documentation of inline functions */
 
+/*! \fn bool QCPColorMapData::circular() const
+
+  Returns whether the data is stored circularly in the key dimension. See \ref setCircular.
+*/
+
+/*! \fn int QCPColorMapData::writeCursor() const
+
+  Returns the position in the internal data array, in the key dimension, where the next line
+  appended with \ref appendKeyLine will be stored. This is also the position of the line with key
+  index 0. It is always 0 if the data isn't stored circularly (see \ref setCircular).
+*/
+
 /*! \fn bool QCPColorMapData::isEmpty() const
 
   Returns whether this instance carries no data. This is equivalent to having a size where at least
@@ -25067,9 +27675,12 @@ QCPColorMapData::QCPColorMapData(int keySize, int valueSize, const QCPRange &key
     mKeyRange(keyRange),
     mValueRange(valueRange),
     mIsEmpty(true),
+    mCircular(false),
+    mCellType(ctDouble),
     mData(0),
     mAlpha(0),
-    mDataModified(true)
+    mDataModified(true),
+    mWriteCursor(0)
 {
     setSize(keySize, valueSize);
     fill(0);
@@ -25090,9 +27701,12 @@ QCPColorMapData::QCPColorMapData(const QCPColorMapData &other) :
     mKeySize(0),
     mValueSize(0),
     mIsEmpty(true),
+    mCircular(false),
+    mCellType(ctDouble),
     mData(0),
     mAlpha(0),
-    mDataModified(true)
+    mDataModified(true),
+    mWriteCursor(0)
 {
     *this = other;
 }
@@ -25109,18 +27723,25 @@ QCPColorMapData &QCPColorMapData::operator=(const QCPColorMapData &other)
         const int valueSize = other.valueSize();
         if (!other.mAlpha && mAlpha)
             clearAlpha();
+        if (mCellType != other.mCellType)
+        {
+            setSize(0, 0); // don't convert the current data, it's overwritten anyway
+            mCellType = other.mCellType;
+        }
         setSize(keySize, valueSize);
         if (other.mAlpha && !mAlpha)
             createAlpha(false);
         setRange(other.keyRange(), other.valueRange());
         if (!isEmpty())
         {
-            memcpy(mData, other.mData, sizeof(mData[0])*keySize*valueSize);
+            memcpy(mData, other.mData, size_t(cellTypeSize(mCellType))*keySize*valueSize);
             if (mAlpha)
                 memcpy(mAlpha, other.mAlpha, sizeof(mAlpha[0])*keySize*valueSize);
         }
         mDataBounds = other.mDataBounds;
-        mDataModified = true;
+        mCircular = other.mCircular;
+        mWriteCursor = other.mWriteCursor;
+        setModified();
     }
     return *this;
 }
@@ -25131,7 +27752,7 @@ double QCPColorMapData::data(double key, double value)
     int keyCell = (key-mKeyRange.lower)/(mKeyRange.upper-mKeyRange.lower)*(mKeySize-1)+0.5;
     int valueCell = (value-mValueRange.lower)/(mValueRange.upper-mValueRange.lower)*(mValueSize-1)+0.5;
     if (keyCell >= 0 && keyCell < mKeySize && valueCell >= 0 && valueCell < mValueSize)
-        return mData[valueCell*mKeySize + keyCell];
+        return cellValue(mData, mCellType, valueCell*mKeySize + storageKeyIndex(keyCell));
     else
         return 0;
 }
@@ -25140,7 +27761,7 @@ double QCPColorMapData::data(double key, double value)
 double QCPColorMapData::cell(int keyIndex, int valueIndex)
 {
     if (keyIndex >= 0 && keyIndex < mKeySize && valueIndex >= 0 && valueIndex < mValueSize)
-        return mData[valueIndex*mKeySize + keyIndex];
+        return cellValue(mData, mCellType, valueIndex*mKeySize + storageKeyIndex(keyIndex));
     else
         return 0;
 }
@@ -25156,7 +27777,7 @@ double QCPColorMapData::cell(int keyIndex, int valueIndex)
 unsigned char QCPColorMapData::alpha(int keyIndex, int valueIndex)
 {
     if (mAlpha && keyIndex >= 0 && keyIndex < mKeySize && valueIndex >= 0 && valueIndex < mValueSize)
-        return mAlpha[valueIndex*mKeySize + keyIndex];
+        return mAlpha[valueIndex*mKeySize + storageKeyIndex(keyIndex)];
     else
         return 255;
 }
@@ -25187,7 +27808,7 @@ void QCPColorMapData::setSize(int keySize, int valueSize)
 #ifdef __EXCEPTIONS
             try { // 2D arrays get memory intensive fast. So if the allocation fails, at least output debug message
 #endif
-                mData = new double[mKeySize*mValueSize];
+                mData = new char[size_t(cellTypeSize(mCellType))*mKeySize*mValueSize];
 #ifdef __EXCEPTIONS
             } catch (...) { mData = 0; }
 #endif
@@ -25201,7 +27822,8 @@ void QCPColorMapData::setSize(int keySize, int valueSize)
         if (mAlpha) // if we had an alpha map, recreate it with new size
             createAlpha();
 
-        mDataModified = true;
+        mWriteCursor = 0;
+        setModified();
     }
 }
 
@@ -25299,12 +27921,13 @@ void QCPColorMapData::setData(double key, double value, double z)
     int valueCell = (value-mValueRange.lower)/(mValueRange.upper-mValueRange.lower)*(mValueSize-1)+0.5;
     if (keyCell >= 0 && keyCell < mKeySize && valueCell >= 0 && valueCell < mValueSize)
     {
-        mData[valueCell*mKeySize + keyCell] = z;
+        keyCell = storageKeyIndex(keyCell);
+        z = storeCell(valueCell*mKeySize + keyCell, z);
         if (z < mDataBounds.lower)
             mDataBounds.lower = z;
         if (z > mDataBounds.upper)
             mDataBounds.upper = z;
-        mDataModified = true;
+        setCellModified(keyCell, valueCell);
     }
 }
 
@@ -25323,12 +27946,13 @@ void QCPColorMapData::setCell(int keyIndex, int valueIndex, double z)
 {
     if (keyIndex >= 0 && keyIndex < mKeySize && valueIndex >= 0 && valueIndex < mValueSize)
     {
-        mData[valueIndex*mKeySize + keyIndex] = z;
+        keyIndex = storageKeyIndex(keyIndex);
+        z = storeCell(valueIndex*mKeySize + keyIndex, z);
         if (z < mDataBounds.lower)
             mDataBounds.lower = z;
         if (z > mDataBounds.upper)
             mDataBounds.upper = z;
-        mDataModified = true;
+        setCellModified(keyIndex, valueIndex);
     } else
         qDebug() << Q_FUNC_INFO << "index out of bounds:" << keyIndex << valueIndex;
 }
@@ -25354,13 +27978,68 @@ void QCPColorMapData::setAlpha(int keyIndex, int valueIndex, unsigned char alpha
     {
         if (mAlpha || createAlpha())
         {
+            keyIndex = storageKeyIndex(keyIndex);
             mAlpha[valueIndex*mKeySize + keyIndex] = alpha;
-            mDataModified = true;
+            setCellModified(keyIndex, valueIndex);
         }
     } else
         qDebug() << Q_FUNC_INFO << "index out of bounds:" << keyIndex << valueIndex;
 }
 
+/*!
+  Sets the cells of the rectangle which starts at the indices \a keyIndex and \a valueIndex and
+  spans \a keyCount cells in the key dimension and \a valueCount cells in the value dimension, to
+  the values of the matrix \a values.
+
+  \a order defines whether the matrix is stored row-major (consecutive values have consecutive key
+  indices) or column-major (consecutive values have consecutive value indices). \a stride is the
+  distance in values between the beginnings of two consecutive rows (or columns, respectively),
+  which allows passing a sub-rectangle of a larger matrix. A \a stride of 0 means the rows (or
+  columns) are densely packed, i.e. the stride is \a keyCount (or \a valueCount).
+
+  This is much faster than calling \ref setCell for each cell, because the bounds are checked, the
+  data bounds are updated and the cells are marked as modified only once per call. If the matrix is
+  row-major and its type matches the cell type (\ref setCellType), the values are copied with
+  memcpy. If the rectangle covers the whole map, the data bounds are set to the exact minimum and
+  maximum of the new values (see \ref recalculateDataBounds).
+
+  To exchange the entire data without any copying, e.g. with a buffer filled in a different thread,
+  see \ref swap.
+
+  \see setCell
+*/
+void QCPColorMapData::setCells(int keyIndex, int valueIndex, int keyCount, int valueCount, const double *values, int stride, QCPColorMapData::MatrixOrder order)
+{
+    copyCells(keyIndex, valueIndex, keyCount, valueCount, reinterpret_cast<const char*>(values), ctDouble, stride, order);
+}
+
+/*! \overload
+
+  Sets the cells of the rectangle to the float values \a values.
+*/
+void QCPColorMapData::setCells(int keyIndex, int valueIndex, int keyCount, int valueCount, const float *values, int stride, QCPColorMapData::MatrixOrder order)
+{
+    copyCells(keyIndex, valueIndex, keyCount, valueCount, reinterpret_cast<const char*>(values), ctFloat, stride, order);
+}
+
+/*! \overload
+
+  Sets the cells of the rectangle to the unsigned 16 bit integer values \a values.
+*/
+void QCPColorMapData::setCells(int keyIndex, int valueIndex, int keyCount, int valueCount, const quint16 *values, int stride, QCPColorMapData::MatrixOrder order)
+{
+    copyCells(keyIndex, valueIndex, keyCount, valueCount, reinterpret_cast<const char*>(values), ctUInt16, stride, order);
+}
+
+/*! \overload
+
+  Sets the cells of the rectangle to the unsigned 8 bit integer values \a values.
+*/
+void QCPColorMapData::setCells(int keyIndex, int valueIndex, int keyCount, int valueCount, const quint8 *values, int stride, QCPColorMapData::MatrixOrder order)
+{
+    copyCells(keyIndex, valueIndex, keyCount, valueCount, reinterpret_cast<const char*>(values), ctUInt8, stride, order);
+}
+
 /*!
   Goes through the data and updates the buffered minimum and maximum data values.
 
@@ -25378,15 +28057,16 @@ void QCPColorMapData::recalculateDataBounds()
 {
     if (mKeySize > 0 && mValueSize > 0)
     {
-        double minHeight = mData[0];
-        double maxHeight = mData[0];
+        double minHeight = cellValue(mData, mCellType, 0);
+        double maxHeight = minHeight;
         const int dataCount = mValueSize*mKeySize;
         for (int i=0; i<dataCount; ++i)
         {
-            if (mData[i] > maxHeight)
-                maxHeight = mData[i];
-            if (mData[i] < minHeight)
-                minHeight = mData[i];
+            const double z = cellValue(mData, mCellType, i);
+            if (z > maxHeight)
+                maxHeight = z;
+            if (z < minHeight)
+                minHeight = z;
         }
         mDataBounds.lower = minHeight;
         mDataBounds.upper = maxHeight;
@@ -25412,7 +28092,7 @@ void QCPColorMapData::clearAlpha()
     {
         delete[] mAlpha;
         mAlpha = 0;
-        mDataModified = true;
+        setModified();
     }
 }
 
@@ -25422,10 +28102,19 @@ void QCPColorMapData::clearAlpha()
 void QCPColorMapData::fill(double z)
 {
     const int dataCount = mValueSize*mKeySize;
-    for (int i=0; i<dataCount; ++i)
-        mData[i] = z;
+    if (dataCount > 0)
+    {
+        z = storeCell(0, z); // converts z to the cell type, the remaining cells are filled with the stored value
+        switch (mCellType)
+        {
+        case ctDouble: { double *cells = reinterpret_cast<double*>(mData); std::fill(cells+1, cells+dataCount, cells[0]); break; }
+        case ctFloat: { float *cells = reinterpret_cast<float*>(mData); std::fill(cells+1, cells+dataCount, cells[0]); break; }
+        case ctUInt16: { quint16 *cells = reinterpret_cast<quint16*>(mData); std::fill(cells+1, cells+dataCount, cells[0]); break; }
+        case ctUInt8: { quint8 *cells = reinterpret_cast<quint8*>(mData); std::fill(cells+1, cells+dataCount, cells[0]); break; }
+        }
+    }
     mDataBounds = QCPRange(z, z);
-    mDataModified = true;
+    setModified();
 }
 
 /*!
@@ -25444,69 +28133,254 @@ void QCPColorMapData::fillAlpha(unsigned char alpha)
         const int dataCount = mValueSize*mKeySize;
         for (int i=0; i<dataCount; ++i)
             mAlpha[i] = alpha;
-        mDataModified = true;
+        setModified();
     }
 }
 
 /*!
-  Transforms plot coordinates given by \a key and \a value to cell indices of this QCPColorMapData
-  instance. The resulting cell indices are returned via the output parameters \a keyIndex and \a
-  valueIndex.
-
-  The retrieved key/value cell indices can then be used for example with \ref setCell.
+  Sets whether the data is stored circularly in the key dimension.
 
-  If you are only interested in a key or value index, you may pass 0 as \a valueIndex or \a
-  keyIndex.
+  In circular mode, \ref appendKeyLine overwrites the oldest line (the one with key index 0) with
+  the new line and advances the write cursor (\ref writeCursor), instead of moving all other lines
+  by one key index. Appending a line thus only costs as much as the line is long, and \ref
+  QCPColorMap only recolorizes the new line. The cell accessors (\ref cell, \ref setCell, \ref
+  data, \ref setData, \ref alpha, \ref setAlpha) transparently take the write cursor into account,
+  so key index 0 always addresses the oldest line.
 
-  \note The QCPColorMap always displays the data at equal key/value intervals, even if the key or
-  value axis is set to a logarithmic scaling. If you want to use QCPColorMap with logarithmic axes,
-  you shouldn't use the \ref QCPColorMapData::coordToCell method as it uses a linear transformation to
-  determine the cell index.
+  When circular mode is disabled, the data is rearranged such that the write cursor becomes 0
+  again.
 
-  \see cellToCoord, QCPAxis::coordToPixel
+  \see appendKeyLine
 */
-void QCPColorMapData::coordToCell(double key, double value, int *keyIndex, int *valueIndex) const
+void QCPColorMapData::setCircular(bool enabled)
 {
-    if (keyIndex)
-        *keyIndex = (key-mKeyRange.lower)/(mKeyRange.upper-mKeyRange.lower)*(mKeySize-1)+0.5;
-    if (valueIndex)
-        *valueIndex = (value-mValueRange.lower)/(mValueRange.upper-mValueRange.lower)*(mValueSize-1)+0.5;
+    if (mCircular == enabled)
+        return;
+    if (!enabled && mWriteCursor != 0)
+    {
+        // rotate every line of constant value index such that the oldest cell is at the beginning:
+        for (int valueIndex=0; valueIndex<mValueSize; ++valueIndex)
+        {
+            const int cellSize = cellTypeSize(mCellType);
+            char *line = mData+size_t(valueIndex)*mKeySize*cellSize;
+            std::rotate(line, line+size_t(mWriteCursor)*cellSize, line+size_t(mKeySize)*cellSize);
+            if (mAlpha)
+            {
+                unsigned char *alphaLine = mAlpha+valueIndex*mKeySize;
+                std::rotate(alphaLine, alphaLine+mWriteCursor, alphaLine+mKeySize);
+            }
+        }
+        mWriteCursor = 0;
+        setModified();
+    }
+    mCircular = enabled;
 }
 
 /*!
-  Transforms cell indices given by \a keyIndex and \a valueIndex to cell indices of this QCPColorMapData
-  instance. The resulting coordinates are returned via the output parameters \a key and \a
-  value.
+  Sets the type in which the cell values are stored. The existing cell values are converted to the
+  new type.
 
-  If you are only interested in a key or value coordinate, you may pass 0 as \a key or \a
-  value.
+  By default, cells are stored as double. For large maps of e.g. camera or detector images, which
+  only carry 8 or 16 bit integer values anyway, \ref ctUInt8 or \ref ctUInt16 reduce the memory
+  usage by a factor of 8 or 4. Additionally, \ref QCPColorMap colorizes integer cells with a lookup
+  table which holds the color of every possible cell value, so the colorization is a pure table
+  lookup per cell.
 
-  \note The QCPColorMap always displays the data at equal key/value intervals, even if the key or
-  value axis is set to a logarithmic scaling. If you want to use QCPColorMap with logarithmic axes,
-  you shouldn't use the \ref QCPColorMapData::cellToCoord method as it uses a linear transformation to
-  determine the cell index.
+  Values passed to the setters (e.g. \ref setCell) are converted to the cell type, i.e. they are
+  rounded and clamped to the range of the integer types. The getters return the converted values.
 
-  \see coordToCell, QCPAxis::pixelToCoord
+  \see CellType
 */
-void QCPColorMapData::cellToCoord(int keyIndex, int valueIndex, double *key, double *value) const
+void QCPColorMapData::setCellType(QCPColorMapData::CellType type)
 {
-    if (key)
-        *key = keyIndex/(double)(mKeySize-1)*(mKeyRange.upper-mKeyRange.lower)+mKeyRange.lower;
-    if (value)
-        *value = valueIndex/(double)(mValueSize-1)*(mValueRange.upper-mValueRange.lower)+mValueRange.lower;
+    if (mCellType == type)
+        return;
+    const CellType oldType = mCellType;
+    char *oldData = mData;
+    mCellType = type;
+    mData = 0;
+    if (!mIsEmpty)
+    {
+        const int dataCount = mKeySize*mValueSize;
+#ifdef __EXCEPTIONS
+        try { // 2D arrays get memory intensive fast. So if the allocation fails, at least output debug message
+#endif
+            mData = new char[size_t(cellTypeSize(mCellType))*dataCount];
+#ifdef __EXCEPTIONS
+        } catch (...) { mData = 0; }
+#endif
+        if (mData)
+        {
+            for (int i=0; i<dataCount; ++i)
+                storeCell(i, cellValue(oldData, oldType, i));
+            recalculateDataBounds();
+        } else
+        {
+            qDebug() << Q_FUNC_INFO << "out of memory for data dimensions "<< mKeySize << "*" << mValueSize;
+            mKeySize = 0;
+            mValueSize = 0;
+            mIsEmpty = true;
+            if (mAlpha)
+            {
+                delete[] mAlpha;
+                mAlpha = 0;
+            }
+        }
+    }
+    if (oldData)
+        delete[] oldData;
+    setModified();
 }
 
-/*! \internal
-
-  Allocates the internal alpha map with the current data map key/value size and, if \a
-  initializeOpaque is true, initializes all values to 255. If \a initializeOpaque is false, the
-  values are not initialized at all. In this case, the alpha map should be initialized manually,
-  e.g. with \ref fillAlpha.
+/*!
+  Appends a line of cells at the upper end of the key dimension and drops the line with key index
+  0. \a values must point to an array of \ref valueSize values, which are assigned to the cells of
+  the new line in the order of increasing value index. If an alpha map exists, the new cells are
+  opaque.
 
-  If an alpha map exists already, it is deleted first. If this color map is empty (has either key
-  or value size zero, see \ref isEmpty), the alpha map is cleared.
+  If \a shiftKeyRange is true, the key range (\ref setKeyRange) is moved by the width of one cell
+  towards higher keys, so the already existing cells keep their key coordinates. This is what
+  scrolling displays with a moving key axis need. If the key axis shows a fixed range instead (e.g.
+  the age of the lines), pass false.
 
-  The return value indicates the existence of the alpha map after the call. So this method returns
+  If the data is stored circularly (\ref setCircular), only the new line is written, and the color
+  map only recolorizes this line. Otherwise, all other lines are moved by one key index, which
+  costs as much as rewriting the entire data.
+*/
+void QCPColorMapData::appendKeyLine(const double *values, bool shiftKeyRange)
+{
+    if (isEmpty())
+        return;
+    if (!values)
+    {
+        qDebug() << Q_FUNC_INFO << "null pointer given as values";
+        return;
+    }
+
+    int keyIndex; // index in the data array where the new line is stored
+    if (mCircular)
+    {
+        keyIndex = mWriteCursor; // the oldest line is overwritten
+        mWriteCursor = (mWriteCursor+1) % mKeySize;
+    } else
+    {
+        const int cellSize = cellTypeSize(mCellType);
+        for (int valueIndex=0; valueIndex<mValueSize; ++valueIndex)
+        {
+            memmove(mData+size_t(valueIndex)*mKeySize*cellSize, mData+(size_t(valueIndex)*mKeySize+1)*cellSize, size_t(cellSize)*(mKeySize-1));
+            if (mAlpha)
+                memmove(mAlpha+valueIndex*mKeySize, mAlpha+valueIndex*mKeySize+1, sizeof(mAlpha[0])*(mKeySize-1));
+        }
+        keyIndex = mKeySize-1;
+    }
+
+    for (int valueIndex=0; valueIndex<mValueSize; ++valueIndex)
+    {
+        const double z = storeCell(valueIndex*mKeySize + keyIndex, values[valueIndex]);
+        if (z < mDataBounds.lower)
+            mDataBounds.lower = z;
+        if (z > mDataBounds.upper)
+            mDataBounds.upper = z;
+        if (mAlpha)
+            mAlpha[valueIndex*mKeySize + keyIndex] = 255;
+    }
+    if (mCircular)
+    {
+        setCellModified(keyIndex, 0);
+        setCellModified(keyIndex, mValueSize-1);
+    } else
+        setModified();
+
+    if (shiftKeyRange && mKeySize > 1)
+        mKeyRange += mKeyRange.size()/(double)(mKeySize-1);
+}
+
+/*!
+  Exchanges the contents of this instance with \a other, including sizes, ranges, cell type, cells
+  and alpha map. No cells are copied, so this is the fastest way to replace all data of a color map,
+  e.g. with a second instance that was filled in a different thread (double buffering).
+
+  All cells of both instances are marked as modified, so color maps using them will recolorize them
+  entirely.
+*/
+void QCPColorMapData::swap(QCPColorMapData &other)
+{
+    if (&other == this)
+        return;
+    qSwap(mKeySize, other.mKeySize);
+    qSwap(mValueSize, other.mValueSize);
+    qSwap(mKeyRange, other.mKeyRange);
+    qSwap(mValueRange, other.mValueRange);
+    qSwap(mIsEmpty, other.mIsEmpty);
+    qSwap(mCircular, other.mCircular);
+    qSwap(mCellType, other.mCellType);
+    qSwap(mData, other.mData);
+    qSwap(mAlpha, other.mAlpha);
+    qSwap(mDataBounds, other.mDataBounds);
+    qSwap(mWriteCursor, other.mWriteCursor);
+    setModified();
+    other.setModified();
+}
+
+/*!
+  Transforms plot coordinates given by \a key and \a value to cell indices of this QCPColorMapData
+  instance. The resulting cell indices are returned via the output parameters \a keyIndex and \a
+  valueIndex.
+
+  The retrieved key/value cell indices can then be used for example with \ref setCell.
+
+  If you are only interested in a key or value index, you may pass 0 as \a valueIndex or \a
+  keyIndex.
+
+  \note The QCPColorMap always displays the data at equal key/value intervals, even if the key or
+  value axis is set to a logarithmic scaling. If you want to use QCPColorMap with logarithmic axes,
+  you shouldn't use the \ref QCPColorMapData::coordToCell method as it uses a linear transformation to
+  determine the cell index.
+
+  \see cellToCoord, QCPAxis::coordToPixel
+*/
+void QCPColorMapData::coordToCell(double key, double value, int *keyIndex, int *valueIndex) const
+{
+    if (keyIndex)
+        *keyIndex = (key-mKeyRange.lower)/(mKeyRange.upper-mKeyRange.lower)*(mKeySize-1)+0.5;
+    if (valueIndex)
+        *valueIndex = (value-mValueRange.lower)/(mValueRange.upper-mValueRange.lower)*(mValueSize-1)+0.5;
+}
+
+/*!
+  Transforms cell indices given by \a keyIndex and \a valueIndex to cell indices of this QCPColorMapData
+  instance. The resulting coordinates are returned via the output parameters \a key and \a
+  value.
+
+  If you are only interested in a key or value coordinate, you may pass 0 as \a key or \a
+  value.
+
+  \note The QCPColorMap always displays the data at equal key/value intervals, even if the key or
+  value axis is set to a logarithmic scaling. If you want to use QCPColorMap with logarithmic axes,
+  you shouldn't use the \ref QCPColorMapData::cellToCoord method as it uses a linear transformation to
+  determine the cell index.
+
+  \see coordToCell, QCPAxis::pixelToCoord
+*/
+void QCPColorMapData::cellToCoord(int keyIndex, int valueIndex, double *key, double *value) const
+{
+    if (key)
+        *key = keyIndex/(double)(mKeySize-1)*(mKeyRange.upper-mKeyRange.lower)+mKeyRange.lower;
+    if (value)
+        *value = valueIndex/(double)(mValueSize-1)*(mValueRange.upper-mValueRange.lower)+mValueRange.lower;
+}
+
+/*! \internal
+
+  Allocates the internal alpha map with the current data map key/value size and, if \a
+  initializeOpaque is true, initializes all values to 255. If \a initializeOpaque is false, the
+  values are not initialized at all. In this case, the alpha map should be initialized manually,
+  e.g. with \ref fillAlpha.
+
+  If an alpha map exists already, it is deleted first. If this color map is empty (has either key
+  or value size zero, see \ref isEmpty), the alpha map is cleared.
+
+  The return value indicates the existence of the alpha map after the call. So this method returns
   true if the data map isn't empty and an alpha map was successfully allocated.
 */
 bool QCPColorMapData::createAlpha(bool initializeOpaque)
@@ -25534,6 +28408,270 @@ bool QCPColorMapData::createAlpha(bool initializeOpaque)
     }
 }
 
+/*! \internal
+
+  Marks all cells of this color map data as modified. The next \ref QCPColorMap::updateMapImage
+  will then recolorize the entire map image.
+
+  \see setCellModified, takeModifiedCells
+*/
+void QCPColorMapData::setModified()
+{
+    mModifiedCells = QRect(0, 0, mKeySize, mValueSize);
+    mDataModified = true;
+}
+
+/*! \internal
+
+  Marks the cell with indices \a keyIndex and \a valueIndex as modified. The rectangle of modified
+  cells (key index as x and value index as y coordinate) is extended to include this cell, so the
+  next \ref QCPColorMap::updateMapImage only needs to recolorize the scanlines and columns which are
+  affected by the modified cells.
+
+  \see setModified
+*/
+void QCPColorMapData::setCellModified(int keyIndex, int valueIndex)
+{
+    if (mModifiedCells.isNull())
+    {
+        mModifiedCells = QRect(keyIndex, valueIndex, 1, 1);
+    } else
+    {
+        if (keyIndex < mModifiedCells.left())
+            mModifiedCells.setLeft(keyIndex);
+        else if (keyIndex > mModifiedCells.right())
+            mModifiedCells.setRight(keyIndex);
+        if (valueIndex < mModifiedCells.top())
+            mModifiedCells.setTop(valueIndex);
+        else if (valueIndex > mModifiedCells.bottom())
+            mModifiedCells.setBottom(valueIndex);
+    }
+    mDataModified = true;
+}
+
+/*! \internal
+
+  Returns whether cells were modified since \a consumer last called \ref takeModifiedCells, or
+  whether \a consumer never called it.
+*/
+bool QCPColorMapData::hasModifiedCells(const void *consumer) const
+{
+    if (mDataModified)
+        return true;
+    QHash<const void*, QRect>::const_iterator it = mConsumerModifiedCells.constFind(consumer);
+    return it == mConsumerModifiedCells.constEnd() || !it.value().isNull();
+}
+
+/*! \internal
+
+  Returns the rectangle of cells (key index as x, value index as y, in storage order) which were
+  modified since \a consumer last called this method, and resets it for \a consumer. On the first
+  call of a consumer, all cells are returned.
+
+  Several consumers may track the modifications of the same data independently, e.g. the map image
+  and the tile levels of a \ref QCPColorMap, or a \ref QCPContour sharing the data of a color map.
+  The cells modified since the last call of any consumer are handed over to all other consumers
+  here, so each consumer only costs one rectangle union per call, not per modified cell.
+
+  A consumer that doesn't use the data anymore should call \ref releaseModifiedCells.
+*/
+QRect QCPColorMapData::takeModifiedCells(const void *consumer)
+{
+    const QRect allCells(0, 0, mKeySize, mValueSize);
+    QHash<const void*, QRect>::iterator consumerIt = mConsumerModifiedCells.find(consumer);
+    const QRect result = consumerIt == mConsumerModifiedCells.end() ? allCells : consumerIt.value() | mModifiedCells;
+    if (!mModifiedCells.isNull())
+    {
+        for (QHash<const void*, QRect>::iterator it=mConsumerModifiedCells.begin(); it!=mConsumerModifiedCells.end(); ++it)
+            it.value() |= mModifiedCells;
+    }
+    mConsumerModifiedCells.insert(consumer, QRect());
+    mModifiedCells = QRect();
+    mDataModified = false;
+    return result & allCells;
+}
+
+/*! \internal
+
+  Stops tracking the modified cells for \a consumer, see \ref takeModifiedCells.
+*/
+void QCPColorMapData::releaseModifiedCells(const void *consumer)
+{
+    mConsumerModifiedCells.remove(consumer);
+}
+
+/*! \internal
+
+  Converts \a z to the cell type (\ref setCellType) and stores it in the cell with the index \a
+  index of the internal data array. Returns the stored value, which may differ from \a z due to
+  rounding and clamping for the integer types.
+*/
+double QCPColorMapData::storeCell(int index, double z)
+{
+    switch (mCellType)
+    {
+    case ctDouble:
+    {
+        reinterpret_cast<double*>(mData)[index] = z;
+        return z;
+    }
+    case ctFloat:
+    {
+        const float value = z;
+        reinterpret_cast<float*>(mData)[index] = value;
+        return value;
+    }
+    case ctUInt16:
+    {
+        const quint16 value = qBound(0.0, z, 65535.0)+0.5; // NaN ends up as 0
+        reinterpret_cast<quint16*>(mData)[index] = value;
+        return value;
+    }
+    case ctUInt8:
+    {
+        const quint8 value = qBound(0.0, z, 255.0)+0.5; // NaN ends up as 0
+        reinterpret_cast<quint8*>(mData)[index] = value;
+        return value;
+    }
+    }
+    return z;
+}
+
+/*! \internal
+
+  Copies the matrix \a values of type \a valueType to the rectangle of cells given by \a keyIndex,
+  \a valueIndex, \a keyCount and \a valueCount. This is the implementation of the \ref setCells
+  overloads, see there for the meaning of \a stride and \a order.
+*/
+void QCPColorMapData::copyCells(int keyIndex, int valueIndex, int keyCount, int valueCount, const char *values, QCPColorMapData::CellType valueType, int stride, QCPColorMapData::MatrixOrder order)
+{
+    if (!values)
+    {
+        qDebug() << Q_FUNC_INFO << "null pointer given as values";
+        return;
+    }
+    if (keyIndex < 0 || valueIndex < 0 || keyCount < 0 || valueCount < 0 || keyIndex+keyCount > mKeySize || valueIndex+valueCount > mValueSize)
+    {
+        qDebug() << Q_FUNC_INFO << "cells out of bounds:" << keyIndex << valueIndex << keyCount << valueCount;
+        return;
+    }
+    if (keyCount == 0 || valueCount == 0)
+        return;
+    if (stride <= 0)
+        stride = order == moRowMajor ? keyCount : valueCount;
+
+    const int cellSize = cellTypeSize(mCellType);
+    const int valueTypeSize = cellTypeSize(valueType);
+    const bool sameType = valueType == mCellType;
+    double lower = (std::numeric_limits<double>::max)();
+    double upper = -(std::numeric_limits<double>::max)();
+    if (order == moRowMajor && sameType && mWriteCursor == 0 && keyIndex == 0 && keyCount == mKeySize && stride == keyCount)
+    {
+        // the matrix has exactly the layout of the internal data array, copy all rows at once:
+        const int count = keyCount*valueCount;
+        memcpy(mData+size_t(valueIndex)*mKeySize*cellSize, values, size_t(cellSize)*count);
+        for (int i=0; i<count; ++i)
+        {
+            const double z = cellValue(values, valueType, i);
+            if (z < lower)
+                lower = z;
+            if (z > upper)
+                upper = z;
+        }
+    } else
+    {
+        for (int v=0; v<valueCount; ++v)
+        {
+            // in circular storage, a line of consecutive key indices may wrap around at the end of the data array, so copy it in runs:
+            int k = 0;
+            while (k < keyCount)
+            {
+                const int storageKey = storageKeyIndex(keyIndex+k);
+                const int runLength = qMin(keyCount-k, mKeySize-storageKey);
+                const int targetIndex = (valueIndex+v)*mKeySize + storageKey;
+                if (order == moRowMajor)
+                {
+                    const char *source = values + (size_t(v)*stride + k)*valueTypeSize;
+                    if (sameType)
+                    {
+                        memcpy(mData+size_t(targetIndex)*cellSize, source, size_t(cellSize)*runLength);
+                        for (int i=0; i<runLength; ++i)
+                        {
+                            const double z = cellValue(source, valueType, i);
+                            if (z < lower)
+                                lower = z;
+                            if (z > upper)
+                                upper = z;
+                        }
+                    } else
+                    {
+                        for (int i=0; i<runLength; ++i)
+                        {
+                            const double z = storeCell(targetIndex+i, cellValue(source, valueType, i));
+                            if (z < lower)
+                                lower = z;
+                            if (z > upper)
+                                upper = z;
+                        }
+                    }
+                } else // order == moColumnMajor
+                {
+                    for (int i=0; i<runLength; ++i)
+                    {
+                        const double z = storeCell(targetIndex+i, cellValue(values, valueType, (k+i)*stride + v));
+                        if (z < lower)
+                            lower = z;
+                        if (z > upper)
+                            upper = z;
+                    }
+                }
+                k += runLength;
+            }
+        }
+    }
+
+    if (lower <= upper) // false if all values were NaN
+    {
+        if (keyCount == mKeySize && valueCount == mValueSize) // all cells were replaced, so the bounds are exact
+        {
+            mDataBounds = QCPRange(lower, upper);
+        } else
+        {
+            if (lower < mDataBounds.lower)
+                mDataBounds.lower = lower;
+            if (upper > mDataBounds.upper)
+                mDataBounds.upper = upper;
+        }
+    }
+    const int storageKeyBegin = storageKeyIndex(keyIndex);
+    const int storageKeyEnd = storageKeyIndex(keyIndex+keyCount-1);
+    if (storageKeyEnd >= storageKeyBegin)
+    {
+        setCellModified(storageKeyBegin, valueIndex);
+        setCellModified(storageKeyEnd, valueIndex+valueCount-1);
+    } else // rectangle wraps around in circular storage
+    {
+        setCellModified(0, valueIndex);
+        setCellModified(mKeySize-1, valueIndex+valueCount-1);
+    }
+}
+
+/*! \internal
+
+  Returns the number of bytes a cell of type \a type occupies in the internal data array.
+*/
+int QCPColorMapData::cellTypeSize(QCPColorMapData::CellType type)
+{
+    switch (type)
+    {
+    case ctDouble: return sizeof(double);
+    case ctFloat: return sizeof(float);
+    case ctUInt16: return sizeof(quint16);
+    case ctUInt8: return sizeof(quint8);
+    }
+    return sizeof(double);
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////// QCPColorMap
@@ -25594,6 +28732,13 @@ bool QCPColorMapData::createAlpha(bool initializeOpaque)
   other. They are mixed in a multiplicative matter, so an alpha of e.g. 50% (128/255) in both modes
   simultaneously, will result in a total transparency of 25% (64/255).
 
+  \section qcpcolormap-large Large color maps
+
+  By default, the whole data is colorized into one image at full resolution, which is then scaled
+  to the axis rect. For very large maps, enable \ref setTiledRendering. The color map then keeps a
+  pyramid of reduced resolution levels of the data and only colorizes the visible tiles of the
+  level that matches the screen resolution.
+
   \section qcpcolormap-usage Usage
 
   Like all data representing objects in QCustomPlot, the QCPColorMap is a plottable
@@ -25665,7 +28810,14 @@ QCPColorMap::QCPColorMap(QCPAxis *keyAxis, QCPAxis *valueAxis) :
     mGradient(QCPColorGradient::gpCold),
     mInterpolate(true),
     mTightBoundary(false),
-    mMapImageInvalidated(true)
+    mTiledRendering(false),
+    mTileAggregation(taMean),
+    mTileSize(256),
+    mViewportCropping(false),
+    mMapImageInvalidated(true),
+    mTileCache(16*1024*1024), // cost of a tile is its pixel count, so this caches up to 64 MB of tiles
+    mTileLevelsInvalidated(true),
+    mCellLookupInvalidated(true)
 {
 }
 
@@ -25697,6 +28849,7 @@ void QCPColorMap::setData(QCPColorMapData *data, bool copy)
         mMapData = data;
     }
     mMapImageInvalidated = true;
+    mTileLevelsInvalidated = true;
 }
 
 /*!
@@ -25717,6 +28870,8 @@ void QCPColorMap::setDataRange(const QCPRange &dataRange)
         else
             mDataRange = dataRange.sanitizedForLinScale();
         mMapImageInvalidated = true;
+        mTileCache.clear();
+        mCellLookupInvalidated = true;
         emit dataRangeChanged(mDataRange);
     }
 }
@@ -25732,6 +28887,8 @@ void QCPColorMap::setDataScaleType(QCPAxis::ScaleType scaleType)
     {
         mDataScaleType = scaleType;
         mMapImageInvalidated = true;
+        mTileCache.clear();
+        mCellLookupInvalidated = true;
         emit dataScaleTypeChanged(mDataScaleType);
         if (mDataScaleType == QCPAxis::stLogarithmic)
             setDataRange(mDataRange.sanitizedForLogScale());
@@ -25755,6 +28912,8 @@ void QCPColorMap::setGradient(const QCPColorGradient &gradient)
     {
         mGradient = gradient;
         mMapImageInvalidated = true;
+        mTileCache.clear();
+        mCellLookupInvalidated = true;
         emit gradientChanged(mGradient);
     }
 }
@@ -25787,6 +28946,99 @@ void QCPColorMap::setTightBoundary(bool enabled)
     mTightBoundary = enabled;
 }
 
+/*!
+  Sets whether the color map is rendered in tiles from a multi-resolution pyramid of the data,
+  instead of colorizing the entire data into one image at full resolution.
+
+  With tiled rendering, the color map builds reduced resolution levels of the data, where each level
+  has half the key and value size of the next finer one (see \ref setTileAggregation). Each level is
+  divided into tiles of \ref setTileSize cells. When drawing, only the tiles intersecting the visible
+  key and value ranges are colorized and drawn, at the level whose cells are closest to the size of
+  a screen pixel. Colorized tiles are cached until the data, data range, scale type or gradient
+  change. If cells are modified (e.g. with \ref QCPColorMapData::setCell), only the affected cells
+  of the levels are recalculated and only the affected tiles are colorized again.
+
+  This is meant for very large maps, where one image at full resolution would be too large for
+  memory or too slow to draw. Small maps are better drawn without tiled rendering, since \ref
+  setInterpolate may cause visible seams between tiles.
+
+  Tiled rendering isn't used while the map data is stored circularly with a nonzero write cursor
+  (see \ref QCPColorMapData::setCircular).
+*/
+void QCPColorMap::setTiledRendering(bool enabled)
+{
+    if (mTiledRendering == enabled)
+        return;
+    mTiledRendering = enabled;
+    if (mTiledRendering)
+    {
+        mTileLevelsInvalidated = true;
+    } else
+    {
+        mTileLevels.clear();
+        mTileCache.clear();
+        mMapImageInvalidated = true;
+    }
+}
+
+/*!
+  Sets how the cells of the reduced resolution levels are computed from the cells of the next
+  finer level, when tiled rendering is enabled (\ref setTiledRendering).
+
+  \see TileAggregation
+*/
+void QCPColorMap::setTileAggregation(QCPColorMap::TileAggregation aggregation)
+{
+    if (mTileAggregation != aggregation)
+    {
+        mTileAggregation = aggregation;
+        mTileLevelsInvalidated = true;
+    }
+}
+
+/*!
+  Sets the size of the tiles used for tiled rendering (\ref setTiledRendering) to \a cells cells in
+  the key and value dimension. The coarsest level of the pyramid fits into a single tile.
+*/
+void QCPColorMap::setTileSize(int cells)
+{
+    cells = qMax(16, cells);
+    if (mTileSize != cells)
+    {
+        mTileSize = cells;
+        mTileLevelsInvalidated = true;
+    }
+}
+
+/*!
+  Sets whether only the visible part of a large color map is colorized, when the key and value
+  axis ranges show only a small part of the map (e.g. after zooming in with the \ref
+  QCP::iRangeZoom interaction).
+
+  If enabled, the map image only covers the visible cells plus a margin for smooth panning. The
+  cost of colorizing then depends on the size of the viewport rather than on the size of the data.
+  The map image is recolorized when panning moves visible cells outside of the margin, or when
+  zooming makes the map image much larger than needed.
+
+  Viewport cropping isn't used with tiled rendering (\ref setTiledRendering), which only colorizes
+  the visible tiles anyway, and while the map data is stored circularly with a nonzero write cursor
+  (see \ref QCPColorMapData::setCircular).
+
+  Viewport cropping is disabled by default.
+*/
+void QCPColorMap::setViewportCropping(bool enabled)
+{
+    if (mViewportCropping != enabled)
+    {
+        mViewportCropping = enabled;
+        if (!mViewportCropping && mMapImageCells != QRect(0, 0, mMapData->keySize(), mMapData->valueSize()))
+        {
+            mMapImageCells = QRect();
+            mMapImageInvalidated = true;
+        }
+    }
+}
+
 /*!
   Associates the color scale \a colorScale with this color map.
 
@@ -25845,47 +29097,2632 @@ void QCPColorMap::setColorScale(QCPColorScale *colorScale)
   recalculateDataBounds calls this method before setting the data range to the buffered minimum and
   maximum.
 
-  \see setDataRange
+  \see setDataRange
+*/
+void QCPColorMap::rescaleDataRange(bool recalculateDataBounds)
+{
+    if (recalculateDataBounds)
+        mMapData->recalculateDataBounds();
+    setDataRange(mMapData->dataBounds());
+}
+
+/*!
+  Takes the current appearance of the color map and updates the legend icon, which is used to
+  represent this color map in the legend (see \ref QCPLegend).
+
+  The \a transformMode specifies whether the rescaling is done by a faster, low quality image
+  scaling algorithm (Qt::FastTransformation) or by a slower, higher quality algorithm
+  (Qt::SmoothTransformation).
+
+  The current color map appearance is scaled down to \a thumbSize. Ideally, this should be equal to
+  the size of the legend icon (see \ref QCPLegend::setIconSize). If it isn't exactly the configured
+  legend icon size, the thumb will be rescaled during drawing of the legend item.
+
+  The icon always shows the whole map, independent of the visible part when viewport cropping (\ref
+  setViewportCropping) is enabled.
+
+  \see setDataRange
+*/
+void QCPColorMap::updateLegendIcon(Qt::TransformationMode transformMode, const QSize &thumbSize)
+{
+    if (useTiledRendering()) // use the single tile of the coarsest level, instead of creating the full resolution map image
+    {
+        if (mMapData->hasModifiedCells(&mTileLevels) || mTileLevelsInvalidated)
+            updateTileLevels();
+        if (QImage *tile = tileImage(mTileLevels.size(), 0, 0))
+        {
+            bool mirrorX = (keyAxis()->orientation() == Qt::Horizontal ? keyAxis() : valueAxis())->rangeReversed();
+            bool mirrorY = (valueAxis()->orientation() == Qt::Vertical ? valueAxis() : keyAxis())->rangeReversed();
+            mLegendIcon = QPixmap::fromImage(tile->mirrored(mirrorX, mirrorY)).scaled(thumbSize, Qt::KeepAspectRatio, transformMode);
+        }
+        return;
+    }
+
+    if (mMapImage.isNull() && !data()->isEmpty())
+        updateMapImage(); // try to update map image if it's null (happens if no draw has happened yet)
+
+    if (!mMapImage.isNull()) // might still be null, e.g. if data is empty, so check here again
+    {
+        bool mirrorX = (keyAxis()->orientation() == Qt::Horizontal ? keyAxis() : valueAxis())->rangeReversed();
+        bool mirrorY = (valueAxis()->orientation() == Qt::Vertical ? valueAxis() : keyAxis())->rangeReversed();
+        if (mMapImageCells == QRect(0, 0, mMapData->keySize(), mMapData->valueSize()))
+            mLegendIcon = QPixmap::fromImage(mMapImage.mirrored(mirrorX, mirrorY)).scaled(thumbSize, Qt::KeepAspectRatio, transformMode);
+        else // map image is cropped to the viewport, sample the whole map instead
+            mLegendIcon = QPixmap::fromImage(sampledMapImage(4*qMax(thumbSize.width(), thumbSize.height())).mirrored(mirrorX, mirrorY)).scaled(thumbSize, Qt::KeepAspectRatio, transformMode);
+    }
+}
+
+/* inherits documentation from base class */
+double QCPColorMap::selectTest(const QPointF &pos, bool onlySelectable, QVariant *details) const
+{
+    Q_UNUSED(details)
+    if ((onlySelectable && mSelectable == QCP::stNone) || mMapData->isEmpty())
+        return -1;
+    if (!mKeyAxis || !mValueAxis)
+        return -1;
+
+    if (mKeyAxis.data()->axisRect()->rect().contains(pos.toPoint()))
+    {
+        double posKey, posValue;
+        pixelsToCoords(pos, posKey, posValue);
+        if (mMapData->keyRange().contains(posKey) && mMapData->valueRange().contains(posValue))
+        {
+            if (details)
+                details->setValue(QCPDataSelection(QCPDataRange(0, 1))); // temporary solution, to facilitate whole-plottable selection. Replace in future version with segmented 2D selection.
+            return mParentPlot->selectionTolerance()*0.99;
+        }
+    }
+    return -1;
+}
+
+/* inherits documentation from base class */
+QCPRange QCPColorMap::getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain) const
+{
+    foundRange = true;
+    QCPRange result = mMapData->keyRange();
+    result.normalize();
+    if (inSignDomain == QCP::sdPositive)
+    {
+        if (result.lower <= 0 && result.upper > 0)
+            result.lower = result.upper*1e-3;
+        else if (result.lower <= 0 && result.upper <= 0)
+            foundRange = false;
+    } else if (inSignDomain == QCP::sdNegative)
+    {
+        if (result.upper >= 0 && result.lower < 0)
+            result.upper = result.lower*1e-3;
+        else if (result.upper >= 0 && result.lower >= 0)
+            foundRange = false;
+    }
+    return result;
+}
+
+/* inherits documentation from base class */
+QCPRange QCPColorMap::getValueRange(bool &foundRange, QCP::SignDomain inSignDomain, const QCPRange &inKeyRange) const
+{
+    if (inKeyRange != QCPRange())
+    {
+        if (mMapData->keyRange().upper < inKeyRange.lower || mMapData->keyRange().lower > inKeyRange.upper)
+        {
+            foundRange = false;
+            return QCPRange();
+        }
+    }
+
+    foundRange = true;
+    QCPRange result = mMapData->valueRange();
+    result.normalize();
+    if (inSignDomain == QCP::sdPositive)
+    {
+        if (result.lower <= 0 && result.upper > 0)
+            result.lower = result.upper*1e-3;
+        else if (result.lower <= 0 && result.upper <= 0)
+            foundRange = false;
+    } else if (inSignDomain == QCP::sdNegative)
+    {
+        if (result.upper >= 0 && result.lower < 0)
+            result.upper = result.lower*1e-3;
+        else if (result.upper >= 0 && result.lower >= 0)
+            foundRange = false;
+    }
+    return result;
+}
+
+/*! \internal
+
+  Updates the internal map image buffer by going through the internal \ref QCPColorMapData and
+  turning the data values into color pixels with \ref QCPColorGradient::colorize.
+
+  This method is called by \ref QCPColorMap::draw if either the data has been modified or the map image
+  has been invalidated for a different reason (e.g. a change of the data range with \ref
+  setDataRange).
+
+  If the map cell count is low, the image created will be oversampled in order to avoid a
+  QPainter::drawImage bug which makes inner pixel boundaries jitter when stretch-drawing images
+  without smooth transform enabled. Accordingly, oversampling isn't performed if \ref
+  setInterpolate is true.
+
+  If the map image wasn't invalidated and only some cells of the data were modified since the last
+  update (e.g. with \ref QCPColorMapData::setCell), only the scanlines and columns spanned by the
+  modified cells are recolorized, in the undersampled as well as in the oversampled map image.
+*/
+void QCPColorMap::updateMapImage()
+{
+    QCPAxis *keyAxis = mKeyAxis.data();
+    if (!keyAxis) return;
+    if (mMapData->isEmpty()) return;
+
+    const QImage::Format format = QImage::Format_ARGB32_Premultiplied;
+    const QRect modifiedCells = mMapData->takeModifiedCells(this);
+    // the map image may only cover a part of the cells, see updateMapImageCells:
+    if (mMapImageCells.isEmpty() || !QRect(0, 0, mMapData->keySize(), mMapData->valueSize()).contains(mMapImageCells))
+        mMapImageCells = QRect(0, 0, mMapData->keySize(), mMapData->valueSize());
+    const int keySize = mMapImageCells.width();
+    const int valueSize = mMapImageCells.height();
+    int keyOversamplingFactor = mInterpolate ? 1 : (int)(1.0+100.0/(double)keySize); // make mMapImage have at least size 100, factor becomes 1 if size > 200 or interpolation is on
+    int valueOversamplingFactor = mInterpolate ? 1 : (int)(1.0+100.0/(double)valueSize); // make mMapImage have at least size 100, factor becomes 1 if size > 200 or interpolation is on
+    bool imageRecreated = false; // if the images are recreated, they must be colorized entirely
+
+    // resize mMapImage to correct dimensions including possible oversampling factors, according to key/value axes orientation:
+    if (keyAxis->orientation() == Qt::Horizontal && (mMapImage.width() != keySize*keyOversamplingFactor || mMapImage.height() != valueSize*valueOversamplingFactor))
+    {
+        mMapImage = QImage(QSize(keySize*keyOversamplingFactor, valueSize*valueOversamplingFactor), format);
+        imageRecreated = true;
+    } else if (keyAxis->orientation() == Qt::Vertical && (mMapImage.width() != valueSize*valueOversamplingFactor || mMapImage.height() != keySize*keyOversamplingFactor))
+    {
+        mMapImage = QImage(QSize(valueSize*valueOversamplingFactor, keySize*keyOversamplingFactor), format);
+        imageRecreated = true;
+    }
+
+    if (mMapImage.isNull())
+    {
+        qDebug() << Q_FUNC_INFO << "Couldn't create map image (possibly too large for memory)";
+        mMapImage = QImage(QSize(10, 10), format);
+        mMapImage.fill(Qt::black);
+    } else
+    {
+        const bool oversampling = keyOversamplingFactor > 1 || valueOversamplingFactor > 1;
+        QImage *localMapImage = &mMapImage; // this is the image on which the colorization operates. Either the final mMapImage, or if we need oversampling, mUndersampledMapImage
+        if (oversampling)
+        {
+            // resize undersampled map image to actual key/value cell sizes:
+            if (keyAxis->orientation() == Qt::Horizontal && (mUndersampledMapImage.width() != keySize || mUndersampledMapImage.height() != valueSize))
+            {
+                mUndersampledMapImage = QImage(QSize(keySize, valueSize), format);
+                imageRecreated = true;
+            } else if (keyAxis->orientation() == Qt::Vertical && (mUndersampledMapImage.width() != valueSize || mUndersampledMapImage.height() != keySize))
+            {
+                mUndersampledMapImage = QImage(QSize(valueSize, keySize), format);
+                imageRecreated = true;
+            }
+            localMapImage = &mUndersampledMapImage; // make the colorization run on the undersampled image
+        } else if (!mUndersampledMapImage.isNull())
+            mUndersampledMapImage = QImage(); // don't need oversampling mechanism anymore (map size has changed) but mUndersampledMapImage still has nonzero size, free it
+
+        // determine the cells that need to be colorized, either all or only the modified ones:
+        QRect cells = mMapImageCells; // key index as x, value index as y
+        if (!mMapImageInvalidated && !imageRecreated)
+            cells &= modifiedCells;
+        const bool partialUpdate = cells != mMapImageCells;
+
+        // a scanline corresponds to a value index if the key axis is horizontal, and to a key index if it is vertical. Rows are the cells along a scanline:
+        const int lineCount = keyAxis->orientation() == Qt::Horizontal ? valueSize : keySize;
+        const int lineOffset = keyAxis->orientation() == Qt::Horizontal ? mMapImageCells.top() : mMapImageCells.left(); // cell index of the bottom/left scanline of the map image
+        const int rowOffset = keyAxis->orientation() == Qt::Horizontal ? mMapImageCells.left() : mMapImageCells.top(); // cell index of the first pixel of a scanline
+        const int beginLine = keyAxis->orientation() == Qt::Horizontal ? cells.top() : cells.left();
+        const int endLine = keyAxis->orientation() == Qt::Horizontal ? cells.bottom()+1 : cells.right()+1;
+        const int beginRow = keyAxis->orientation() == Qt::Horizontal ? cells.left() : cells.top();
+        const int endRow = keyAxis->orientation() == Qt::Horizontal ? cells.right()+1 : cells.bottom()+1;
+
+        if (!cells.isEmpty())
+        {
+            updateCellLookup();
+            // colorize the scanlines. Large areas are split into chunks of scanlines which are colorized
+            // concurrently in the global thread pool:
+            uchar *imageBits = localMapImage->bits();
+            const int bytesPerLine = localMapImage->bytesPerLine();
+            const qint64 minimumCellsPerChunk = 65536;
+            const int chunkCount = qBound(1, int(qMin(qint64(QThreadPool::globalInstance()->maxThreadCount()), qint64(cells.width())*qint64(cells.height())/minimumCellsPerChunk)), endLine-beginLine);
+            if (chunkCount > 1)
+            {
+                // colorize the first line in this thread, which also makes sure the color buffer of the
+                // gradient is up to date before the worker threads access it concurrently:
+                colorizeLines(imageBits, bytesPerLine, beginLine, beginLine+1, beginRow, endRow);
+                const int linesPerChunk = (endLine-beginLine-1+chunkCount-1)/chunkCount;
+                QSemaphore finished;
+                int taskCount = 0;
+                for (int chunkBegin=beginLine+1+linesPerChunk; chunkBegin<endLine; chunkBegin+=linesPerChunk)
+                {
+                    QCPColorMapColorizeTask *task = new QCPColorMapColorizeTask(this, imageBits, bytesPerLine, chunkBegin, qMin(chunkBegin+linesPerChunk, endLine), beginRow, endRow, &finished);
+                    if (!QThreadPool::globalInstance()->tryStart(task)) // no free thread (pool busy, or called from a pool thread), so colorize the chunk here instead of waiting for one
+                    {
+                        task->run();
+                        delete task;
+                    }
+                    ++taskCount;
+                }
+                colorizeLines(imageBits, bytesPerLine, beginLine+1, qMin(beginLine+1+linesPerChunk, endLine), beginRow, endRow);
+                finished.acquire(taskCount);
+            } else
+                colorizeLines(imageBits, bytesPerLine, beginLine, endLine, beginRow, endRow);
+        }
+
+        if (oversampling)
+        {
+            const int xFactor = keyAxis->orientation() == Qt::Horizontal ? keyOversamplingFactor : valueOversamplingFactor;
+            const int yFactor = keyAxis->orientation() == Qt::Horizontal ? valueOversamplingFactor : keyOversamplingFactor;
+            if (!partialUpdate)
+            {
+                mMapImage = mUndersampledMapImage.scaled(mUndersampledMapImage.width()*xFactor, mUndersampledMapImage.height()*yFactor, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+            } else if (!cells.isEmpty())
+            {
+                // replicate the recolorized pixels of the undersampled image into the blocks they cover in the oversampled image:
+                const int beginX = beginRow-rowOffset, endX = endRow-rowOffset;
+                const int beginY = lineCount-(endLine-lineOffset), endY = lineCount-(beginLine-lineOffset); // scanlines are counted from the top in QImage
+                for (int y=beginY*yFactor; y<endY*yFactor; ++y)
+                {
+                    const QRgb *source = reinterpret_cast<const QRgb*>(mUndersampledMapImage.constScanLine(y/yFactor));
+                    QRgb *target = reinterpret_cast<QRgb*>(mMapImage.scanLine(y));
+                    for (int x=beginX*xFactor; x<endX*xFactor; ++x)
+                        target[x] = source[x/xFactor];
+                }
+            }
+        }
+    }
+    mMapImageInvalidated = false;
+}
+
+/*! \internal
+
+  Colorizes the scanlines \a beginLine (inclusive) to \a endLine (exclusive) of the (possibly
+  undersampled) map image whose pixel data starts at \a imageBits, with \a bytesPerLine bytes per
+  scanline. Only the pixels \a beginRow (inclusive) to \a endRow (exclusive) of each scanline are
+  colorized. A scanline corresponds to one value index if the key axis is horizontal, and to one
+  key index if it is vertical. Lines and rows are given as cell indices, which are translated to
+  pixels of the map image according to the cells it covers (see \ref updateMapImageCells).
+
+  This is a helper function for \ref updateMapImage. It only reads the map data and writes to the
+  given scanlines, so it may be called concurrently for disjoint scanline ranges (see \ref
+  QCPColorMapColorizeTask).
+*/
+void QCPColorMap::colorizeLines(uchar *imageBits, int bytesPerLine, int beginLine, int endLine, int beginRow, int endRow)
+{
+    const char *rawData = mMapData->mData;
+    const QCPColorMapData::CellType cellType = mMapData->mCellType;
+    const int cellSize = QCPColorMapData::cellTypeSize(cellType);
+    const unsigned char *rawAlpha = mMapData->mAlpha;
+    const int n = endRow-beginRow;
+    if (mKeyAxis.data()->orientation() == Qt::Horizontal)
+    {
+        const int rowCount = mMapData->keySize();
+        for (int line=beginLine; line<endLine; ++line)
+        {
+            QRgb* pixels = reinterpret_cast<QRgb*>(imageBits+(mMapImageCells.bottom()-line)*bytesPerLine)+beginRow-mMapImageCells.left(); // invert scanline index because QImage counts scanlines from top, but our vertical index counts from bottom (mathematical coordinate system)
+            const int dataIndex = line*rowCount+beginRow;
+            colorizeCells(rawData+size_t(dataIndex)*cellSize, cellType, rawAlpha ? rawAlpha+dataIndex : 0, pixels, n, 1);
+        }
+    } else // keyAxis->orientation() == Qt::Vertical
+    {
+        const int lineCount = mMapData->keySize();
+        for (int line=beginLine; line<endLine; ++line)
+        {
+            QRgb* pixels = reinterpret_cast<QRgb*>(imageBits+(mMapImageCells.right()-line)*bytesPerLine)+beginRow-mMapImageCells.top(); // invert scanline index because QImage counts scanlines from top, but our vertical index counts from bottom (mathematical coordinate system)
+            const int dataIndex = beginRow*lineCount+line;
+            colorizeCells(rawData+size_t(dataIndex)*cellSize, cellType, rawAlpha ? rawAlpha+dataIndex : 0, pixels, n, lineCount);
+        }
+    }
+}
+
+/*! \internal
+
+  Colorizes the \a n cells of type \a cellType starting at \a data, which are accessed in steps of
+  \a dataIndexFactor cells, into \a scanLine. If \a alpha is not 0, it holds the alpha values of the
+  cells with the same layout as \a data.
+
+  Cells of integer type are colorized with the lookup table (see \ref updateCellLookup), which must
+  be up to date. Other cells are colorized with \ref QCPColorGradient::colorize.
+*/
+void QCPColorMap::colorizeCells(const char *data, QCPColorMapData::CellType cellType, const unsigned char *alpha, QRgb *scanLine, int n, int dataIndexFactor)
+{
+    const bool logarithmic = mDataScaleType == QCPAxis::stLogarithmic;
+    switch (cellType)
+    {
+    case QCPColorMapData::ctDouble:
+    {
+        const double *doubleData = reinterpret_cast<const double*>(data);
+        if (alpha)
+            mGradient.colorize(doubleData, alpha, mDataRange, scanLine, n, dataIndexFactor, logarithmic);
+        else
+            mGradient.colorize(doubleData, mDataRange, scanLine, n, dataIndexFactor, logarithmic);
+        return;
+    }
+    case QCPColorMapData::ctFloat:
+    {
+        // convert to double in blocks, which are then colorized by the gradient:
+        const float *floatData = reinterpret_cast<const float*>(data);
+        const int blockSize = 256;
+        double block[blockSize];
+        for (int blockBegin=0; blockBegin<n; blockBegin+=blockSize)
+        {
+            const int blockCount = qMin(blockSize, n-blockBegin);
+            for (int i=0; i<blockCount; ++i)
+                block[i] = floatData[(blockBegin+i)*dataIndexFactor];
+            mGradient.colorize(block, mDataRange, scanLine+blockBegin, blockCount, 1, logarithmic);
+        }
+        break;
+    }
+    case QCPColorMapData::ctUInt16:
+    {
+        const quint16 *uint16Data = reinterpret_cast<const quint16*>(data);
+        const QRgb *lookup = mCellLookup.constData();
+        for (int i=0; i<n; ++i)
+            scanLine[i] = lookup[uint16Data[i*dataIndexFactor]];
+        break;
+    }
+    case QCPColorMapData::ctUInt8:
+    {
+        const quint8 *uint8Data = reinterpret_cast<const quint8*>(data);
+        const QRgb *lookup = mCellLookup.constData();
+        for (int i=0; i<n; ++i)
+            scanLine[i] = lookup[uint8Data[i*dataIndexFactor]];
+        break;
+    }
+    }
+    if (alpha)
+        QCPColorGradient::premultiplyAlpha(alpha, scanLine, n, dataIndexFactor);
+}
+
+/*! \internal
+
+  If the map data holds cells of an integer type (see \ref QCPColorMapData::setCellType), makes
+  sure the lookup table holds the colors of all possible cell values for the current gradient, data
+  range and data scale type. Otherwise the lookup table is freed.
+
+  This must be called before \ref colorizeCells is used concurrently, since it isn't thread-safe.
+*/
+void QCPColorMap::updateCellLookup()
+{
+    int lookupSize = 0;
+    if (mMapData->mCellType == QCPColorMapData::ctUInt16)
+        lookupSize = 65536;
+    else if (mMapData->mCellType == QCPColorMapData::ctUInt8)
+        lookupSize = 256;
+
+    if (lookupSize == 0)
+    {
+        mCellLookup.clear();
+    } else if (mCellLookupInvalidated || mCellLookup.size() != lookupSize)
+    {
+        QVector<double> values(lookupSize);
+        for (int i=0; i<lookupSize; ++i)
+            values[i] = i;
+        mCellLookup.resize(lookupSize);
+        mGradient.colorize(values.constData(), mDataRange, mCellLookup.data(), lookupSize, 1, mDataScaleType == QCPAxis::stLogarithmic);
+        mCellLookupInvalidated = false;
+    }
+}
+
+/*! \internal
+
+  Returns the cells (key index as x, value index as y) which are visible in the current key and
+  value axis ranges, clamped to the cells of the map data. The map data must not be empty.
+*/
+QRect QCPColorMap::visibleCells() const
+{
+    const QCPRange keyRange = mMapData->keyRange();
+    const QCPRange valueRange = mMapData->valueRange();
+    int keyIndexBegin, keyIndexEnd, valueIndexBegin, valueIndexEnd;
+    mMapData->coordToCell(qBound(qMin(keyRange.lower, keyRange.upper), mKeyAxis.data()->range().lower, qMax(keyRange.lower, keyRange.upper)),
+                          qBound(qMin(valueRange.lower, valueRange.upper), mValueAxis.data()->range().lower, qMax(valueRange.lower, valueRange.upper)),
+                          &keyIndexBegin, &valueIndexBegin);
+    mMapData->coordToCell(qBound(qMin(keyRange.lower, keyRange.upper), mKeyAxis.data()->range().upper, qMax(keyRange.lower, keyRange.upper)),
+                          qBound(qMin(valueRange.lower, valueRange.upper), mValueAxis.data()->range().upper, qMax(valueRange.lower, valueRange.upper)),
+                          &keyIndexEnd, &valueIndexEnd);
+    if (keyIndexBegin > keyIndexEnd)
+        qSwap(keyIndexBegin, keyIndexEnd);
+    if (valueIndexBegin > valueIndexEnd)
+        qSwap(valueIndexBegin, valueIndexEnd);
+    return QRect(QPoint(keyIndexBegin, valueIndexBegin), QPoint(keyIndexEnd, valueIndexEnd)) & QRect(0, 0, mMapData->keySize(), mMapData->valueSize());
+}
+
+/*! \internal
+
+  Determines which cells the map image covers. Usually these are all cells of the map data. If
+  viewport cropping is enabled (\ref setViewportCropping) and only a small part of the map is
+  visible, the map image only covers the visible cells plus a margin of a quarter of the visible
+  extent on each side.
+
+  The current cells are kept as long as they contain the visible cells and aren't much larger than
+  needed, so panning within the margin doesn't cause a recolorization. If the cells change, the map
+  image is invalidated.
+*/
+void QCPColorMap::updateMapImageCells()
+{
+    const QRect allCells(0, 0, mMapData->keySize(), mMapData->valueSize());
+    QRect cells = allCells;
+    if (mViewportCropping && mMapData->mWriteCursor == 0)
+    {
+        const QRect visible = visibleCells();
+        const int keyMargin = visible.width()/4+1;
+        const int valueMargin = visible.height()/4+1;
+        const QRect margined = visible.adjusted(-keyMargin, -valueMargin, keyMargin, valueMargin) & allCells;
+        const qint64 marginedArea = qint64(margined.width())*qint64(margined.height());
+        if (!visible.isEmpty() && 2*marginedArea < qint64(allCells.width())*qint64(allCells.height())) // only crop if it saves at least half of the cells
+        {
+            if (mMapImageCells.contains(visible) && qint64(mMapImageCells.width())*qint64(mMapImageCells.height()) <= 4*marginedArea)
+                cells = mMapImageCells;
+            else
+                cells = margined;
+        }
+    }
+    if (cells != mMapImageCells)
+    {
+        mMapImageCells = cells;
+        mMapImageInvalidated = true;
+    }
+}
+
+/*! \internal
+
+  Returns an image of the whole map, colorized from every n-th cell in key and value direction such
+  that the image has at most \a maxCells pixels in either direction. Unlike the map image, it
+  doesn't depend on the visible cells (see \ref updateMapImageCells).
+
+  This is used by \ref updateLegendIcon while the map image is cropped to the viewport.
+*/
+QImage QCPColorMap::sampledMapImage(int maxCells)
+{
+    const int keySize = mMapData->keySize();
+    const int valueSize = mMapData->valueSize();
+    if (keySize <= 0 || valueSize <= 0 || maxCells <= 0)
+        return QImage();
+    const int keyStep = (keySize+maxCells-1)/maxCells;
+    const int valueStep = (valueSize+maxCells-1)/maxCells;
+    const int keyCount = (keySize+keyStep-1)/keyStep;
+    const int valueCount = (valueSize+valueStep-1)/valueStep;
+    const char *data = mMapData->mData;
+    const QCPColorMapData::CellType cellType = mMapData->mCellType;
+    const int cellSize = QCPColorMapData::cellTypeSize(cellType);
+    const unsigned char *alpha = mMapData->mAlpha;
+    updateCellLookup();
+
+    QImage result;
+    if (mKeyAxis.data()->orientation() == Qt::Horizontal)
+    {
+        result = QImage(QSize(keyCount, valueCount), QImage::Format_ARGB32_Premultiplied);
+        if (result.isNull())
+            return result;
+        for (int i=0; i<valueCount; ++i)
+        {
+            QRgb* pixels = reinterpret_cast<QRgb*>(result.scanLine(valueCount-1-i)); // invert scanline index because QImage counts scanlines from top, but our vertical index counts from bottom (mathematical coordinate system)
+            const int dataIndex = i*valueStep*keySize;
+            colorizeCells(data+size_t(dataIndex)*cellSize, cellType, alpha ? alpha+dataIndex : 0, pixels, keyCount, keyStep);
+        }
+    } else // keyAxis->orientation() == Qt::Vertical
+    {
+        result = QImage(QSize(valueCount, keyCount), QImage::Format_ARGB32_Premultiplied);
+        if (result.isNull())
+            return result;
+        for (int i=0; i<keyCount; ++i)
+        {
+            QRgb* pixels = reinterpret_cast<QRgb*>(result.scanLine(keyCount-1-i)); // invert scanline index because QImage counts scanlines from top, but our vertical index counts from bottom (mathematical coordinate system)
+            const int dataIndex = i*keyStep;
+            colorizeCells(data+size_t(dataIndex)*cellSize, cellType, alpha ? alpha+dataIndex : 0, pixels, valueCount, valueStep*keySize);
+        }
+    }
+    return result;
+}
+
+/*! \internal
+
+  Returns whether the color map is currently drawn with tiled rendering (see \ref
+  setTiledRendering).
+*/
+bool QCPColorMap::useTiledRendering() const
+{
+    return mTiledRendering && mMapData->mWriteCursor == 0 && !mMapData->isEmpty() && mKeyAxis && mValueAxis;
+}
+
+/*! \internal
+
+  Brings the reduced resolution levels of tiled rendering up to date with the map data. If the
+  levels were invalidated or the data changed its size, all levels are rebuilt and all cached tiles
+  are discarded. Otherwise only the cells covering the modified cells of the map data (\ref
+  QCPColorMapData::setCellModified) are recalculated, and only the affected tiles are discarded.
+*/
+void QCPColorMap::updateTileLevels()
+{
+    const int keySize = mMapData->keySize();
+    const int valueSize = mMapData->valueSize();
+    const bool hasAlpha = mMapData->mAlpha;
+    const QRect modifiedCells = mMapData->takeModifiedCells(&mTileLevels);
+
+    // the number of levels is chosen such that the coarsest level fits into a single tile:
+    int levelCount = 0;
+    int levelKeySize = keySize;
+    int levelValueSize = valueSize;
+    while (qMax(levelKeySize, levelValueSize) > mTileSize)
+    {
+        levelKeySize = (levelKeySize+1)/2;
+        levelValueSize = (levelValueSize+1)/2;
+        ++levelCount;
+    }
+
+    bool rebuild = mTileLevelsInvalidated || mTileLevels.size() != levelCount;
+    if (!rebuild && levelCount > 0)
+        rebuild = mTileLevels.first().keySize != (keySize+1)/2 || mTileLevels.first().valueSize != (valueSize+1)/2 || mTileLevels.first().alpha.isEmpty() == hasAlpha;
+
+    QRect cells(0, 0, keySize, valueSize); // cells of the current level that need to be updated, key index as x, value index as y
+    if (rebuild)
+    {
+        mTileCache.clear();
+        mTileLevels.resize(levelCount);
+        levelKeySize = keySize;
+        levelValueSize = valueSize;
+        for (int i=0; i<levelCount; ++i)
+        {
+            levelKeySize = (levelKeySize+1)/2;
+            levelValueSize = (levelValueSize+1)/2;
+            TileLevel &level = mTileLevels[i];
+            level.keySize = levelKeySize;
+            level.valueSize = levelValueSize;
+            level.data.resize(levelKeySize*levelValueSize);
+            if (hasAlpha)
+                level.alpha.resize(levelKeySize*levelValueSize);
+            else
+                level.alpha.clear();
+        }
+    } else
+    {
+        cells &= modifiedCells;
+        removeTiles(0, cells);
+    }
+
+    for (int level=1; level<=levelCount && !cells.isEmpty(); ++level)
+    {
+        cells = QRect(QPoint(cells.left()/2, cells.top()/2), QPoint(cells.right()/2, cells.bottom()/2));
+        aggregateTileLevel(level, cells);
+        if (!rebuild)
+            removeTiles(level, cells);
+    }
+
+    mTileLevelsInvalidated = false;
+}
+
+/*! \internal
+
+  Calculates the \a cells (key index as x, value index as y) of the reduced resolution \a level
+  (starting at 1) from the cells of the next finer level, according to \ref setTileAggregation.
+*/
+void QCPColorMap::aggregateTileLevel(int level, const QRect &cells)
+{
+    const char *sourceData;
+    QCPColorMapData::CellType sourceType;
+    const unsigned char *sourceAlpha;
+    int sourceKeySize, sourceValueSize;
+    tileLevelData(level-1, &sourceData, &sourceType, &sourceAlpha, &sourceKeySize, &sourceValueSize);
+    TileLevel &target = mTileLevels[level-1];
+    double *targetData = target.data.data();
+    unsigned char *targetAlpha = target.alpha.isEmpty() ? 0 : target.alpha.data();
+
+    for (int valueIndex=cells.top(); valueIndex<=cells.bottom(); ++valueIndex)
+    {
+        const int sourceValueBegin = 2*valueIndex;
+        const int sourceValueEnd = qMin(2*valueIndex+2, sourceValueSize);
+        for (int keyIndex=cells.left(); keyIndex<=cells.right(); ++keyIndex)
+        {
+            const int sourceKeyBegin = 2*keyIndex;
+            const int sourceKeyEnd = qMin(2*keyIndex+2, sourceKeySize);
+            double sum = 0;
+            double maximum = QCPColorMapData::cellValue(sourceData, sourceType, sourceValueBegin*sourceKeySize + sourceKeyBegin);
+            int alphaSum = 0;
+            int count = 0;
+            for (int sourceValueIndex=sourceValueBegin; sourceValueIndex<sourceValueEnd; ++sourceValueIndex)
+            {
+                for (int sourceKeyIndex=sourceKeyBegin; sourceKeyIndex<sourceKeyEnd; ++sourceKeyIndex)
+                {
+                    const double z = QCPColorMapData::cellValue(sourceData, sourceType, sourceValueIndex*sourceKeySize + sourceKeyIndex);
+                    sum += z;
+                    if (z > maximum)
+                        maximum = z;
+                    if (sourceAlpha)
+                        alphaSum += sourceAlpha[sourceValueIndex*sourceKeySize + sourceKeyIndex];
+                    ++count;
+                }
+            }
+            targetData[valueIndex*target.keySize + keyIndex] = mTileAggregation == taMax ? maximum : sum/count;
+            if (targetAlpha && sourceAlpha)
+                targetAlpha[valueIndex*target.keySize + keyIndex] = alphaSum/count;
+        }
+    }
+}
+
+/*! \internal
+
+  Provides the cell data, cell type, alpha map (0 if there is none) and size of the tile rendering
+  \a level. Level 0 is the map data itself, higher levels are the reduced resolution levels, which
+  always hold cells of type double.
+*/
+void QCPColorMap::tileLevelData(int level, const char **data, QCPColorMapData::CellType *cellType, const unsigned char **alpha, int *keySize, int *valueSize) const
+{
+    if (level == 0)
+    {
+        *data = mMapData->mData;
+        *cellType = mMapData->mCellType;
+        *alpha = mMapData->mAlpha;
+        *keySize = mMapData->keySize();
+        *valueSize = mMapData->valueSize();
+    } else
+    {
+        const TileLevel &tileLevel = mTileLevels.at(level-1);
+        *data = reinterpret_cast<const char*>(tileLevel.data.constData());
+        *cellType = QCPColorMapData::ctDouble;
+        *alpha = tileLevel.alpha.isEmpty() ? 0 : tileLevel.alpha.constData();
+        *keySize = tileLevel.keySize;
+        *valueSize = tileLevel.valueSize;
+    }
+}
+
+/*! \internal
+
+  Removes the cached tiles of \a level which contain any of the \a cells (key index as x, value
+  index as y), so they are colorized again when they're drawn the next time.
+*/
+void QCPColorMap::removeTiles(int level, const QRect &cells)
+{
+    if (cells.isEmpty())
+        return;
+    for (int tileKeyIndex=cells.left()/mTileSize; tileKeyIndex<=cells.right()/mTileSize; ++tileKeyIndex)
+    {
+        for (int tileValueIndex=cells.top()/mTileSize; tileValueIndex<=cells.bottom()/mTileSize; ++tileValueIndex)
+            mTileCache.remove((quint64(level) << 48) | (quint64(tileKeyIndex) << 24) | quint64(tileValueIndex));
+    }
+}
+
+/*! \internal
+
+  Returns the colorized tile with the indices \a tileKeyIndex and \a tileValueIndex of the tile
+  rendering \a level. The tile is taken from the tile cache, or colorized and inserted into the
+  cache, if it isn't cached yet.
+
+  The image is oriented like the full resolution map image (see \ref updateMapImage). The returned
+  pointer is owned by the tile cache and only valid until the next call of this method.
+*/
+QImage *QCPColorMap::tileImage(int level, int tileKeyIndex, int tileValueIndex)
+{
+    const quint64 cacheKey = (quint64(level) << 48) | (quint64(tileKeyIndex) << 24) | quint64(tileValueIndex);
+    if (QImage *cachedTile = mTileCache.object(cacheKey))
+        return cachedTile;
+
+    const char *data;
+    QCPColorMapData::CellType cellType;
+    const unsigned char *alpha;
+    int levelKeySize, levelValueSize;
+    tileLevelData(level, &data, &cellType, &alpha, &levelKeySize, &levelValueSize);
+    const int cellSize = QCPColorMapData::cellTypeSize(cellType);
+    const int keyBegin = tileKeyIndex*mTileSize;
+    const int keyEnd = qMin(keyBegin+mTileSize, levelKeySize);
+    const int valueBegin = tileValueIndex*mTileSize;
+    const int valueEnd = qMin(valueBegin+mTileSize, levelValueSize);
+    if (keyBegin >= keyEnd || valueBegin >= valueEnd)
+        return 0;
+
+    const bool keyHorizontal = mKeyAxis.data()->orientation() == Qt::Horizontal;
+    QImage *tile = new QImage(keyHorizontal ? QSize(keyEnd-keyBegin, valueEnd-valueBegin) : QSize(valueEnd-valueBegin, keyEnd-keyBegin), QImage::Format_ARGB32_Premultiplied);
+    if (tile->isNull())
+    {
+        delete tile;
+        return 0;
+    }
+    updateCellLookup();
+    if (keyHorizontal)
+    {
+        for (int valueIndex=valueBegin; valueIndex<valueEnd; ++valueIndex)
+        {
+            QRgb* pixels = reinterpret_cast<QRgb*>(tile->scanLine(valueEnd-1-valueIndex)); // invert scanline index because QImage counts scanlines from top, but our vertical index counts from bottom (mathematical coordinate system)
+            const int dataIndex = valueIndex*levelKeySize + keyBegin;
+            colorizeCells(data+size_t(dataIndex)*cellSize, cellType, alpha ? alpha+dataIndex : 0, pixels, keyEnd-keyBegin, 1);
+        }
+    } else
+    {
+        for (int keyIndex=keyBegin; keyIndex<keyEnd; ++keyIndex)
+        {
+            QRgb* pixels = reinterpret_cast<QRgb*>(tile->scanLine(keyEnd-1-keyIndex)); // invert scanline index because QImage counts scanlines from top, but our vertical index counts from bottom (mathematical coordinate system)
+            const int dataIndex = valueBegin*levelKeySize + keyIndex;
+            colorizeCells(data+size_t(dataIndex)*cellSize, cellType, alpha ? alpha+dataIndex : 0, pixels, valueEnd-valueBegin, levelKeySize);
+        }
+    }
+    const int cost = tile->width()*tile->height();
+    if (!mTileCache.insert(cacheKey, tile, cost)) // tile is larger than the whole cache and was deleted
+        return 0;
+    return tile;
+}
+
+/*! \internal
+
+  Draws the color map with tiled rendering (see \ref setTiledRendering). The level is chosen such
+  that its cells are at most one device pixel large in the visible key and value ranges, and only
+  the tiles of that level which intersect the visible ranges are drawn. \a mirrorX and \a mirrorY
+  indicate whether the tile images must be mirrored due to reversed axes, like the full resolution
+  map image in \ref draw. Mirrored tiles are drawn through a flipped painter transform instead of
+  mirrored copies, so reversed axes don't cost an image allocation per tile and frame.
+*/
+void QCPColorMap::drawTiles(QCPPainter *painter, bool mirrorX, bool mirrorY)
+{
+    QCPAxis *keyAxis = mKeyAxis.data();
+    QCPAxis *valueAxis = mValueAxis.data();
+    const int keySize = mMapData->keySize();
+    const int valueSize = mMapData->valueSize();
+    const QCPRange keyRange = mMapData->keyRange();
+    const QCPRange valueRange = mMapData->valueRange();
+
+    // determine the range of visible cells of the full resolution data:
+    const QRect visible = visibleCells();
+    if (visible.isEmpty())
+        return;
+    const int keyIndexBegin = visible.left();
+    const int keyIndexEnd = visible.right();
+    const int valueIndexBegin = visible.top();
+    const int valueIndexEnd = visible.bottom();
+
+    // choose the coarsest level whose cells still are at most one device pixel large:
+    double keyCellPixels = 0, valueCellPixels = 0, cellKeyBegin, cellKeyEnd, cellValueBegin, cellValueEnd;
+    mMapData->cellToCoord(keyIndexBegin, valueIndexBegin, &cellKeyBegin, &cellValueBegin);
+    mMapData->cellToCoord(keyIndexEnd, valueIndexEnd, &cellKeyEnd, &cellValueEnd);
+    if (keyIndexEnd > keyIndexBegin)
+        keyCellPixels = qAbs(keyAxis->coordToPixel(cellKeyEnd)-keyAxis->coordToPixel(cellKeyBegin))/(double)(keyIndexEnd-keyIndexBegin);
+    if (valueIndexEnd > valueIndexBegin)
+        valueCellPixels = qAbs(valueAxis->coordToPixel(cellValueEnd)-valueAxis->coordToPixel(cellValueBegin))/(double)(valueIndexEnd-valueIndexBegin);
+    const double cellPixels = qMax(keyCellPixels, valueCellPixels)*mParentPlot->bufferDevicePixelRatio();
+    int level = 0;
+    while (cellPixels > 0 && level < mTileLevels.size() && cellPixels*(2 << level) <= 1.0)
+        ++level;
+
+    // draw the visible tiles of that level:
+    const double keyStep = keySize > 1 ? keyRange.size()/(double)(keySize-1) : 0;
+    const double valueStep = valueSize > 1 ? valueRange.size()/(double)(valueSize-1) : 0;
+    const int levelKeySize = level == 0 ? keySize : mTileLevels.at(level-1).keySize;
+    const int levelValueSize = level == 0 ? valueSize : mTileLevels.at(level-1).valueSize;
+    for (int tileKeyIndex=(keyIndexBegin >> level)/mTileSize; tileKeyIndex<=(keyIndexEnd >> level)/mTileSize; ++tileKeyIndex)
+    {
+        for (int tileValueIndex=(valueIndexBegin >> level)/mTileSize; tileValueIndex<=(valueIndexEnd >> level)/mTileSize; ++tileValueIndex)
+        {
+            QImage *tile = tileImage(level, tileKeyIndex, tileValueIndex);
+            if (!tile)
+                continue;
+            // full resolution cells covered by this tile:
+            const int tileKeyBegin = (tileKeyIndex*mTileSize) << level;
+            const int tileKeyEnd = qMin((qMin((tileKeyIndex+1)*mTileSize, levelKeySize)) << level, keySize);
+            const int tileValueBegin = (tileValueIndex*mTileSize) << level;
+            const int tileValueEnd = qMin((qMin((tileValueIndex+1)*mTileSize, levelValueSize)) << level, valueSize);
+            double keyLower, keyUpper, valueLower, valueUpper;
+            mMapData->cellToCoord(tileKeyBegin, tileValueBegin, &keyLower, &valueLower);
+            mMapData->cellToCoord(tileKeyEnd-1, tileValueEnd-1, &keyUpper, &valueUpper);
+            const QRectF tileRect = QRectF(coordsToPixels(keyLower-0.5*keyStep, valueLower-0.5*valueStep),
+                                           coordsToPixels(keyUpper+0.5*keyStep, valueUpper+0.5*valueStep)).normalized();
+            if (mirrorX || mirrorY) // draw through a flipped transform, so the cached tile needn't be copied
+            {
+                painter->save();
+                painter->translate(tileRect.center());
+                painter->scale(mirrorX ? -1 : 1, mirrorY ? -1 : 1);
+                painter->drawImage(QRectF(-0.5*tileRect.width(), -0.5*tileRect.height(), tileRect.width(), tileRect.height()), *tile);
+                painter->restore();
+            } else
+                painter->drawImage(tileRect, *tile);
+        }
+    }
+}
+
+/* inherits documentation from base class */
+void QCPColorMap::draw(QCPPainter *painter)
+{
+    if (mMapData->isEmpty()) return;
+    if (!mKeyAxis || !mValueAxis) return;
+    applyDefaultAntialiasingHint(painter);
+
+    const bool tiled = useTiledRendering();
+    if (tiled)
+    {
+        if (mMapData->hasModifiedCells(&mTileLevels) || mTileLevelsInvalidated)
+            updateTileLevels();
+        if (!mMapImage.isNull()) // free the full resolution map image, it isn't needed for tiled rendering
+        {
+            mMapImage = QImage();
+            mUndersampledMapImage = QImage();
+            mMapImageInvalidated = true;
+        }
+    } else
+    {
+        updateMapImageCells();
+        if (mMapData->hasModifiedCells(this) || mMapImageInvalidated)
+            updateMapImage();
+    }
+
+    // use buffer if painting vectorized (PDF):
+    const bool useBuffer = painter->modes().testFlag(QCPPainter::pmVectorized);
+    QCPPainter *localPainter = painter; // will be redirected to paint on mapBuffer if painting vectorized
+    QRectF mapBufferTarget; // the rect in absolute widget coordinates where the visible map portion/buffer will end up in
+    QPixmap mapBuffer;
+    if (useBuffer)
+    {
+        const double mapBufferPixelRatio = 3; // factor by which DPI is increased in embedded bitmaps
+        mapBufferTarget = painter->clipRegion().boundingRect();
+        mapBuffer = QPixmap((mapBufferTarget.size()*mapBufferPixelRatio).toSize());
+        mapBuffer.fill(Qt::transparent);
+        localPainter = new QCPPainter(&mapBuffer);
+        localPainter->scale(mapBufferPixelRatio, mapBufferPixelRatio);
+        localPainter->translate(-mapBufferTarget.topLeft());
+    }
+
+    QRectF imageRect = QRectF(coordsToPixels(mMapData->keyRange().lower, mMapData->valueRange().lower),
+                              coordsToPixels(mMapData->keyRange().upper, mMapData->valueRange().upper)).normalized();
+    // extend imageRect to contain outer halves/quarters of bordering/cornering pixels (cells are centered on map range boundary):
+    double halfCellWidth = 0; // in pixels
+    double halfCellHeight = 0; // in pixels
+    if (keyAxis()->orientation() == Qt::Horizontal)
+    {
+        if (mMapData->keySize() > 1)
+            halfCellWidth = 0.5*imageRect.width()/(double)(mMapData->keySize()-1);
+        if (mMapData->valueSize() > 1)
+            halfCellHeight = 0.5*imageRect.height()/(double)(mMapData->valueSize()-1);
+    } else // keyAxis orientation is Qt::Vertical
+    {
+        if (mMapData->keySize() > 1)
+            halfCellHeight = 0.5*imageRect.height()/(double)(mMapData->keySize()-1);
+        if (mMapData->valueSize() > 1)
+            halfCellWidth = 0.5*imageRect.width()/(double)(mMapData->valueSize()-1);
+    }
+    if (!tiled && mMapImageCells != QRect(0, 0, mMapData->keySize(), mMapData->valueSize())) // map image only covers the cells in the viewport, see updateMapImageCells
+    {
+        double keyLower, keyUpper, valueLower, valueUpper;
+        mMapData->cellToCoord(mMapImageCells.left(), mMapImageCells.top(), &keyLower, &valueLower);
+        mMapData->cellToCoord(mMapImageCells.right(), mMapImageCells.bottom(), &keyUpper, &valueUpper);
+        imageRect = QRectF(coordsToPixels(keyLower, valueLower), coordsToPixels(keyUpper, valueUpper)).normalized();
+    }
+    imageRect.adjust(-halfCellWidth, -halfCellHeight, halfCellWidth, halfCellHeight);
+    const bool mirrorX = (keyAxis()->orientation() == Qt::Horizontal ? keyAxis() : valueAxis())->rangeReversed();
+    const bool mirrorY = (valueAxis()->orientation() == Qt::Vertical ? valueAxis() : keyAxis())->rangeReversed();
+    const bool smoothBackup = localPainter->renderHints().testFlag(QPainter::SmoothPixmapTransform);
+    localPainter->setRenderHint(QPainter::SmoothPixmapTransform, mInterpolate);
+    QRegion clipBackup;
+    if (mTightBoundary)
+    {
+        clipBackup = localPainter->clipRegion();
+        QRectF tightClipRect = QRectF(coordsToPixels(mMapData->keyRange().lower, mMapData->valueRange().lower),
+                                      coordsToPixels(mMapData->keyRange().upper, mMapData->valueRange().upper)).normalized();
+        localPainter->setClipRect(tightClipRect, Qt::IntersectClip);
+    }
+    const QImage mapImage = tiled ? QImage() : mMapImage.mirrored(mirrorX, mirrorY);
+    if (tiled)
+    {
+        drawTiles(localPainter, mirrorX, mirrorY);
+    } else if (mMapData->mWriteCursor == 0)
+    {
+        localPainter->drawImage(imageRect, mapImage);
+    } else
+    {
+        // the data is stored circularly (see QCPColorMapData::setCircular), so the map image starts with the line at
+        // the write cursor. It is drawn in two parts, such that the line with key index 0 ends up at the lower key end:
+        const bool keyHorizontal = keyAxis()->orientation() == Qt::Horizontal;
+        const int imageSize = keyHorizontal ? mapImage.width() : mapImage.height(); // size of the image in key direction
+        const int cursorPixels = mMapData->mWriteCursor*imageSize/mMapData->keySize();
+        int shift = keyHorizontal ? imageSize-cursorPixels : cursorPixels; // image pixels are moved by this amount (modulo imageSize) in key direction
+        if (keyHorizontal ? mirrorX : mirrorY)
+            shift = imageSize-shift;
+        const double scale = (keyHorizontal ? imageRect.width() : imageRect.height())/(double)imageSize;
+        for (int part=0; part<2; ++part)
+        {
+            const int sourceBegin = part == 0 ? 0 : imageSize-shift;
+            const int targetBegin = part == 0 ? shift : 0;
+            const int length = part == 0 ? imageSize-shift : shift;
+            if (keyHorizontal)
+                localPainter->drawImage(QRectF(imageRect.left()+targetBegin*scale, imageRect.top(), length*scale, imageRect.height()), mapImage, QRectF(sourceBegin, 0, length, mapImage.height()));
+            else
+                localPainter->drawImage(QRectF(imageRect.left(), imageRect.top()+targetBegin*scale, imageRect.width(), length*scale), mapImage, QRectF(0, sourceBegin, mapImage.width(), length));
+        }
+    }
+    if (mTightBoundary)
+        localPainter->setClipRegion(clipBackup);
+    localPainter->setRenderHint(QPainter::SmoothPixmapTransform, smoothBackup);
+
+    if (useBuffer) // localPainter painted to mapBuffer, so now draw buffer with original painter
+    {
+        delete localPainter;
+        painter->drawPixmap(mapBufferTarget.toRect(), mapBuffer);
+    }
+}
+
+/* inherits documentation from base class */
+void QCPColorMap::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const
+{
+    applyDefaultAntialiasingHint(painter);
+    // draw map thumbnail:
+    if (!mLegendIcon.isNull())
+    {
+        QPixmap scaledIcon = mLegendIcon.scaled(rect.size().toSize(), Qt::KeepAspectRatio, Qt::FastTransformation);
+        QRectF iconRect = QRectF(0, 0, scaledIcon.width(), scaledIcon.height());
+        iconRect.moveCenter(rect.center());
+        painter->drawPixmap(iconRect.topLeft(), scaledIcon);
+    }
+    /*
+  // draw frame:
+  painter->setBrush(Qt::NoBrush);
+  painter->setPen(Qt::black);
+  painter->drawRect(rect.adjusted(1, 1, 0, 0));
+  */
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPColorMapColorizeTask
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPColorMapColorizeTask
+  \internal
+  \brief A QRunnable which colorizes a range of scanlines of a color map image
+
+  \ref QCPColorMap::updateMapImage splits the colorization of large maps into chunks of scanlines
+  and starts one QCPColorMapColorizeTask per chunk in the global QThreadPool. Each task calls \ref
+  QCPColorMap::colorizeLines for its scanlines and then releases the semaphore \a finished once, so
+  the color map can wait for all tasks to complete. Tasks for which the pool has no free thread are
+  run directly by the color map, so waiting never depends on threads occupied by other work.
+*/
+
+/*!
+  Creates a task which colorizes the pixels \a beginRow to \a endRow of the scanlines \a beginLine
+  (inclusive) to \a endLine (exclusive) of the image data \a imageBits of \a colorMap. See \ref
+  QCPColorMap::colorizeLines.
+*/
+QCPColorMapColorizeTask::QCPColorMapColorizeTask(QCPColorMap *colorMap, uchar *imageBits, int bytesPerLine, int beginLine, int endLine, int beginRow, int endRow, QSemaphore *finished) :
+    mColorMap(colorMap),
+    mImageBits(imageBits),
+    mBytesPerLine(bytesPerLine),
+    mBeginLine(beginLine),
+    mEndLine(endLine),
+    mBeginRow(beginRow),
+    mEndRow(endRow),
+    mFinished(finished)
+{
+}
+
+/* inherits documentation from base class */
+void QCPColorMapColorizeTask::run()
+{
+    mColorMap->colorizeLines(mImageBits, mBytesPerLine, mBeginLine, mEndLine, mBeginRow, mEndRow);
+    mFinished->release();
+}
+
+/* end of 'src/plottables/plottable-colormap.cpp' */
+
+
+/* including file 'src/plottables/plottable-contour.cpp'                     */
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPContour
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPContour
+  \brief A plottable representing contour lines (iso-lines) of two-dimensional data.
+
+  QCPContour draws the lines along which the two-dimensional data of a \ref QCPColorMapData has
+  the values given with \ref setLevels. The lines are extracted with the marching squares
+  algorithm: The cells of the data are the corners of the squares, and the line positions on the
+  square edges are linearly interpolated between the cell values.
+
+  The data can either be owned by the contour plottable (\ref data, \ref setData), or be taken from
+  a color map with \ref setColorMap. The latter is the typical way to overlay iso-lines on a \ref
+  QCPColorMap, without keeping a second copy of the data:
+  \code
+  QCPContour *contour = new QCPContour(customPlot->xAxis, customPlot->yAxis);
+  contour->setColorMap(colorMap);
+  contour->setLevels(-1, 1, 9);
+  \endcode
+
+  The contour lines are calculated when the plottable is drawn, and cached until the data or the
+  levels change. The data is divided into bands of value indices, and the bands of large maps are
+  calculated concurrently in the global QThreadPool. If only some cells of the data were modified
+  (e.g. with \ref QCPColorMapData::setCell or \ref QCPColorMapData::setCells), only the bands which
+  contain the modified cells are recalculated.
+
+  The lines are drawn with the pen of the plottable (\ref setPen). The brush isn't used.
+*/
+
+/*!
+  Constructs a contour plottable with the specified \a keyAxis and \a valueAxis.
+
+  The created QCPContour is automatically registered with the QCustomPlot instance inferred from \a
+  keyAxis. This QCustomPlot instance takes ownership of the QCPContour, so do not delete it
+  manually but use QCustomPlot::removePlottable() instead.
+*/
+QCPContour::QCPContour(QCPAxis *keyAxis, QCPAxis *valueAxis) :
+    QCPAbstractPlottable(keyAxis, valueAxis),
+    mMapData(new QCPColorMapData(10, 10, QCPRange(0, 5), QCPRange(0, 5))),
+    mContouredData(0),
+    mContouredKeySize(0),
+    mContouredValueSize(0),
+    mContoursInvalidated(true),
+    mBandSize(32)
+{
+    mBrush = Qt::NoBrush;
+}
+
+QCPContour::~QCPContour()
+{
+    data()->releaseModifiedCells(this);
+    delete mMapData;
+}
+
+/*!
+  Returns the data the contour lines are calculated from. This is the data of the color map set
+  with \ref setColorMap, or the data owned by this plottable, if no color map is set.
+
+  Access this to modify the cells and the key/value range of the data.
+*/
+QCPColorMapData *QCPContour::data() const
+{
+    return mColorMap ? mColorMap.data()->data() : mMapData;
+}
+
+/*!
+  Replaces the data owned by this plottable with the provided \a data.
+
+  If \a copy is set to true, the \a data object will only be copied. if false, the contour
+  plottable takes ownership of the passed data and replaces the internal data pointer with it.
+
+  The owned data is only used if no color map is set, see \ref setColorMap.
+*/
+void QCPContour::setData(QCPColorMapData *data, bool copy)
+{
+    if (mMapData == data)
+    {
+        qDebug() << Q_FUNC_INFO << "The data pointer is already in (and owned by) this plottable" << reinterpret_cast<quintptr>(data);
+        return;
+    }
+    if (copy)
+    {
+        *mMapData = *data;
+    } else
+    {
+        delete mMapData;
+        mMapData = data;
+    }
+    mContoursInvalidated = true;
+}
+
+/*!
+  Makes the contour plottable calculate its lines from the data of \a colorMap (see \ref
+  QCPColorMap::data), instead of from its own data. The data isn't copied, so the contour lines
+  follow all modifications of the color map data.
+
+  Pass 0 to use the data owned by this plottable again. This also happens automatically if \a
+  colorMap is deleted.
+*/
+void QCPContour::setColorMap(QCPColorMap *colorMap)
+{
+    if (mColorMap.data() == colorMap)
+        return;
+    data()->releaseModifiedCells(this);
+    mColorMap = colorMap;
+    mContoursInvalidated = true;
+}
+
+/*!
+  Sets the data values at which contour lines are drawn.
+
+  \see setLevels(double lower, double upper, int count)
+*/
+void QCPContour::setLevels(const QVector<double> &levels)
+{
+    mLevels = levels;
+    mContoursInvalidated = true;
+}
+
+/*! \overload
+
+  Sets \a count levels, which are evenly distributed from \a lower to \a upper, both inclusive.
+*/
+void QCPContour::setLevels(double lower, double upper, int count)
+{
+    QVector<double> levels;
+    if (count == 1)
+    {
+        levels.append(lower);
+    } else if (count > 1)
+    {
+        levels.reserve(count);
+        for (int i=0; i<count; ++i)
+            levels.append(lower+(upper-lower)*i/(double)(count-1));
+    }
+    setLevels(levels);
+}
+
+/*!
+  Returns the contour lines of the level with index \a levelIndex (see \ref setLevels) as
+  polylines in plot coordinates. Closed lines end with their first point.
+
+  The contour lines are recalculated first, if the data or levels changed since they were last
+  calculated. Note that lines are split at the boundaries of the internal bands, so a contour line
+  may consist of several consecutive polylines.
+*/
+QList<QPolygonF> QCPContour::contourLines(int levelIndex)
+{
+    QList<QPolygonF> result;
+    if (levelIndex < 0 || levelIndex >= mLevels.size())
+    {
+        qDebug() << Q_FUNC_INFO << "level index out of bounds:" << levelIndex;
+        return result;
+    }
+    updateContours();
+
+    const QCPColorMapData *mapData = data();
+    const QCPRange keyRange = mapData->keyRange();
+    const QCPRange valueRange = mapData->valueRange();
+    const double keyStep = mapData->keySize() > 1 ? keyRange.size()/(double)(mapData->keySize()-1) : 0;
+    const double valueStep = mapData->valueSize() > 1 ? valueRange.size()/(double)(mapData->valueSize()-1) : 0;
+    for (int band=0; band<mBandLines.size(); ++band)
+    {
+        foreach (const QPolygonF &cellLine, mBandLines.at(band).at(levelIndex))
+        {
+            QPolygonF line(cellLine.size());
+            for (int i=0; i<cellLine.size(); ++i)
+                line[i] = QPointF(keyRange.lower+cellLine.at(i).x()*keyStep, valueRange.lower+cellLine.at(i).y()*valueStep);
+            result.append(line);
+        }
+    }
+    return result;
+}
+
+/* inherits documentation from base class */
+double QCPContour::selectTest(const QPointF &pos, bool onlySelectable, QVariant *details) const
+{
+    if ((onlySelectable && mSelectable == QCP::stNone) || data()->isEmpty())
+        return -1;
+    if (!mKeyAxis || !mValueAxis)
+        return -1;
+
+    if (mKeyAxis.data()->axisRect()->rect().contains(pos.toPoint()))
+    {
+        // the data may have changed since the last draw:
+        if (mContoursInvalidated || data() != mContouredData || data()->hasModifiedCells(this))
+            updateContours();
+        const QCPVector2D posVec(pos);
+        double minDistSqr = (std::numeric_limits<double>::max)();
+        for (int band=0; band<mBandLines.size(); ++band)
+        {
+            for (int level=0; level<mBandLines.at(band).size(); ++level)
+            {
+                foreach (const QPolygonF &cellLine, mBandLines.at(band).at(level))
+                {
+                    const QPolygonF line = cellsToPixels(cellLine);
+                    for (int i=1; i<line.size(); ++i)
+                    {
+                        const double distSqr = posVec.distanceSquaredToLine(QCPVector2D(line.at(i-1)), QCPVector2D(line.at(i)));
+                        if (distSqr < minDistSqr)
+                            minDistSqr = distSqr;
+                    }
+                }
+            }
+        }
+        if (minDistSqr < (std::numeric_limits<double>::max)())
+        {
+            if (details)
+                details->setValue(QCPDataSelection(QCPDataRange(0, 1))); // whole-plottable selection, like QCPColorMap
+            return qSqrt(minDistSqr);
+        }
+    }
+    return -1;
+}
+
+/* inherits documentation from base class */
+QCPRange QCPContour::getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain) const
+{
+    foundRange = true;
+    QCPRange result = data()->keyRange();
+    result.normalize();
+    if (inSignDomain == QCP::sdPositive)
+    {
+        if (result.lower <= 0 && result.upper > 0)
+            result.lower = result.upper*1e-3;
+        else if (result.lower <= 0 && result.upper <= 0)
+            foundRange = false;
+    } else if (inSignDomain == QCP::sdNegative)
+    {
+        if (result.upper >= 0 && result.lower < 0)
+            result.upper = result.lower*1e-3;
+        else if (result.upper >= 0 && result.lower >= 0)
+            foundRange = false;
+    }
+    return result;
+}
+
+/* inherits documentation from base class */
+QCPRange QCPContour::getValueRange(bool &foundRange, QCP::SignDomain inSignDomain, const QCPRange &inKeyRange) const
+{
+    if (inKeyRange != QCPRange())
+    {
+        if (data()->keyRange().upper < inKeyRange.lower || data()->keyRange().lower > inKeyRange.upper)
+        {
+            foundRange = false;
+            return QCPRange();
+        }
+    }
+
+    foundRange = true;
+    QCPRange result = data()->valueRange();
+    result.normalize();
+    if (inSignDomain == QCP::sdPositive)
+    {
+        if (result.lower <= 0 && result.upper > 0)
+            result.lower = result.upper*1e-3;
+        else if (result.lower <= 0 && result.upper <= 0)
+            foundRange = false;
+    } else if (inSignDomain == QCP::sdNegative)
+    {
+        if (result.upper >= 0 && result.lower < 0)
+            result.upper = result.lower*1e-3;
+        else if (result.upper >= 0 && result.lower >= 0)
+            foundRange = false;
+    }
+    return result;
+}
+
+/* inherits documentation from base class */
+void QCPContour::draw(QCPPainter *painter)
+{
+    QCPColorMapData *mapData = data();
+    if (mapData->isEmpty() || mLevels.isEmpty()) return;
+    if (!mKeyAxis || !mValueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
+
+    if (mContoursInvalidated || mapData != mContouredData || mapData->hasModifiedCells(this))
+        updateContours();
+
+    applyDefaultAntialiasingHint(painter);
+    if (selected() && mSelectionDecorator)
+        mSelectionDecorator->applyPen(painter);
+    else
+        painter->setPen(mPen);
+    painter->setBrush(Qt::NoBrush);
+    for (int band=0; band<mBandLines.size(); ++band)
+    {
+        for (int level=0; level<mBandLines.at(band).size(); ++level)
+        {
+            foreach (const QPolygonF &cellLine, mBandLines.at(band).at(level))
+                painter->drawPolyline(cellsToPixels(cellLine));
+        }
+    }
+}
+
+/* inherits documentation from base class */
+void QCPContour::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const
+{
+    // draw two nested closed lines as a symbol for contour lines:
+    applyDefaultAntialiasingHint(painter);
+    painter->setPen(mPen);
+    painter->setBrush(Qt::NoBrush);
+    painter->drawEllipse(rect.center(), rect.width()*0.45, rect.height()*0.4);
+    painter->drawEllipse(rect.center(), rect.width()*0.2, rect.height()*0.18);
+}
+
+/*! \internal
+
+  Brings the cached contour lines up to date with the data and levels. If the levels, the data
+  instance or the data size changed, all bands are recalculated. Otherwise only the bands which
+  contain cells modified since the last update are recalculated (see \ref
+  QCPColorMapData::takeModifiedCells).
+
+  If many cells need to be processed, the bands are split into chunks which are calculated
+  concurrently in the global QThreadPool (see \ref QCPContourTask).
+*/
+void QCPContour::updateContours() const
+{
+    QCPColorMapData *mapData = data();
+    const int keySize = mapData->keySize();
+    const int valueSize = mapData->valueSize();
+    const int bandCount = valueSize > 1 ? (valueSize-2)/mBandSize+1 : 0; // there are valueSize-1 rows of squares
+    const QRect modifiedCells = mapData->takeModifiedCells(this);
+
+    // in circular storage with a nonzero write cursor, every modification shifts the key indices of all cells:
+    const bool keysShifted = mapData->mWriteCursor != 0 && !modifiedCells.isEmpty();
+    const bool rebuild = mContoursInvalidated || keysShifted || mapData != mContouredData ||
+            keySize != mContouredKeySize || valueSize != mContouredValueSize || mBandLines.size() != bandCount;
+    QVector<int> bands;
+    if (rebuild)
+    {
+        mBandLines.clear();
+        mBandLines.resize(bandCount);
+        for (int band=0; band<bandCount; ++band)
+            bands.append(band);
+    } else if (!modifiedCells.isEmpty() && bandCount > 0)
+    {
+        // a cell is a corner of the squares in the rows below and above it:
+        const int beginBand = qMax(0, modifiedCells.top()-1)/mBandSize;
+        const int endBand = qMin(bandCount-1, modifiedCells.bottom()/mBandSize);
+        for (int band=beginBand; band<=endBand; ++band)
+            bands.append(band);
+    }
+    mContouredData = mapData;
+    mContouredKeySize = keySize;
+    mContouredValueSize = valueSize;
+    mContoursInvalidated = false;
+    if (bands.isEmpty())
+        return;
+
+    mBandLines.detach(); // the bands are written concurrently, so make sure the vector isn't shared and doesn't detach in the worker threads
+    const qint64 minimumCellsPerTask = 65536;
+    const int taskCount = qBound(1, int(qMin(qint64(QThreadPool::globalInstance()->maxThreadCount()), qint64(bands.size())*mBandSize*keySize*qMax(1, mLevels.size())/minimumCellsPerTask)), bands.size());
+    if (taskCount > 1)
+    {
+        const int bandsPerTask = (bands.size()+taskCount-1)/taskCount;
+        QSemaphore finished;
+        int startedTasks = 0;
+        for (int begin=bandsPerTask; begin<bands.size(); begin+=bandsPerTask)
+        {
+            QCPContourTask *task = new QCPContourTask(this, bands.constData()+begin, qMin(bandsPerTask, bands.size()-begin), &finished);
+            if (!QThreadPool::globalInstance()->tryStart(task)) // no free thread (pool busy, or called from a pool thread), so calculate the chunk here instead of waiting for one
+            {
+                task->run();
+                delete task;
+            }
+            ++startedTasks;
+        }
+        contourBands(bands.constData(), bandsPerTask);
+        finished.acquire(startedTasks);
+    } else
+        contourBands(bands.constData(), bands.size());
+}
+
+/*! \internal
+
+  Calculates the contour lines of all levels for the \a count bands whose indices are given in \a
+  bands, and stores them in \ref mBandLines. Band \a b consists of the squares whose lower corners
+  have the value indices <tt>b*mBandSize</tt> up to <tt>(b+1)*mBandSize-1</tt>.
+
+  This only reads the data and writes the given bands, so it may be called concurrently for
+  disjoint sets of bands.
+*/
+void QCPContour::contourBands(const int *bands, int count) const
+{
+    const QCPColorMapData *mapData = data();
+    const int keySize = mapData->keySize();
+    const int valueSize = mapData->valueSize();
+    const int levelCount = mLevels.size();
+    QVector<QVector<QPolygonF> > *bandLines = mBandLines.data();
+    QVector<double> lowerRow(keySize), upperRow(keySize); // cell values of the lower and upper corners of a row of squares
+    QVector<QVector<Segment> > levelSegments(levelCount);
+    double corners[4];
+
+    for (int i=0; i<count; ++i)
+    {
+        const int band = bands[i];
+        const int beginValueIndex = band*mBandSize;
+        const int endValueIndex = qMin(beginValueIndex+mBandSize, valueSize-1);
+        for (int level=0; level<levelCount; ++level)
+            levelSegments[level].clear();
+
+        for (int valueIndex=beginValueIndex; valueIndex<endValueIndex; ++valueIndex)
+        {
+            for (int keyIndex=0; keyIndex<keySize; ++keyIndex)
+            {
+                const int storageKey = mapData->storageKeyIndex(keyIndex);
+                lowerRow[keyIndex] = QCPColorMapData::cellValue(mapData->mData, mapData->mCellType, valueIndex*keySize + storageKey);
+                upperRow[keyIndex] = QCPColorMapData::cellValue(mapData->mData, mapData->mCellType, (valueIndex+1)*keySize + storageKey);
+            }
+            for (int keyIndex=0; keyIndex<keySize-1; ++keyIndex)
+            {
+                // corners in counter-clockwise order, starting at the lower left:
+                corners[0] = lowerRow.at(keyIndex);
+                corners[1] = lowerRow.at(keyIndex+1);
+                corners[2] = upperRow.at(keyIndex+1);
+                corners[3] = upperRow.at(keyIndex);
+                if (qIsNaN(corners[0]) || qIsNaN(corners[1]) || qIsNaN(corners[2]) || qIsNaN(corners[3]))
+                    continue;
+                for (int level=0; level<levelCount; ++level)
+                {
+                    const double z = mLevels.at(level);
+                    const int squareCase = (corners[0] >= z ? 1 : 0) | (corners[1] >= z ? 2 : 0) | (corners[2] >= z ? 4 : 0) | (corners[3] >= z ? 8 : 0);
+                    QVector<Segment> *segments = &levelSegments[level];
+                    switch (squareCase)
+                    {
+                    case 0: case 15: break; // square is entirely below or above the level
+                    case 1: case 14: addSegment(segments, 3, 0, keyIndex, valueIndex, keySize, corners, z); break;
+                    case 2: case 13: addSegment(segments, 0, 1, keyIndex, valueIndex, keySize, corners, z); break;
+                    case 3: case 12: addSegment(segments, 3, 1, keyIndex, valueIndex, keySize, corners, z); break;
+                    case 4: case 11: addSegment(segments, 1, 2, keyIndex, valueIndex, keySize, corners, z); break;
+                    case 6: case 9: addSegment(segments, 0, 2, keyIndex, valueIndex, keySize, corners, z); break;
+                    case 7: case 8: addSegment(segments, 3, 2, keyIndex, valueIndex, keySize, corners, z); break;
+                    case 5: case 10:
+                    {
+                        // saddle, resolved by the mean of the corners: If the center is on the same side as the lower
+                        // left corner, the lines separate the other two corners, otherwise they separate the lower left
+                        // and upper right corner:
+                        const bool centerAbove = (corners[0]+corners[1]+corners[2]+corners[3])*0.25 >= z;
+                        if (centerAbove == (squareCase == 5))
+                        {
+                            addSegment(segments, 0, 1, keyIndex, valueIndex, keySize, corners, z);
+                            addSegment(segments, 3, 2, keyIndex, valueIndex, keySize, corners, z);
+                        } else
+                        {
+                            addSegment(segments, 3, 0, keyIndex, valueIndex, keySize, corners, z);
+                            addSegment(segments, 1, 2, keyIndex, valueIndex, keySize, corners, z);
+                        }
+                        break;
+                    }
+                    }
+                }
+            }
+        }
+
+        bandLines[band] = QVector<QVector<QPolygonF> >(levelCount);
+        for (int level=0; level<levelCount; ++level)
+            joinSegments(levelSegments.at(level), &bandLines[band][level]);
+    }
+}
+
+/*! \internal
+
+  Transforms the polyline \a cellLine, given in cell index coordinates (key index as x, value index
+  as y), to pixel coordinates.
+*/
+QPolygonF QCPContour::cellsToPixels(const QPolygonF &cellLine) const
+{
+    const QCPColorMapData *mapData = data();
+    const QCPRange keyRange = mapData->keyRange();
+    const QCPRange valueRange = mapData->valueRange();
+    const double keyStep = mapData->keySize() > 1 ? keyRange.size()/(double)(mapData->keySize()-1) : 0;
+    const double valueStep = mapData->valueSize() > 1 ? valueRange.size()/(double)(mapData->valueSize()-1) : 0;
+    QPolygonF result(cellLine.size());
+    for (int i=0; i<cellLine.size(); ++i)
+        result[i] = coordsToPixels(keyRange.lower+cellLine.at(i).x()*keyStep, valueRange.lower+cellLine.at(i).y()*valueStep);
+    return result;
+}
+
+/*! \internal
+
+  Appends the segment of a contour line at \a level which crosses the square with the lower left
+  corner \a keyIndex, \a valueIndex, from the square edge \a beginEdge to the square edge \a
+  endEdge. \a corners holds the cell values of the four square corners in counter-clockwise order,
+  starting at the lower left corner. Edge \a i of the square connects corner \a i with corner \a
+  i+1 (modulo 4), so edge 0 is the lower, 1 the right, 2 the upper and 3 the left edge.
+
+  The segment end points are linearly interpolated on the edges. Each end point is identified by an
+  id of the edge in the whole data, so \ref joinSegments can connect the segments of neighbouring
+  squares: A horizontal edge from cell (k, v) to (k+1, v) has the id <tt>2*(v*keySize+k)</tt>, a
+  vertical edge from cell (k, v) to (k, v+1) has the id <tt>2*(v*keySize+k)+1</tt>.
+*/
+void QCPContour::addSegment(QVector<Segment> *segments, int beginEdge, int endEdge, int keyIndex, int valueIndex, int keySize, const double *corners, double level)
+{
+    static const int cornerKeyOffset[4] = {0, 1, 1, 0};
+    static const int cornerValueOffset[4] = {0, 0, 1, 1};
+    Segment segment;
+    for (int end=0; end<2; ++end)
+    {
+        const int edge = end == 0 ? beginEdge : endEdge;
+        const int cornerA = edge;
+        const int cornerB = (edge+1) % 4;
+        const double t = (level-corners[cornerA])/(corners[cornerB]-corners[cornerA]);
+        const QPointF point(keyIndex+cornerKeyOffset[cornerA]+t*(cornerKeyOffset[cornerB]-cornerKeyOffset[cornerA]),
+                            valueIndex+cornerValueOffset[cornerA]+t*(cornerValueOffset[cornerB]-cornerValueOffset[cornerA]));
+        // the id is determined by the lower/left cell of the edge:
+        const int edgeKeyIndex = keyIndex+qMin(cornerKeyOffset[cornerA], cornerKeyOffset[cornerB]);
+        const int edgeValueIndex = valueIndex+qMin(cornerValueOffset[cornerA], cornerValueOffset[cornerB]);
+        const qint64 edgeId = 2*(qint64(edgeValueIndex)*keySize + edgeKeyIndex) + (edge % 2 == 0 ? 0 : 1);
+        if (end == 0)
+        {
+            segment.begin = point;
+            segment.beginEdge = edgeId;
+        } else
+        {
+            segment.end = point;
+            segment.endEdge = edgeId;
+        }
+    }
+    segments->append(segment);
+}
+
+/*! \internal
+
+  Connects the \a segments, which share end points on the same square edges, to polylines and
+  appends them to \a lines. Closed contour lines end with their first point.
+
+  Since a contour line crosses a square edge at most once, each edge is shared by at most two
+  segments.
+*/
+void QCPContour::joinSegments(const QVector<Segment> &segments, QVector<QPolygonF> *lines)
+{
+    QHash<qint64, QPair<int, int> > edgeSegments; // the (up to two) segments ending on an edge, -1 if there is no second one
+    edgeSegments.reserve(segments.size()*2);
+    for (int i=0; i<segments.size(); ++i)
+    {
+        for (int end=0; end<2; ++end)
+        {
+            const qint64 edge = end == 0 ? segments.at(i).beginEdge : segments.at(i).endEdge;
+            QHash<qint64, QPair<int, int> >::iterator it = edgeSegments.find(edge);
+            if (it == edgeSegments.end())
+                edgeSegments.insert(edge, qMakePair(i, -1));
+            else
+                it.value().second = i;
+        }
+    }
+
+    QVector<bool> used(segments.size(), false);
+    for (int i=0; i<segments.size(); ++i)
+    {
+        if (used.at(i))
+            continue;
+        used[i] = true;
+        // follow the connected segments from the end of segment i, then from its beginning:
+        QPolygonF forward, backward;
+        forward << segments.at(i).begin << segments.at(i).end;
+        for (int direction=0; direction<2; ++direction)
+        {
+            QPolygonF &points = direction == 0 ? forward : backward;
+            qint64 edge = direction == 0 ? segments.at(i).endEdge : segments.at(i).beginEdge;
+            while (true)
+            {
+                const QPair<int, int> candidates = edgeSegments.value(edge);
+                int next = -1;
+                if (!used.at(candidates.first))
+                    next = candidates.first;
+                else if (candidates.second >= 0 && !used.at(candidates.second))
+                    next = candidates.second;
+                if (next < 0)
+                    break;
+                used[next] = true;
+                const Segment &segment = segments.at(next);
+                if (segment.beginEdge == edge)
+                {
+                    points << segment.end;
+                    edge = segment.endEdge;
+                } else
+                {
+                    points << segment.begin;
+                    edge = segment.beginEdge;
+                }
+            }
+        }
+        QPolygonF line;
+        line.reserve(backward.size()+forward.size());
+        for (int p=backward.size()-1; p>=0; --p)
+            line << backward.at(p);
+        line << forward;
+        lines->append(line);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPContourTask
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPContourTask
+  \internal
+  \brief A QRunnable which calculates the contour lines of some bands of a QCPContour
+
+  \ref QCPContour::updateContours splits the bands which need to be recalculated into chunks and
+  starts one QCPContourTask per chunk in the global QThreadPool. Each task calls \ref
+  QCPContour::contourBands for its bands and then releases the semaphore \a finished once. Tasks for
+  which the pool has no free thread are run directly by the contour.
+*/
+
+/*!
+  Creates a task which calculates the contour lines of the \a count bands of \a contour whose
+  indices are given in \a bands. See \ref QCPContour::contourBands.
+*/
+QCPContourTask::QCPContourTask(const QCPContour *contour, const int *bands, int count, QSemaphore *finished) :
+    mContour(contour),
+    mBands(bands),
+    mCount(count),
+    mFinished(finished)
+{
+}
+
+/* inherits documentation from base class */
+void QCPContourTask::run()
+{
+    mContour->contourBands(mBands, mCount);
+    mFinished->release();
+}
+
+/* end of 'src/plottables/plottable-contour.cpp' */
+
+
+/* including file 'src/spectrogram.cpp'                                      */
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPSpectrogram
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPSpectrogram
+  \brief Calculates the spectrogram of a sample stream and appends it to a QCPColorMap
+
+  QCPSpectrogram transforms a stream of equidistant samples with overlapping, windowed FFTs, and
+  appends the resulting spectra as key lines (columns) to the data of a \ref QCPColorMap. The key
+  axis of the color map shows the time (the key of the sample in the center of the last frame of a
+  column), and the value axis shows the frequency from zero to half the sample rate. The color map
+  data is used in circular mode (see \ref QCPColorMapData::setCircular), so appending a column
+  doesn't move any cells, and it always shows the \ref setColumnCount most recent columns.
+
+  The samples are either taken from a \ref QCPGraph with \ref setSource and \ref update, or are
+  passed directly with \ref addSamples. The latter avoids the overhead of the graph data container
+  for high sample rates, e.g. when the graph only shows a decimated version of the signal:
+  \code
+  QCPColorMap *colorMap = new QCPColorMap(customPlot->xAxis, customPlot->yAxis);
+  colorMap->setGradient(QCPColorGradient::gpSpectrum);
+  QCPSpectrogram *spectrogram = new QCPSpectrogram(colorMap);
+  spectrogram->setFftSize(2048);
+  spectrogram->setHop(1024);
+  spectrogram->setSampleRate(1.0e6);
+  ...
+  spectrogram->addSamples(samples.constData(), samples.size()); // e.g. for each block from the acquisition device
+  \endcode
+
+  Each FFT frame consists of \ref setFftSize samples, and consecutive frames start \ref setHop
+  samples apart. The samples of a frame are weighted with the window function \ref setWindowType
+  before the transformation. The power spectra of \ref setAveraging consecutive frames are averaged
+  to form one column, which is then written to the color map as amplitude or decibel values, see
+  \ref setMagnitudeScale.
+
+  The FFTs don't run in the thread which provides the samples: All frames which can be formed from
+  the available samples are transformed in one task in the global QThreadPool, while new samples
+  keep accumulating. When the task is finished, its columns are appended to the color map in the
+  thread of the QCPSpectrogram (the GUI thread), and the \ref columnsAppended signal is emitted.
+  Replot the color map in a slot connected to that signal, or simply with the next regular replot.
+  \ref waitForDone processes all pending samples synchronously.
+
+  The built-in FFT is an iterative radix-2 transformation (\ref fftRadix2). It can be replaced by
+  any other implementation with \ref setFftKernel, e.g. to use an optimized FFT library.
+
+  The QCPSpectrogram is a child of the color map passed to the constructor, so it is deleted
+  together with the color map.
+*/
+
+/* start documentation of signals */
+
+/*! \fn void QCPSpectrogram::columnsAppended(int count)
+
+  This signal is emitted when \a count new columns were appended to the color map. The color map
+  isn't replotted automatically.
+*/
+
+/* end documentation of signals */
+
+/*!
+  Constructs a spectrogram which appends its columns to the data of \a colorMap. The spectrogram
+  becomes a child of \a colorMap.
+
+  The default configuration is an FFT size of 1024 with a hop of 512 (50 % overlap), no averaging,
+  a Hann window and a decibel magnitude scale.
+*/
+QCPSpectrogram::QCPSpectrogram(QCPColorMap *colorMap) :
+    QObject(colorMap),
+    mColorMap(colorMap),
+    mFftSize(1024),
+    mHop(512),
+    mAveraging(1),
+    mWindowType(wtHann),
+    mMagnitudeScale(msDecibel),
+    mSampleRate(0),
+    mColumnCount(256),
+    mFftKernel(&QCPSpectrogram::fftRadix2),
+    mPendingIndex(0),
+    mSkipSamples(0),
+    mStreamStarted(false),
+    mStreamKey(0),
+    mSourceKey(-(std::numeric_limits<double>::max)()),
+    mEstimatedSampleRate(0),
+    mWindowSum(0),
+    mAverageCount(0),
+    mColorMapConfigured(false),
+    mTask(0)
+{
+    updateWindow();
+}
+
+QCPSpectrogram::~QCPSpectrogram()
+{
+    if (mTask)
+    {
+        mTaskFinished.acquire(); // the task accesses this spectrogram until it's finished
+        delete mTask;
+    }
+}
+
+/*!
+  Sets the color map whose data receives the spectrogram columns. The data of the color map is
+  resized and its key and value range are set when the next column is appended.
+*/
+void QCPSpectrogram::setColorMap(QCPColorMap *colorMap)
+{
+    mColorMap = colorMap;
+    mColorMapConfigured = false;
+}
+
+/*!
+  Sets the graph whose data is transformed. Each call of \ref update takes the data points of \a
+  graph with keys larger than the last key taken before, so the graph is expected to receive its
+  data in ascending key order, like in a real time plot. Removing old data points from the graph
+  (e.g. with \ref QCPDataContainer::removeBefore) doesn't interfere with the spectrogram.
+
+  Only the values of the data points are used. Their keys determine the key of the first sample
+  and, if no sample rate is set with \ref setSampleRate, the sample rate.
+
+  Setting a new source starts a new stream, see \ref clear.
+*/
+void QCPSpectrogram::setSource(QCPGraph *graph)
+{
+    clear();
+    mSource = graph;
+    mSourceKey = -(std::numeric_limits<double>::max)();
+}
+
+/*!
+  Sets the number of samples of each FFT frame. \a size must be a power of two and at least 4. The
+  spectrogram has \a size/2+1 frequency bins.
+
+  Changing the FFT size discards the samples which weren't transformed yet, and clears the color
+  map when the next column is appended.
+*/
+void QCPSpectrogram::setFftSize(int size)
+{
+    if (size < 4 || (size & (size-1)) != 0)
+    {
+        qDebug() << Q_FUNC_INFO << "FFT size must be a power of two and at least 4:" << size;
+        return;
+    }
+    if (mFftSize != size)
+    {
+        resetStream();
+        mFftSize = size;
+        updateWindow();
+    }
+}
+
+/*!
+  Sets the number of samples between the beginnings of two consecutive FFT frames. A hop smaller
+  than the FFT size makes the frames overlap, a hop larger than the FFT size skips samples.
+
+  Changing the hop discards the samples which weren't transformed yet, and clears the color map
+  when the next column is appended.
+*/
+void QCPSpectrogram::setHop(int hop)
+{
+    if (hop < 1)
+    {
+        qDebug() << Q_FUNC_INFO << "hop must be positive:" << hop;
+        return;
+    }
+    if (mHop != hop)
+    {
+        resetStream();
+        mHop = hop;
+    }
+}
+
+/*!
+  Sets the number of consecutive FFT frames whose power spectra are averaged to form one column of
+  the spectrogram. Averaging reduces the variance of noisy spectra, and the column rate.
+*/
+void QCPSpectrogram::setAveraging(int frames)
+{
+    if (frames < 1)
+    {
+        qDebug() << Q_FUNC_INFO << "number of averaged frames must be positive:" << frames;
+        return;
+    }
+    if (mAveraging != frames)
+    {
+        resetStream();
+        mAveraging = frames;
+    }
+}
+
+/*!
+  Sets the window function which weights the samples of each FFT frame.
+
+  \see WindowType
+*/
+void QCPSpectrogram::setWindowType(WindowType type)
+{
+    if (mWindowType != type)
+    {
+        resetStream();
+        mWindowType = type;
+        updateWindow();
+    }
+}
+
+/*!
+  Sets whether the columns contain the amplitudes or the power in decibel of the frequency bins.
+  The color map is cleared when the next column is appended.
+
+  Note that the data range of the color map isn't changed by the spectrogram, see \ref
+  QCPColorMap::setDataRange and \ref QCPColorMap::rescaleDataRange.
+*/
+void QCPSpectrogram::setMagnitudeScale(MagnitudeScale scale)
+{
+    if (mMagnitudeScale != scale)
+    {
+        mMagnitudeScale = scale;
+        mColorMapConfigured = false;
+    }
+}
+
+/*!
+  Sets the sample rate of the stream in samples per key unit (e.g. Hz, if the key axis shows
+  seconds). It determines the key spacing of the columns and the value range (the frequency range)
+  of the color map.
+
+  If \a sampleRate is zero, the sample rate is estimated from the keys of the source graph (see
+  \ref setSource). If there is no source graph either, a sample rate of 1 is used.
+*/
+void QCPSpectrogram::setSampleRate(double sampleRate)
+{
+    if (sampleRate < 0)
+    {
+        qDebug() << Q_FUNC_INFO << "sample rate can't be negative:" << sampleRate;
+        return;
+    }
+    if (mSampleRate != sampleRate)
+    {
+        mSampleRate = sampleRate;
+        mColorMapConfigured = false;
+    }
+}
+
+/*!
+  Sets the number of columns the color map keeps, i.e. its key size. When more columns are
+  appended, the oldest ones are overwritten. The color map is cleared when the next column is
+  appended.
+*/
+void QCPSpectrogram::setColumnCount(int count)
+{
+    if (count < 2)
+    {
+        qDebug() << Q_FUNC_INFO << "column count must be at least 2:" << count;
+        return;
+    }
+    if (mColumnCount != count)
+    {
+        mColumnCount = count;
+        mColorMapConfigured = false;
+    }
+}
+
+/*!
+  Sets the function which performs the FFTs. The default is \ref fftRadix2. Passing 0 restores the
+  default.
+
+  The kernel is called from threads of the global QThreadPool, possibly concurrently with other
+  kernel calls, so it must be reentrant.
+
+  \see FftKernel
+*/
+void QCPSpectrogram::setFftKernel(FftKernel kernel)
+{
+    if (!kernel)
+        kernel = &QCPSpectrogram::fftRadix2;
+    if (mFftKernel != kernel)
+    {
+        resetStream();
+        mFftKernel = kernel;
+    }
+}
+
+/*!
+  Appends \a count samples, stored at \a values, to the stream. The samples are copied, so \a
+  values may be reused after the call.
+
+  If enough samples are available to form at least one FFT frame and no task is running, the frames
+  are transformed in the global QThreadPool. Otherwise the samples are kept until the running task
+  is finished.
+
+  If a source graph is set (\ref setSource), \ref update calls this method with the new data of the
+  graph.
+*/
+void QCPSpectrogram::addSamples(const double *values, int count)
+{
+    if (!values)
+    {
+        qDebug() << Q_FUNC_INFO << "null pointer given as values";
+        return;
+    }
+    if (count <= 0)
+        return;
+    mStreamStarted = true;
+
+    const int skipped = qMin(mSkipSamples, count); // samples between two frames, if the hop is larger than the FFT size
+    mSkipSamples -= skipped;
+    mPendingIndex += skipped;
+    const int oldSize = mPendingSamples.size();
+    mPendingSamples.resize(oldSize+count-skipped);
+    std::copy(values+skipped, values+count, mPendingSamples.begin()+oldSize);
+    dispatchFrames();
+}
+
+/*!
+  Discards all samples which weren't transformed yet and the partial average of the next column,
+  and starts a new stream. A running task is waited for, and its result is discarded. The color map
+  is cleared when the next column is appended.
+
+  The source graph remains set, but only its data points which are added after this call are used.
+*/
+void QCPSpectrogram::clear()
+{
+    resetStream();
+    mStreamStarted = false;
+    mPendingIndex = 0;
+    mStreamKey = 0;
+    mEstimatedSampleRate = 0;
+}
+
+/*!
+  Blocks until all samples which can form complete FFT frames are transformed, and their columns
+  are appended to the color map.
+
+  This is useful if the spectrogram must be up to date at a specific point, e.g. before exporting
+  the plot.
+*/
+void QCPSpectrogram::waitForDone()
+{
+    while (mTask)
+        collectFrames(); // starts the next task, if samples accumulated during the previous one
+}
+
+/*!
+  The built-in FFT kernel, an in-place, iterative radix-2 decimation-in-time FFT of the \a n
+  complex values given by \a real and \a imag. \a n must be a power of two.
+
+  The transformation is unnormalized and uses the sign convention X(k) = sum x(j)*exp(-2*pi*i*j*k/n).
+
+  \see setFftKernel
+*/
+void QCPSpectrogram::fftRadix2(double *real, double *imag, int n)
+{
+    // reorder the input into bit reversed index order:
+    for (int i=1, j=0; i<n; ++i)
+    {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)
+        {
+            qSwap(real[i], real[j]);
+            qSwap(imag[i], imag[j]);
+        }
+    }
+    // combine transformations of doubling length with butterflies. The twiddle factors are advanced
+    // by complex multiplication, so only one sine and cosine is evaluated per length:
+    for (int length=2; length<=n; length <<= 1)
+    {
+        const int half = length/2;
+        const double angle = -2.0*M_PI/length;
+        const double stepReal = qCos(angle);
+        const double stepImag = qSin(angle);
+        double twiddleReal = 1;
+        double twiddleImag = 0;
+        for (int k=0; k<half; ++k)
+        {
+            for (int a=k; a<n; a+=length)
+            {
+                const int b = a+half;
+                const double tReal = real[b]*twiddleReal - imag[b]*twiddleImag;
+                const double tImag = real[b]*twiddleImag + imag[b]*twiddleReal;
+                real[b] = real[a]-tReal;
+                imag[b] = imag[a]-tImag;
+                real[a] += tReal;
+                imag[a] += tImag;
+            }
+            const double nextReal = twiddleReal*stepReal - twiddleImag*stepImag;
+            twiddleImag = twiddleReal*stepImag + twiddleImag*stepReal;
+            twiddleReal = nextReal;
+        }
+    }
+}
+
+/*!
+  Takes the data points of the source graph which were added since the last call, and appends their
+  values to the stream (see \ref addSamples). Call this method whenever new data was added to the
+  source graph, e.g. in the same slot that adds the data, or connect it to QCustomPlot::beforeReplot.
+
+  \see setSource
+*/
+void QCPSpectrogram::update()
+{
+    QCPGraph *source = mSource.data();
+    if (!source)
+        return;
+
+    QSharedPointer<QCPGraphDataContainer> data = source->data();
+    QCPGraphDataContainer::const_iterator begin = data->findBegin(mSourceKey, false);
+    while (begin != data->constEnd() && !(begin->key > mSourceKey))
+        ++begin;
+    const int count = data->constEnd()-begin;
+    if (count <= 0)
+        return;
+
+    const double lastKey = (data->constEnd()-1)->key;
+    if (!mStreamStarted)
+        mStreamKey = begin->key;
+    if (mEstimatedSampleRate <= 0 && count > 1 && lastKey > begin->key)
+        mEstimatedSampleRate = (count-1)/(lastKey-begin->key);
+    mSourceKey = lastKey;
+
+    QVector<double> values(count);
+    double *value = values.data();
+    for (QCPGraphDataContainer::const_iterator it=begin; it!=data->constEnd(); ++it)
+        *value++ = it->value;
+    addSamples(values.constData(), count);
+}
+
+/*! \internal
+
+  This slot is invoked (queued) by a \ref QCPSpectrogramTask when it's finished, with the stream
+  index of its first sample \a firstSampleIndex. It appends the columns of the task to the color
+  map.
+
+  The task posts this notification right before it releases \ref mTaskFinished, so \ref
+  collectFrames may have to wait briefly for the release. Notifications of tasks whose result was
+  already collected by \ref waitForDone don't match the running task and are ignored.
+*/
+void QCPSpectrogram::taskFinished(qlonglong firstSampleIndex)
+{
+    if (mTask && mTask->mFirstSampleIndex == firstSampleIndex)
+        collectFrames();
+}
+
+/*! \internal
+
+  Returns the sample rate set with \ref setSampleRate, or, if that is zero, the sample rate
+  estimated from the source graph. If neither is available, returns 1.
+*/
+double QCPSpectrogram::effectiveSampleRate() const
+{
+    if (mSampleRate > 0)
+        return mSampleRate;
+    else if (mEstimatedSampleRate > 0)
+        return mEstimatedSampleRate;
+    else
+        return 1;
+}
+
+/*! \internal
+
+  Waits for a running task and discards its result, as well as the pending samples and the partial
+  average. The stream index continues, so the keys of later columns remain consistent. The color map
+  is reconfigured when the next column is appended.
+
+  This is called when a parameter changes which the running task or the partial average depends on.
+*/
+void QCPSpectrogram::resetStream()
+{
+    if (mTask)
+    {
+        mTaskFinished.acquire();
+        delete mTask;
+        mTask = 0;
+    }
+    mPendingIndex += mPendingSamples.size();
+    mPendingSamples.clear();
+    mSkipSamples = 0;
+    mAverageSum.clear();
+    mAverageCount = 0;
+    mColorMapConfigured = false;
+}
+
+/*! \internal
+
+  Calculates the window function of the current window type and FFT size, and the sum of its
+  weights, which normalizes the bin amplitudes.
+
+  The windows are periodic (i.e. the denominator of the phase is the FFT size, not the FFT size
+  minus one), which is the appropriate form for spectral analysis with overlapping frames.
+*/
+void QCPSpectrogram::updateWindow()
+{
+    mWindow.resize(mFftSize);
+    mWindowSum = 0;
+    for (int i=0; i<mFftSize; ++i)
+    {
+        const double phase = 2.0*M_PI*i/double(mFftSize);
+        double weight = 1;
+        switch (mWindowType)
+        {
+        case wtRectangular: weight = 1; break;
+        case wtHann: weight = 0.5-0.5*qCos(phase); break;
+        case wtHamming: weight = 0.54-0.46*qCos(phase); break;
+        case wtBlackman: weight = 0.42-0.5*qCos(phase)+0.08*qCos(2*phase); break;
+        }
+        mWindow[i] = weight;
+        mWindowSum += weight;
+    }
+}
+
+/*! \internal
+
+  Starts a \ref QCPSpectrogramTask for all FFT frames which can be formed from the pending samples,
+  unless a task is already running. The samples which aren't needed by later frames are removed
+  from the pending samples.
+*/
+void QCPSpectrogram::dispatchFrames()
+{
+    if (mTask || !mColorMap)
+        return;
+    const int available = mPendingSamples.size();
+    if (available < mFftSize)
+        return;
+
+    const int frameCount = (available-mFftSize)/mHop+1;
+    mTask = new QCPSpectrogramTask(this, mPendingSamples.mid(0, (frameCount-1)*mHop+mFftSize), mPendingIndex, frameCount);
+    mTask->setAutoDelete(false);
+
+    const qint64 consumed = qint64(frameCount)*mHop; // samples up to the beginning of the next frame
+    if (consumed < available)
+    {
+        mPendingSamples.remove(0, int(consumed));
+        mPendingIndex += consumed;
+    } else
+    {
+        mSkipSamples = int(consumed-available);
+        mPendingSamples.clear();
+        mPendingIndex += available;
+    }
+    QThreadPool::globalInstance()->start(mTask);
+}
+
+/*! \internal
+
+  Collects the power spectra of the finished task, averages them and appends the resulting columns
+  to the color map. Afterwards, a new task is started if enough samples accumulated in the meantime.
+
+  Blocks until the running task is finished.
+*/
+void QCPSpectrogram::collectFrames()
+{
+    if (!mTask)
+        return;
+    mTaskFinished.acquire();
+    QCPSpectrogramTask *task = mTask;
+    mTask = 0;
+
+    const int binCount = mFftSize/2+1;
+    if (mAverageSum.size() != binCount)
+    {
+        mAverageSum.fill(0, binCount);
+        mAverageCount = 0;
+    }
+    const double sampleRate = effectiveSampleRate();
+    double *sum = mAverageSum.data();
+    int appendedColumns = 0;
+    for (int frame=0; frame<task->mFrameCount; ++frame)
+    {
+        const double *power = task->mPowers.constData()+frame*binCount;
+        for (int bin=0; bin<binCount; ++bin)
+            sum[bin] += power[bin];
+        if (++mAverageCount == mAveraging)
+        {
+            if (mAveraging > 1)
+            {
+                for (int bin=0; bin<binCount; ++bin)
+                    sum[bin] /= double(mAveraging);
+            }
+            const qint64 centerIndex = task->mFirstSampleIndex + qint64(frame)*mHop + mFftSize/2;
+            appendColumn(sum, mStreamKey + centerIndex/sampleRate);
+            std::fill(sum, sum+binCount, 0.0);
+            mAverageCount = 0;
+            ++appendedColumns;
+        }
+    }
+    delete task;
+
+    if (appendedColumns > 0)
+        emit columnsAppended(appendedColumns);
+    dispatchFrames();
+}
+
+/*! \internal
+
+  Converts the averaged power spectrum \a power to the magnitude scale and appends it as new key
+  line to the color map data. \a key is the key of the column.
+
+  If the color map data doesn't have the configuration of the spectrogram yet, it is resized and
+  its ranges are set such that the appended column lies at \a key.
+*/
+void QCPSpectrogram::appendColumn(const double *power, double key)
+{
+    QCPColorMap *colorMap = mColorMap.data();
+    if (!colorMap)
+        return;
+    QCPColorMapData *mapData = colorMap->data();
+    const int binCount = mFftSize/2+1;
+
+    mColumn.resize(binCount);
+    double *column = mColumn.data();
+    if (mMagnitudeScale == msDecibel)
+    {
+        const double lowestPower = 1e-30; // limits the decibel values of empty bins to -300
+        for (int bin=0; bin<binCount; ++bin)
+            column[bin] = 10.0*std::log10(qMax(power[bin], lowestPower));
+    } else
+    {
+        for (int bin=0; bin<binCount; ++bin)
+            column[bin] = qSqrt(power[bin]);
+    }
+
+    if (!mColorMapConfigured || mapData->keySize() != mColumnCount || mapData->valueSize() != binCount)
+    {
+        const double sampleRate = effectiveSampleRate();
+        const double columnStep = mHop*mAveraging/sampleRate;
+        mapData->setSize(mColumnCount, binCount);
+        mapData->setCircular(true);
+        // appendKeyLine shifts the key range by one column step, so the new column ends up at key:
+        mapData->setRange(QCPRange(key-mColumnCount*columnStep, key-columnStep), QCPRange(0, sampleRate/2.0));
+        mapData->fill(mMagnitudeScale == msDecibel ? *std::min_element(column, column+binCount) : 0);
+        mColorMapConfigured = true;
+    }
+    mapData->appendKeyLine(column, true);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPSpectrogramTask
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPSpectrogramTask
+  \internal
+  \brief A QRunnable which calculates the power spectra of consecutive FFT frames for a QCPSpectrogram
+
+  \ref QCPSpectrogram::dispatchFrames starts one task at a time in the global QThreadPool. The task
+  copies the configuration of the spectrogram when it's created, so it doesn't access the
+  spectrogram while running. When finished, it invokes \ref QCPSpectrogram::taskFinished queued,
+  and releases the semaphore of the spectrogram.
+*/
+
+/*!
+  Creates a task which transforms \a frameCount frames of \a samples with the FFT size, hop, window
+  and FFT kernel of \a spectrogram. \a firstSampleIndex is the stream index of the first sample, it
+  is used by the spectrogram to determine the keys of the columns.
+*/
+QCPSpectrogramTask::QCPSpectrogramTask(QCPSpectrogram *spectrogram, const QVector<double> &samples, qint64 firstSampleIndex, int frameCount) :
+    mSpectrogram(spectrogram),
+    mSamples(samples),
+    mWindow(spectrogram->mWindow),
+    mFirstSampleIndex(firstSampleIndex),
+    mFrameCount(frameCount),
+    mFftSize(spectrogram->mFftSize),
+    mHop(spectrogram->mHop),
+    mWindowSum(spectrogram->mWindowSum),
+    mFftKernel(spectrogram->mFftKernel)
+{
+}
+
+/* inherits documentation from base class */
+void QCPSpectrogramTask::run()
+{
+    const int binCount = mFftSize/2+1;
+    mPowers.resize(mFrameCount*binCount);
+    QVector<double> realBuffer(mFftSize), imagBuffer(mFftSize);
+    double *real = realBuffer.data();
+    double *imag = imagBuffer.data();
+    const double *window = mWindow.constData();
+    // scales the squared bin magnitudes to the squared amplitude of a sinusoid in the single-sided spectrum:
+    const double scale = 4.0/(mWindowSum*mWindowSum);
+    for (int frame=0; frame<mFrameCount; ++frame)
+    {
+        const double *samples = mSamples.constData()+frame*mHop;
+        for (int i=0; i<mFftSize; ++i)
+        {
+            real[i] = samples[i]*window[i];
+            imag[i] = 0;
+        }
+        mFftKernel(real, imag, mFftSize);
+        double *power = mPowers.data()+frame*binCount;
+        for (int bin=0; bin<binCount; ++bin)
+            power[bin] = (real[bin]*real[bin] + imag[bin]*imag[bin])*scale;
+        power[0] *= 0.25; // the DC and Nyquist bins have no counterpart at negative frequencies
+        power[binCount-1] *= 0.25;
+    }
+    // notify before releasing the semaphore, since the spectrogram may be deleted right after the release:
+    QMetaObject::invokeMethod(mSpectrogram, "taskFinished", Qt::QueuedConnection, Q_ARG(qlonglong, mFirstSampleIndex));
+    mSpectrogram->mTaskFinished.release();
+}
+
+/* end of 'src/spectrogram.cpp' */
+
+
+/* including file 'src/plottables/plottable-persistence.cpp'                 */
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPPersistence
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPPersistence
+  \brief A plottable which accumulates many overlaid sweeps into a decaying hit count map
+
+  QCPPersistence displays repeated waveforms like the persistence (phosphor) mode of an
+  oscilloscope, e.g. eye diagrams or overlaid ECG beats. Instead of storing each sweep as a graph,
+  every sweep passed to \ref addSweep is rasterized into a buffer of hit counts, and only the buffer
+  is drawn. The cost of a sweep is proportional to its length in buffer cells, independent of how
+  many sweeps were added before, so thousands of sweeps per second can be displayed.
+
+  The buffer has \ref keySize times \ref valueSize cells, covering the rectangle given by \ref
+  setRange in plot coordinates. Each line segment of a sweep increments the cells it passes through
+  by one. With every sweep, the hit counts of all previous sweeps are multiplied by \ref setDecay,
+  so old sweeps fade out exponentially. A decay of 1 accumulates sweeps indefinitely.
+
+  The hit counts are colorized with the color gradient \ref setGradient and the data range \ref
+  setDataRange (or \ref rescaleDataRange), like the cells of a \ref QCPColorMap. Cells without hits
+  remain transparent. A logarithmic data scale (\ref setDataScaleType) makes rare traces visible
+  next to frequent ones.
+
+  \code
+  QCPPersistence *persistence = new QCPPersistence(customPlot->xAxis, customPlot->yAxis);
+  persistence->setSize(600, 300);
+  persistence->setRange(QCPRange(0, 1), QCPRange(-1.5, 1.5));
+  persistence->setDecay(0.98);
+  ...
+  persistence->addSweep(keys, values); // for each acquired sweep
+  \endcode
+
+  The decay doesn't touch the buffer: New hits are instead weighted increasingly higher. Only when
+  the weight gets large, all cells are normalized once.
+*/
+
+/*!
+  Constructs a persistence plottable with the specified \a keyAxis and \a valueAxis.
+
+  The created QCPPersistence is automatically registered with the QCustomPlot instance inferred
+  from \a keyAxis. This QCustomPlot instance takes ownership of the QCPPersistence, so do not delete
+  it manually but use QCustomPlot::removePlottable() instead.
+*/
+QCPPersistence::QCPPersistence(QCPAxis *keyAxis, QCPAxis *valueAxis) :
+    QCPAbstractPlottable(keyAxis, valueAxis),
+    mKeySize(0),
+    mValueSize(0),
+    mKeyRange(0, 5),
+    mValueRange(0, 5),
+    mDataRange(0, 10),
+    mDataScaleType(QCPAxis::stLinear),
+    mGradient(QCPColorGradient::gpHot),
+    mInterpolate(true),
+    mDecay(0.99),
+    mHitWeight(1),
+    mMapImageInvalidated(true)
+{
+    setSize(256, 256);
+}
+
+QCPPersistence::~QCPPersistence()
+{
+}
+
+/*!
+  Sets the number of cells of the hit count buffer in key and value direction. For a sharp display,
+  choose roughly the pixel size of the plottable in the axis rect.
+
+  All hit counts are cleared.
+*/
+void QCPPersistence::setSize(int keySize, int valueSize)
+{
+    if (keySize < 1 || valueSize < 1)
+    {
+        qDebug() << Q_FUNC_INFO << "invalid size:" << keySize << valueSize;
+        return;
+    }
+    mKeySize = keySize;
+    mValueSize = valueSize;
+    mHits.fill(0, mKeySize*mValueSize);
+    mHitWeight = 1;
+    mMapImageInvalidated = true;
+}
+
+/*!
+  Sets the rectangle in plot coordinates which the hit count buffer covers. Parts of sweeps outside
+  of these ranges are ignored.
+
+  All hit counts are cleared, since they refer to the previous ranges.
+*/
+void QCPPersistence::setRange(const QCPRange &keyRange, const QCPRange &valueRange)
+{
+    if (keyRange.size() == 0 || valueRange.size() == 0)
+    {
+        qDebug() << Q_FUNC_INFO << "ranges must have non-zero size:" << keyRange << valueRange;
+        return;
+    }
+    mKeyRange = keyRange;
+    mValueRange = valueRange;
+    clear();
+}
+
+/*!
+  Sets the data range of this plottable to \a dataRange. The data range defines which hit counts
+  are mapped to the color gradient.
+
+  \see rescaleDataRange
+*/
+void QCPPersistence::setDataRange(const QCPRange &dataRange)
+{
+    if (!QCPRange::validRange(dataRange)) return;
+    if (mDataRange.lower != dataRange.lower || mDataRange.upper != dataRange.upper)
+    {
+        if (mDataScaleType == QCPAxis::stLogarithmic)
+            mDataRange = dataRange.sanitizedForLogScale();
+        else
+            mDataRange = dataRange.sanitizedForLinScale();
+        mMapImageInvalidated = true;
+    }
+}
+
+/*!
+  Sets whether the hit counts are correlated with the color gradient linearly or logarithmically.
+*/
+void QCPPersistence::setDataScaleType(QCPAxis::ScaleType scaleType)
+{
+    if (mDataScaleType != scaleType)
+    {
+        mDataScaleType = scaleType;
+        mMapImageInvalidated = true;
+        if (mDataScaleType == QCPAxis::stLogarithmic)
+            setDataRange(mDataRange.sanitizedForLogScale());
+    }
+}
+
+/*!
+  Sets the color gradient that is used to represent the hit counts.
+*/
+void QCPPersistence::setGradient(const QCPColorGradient &gradient)
+{
+    if (mGradient != gradient)
+    {
+        mGradient = gradient;
+        mMapImageInvalidated = true;
+    }
+}
+
+/*!
+  Sets whether the hit count image is drawn with smooth interpolation, when it's displayed at a
+  scale different from one cell per pixel.
+*/
+void QCPPersistence::setInterpolate(bool enabled)
+{
+    mInterpolate = enabled;
+}
+
+/*!
+  Sets the factor by which the hit counts of all previous sweeps are multiplied when a new sweep is
+  added. \a decay must be in the range (0, 1]. A sweep fades to half its intensity after ln(0.5)/ln(\a
+  decay) further sweeps, e.g. after 69 sweeps for a decay of 0.99.
+*/
+void QCPPersistence::setDecay(double decay)
+{
+    if (decay <= 0 || decay > 1)
+    {
+        qDebug() << Q_FUNC_INFO << "decay must be in the range (0, 1]:" << decay;
+        return;
+    }
+    mDecay = decay;
+}
+
+/*!
+  Rasterizes the sweep given by the \a count points at \a keys and \a values into the hit count
+  buffer. Consecutive points are connected by line segments. NaN values create gaps.
+
+  The hit counts of all previous sweeps decay by the factor \ref setDecay.
+*/
+void QCPPersistence::addSweep(const double *keys, const double *values, int count)
+{
+    if (!keys || !values)
+    {
+        qDebug() << Q_FUNC_INFO << "null pointer given as keys or values";
+        return;
+    }
+    if (count <= 0)
+        return;
+
+    mHitWeight /= mDecay; // instead of decaying all previous hits, weight the new ones higher
+    if (mHitWeight > 1e20) // cells accumulate up to about mHitWeight*hitsPerSweep/(1-mDecay), which must stay well below the float maximum of 3.4e38
+        normalizeHits();
+    const float weight = float(mHitWeight);
+
+    const double keyScale = mKeySize/mKeyRange.size();
+    const double valueScale = mValueSize/mValueRange.size();
+    double x0 = (keys[0]-mKeyRange.lower)*keyScale;
+    double y0 = (values[0]-mValueRange.lower)*valueScale;
+    if (count == 1 && !qIsNaN(x0) && !qIsNaN(y0))
+        addSegment(x0, y0, x0, y0, false, weight);
+    bool skipBegin = false; // the begin cell of a segment was already hit as end cell of the previous segment
+    for (int i=1; i<count; ++i)
+    {
+        const double x1 = (keys[i]-mKeyRange.lower)*keyScale;
+        const double y1 = (values[i]-mValueRange.lower)*valueScale;
+        if (qIsNaN(x0) || qIsNaN(y0) || qIsNaN(x1) || qIsNaN(y1))
+        {
+            skipBegin = false;
+        } else
+        {
+            addSegment(x0, y0, x1, y1, skipBegin, weight);
+            skipBegin = true;
+        }
+        x0 = x1;
+        y0 = y1;
+    }
+    mMapImageInvalidated = true;
+}
+
+/*! \overload
+
+  Rasterizes the sweep given by \a keys and \a values, which must have the same size.
+*/
+void QCPPersistence::addSweep(const QVector<double> &keys, const QVector<double> &values)
+{
+    if (keys.size() != values.size())
+        qDebug() << Q_FUNC_INFO << "keys and values have different sizes:" << keys.size() << values.size();
+    addSweep(keys.constData(), values.constData(), qMin(keys.size(), values.size()));
+}
+
+/*! \overload
+
+  Rasterizes the sweep given by the data points of \a data, e.g. the data of a \ref QCPGraph which
+  holds the current sweep.
 */
-void QCPColorMap::rescaleDataRange(bool recalculateDataBounds)
+void QCPPersistence::addSweep(const QCPGraphDataContainer &data)
 {
-    if (recalculateDataBounds)
-        mMapData->recalculateDataBounds();
-    setDataRange(mMapData->dataBounds());
+    mSweepKeys.resize(data.size());
+    mSweepValues.resize(data.size());
+    double *key = mSweepKeys.data();
+    double *value = mSweepValues.data();
+    for (QCPGraphDataContainer::const_iterator it=data.constBegin(); it!=data.constEnd(); ++it)
+    {
+        *key++ = it->key;
+        *value++ = it->value;
+    }
+    addSweep(mSweepKeys.constData(), mSweepValues.constData(), data.size());
 }
 
 /*!
-  Takes the current appearance of the color map and updates the legend icon, which is used to
-  represent this color map in the legend (see \ref QCPLegend).
-
-  The \a transformMode specifies whether the rescaling is done by a faster, low quality image
-  scaling algorithm (Qt::FastTransformation) or by a slower, higher quality algorithm
-  (Qt::SmoothTransformation).
-
-  The current color map appearance is scaled down to \a thumbSize. Ideally, this should be equal to
-  the size of the legend icon (see \ref QCPLegend::setIconSize). If it isn't exactly the configured
-  legend icon size, the thumb will be rescaled during drawing of the legend item.
+  Returns the decayed hit count of the cell at \a keyIndex and \a valueIndex. A cell which was hit
+  by the latest sweep and no earlier sweep has a hit count of one.
+*/
+double QCPPersistence::hits(int keyIndex, int valueIndex) const
+{
+    if (keyIndex >= 0 && keyIndex < mKeySize && valueIndex >= 0 && valueIndex < mValueSize)
+        return mHits.at(valueIndex*mKeySize+keyIndex)/mHitWeight;
+    else
+        return 0;
+}
 
-  \see setDataRange
+/*!
+  Clears the hit counts of all cells.
 */
-void QCPColorMap::updateLegendIcon(Qt::TransformationMode transformMode, const QSize &thumbSize)
+void QCPPersistence::clear()
 {
-    if (mMapImage.isNull() && !data()->isEmpty())
-        updateMapImage(); // try to update map image if it's null (happens if no draw has happened yet)
+    mHits.fill(0);
+    mHitWeight = 1;
+    mMapImageInvalidated = true;
+}
 
-    if (!mMapImage.isNull()) // might still be null, e.g. if data is empty, so check here again
+/*!
+  Sets the data range (\ref setDataRange) from zero to the highest hit count of all cells.
+*/
+void QCPPersistence::rescaleDataRange()
+{
+    float maxHits = 0;
+    const float *hits = mHits.constData();
+    const int cellCount = mHits.size();
+    for (int i=0; i<cellCount; ++i)
     {
-        bool mirrorX = (keyAxis()->orientation() == Qt::Horizontal ? keyAxis() : valueAxis())->rangeReversed();
-        bool mirrorY = (valueAxis()->orientation() == Qt::Vertical ? valueAxis() : keyAxis())->rangeReversed();
-        mLegendIcon = QPixmap::fromImage(mMapImage.mirrored(mirrorX, mirrorY)).scaled(thumbSize, Qt::KeepAspectRatio, transformMode);
+        if (hits[i] > maxHits)
+            maxHits = hits[i];
     }
+    if (maxHits > 0)
+        setDataRange(QCPRange(0, maxHits/mHitWeight));
 }
 
 /* inherits documentation from base class */
-double QCPColorMap::selectTest(const QPointF &pos, bool onlySelectable, QVariant *details) const
+double QCPPersistence::selectTest(const QPointF &pos, bool onlySelectable, QVariant *details) const
 {
     Q_UNUSED(details)
-    if ((onlySelectable && mSelectable == QCP::stNone) || mMapData->isEmpty())
+    if (onlySelectable && mSelectable == QCP::stNone)
         return -1;
     if (!mKeyAxis || !mValueAxis)
         return -1;
@@ -25894,10 +31731,12 @@ double QCPColorMap::selectTest(const QPointF &pos, bool onlySelectable, QVariant
     {
         double posKey, posValue;
         pixelsToCoords(pos, posKey, posValue);
-        if (mMapData->keyRange().contains(posKey) && mMapData->valueRange().contains(posValue))
+        const int keyIndex = qFloor((posKey-mKeyRange.lower)/mKeyRange.size()*mKeySize);
+        const int valueIndex = qFloor((posValue-mValueRange.lower)/mValueRange.size()*mValueSize);
+        if (hits(keyIndex, valueIndex) > 0)
         {
             if (details)
-                details->setValue(QCPDataSelection(QCPDataRange(0, 1))); // temporary solution, to facilitate whole-plottable selection. Replace in future version with segmented 2D selection.
+                details->setValue(QCPDataSelection(QCPDataRange(0, 1))); // whole-plottable selection, like QCPColorMap
             return mParentPlot->selectionTolerance()*0.99;
         }
     }
@@ -25905,10 +31744,10 @@ double QCPColorMap::selectTest(const QPointF &pos, bool onlySelectable, QVariant
 }
 
 /* inherits documentation from base class */
-QCPRange QCPColorMap::getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain) const
+QCPRange QCPPersistence::getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain) const
 {
     foundRange = true;
-    QCPRange result = mMapData->keyRange();
+    QCPRange result = mKeyRange;
     result.normalize();
     if (inSignDomain == QCP::sdPositive)
     {
@@ -25927,11 +31766,11 @@ QCPRange QCPColorMap::getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain
 }
 
 /* inherits documentation from base class */
-QCPRange QCPColorMap::getValueRange(bool &foundRange, QCP::SignDomain inSignDomain, const QCPRange &inKeyRange) const
+QCPRange QCPPersistence::getValueRange(bool &foundRange, QCP::SignDomain inSignDomain, const QCPRange &inKeyRange) const
 {
     if (inKeyRange != QCPRange())
     {
-        if (mMapData->keyRange().upper < inKeyRange.lower || mMapData->keyRange().lower > inKeyRange.upper)
+        if (qMax(mKeyRange.lower, mKeyRange.upper) < inKeyRange.lower || qMin(mKeyRange.lower, mKeyRange.upper) > inKeyRange.upper)
         {
             foundRange = false;
             return QCPRange();
@@ -25939,7 +31778,7 @@ QCPRange QCPColorMap::getValueRange(bool &foundRange, QCP::SignDomain inSignDoma
     }
 
     foundRange = true;
-    QCPRange result = mMapData->valueRange();
+    QCPRange result = mValueRange;
     result.normalize();
     if (inSignDomain == QCP::sdPositive)
     {
@@ -25957,186 +31796,157 @@ QCPRange QCPColorMap::getValueRange(bool &foundRange, QCP::SignDomain inSignDoma
     return result;
 }
 
-/*! \internal
+/* inherits documentation from base class */
+void QCPPersistence::draw(QCPPainter *painter)
+{
+    if (mHits.isEmpty()) return;
+    if (!mKeyAxis || !mValueAxis) return;
 
-  Updates the internal map image buffer by going through the internal \ref QCPColorMapData and
-  turning the data values into color pixels with \ref QCPColorGradient::colorize.
+    const bool keyHorizontal = keyAxis()->orientation() == Qt::Horizontal;
+    if (mMapImageInvalidated || mMapImage.size() != (keyHorizontal ? QSize(mKeySize, mValueSize) : QSize(mValueSize, mKeySize)))
+        updateMapImage();
 
-  This method is called by \ref QCPColorMap::draw if either the data has been modified or the map image
-  has been invalidated for a different reason (e.g. a change of the data range with \ref
-  setDataRange).
+    const QRectF imageRect = QRectF(coordsToPixels(mKeyRange.lower, mValueRange.lower),
+                                    coordsToPixels(mKeyRange.upper, mValueRange.upper)).normalized();
+    // the image is built for ascending ranges, mirror it if an axis or the cell range is reversed:
+    const bool mirrorX = (keyHorizontal ? keyAxis()->rangeReversed() != (mKeyRange.lower > mKeyRange.upper) : valueAxis()->rangeReversed() != (mValueRange.lower > mValueRange.upper));
+    const bool mirrorY = (keyHorizontal ? valueAxis()->rangeReversed() != (mValueRange.lower > mValueRange.upper) : keyAxis()->rangeReversed() != (mKeyRange.lower > mKeyRange.upper));
+    const bool smoothBackup = painter->renderHints().testFlag(QPainter::SmoothPixmapTransform);
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, mInterpolate);
+    painter->drawImage(imageRect, mMapImage.mirrored(mirrorX, mirrorY));
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, smoothBackup);
+}
 
-  If the map cell count is low, the image created will be oversampled in order to avoid a
-  QPainter::drawImage bug which makes inner pixel boundaries jitter when stretch-drawing images
-  without smooth transform enabled. Accordingly, oversampling isn't performed if \ref
-  setInterpolate is true.
-*/
-void QCPColorMap::updateMapImage()
+/* inherits documentation from base class */
+void QCPPersistence::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const
 {
-    QCPAxis *keyAxis = mKeyAxis.data();
-    if (!keyAxis) return;
-    if (mMapData->isEmpty()) return;
+    // draw a few overlaid waves in the colors of the upper half of the gradient:
+    applyDefaultAntialiasingHint(painter);
+    QCPColorGradient gradient(mGradient);
+    const int waveCount = 3;
+    for (int wave=0; wave<waveCount; ++wave)
+    {
+        const double position = 0.5+0.5*(wave+1)/double(waveCount);
+        painter->setPen(QPen(gradient.color(position, QCPRange(0, 1))));
+        QPolygonF line;
+        for (int i=0; i<=8; ++i)
+            line << QPointF(rect.left()+rect.width()*i/8.0, rect.center().y()-(0.2+0.1*wave)*rect.height()*qSin(i/8.0*2*M_PI));
+        painter->drawPolyline(line);
+    }
+}
 
-    const QImage::Format format = QImage::Format_ARGB32_Premultiplied;
-    const int keySize = mMapData->keySize();
-    const int valueSize = mMapData->valueSize();
-    int keyOversamplingFactor = mInterpolate ? 1 : (int)(1.0+100.0/(double)keySize); // make mMapImage have at least size 100, factor becomes 1 if size > 200 or interpolation is on
-    int valueOversamplingFactor = mInterpolate ? 1 : (int)(1.0+100.0/(double)valueSize); // make mMapImage have at least size 100, factor becomes 1 if size > 200 or interpolation is on
+/*! \internal
 
-    // resize mMapImage to correct dimensions including possible oversampling factors, according to key/value axes orientation:
-    if (keyAxis->orientation() == Qt::Horizontal && (mMapImage.width() != keySize*keyOversamplingFactor || mMapImage.height() != valueSize*valueOversamplingFactor))
-        mMapImage = QImage(QSize(keySize*keyOversamplingFactor, valueSize*valueOversamplingFactor), format);
-    else if (keyAxis->orientation() == Qt::Vertical && (mMapImage.width() != valueSize*valueOversamplingFactor || mMapImage.height() != keySize*keyOversamplingFactor))
-        mMapImage = QImage(QSize(valueSize*valueOversamplingFactor, keySize*keyOversamplingFactor), format);
+  Colorizes the decayed hit counts into the map image. Scanlines are lines of constant value index
+  if the key axis is horizontal, and lines of constant key index otherwise, with the scanline order
+  inverted, since QImage counts scanlines from the top.
+*/
+void QCPPersistence::updateMapImage()
+{
+    const bool keyHorizontal = mKeyAxis.data()->orientation() == Qt::Horizontal;
+    const QSize imageSize = keyHorizontal ? QSize(mKeySize, mValueSize) : QSize(mValueSize, mKeySize);
+    if (mMapImage.size() != imageSize)
+        mMapImage = QImage(imageSize, QImage::Format_ARGB32_Premultiplied);
 
-    if (mMapImage.isNull())
-    {
-        qDebug() << Q_FUNC_INFO << "Couldn't create map image (possibly too large for memory)";
-        mMapImage = QImage(QSize(10, 10), format);
-        mMapImage.fill(Qt::black);
-    } else
+    const bool logarithmic = mDataScaleType == QCPAxis::stLogarithmic;
+    const double normalization = 1.0/mHitWeight;
+    const int lineCount = keyHorizontal ? mValueSize : mKeySize;
+    const int rowCount = keyHorizontal ? mKeySize : mValueSize;
+    const int cellStride = keyHorizontal ? 1 : mKeySize;
+    mLineBuffer.resize(rowCount);
+    double *line = mLineBuffer.data();
+    for (int lineIndex=0; lineIndex<lineCount; ++lineIndex)
     {
-        QImage *localMapImage = &mMapImage; // this is the image on which the colorization operates. Either the final mMapImage, or if we need oversampling, mUndersampledMapImage
-        if (keyOversamplingFactor > 1 || valueOversamplingFactor > 1)
-        {
-            // resize undersampled map image to actual key/value cell sizes:
-            if (keyAxis->orientation() == Qt::Horizontal && (mUndersampledMapImage.width() != keySize || mUndersampledMapImage.height() != valueSize))
-                mUndersampledMapImage = QImage(QSize(keySize, valueSize), format);
-            else if (keyAxis->orientation() == Qt::Vertical && (mUndersampledMapImage.width() != valueSize || mUndersampledMapImage.height() != keySize))
-                mUndersampledMapImage = QImage(QSize(valueSize, keySize), format);
-            localMapImage = &mUndersampledMapImage; // make the colorization run on the undersampled image
-        } else if (!mUndersampledMapImage.isNull())
-            mUndersampledMapImage = QImage(); // don't need oversampling mechanism anymore (map size has changed) but mUndersampledMapImage still has nonzero size, free it
-
-        const double *rawData = mMapData->mData;
-        const unsigned char *rawAlpha = mMapData->mAlpha;
-        if (keyAxis->orientation() == Qt::Horizontal)
-        {
-            const int lineCount = valueSize;
-            const int rowCount = keySize;
-            for (int line=0; line<lineCount; ++line)
-            {
-                QRgb* pixels = reinterpret_cast<QRgb*>(localMapImage->scanLine(lineCount-1-line)); // invert scanline index because QImage counts scanlines from top, but our vertical index counts from bottom (mathematical coordinate system)
-                if (rawAlpha)
-                    mGradient.colorize(rawData+line*rowCount, rawAlpha+line*rowCount, mDataRange, pixels, rowCount, 1, mDataScaleType==QCPAxis::stLogarithmic);
-                else
-                    mGradient.colorize(rawData+line*rowCount, mDataRange, pixels, rowCount, 1, mDataScaleType==QCPAxis::stLogarithmic);
-            }
-        } else // keyAxis->orientation() == Qt::Vertical
-        {
-            const int lineCount = keySize;
-            const int rowCount = valueSize;
-            for (int line=0; line<lineCount; ++line)
-            {
-                QRgb* pixels = reinterpret_cast<QRgb*>(localMapImage->scanLine(lineCount-1-line)); // invert scanline index because QImage counts scanlines from top, but our vertical index counts from bottom (mathematical coordinate system)
-                if (rawAlpha)
-                    mGradient.colorize(rawData+line, rawAlpha+line, mDataRange, pixels, rowCount, lineCount, mDataScaleType==QCPAxis::stLogarithmic);
-                else
-                    mGradient.colorize(rawData+line, mDataRange, pixels, rowCount, lineCount, mDataScaleType==QCPAxis::stLogarithmic);
-            }
-        }
-
-        if (keyOversamplingFactor > 1 || valueOversamplingFactor > 1)
+        const float *hits = mHits.constData() + (keyHorizontal ? lineIndex*mKeySize : lineIndex);
+        for (int i=0; i<rowCount; ++i)
+            line[i] = hits[i*cellStride]*normalization;
+        QRgb *pixels = reinterpret_cast<QRgb*>(mMapImage.scanLine(lineCount-1-lineIndex));
+        mGradient.colorize(line, mDataRange, pixels, rowCount, 1, logarithmic);
+        for (int i=0; i<rowCount; ++i)
         {
-            if (keyAxis->orientation() == Qt::Horizontal)
-                mMapImage = mUndersampledMapImage.scaled(keySize*keyOversamplingFactor, valueSize*valueOversamplingFactor, Qt::IgnoreAspectRatio, Qt::FastTransformation);
-            else
-                mMapImage = mUndersampledMapImage.scaled(valueSize*valueOversamplingFactor, keySize*keyOversamplingFactor, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+            if (line[i] == 0) // cells without hits stay transparent
+                pixels[i] = 0;
         }
     }
-    mMapData->mDataModified = false;
     mMapImageInvalidated = false;
 }
 
-/* inherits documentation from base class */
-void QCPColorMap::draw(QCPPainter *painter)
-{
-    if (mMapData->isEmpty()) return;
-    if (!mKeyAxis || !mValueAxis) return;
-    applyDefaultAntialiasingHint(painter);
-
-    if (mMapData->mDataModified || mMapImageInvalidated)
-        updateMapImage();
+/*! \internal
 
-    // use buffer if painting vectorized (PDF):
-    const bool useBuffer = painter->modes().testFlag(QCPPainter::pmVectorized);
-    QCPPainter *localPainter = painter; // will be redirected to paint on mapBuffer if painting vectorized
-    QRectF mapBufferTarget; // the rect in absolute widget coordinates where the visible map portion/buffer will end up in
-    QPixmap mapBuffer;
-    if (useBuffer)
-    {
-        const double mapBufferPixelRatio = 3; // factor by which DPI is increased in embedded bitmaps
-        mapBufferTarget = painter->clipRegion().boundingRect();
-        mapBuffer = QPixmap((mapBufferTarget.size()*mapBufferPixelRatio).toSize());
-        mapBuffer.fill(Qt::transparent);
-        localPainter = new QCPPainter(&mapBuffer);
-        localPainter->scale(mapBufferPixelRatio, mapBufferPixelRatio);
-        localPainter->translate(-mapBufferTarget.topLeft());
-    }
+  Increments the cells on the line segment from (\a x0, \a y0) to (\a x1, \a y1) by \a weight. The
+  coordinates are given in fractional cells, i.e. the cell with key index i covers the x
+  coordinates from i to i+1. If \a skipBegin is true, the cell of the begin point isn't incremented,
+  because it was incremented as end point of the previous segment already.
 
-    QRectF imageRect = QRectF(coordsToPixels(mMapData->keyRange().lower, mMapData->valueRange().lower),
-                              coordsToPixels(mMapData->keyRange().upper, mMapData->valueRange().upper)).normalized();
-    // extend imageRect to contain outer halves/quarters of bordering/cornering pixels (cells are centered on map range boundary):
-    double halfCellWidth = 0; // in pixels
-    double halfCellHeight = 0; // in pixels
-    if (keyAxis()->orientation() == Qt::Horizontal)
-    {
-        if (mMapData->keySize() > 1)
-            halfCellWidth = 0.5*imageRect.width()/(double)(mMapData->keySize()-1);
-        if (mMapData->valueSize() > 1)
-            halfCellHeight = 0.5*imageRect.height()/(double)(mMapData->valueSize()-1);
-    } else // keyAxis orientation is Qt::Vertical
-    {
-        if (mMapData->keySize() > 1)
-            halfCellHeight = 0.5*imageRect.height()/(double)(mMapData->keySize()-1);
-        if (mMapData->valueSize() > 1)
-            halfCellWidth = 0.5*imageRect.width()/(double)(mMapData->valueSize()-1);
-    }
-    imageRect.adjust(-halfCellWidth, -halfCellHeight, halfCellWidth, halfCellHeight);
-    const bool mirrorX = (keyAxis()->orientation() == Qt::Horizontal ? keyAxis() : valueAxis())->rangeReversed();
-    const bool mirrorY = (valueAxis()->orientation() == Qt::Vertical ? valueAxis() : keyAxis())->rangeReversed();
-    const bool smoothBackup = localPainter->renderHints().testFlag(QPainter::SmoothPixmapTransform);
-    localPainter->setRenderHint(QPainter::SmoothPixmapTransform, mInterpolate);
-    QRegion clipBackup;
-    if (mTightBoundary)
+  The segment is clipped to the buffer first (Liang-Barsky), and then stepped through with one step
+  per cell in its major direction.
+*/
+void QCPPersistence::addSegment(double x0, double y0, double x1, double y1, bool skipBegin, float weight)
+{
+    const double dx = x1-x0;
+    const double dy = y1-y0;
+    const double p[4] = {-dx, dx, -dy, dy};
+    const double q[4] = {x0, mKeySize-x0, y0, mValueSize-y0};
+    double t0 = 0, t1 = 1;
+    for (int i=0; i<4; ++i)
     {
-        clipBackup = localPainter->clipRegion();
-        QRectF tightClipRect = QRectF(coordsToPixels(mMapData->keyRange().lower, mMapData->valueRange().lower),
-                                      coordsToPixels(mMapData->keyRange().upper, mMapData->valueRange().upper)).normalized();
-        localPainter->setClipRect(tightClipRect, Qt::IntersectClip);
+        if (p[i] == 0)
+        {
+            if (q[i] < 0) // parallel to and outside of this boundary
+                return;
+        } else
+        {
+            const double t = q[i]/p[i];
+            if (p[i] < 0)
+            {
+                if (t > t1) return;
+                if (t > t0) t0 = t;
+            } else
+            {
+                if (t < t0) return;
+                if (t < t1) t1 = t;
+            }
+        }
     }
-    localPainter->drawImage(imageRect, mMapImage.mirrored(mirrorX, mirrorY));
-    if (mTightBoundary)
-        localPainter->setClipRegion(clipBackup);
-    localPainter->setRenderHint(QPainter::SmoothPixmapTransform, smoothBackup);
+    if (t0 > 0) // the begin point was clipped, so its cell wasn't hit by the previous segment
+        skipBegin = false;
 
-    if (useBuffer) // localPainter painted to mapBuffer, so now draw buffer with original painter
+    const double beginX = x0+t0*dx;
+    const double beginY = y0+t0*dy;
+    const double spanX = (t1-t0)*dx;
+    const double spanY = (t1-t0)*dy;
+    const int steps = qCeil(qMax(qAbs(spanX), qAbs(spanY)));
+    const double stepFactor = steps > 0 ? 1.0/steps : 0;
+    float *hits = mHits.data();
+    for (int step=skipBegin ? 1 : 0; step<=steps; ++step)
     {
-        delete localPainter;
-        painter->drawPixmap(mapBufferTarget.toRect(), mapBuffer);
+        const int keyIndex = qBound(0, int(beginX+spanX*step*stepFactor), mKeySize-1);
+        const int valueIndex = qBound(0, int(beginY+spanY*step*stepFactor), mValueSize-1);
+        hits[valueIndex*mKeySize+keyIndex] += weight;
     }
 }
 
-/* inherits documentation from base class */
-void QCPColorMap::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const
+/*! \internal
+
+  Divides all cells by the current hit weight and resets it to one. This keeps the growing hit
+  weight (see \ref addSweep) within the float range. Cells whose hit count dropped below 1e-6 are
+  set to zero, they aren't visible anymore.
+*/
+void QCPPersistence::normalizeHits()
 {
-    applyDefaultAntialiasingHint(painter);
-    // draw map thumbnail:
-    if (!mLegendIcon.isNull())
+    const float factor = float(1.0/mHitWeight);
+    float *hits = mHits.data();
+    const int cellCount = mHits.size();
+    for (int i=0; i<cellCount; ++i)
     {
-        QPixmap scaledIcon = mLegendIcon.scaled(rect.size().toSize(), Qt::KeepAspectRatio, Qt::FastTransformation);
-        QRectF iconRect = QRectF(0, 0, scaledIcon.width(), scaledIcon.height());
-        iconRect.moveCenter(rect.center());
-        painter->drawPixmap(iconRect.topLeft(), scaledIcon);
+        hits[i] *= factor;
+        if (hits[i] < 1e-6f)
+            hits[i] = 0;
     }
-    /*
-  // draw frame:
-  painter->setBrush(Qt::NoBrush);
-  painter->setPen(Qt::black);
-  painter->drawRect(rect.adjusted(1, 1, 0, 0));
-  */
+    mHitWeight = 1;
 }
-/* end of 'src/plottables/plottable-colormap.cpp' */
+
+/* end of 'src/plottables/plottable-persistence.cpp' */
 
 
 /* including file 'src/plottables/plottable-financial.cpp', size 42827       */
@@ -26536,13 +32346,22 @@ QCPDataSelection QCPFinancial::selectTestRect(const QRectF &rect, bool onlySelec
     QCPFinancialDataContainer::const_iterator visibleBegin, visibleEnd;
     getVisibleDataBounds(visibleBegin, visibleEnd);
 
+    int currentSegmentBegin = -1; // -1 means we're currently not in a segment that's contained in rect
     for (QCPFinancialDataContainer::const_iterator it=visibleBegin; it!=visibleEnd; ++it)
     {
-        if (rect.intersects(selectionHitBox(it)))
-            result.addDataRange(QCPDataRange(it-mDataContainer->constBegin(), it-mDataContainer->constBegin()+1), false);
+        const bool contained = rect.intersects(selectionHitBox(it));
+        if (contained && currentSegmentBegin == -1) // start segment
+            currentSegmentBegin = it-mDataContainer->constBegin();
+        else if (!contained && currentSegmentBegin != -1) // segment just ended
+        {
+            result.addDataRange(QCPDataRange(currentSegmentBegin, it-mDataContainer->constBegin()), false);
+            currentSegmentBegin = -1;
+        }
     }
-    result.simplify();
-    return result;
+    // process potential last segment:
+    if (currentSegmentBegin != -1)
+        result.addDataRange(QCPDataRange(currentSegmentBegin, visibleEnd-mDataContainer->constBegin()), false);
+    return result; // segments are added in ascending order and are separated, so no simplify is necessary
 }
 
 /*!
@@ -27494,22 +33313,33 @@ QCPDataSelection QCPErrorBars::selectTestRect(const QRectF &rect, bool onlySelec
     getVisibleDataBounds(visibleBegin, visibleEnd, QCPDataRange(0, dataCount()));
 
     QVector<QLineF> backbones, whiskers;
+    int currentSegmentBegin = -1; // -1 means we're currently not in a segment that's contained in rect
     for (QCPErrorBarsDataContainer::const_iterator it=visibleBegin; it!=visibleEnd; ++it)
     {
         backbones.clear();
         whiskers.clear();
         getErrorBarLines(it, backbones, whiskers);
+        bool contained = false;
         for (int i=0; i<backbones.size(); ++i)
         {
             if (rectIntersectsLine(rect, backbones.at(i)))
             {
-                result.addDataRange(QCPDataRange(it-mDataContainer->constBegin(), it-mDataContainer->constBegin()+1), false);
+                contained = true;
                 break;
             }
         }
+        if (contained && currentSegmentBegin == -1) // start segment
+            currentSegmentBegin = it-mDataContainer->constBegin();
+        else if (!contained && currentSegmentBegin != -1) // segment just ended
+        {
+            result.addDataRange(QCPDataRange(currentSegmentBegin, it-mDataContainer->constBegin()), false);
+            currentSegmentBegin = -1;
+        }
     }
-    result.simplify();
-    return result;
+    // process potential last segment:
+    if (currentSegmentBegin != -1)
+        result.addDataRange(QCPDataRange(currentSegmentBegin, visibleEnd-mDataContainer->constBegin()), false);
+    return result; // segments are added in ascending order and are separated, so no simplify is necessary
 }
 
 /* inherits documentation from base class */
@@ -28345,6 +34175,13 @@ double QCPItemLine::selectTest(const QPointF &pos, bool onlySelectable, QVariant
     return qSqrt(QCPVector2D(pos).distanceSquaredToLine(start->pixelPosition(), end->pixelPosition()));
 }
 
+/* inherits documentation from base class */
+QRectF QCPItemLine::selectTestBounds(bool &foundBounds) const
+{
+    foundBounds = true;
+    return QRectF(start->pixelPosition(), end->pixelPosition()).normalized();
+}
+
 /* inherits documentation from base class */
 void QCPItemLine::draw(QCPPainter *painter)
 {
@@ -28607,6 +34444,16 @@ double QCPItemCurve::selectTest(const QPointF &pos, bool onlySelectable, QVarian
     return qSqrt(minDistSqr);
 }
 
+/* inherits documentation from base class */
+QRectF QCPItemCurve::selectTestBounds(bool &foundBounds) const
+{
+    // the bezier curve lies within the convex hull of its control points:
+    QPolygonF controlPoints;
+    controlPoints << start->pixelPosition() << startDir->pixelPosition() << endDir->pixelPosition() << end->pixelPosition();
+    foundBounds = true;
+    return controlPoints.boundingRect();
+}
+
 /* inherits documentation from base class */
 void QCPItemCurve::draw(QCPPainter *painter)
 {
@@ -28748,6 +34595,13 @@ double QCPItemRect::selectTest(const QPointF &pos, bool onlySelectable, QVariant
     return rectDistance(rect, pos, filledRect);
 }
 
+/* inherits documentation from base class */
+QRectF QCPItemRect::selectTestBounds(bool &foundBounds) const
+{
+    foundBounds = true;
+    return QRectF(topLeft->pixelPosition(), bottomRight->pixelPosition()).normalized();
+}
+
 /* inherits documentation from base class */
 void QCPItemRect::draw(QCPPainter *painter)
 {
@@ -29021,6 +34875,24 @@ double QCPItemText::selectTest(const QPointF &pos, bool onlySelectable, QVariant
     return rectDistance(textBoxRect, rotatedPos, true);
 }
 
+/* inherits documentation from base class */
+QRectF QCPItemText::selectTestBounds(bool &foundBounds) const
+{
+    // same text box as in selectTest, rotated around the position:
+    QPointF positionPixels(position->pixelPosition());
+    QFontMetrics fontMetrics(mFont);
+    QRect textRect = fontMetrics.boundingRect(0, 0, 0, 0, Qt::TextDontClip|mTextAlignment, mText);
+    QRect textBoxRect = textRect.adjusted(-mPadding.left(), -mPadding.top(), mPadding.right(), mPadding.bottom());
+    QPointF textPos = getTextDrawPoint(positionPixels, textBoxRect, mPositionAlignment);
+    textBoxRect.moveTopLeft(textPos.toPoint());
+    QTransform transform;
+    transform.translate(positionPixels.x(), positionPixels.y());
+    transform.rotate(mRotation);
+    transform.translate(-positionPixels.x(), -positionPixels.y());
+    foundBounds = true;
+    return transform.mapRect(QRectF(textBoxRect));
+}
+
 /* inherits documentation from base class */
 void QCPItemText::draw(QCPPainter *painter)
 {
@@ -29030,7 +34902,8 @@ void QCPItemText::draw(QCPPainter *painter)
     if (!qFuzzyIsNull(mRotation))
         transform.rotate(mRotation);
     painter->setFont(mainFont());
-    QRect textRect = painter->fontMetrics().boundingRect(0, 0, 0, 0, Qt::TextDontClip|mTextAlignment, mText);
+    const QRect layoutRect = mDrawnText.boundingRect(painter->font(), QRect(), Qt::TextDontClip|mTextAlignment, mText, painter->device()); // text rect relative to the point it's laid out at
+    QRect textRect = layoutRect;
     QRect textBoxRect = textRect.adjusted(-mPadding.left(), -mPadding.top(), mPadding.right(), mPadding.bottom());
     QPointF textPos = getTextDrawPoint(QPointF(0, 0), textBoxRect, mPositionAlignment); // 0, 0 because the transform does the translation
     textRect.moveTopLeft(textPos.toPoint()+QPoint(mPadding.left(), mPadding.top()));
@@ -29049,7 +34922,8 @@ void QCPItemText::draw(QCPPainter *painter)
         }
         painter->setBrush(Qt::NoBrush);
         painter->setPen(QPen(mainColor()));
-        painter->drawText(textRect, Qt::TextDontClip|mTextAlignment, mText);
+        // lay out at the point which places the text at textRect, so the cached measurement for an empty layout rect stays valid:
+        mDrawnText.draw(painter, QRect(textRect.topLeft()-layoutRect.topLeft(), QSize(0, 0)), Qt::TextDontClip|mTextAlignment, mText, mParentPlot->plottingHints().testFlag(QCP::phCacheLabels));
     }
 }
 
@@ -29271,6 +35145,13 @@ double QCPItemEllipse::selectTest(const QPointF &pos, bool onlySelectable, QVari
     return result;
 }
 
+/* inherits documentation from base class */
+QRectF QCPItemEllipse::selectTestBounds(bool &foundBounds) const
+{
+    foundBounds = true;
+    return QRectF(topLeft->pixelPosition(), bottomRight->pixelPosition()).normalized();
+}
+
 /* inherits documentation from base class */
 void QCPItemEllipse::draw(QCPPainter *painter)
 {
@@ -29448,6 +35329,13 @@ double QCPItemPixmap::selectTest(const QPointF &pos, bool onlySelectable, QVaria
     return rectDistance(getFinalRect(), pos, true);
 }
 
+/* inherits documentation from base class */
+QRectF QCPItemPixmap::selectTestBounds(bool &foundBounds) const
+{
+    foundBounds = true;
+    return QRectF(getFinalRect());
+}
+
 /* inherits documentation from base class */
 void QCPItemPixmap::draw(QCPPainter *painter)
 {
@@ -29851,6 +35739,17 @@ double QCPItemTracer::selectTest(const QPointF &pos, bool onlySelectable, QVaria
     return -1;
 }
 
+/* inherits documentation from base class */
+QRectF QCPItemTracer::selectTestBounds(bool &foundBounds) const
+{
+    foundBounds = true;
+    if (mStyle == tsCrosshair) // crosshair lines span the clip rect
+        return QRectF(clipRect());
+    QPointF center(position->pixelPosition());
+    double w = mSize/2.0;
+    return QRectF(center-QPointF(w, w), center+QPointF(w, w));
+}
+
 /* inherits documentation from base class */
 void QCPItemTracer::draw(QCPPainter *painter)
 {
@@ -30121,6 +36020,18 @@ double QCPItemBracket::selectTest(const QPointF &pos, bool onlySelectable, QVari
     return -1;
 }
 
+/* inherits documentation from base class */
+QRectF QCPItemBracket::selectTestBounds(bool &foundBounds) const
+{
+    QCPVector2D leftVec(left->pixelPosition());
+    QCPVector2D rightVec(right->pixelPosition());
+    QCPVector2D lengthVec = ((rightVec-leftVec)*0.5).perpendicular().normalized()*mLength;
+    QPolygonF boundingPoly;
+    boundingPoly << leftVec.toPointF() << rightVec.toPointF() << (rightVec-lengthVec).toPointF() << (leftVec-lengthVec).toPointF();
+    foundBounds = true;
+    return boundingPoly.boundingRect();
+}
+
 /* inherits documentation from base class */
 void QCPItemBracket::draw(QCPPainter *painter)
 {
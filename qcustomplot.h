@@ -47,6 +47,10 @@
 #  endif
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define QCP_SSE2
+#endif
+
 #include <QtCore/QObject>
 #include <QtCore/QPointer>
 #include <QtCore/QSharedPointer>
@@ -64,10 +68,19 @@
 #include <QtCore/QDebug>
 #include <QtCore/QStack>
 #include <QtCore/QCache>
+#include <QtCore/QVarLengthArray>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QDataStream>
+#include <QtCore/QRunnable>
+#include <QtCore/QThreadPool>
+#include <QtCore/QSemaphore>
 #include <QtCore/QMargins>
 #include <qmath.h>
 #include <limits>
 #include <algorithm>
+#ifdef QCP_SSE2
+#  include <emmintrin.h>
+#endif
 #ifdef QCP_OPENGL_FBO
 #  include <QtGui/QOpenGLContext>
 #  include <QtGui/QOpenGLFramebufferObject>
@@ -243,6 +256,10 @@ public:
                         ,phImmediateRefresh = 0x002 ///< <tt>0x002</tt> causes an immediate repaint() instead of a soft update() when QCustomPlot::replot() is called with parameter \ref QCustomPlot::rpRefreshHint.
                         ///<                This is set by default to prevent the plot from freezing on fast consecutive replots (e.g. user drags ranges with mouse).
                         ,phCacheLabels      = 0x004 ///< <tt>0x004</tt> axis (tick) labels will be cached as pixmaps, increasing replot performance.
+                        ,phCacheAxes        = 0x008 ///< <tt>0x008</tt> axes and grids are rendered into cached pixmaps, which are reused in subsequent replots as long as the axis range, ticks,
+                        ///<                styles and axis rect geometry are unchanged. This increases replot performance of plots with fixed axes, at the expense of memory.
+                        ,phProgressiveRendering = 0x010 ///< <tt>0x010</tt> if drawing the graphs takes longer than a frame, they are first drawn from a subsample of their data, and the plot is refined
+                        ///<                in subsequent event loop iterations until the exact result is shown (see \ref QCustomPlot::replot).
                       };
     Q_DECLARE_FLAGS(PlottingHints, PlottingHint)
 
@@ -546,9 +563,13 @@ protected:
 
     // non-property members:
     bool mInvalidated;
+    bool mContentsUndefined; // set when the buffer is (re)allocated, until the next clear by QCustomPlot or QCPLayer
 
     // introduced virtual methods:
     virtual void reallocateBuffer() = 0;
+
+    friend class QCustomPlot;
+    friend class QCPLayer;
 };
 
 
@@ -569,6 +590,33 @@ protected:
 
     // reimplemented virtual methods:
     virtual void reallocateBuffer() Q_DECL_OVERRIDE;
+
+    // non-virtual methods:
+    QSize deviceSize() const;
+};
+
+
+class QCP_LIB_DECL QCPDrawCache
+{
+public:
+    QCPDrawCache();
+
+    // getters:
+    QRect rect() const { return mRect; }
+    bool isNull() const { return mPixmap.isNull(); }
+
+    // non-virtual methods:
+    bool isValid(const QRect &rect, const QByteArray &parameterHash) const;
+    QCPPainter *startPainting(const QRect &rect, double devicePixelRatio, const QCPPainter *templatePainter);
+    void donePainting(QCPPainter *painter, const QByteArray &parameterHash);
+    void draw(QCPPainter *painter) const;
+    void clear();
+
+protected:
+    // non-property members:
+    QPixmap mPixmap;
+    QRect mRect;
+    QByteArray mParameterHash;
 };
 
 
@@ -623,6 +671,96 @@ protected:
 /* end of 'src/paintbuffer.h' */
 
 
+/* including file 'src/labelatlas.h'                                         */
+
+class QCP_LIB_DECL QCPLabelAtlas
+{
+public:
+    /*!
+      A rendered text label, see \ref QCPLabelAtlas::label.
+    */
+    struct Label
+    {
+        QPixmap pixmap;
+        QPointF offset; // position of the pixmap's top left corner relative to the label anchor
+    };
+
+    /*!
+      The rendered glyphs of the characters numeric labels consist of, for one combination of font,
+      color and device pixel ratio. See \ref QCPLabelAtlas::glyphSet.
+    */
+    struct GlyphSet
+    {
+        QVector<QPixmap> pixmaps; // one pixmap per glyph, with one pixel of padding on the left side
+        QVector<double> advances; // horizontal advances of the glyphs in pixels
+        signed char glyphIndex[128]; // index of the glyph of a latin1 character, or -1 if it has no glyph
+        int height, ascent;
+    };
+
+    static QCPLabelAtlas *instance();
+
+    // getters:
+    int capacity() const { return mCapacity; }
+
+    // setters:
+    void setCapacity(int kilobytes);
+
+    // non-virtual methods:
+    const Label *label(const QByteArray &key) const;
+    void insertLabel(const QByteArray &key, const Label &label);
+    const GlyphSet *glyphSet(const QByteArray &key) const;
+    const GlyphSet *createGlyphSet(const QByteArray &key, const QFont &font, const QColor &color, double devicePixelRatio);
+    void clear();
+    static bool composedWidth(const GlyphSet *glyphs, const QString &text, int *width);
+    static void drawComposed(QCPPainter *painter, const QPointF &topLeft, const GlyphSet *glyphs, const QString &text);
+
+protected:
+    // property members:
+    int mCapacity;
+
+    // non-property members:
+    QCache<QByteArray, Label> mLabels; // the cost of a label is the memory of its pixmap in bytes
+    QHash<QByteArray, GlyphSet*> mGlyphSets;
+    static QCPLabelAtlas *mInstance;
+
+    QCPLabelAtlas();
+    ~QCPLabelAtlas();
+
+    // non-virtual methods:
+    static void destroyInstance();
+
+private:
+    Q_DISABLE_COPY(QCPLabelAtlas)
+};
+
+
+class QCP_LIB_DECL QCPCachedText
+{
+public:
+    QCPCachedText();
+
+    // non-virtual methods:
+    QRect boundingRect(const QFont &font, const QRect &rect, int flags, const QString &text, QPaintDevice *device=0);
+    void draw(QCPPainter *painter, const QRect &rect, int flags, const QString &text, bool usePixmap, QRect *boundingRect=0);
+    void clear();
+
+protected:
+    // non-property members:
+    QFont mFont;
+    QSize mSize;
+    int mFlags, mDpi;
+    QString mText;
+    QRect mBoundingRect; // relative to the top left corner of the layout rect
+    bool mBoundingRectValid;
+    QPixmap mPixmap;
+    QColor mPixmapColor;
+    double mPixmapRatio;
+    bool mPixmapValid;
+};
+
+/* end of 'src/labelatlas.h' */
+
+
 /* including file 'src/layer.h', size 6885                                   */
 /* commit ce344b3f96a62e5f652585e55f1ae7c7883cd45b 2018-06-25 01:03:39 +0200 */
 
@@ -684,6 +822,7 @@ protected:
     // non-virtual methods:
     void draw(QCPPainter *painter);
     void drawToPaintBuffer();
+    QRegion opaqueRegion() const;
     void addChild(QCPLayerable *layerable, bool prepend);
     void removeChild(QCPLayerable *layerable);
 
@@ -744,6 +883,8 @@ protected:
     virtual void parentPlotInitialized(QCustomPlot *parentPlot);
     virtual QCP::Interaction selectionCategory() const;
     virtual QRect clipRect() const;
+    virtual QRect opaqueRect() const;
+    virtual QRectF selectTestBounds(bool &foundBounds) const;
     virtual void applyDefaultAntialiasingHint(QCPPainter *painter) const = 0;
     virtual void draw(QCPPainter *painter) = 0;
     // selection events:
@@ -1167,11 +1308,14 @@ protected:
     // non-property members:
     QCustomPlot *mParentPlot;
     QHash<QCP::MarginSide, QList<QCPLayoutElement*> > mChildren;
+    QHash<QCP::MarginSide, int> mPassMargins; // common margins already calculated in the layout pass mPassMarginsPass
+    int mPassMarginsPass;
 
     // introduced virtual methods:
     virtual int commonMargin(QCP::MarginSide side) const;
 
     // non-virtual methods:
+    int passCommonMargin(QCP::MarginSide side);
     void addChild(QCP::MarginSide side, QCPLayoutElement *element);
     void removeChild(QCP::MarginSide side, QCPLayoutElement *element);
 
@@ -1406,6 +1550,10 @@ protected:
     int mWrap;
     FillOrder mFillOrder;
 
+    // non-property members:
+    QVector<double> mSectionInput; // all inputs of the last section size calculation in updateLayout
+    QVector<int> mColumnWidths, mRowHeights; // the section sizes resulting from mSectionInput
+
     // non-virtual methods:
     void getMinimumRowColSizes(QVector<int> *minColWidths, QVector<int> *minRowHeights) const;
     void getMaximumRowColSizes(QVector<int> *maxColWidths, QVector<int> *maxRowHeights) const;
@@ -1533,6 +1681,39 @@ Q_DECLARE_METATYPE(QCPLineEnding::EndingStyle)
 /* end of 'src/lineending.h' */
 
 
+/* including file 'src/axis/numberformatter.h'                              */
+
+class QCP_LIB_DECL QCPNumberFormatter
+{
+public:
+    QCPNumberFormatter();
+
+    // getters:
+    QLocale locale() const { return mLocale; }
+
+    // setters:
+    void setLocale(const QLocale &locale);
+
+    // non-virtual methods:
+    QString toString(double value, QChar formatChar, int precision) const;
+    bool format(double value, char formatChar, int precision, QVarLengthArray<QChar, 64> &buffer) const;
+
+protected:
+    // property members:
+    QLocale mLocale;
+
+    // non-property members:
+    QChar mZeroDigit, mDecimalPoint, mGroupSeparator, mExponential, mPlusSign, mMinusSign;
+    bool mGroupDigits, mZeroPadExponent, mTrailingZeroes;
+
+    // non-virtual methods:
+    bool roundDigits(double value, char formatChar, int precision, char *digits, int *digitCount, int *decimalPoint) const;
+    void appendDigits(QVarLengthArray<QChar, 64> &buffer, const char *digits, int count) const;
+};
+
+/* end of 'src/axis/numberformatter.h' */
+
+
 /* including file 'src/axis/axisticker.h', size 4224                         */
 /* commit ce344b3f96a62e5f652585e55f1ae7c7883cd45b 2018-06-25 01:03:39 +0200 */
 
@@ -1559,21 +1740,40 @@ public:
     TickStepStrategy tickStepStrategy() const { return mTickStepStrategy; }
     int tickCount() const { return mTickCount; }
     double tickOrigin() const { return mTickOrigin; }
+    bool caching() const { return mCachingEnabled; }
 
     // setters:
     void setTickStepStrategy(TickStepStrategy strategy);
     void setTickCount(int count);
     void setTickOrigin(double origin);
+    void setCaching(bool enabled);
 
     // introduced virtual methods:
     virtual void generate(const QCPRange &range, const QLocale &locale, QChar formatChar, int precision, QVector<double> &ticks, QVector<double> *subTicks, QVector<QString> *tickLabels);
 
+    // non-virtual methods:
+    void invalidateCache();
+
 protected:
     // property members:
     TickStepStrategy mTickStepStrategy;
     int mTickCount;
     double mTickOrigin;
 
+    // non-property members:
+    bool mCachingEnabled; // off by default, so subclasses whose ticks depend on own members don't silently show stale ticks
+    bool mCacheValid, mCachedSubTicksValid, mCachedLabelsValid;
+    bool mUseLabelPool; // whether createLabelVector may take labels from and add labels to mLabelPool
+    QCPRange mCachedRange;
+    QLocale mCachedLocale;
+    QChar mCachedFormatChar;
+    int mCachedPrecision;
+    QVector<double> mCachedTicks, mCachedSubTicks;
+    QVector<QString> mCachedLabels;
+    QMap<double, QString> mLabelPool; // labels of ticks generated at mLabelPoolTickStep, keyed by tick coordinate
+    double mLabelPoolTickStep;
+    QCPNumberFormatter mNumberFormatter;
+
     // introduced virtual methods:
     virtual double getTickStep(const QCPRange &range);
     virtual int getSubTickCount(double tickStep);
@@ -1588,6 +1788,9 @@ protected:
     double getMantissa(double input, double *magnitude=0) const;
     double cleanMantissa(double input) const;
 
+    // static methods:
+    static void appendDigits(QVarLengthArray<QChar, 64> &buffer, qint64 value, int fieldWidth);
+
 private:
     Q_DISABLE_COPY(QCPAxisTicker)
 
@@ -1628,12 +1831,35 @@ protected:
 
     // non-property members:
     enum DateStrategy {dsNone, dsUniformTimeInDay, dsUniformDayInMonth} mDateStrategy;
+    enum FormatTokenType {ftLiteral, ftDay, ftDay2, ftDayShortName, ftDayLongName, ftMonth, ftMonth2, ftMonthShortName, ftMonthLongName,
+                          ftYear2, ftYear4, ftHour, ftHour2, ftHour24, ftHour24_2, ftMinute, ftMinute2, ftSecond, ftSecond2,
+                          ftMillisecond, ftMillisecond3, ftAmPmLower, ftAmPmUpper};
+    struct FormatToken
+    {
+      FormatTokenType type;
+      int start, length; // character range in mFormatLiterals, only used by ftLiteral
+    };
+    QVector<FormatToken> mFormatTokens;
+    QString mFormatLiterals;
+    bool mFormatCompiled; // false if mDateTimeFormat contains patterns only QLocale::toString can render (e.g. time zone names)
+    bool mFormatHasAmPm;
+    QLocale mTextsLocale;
+    bool mTextsValid;
+    QString mDayNames[2][7], mMonthNames[2][12], mAmPmTexts[2][2]; // [short/long][index] and [lower/upper][am/pm]
+    qint64 mUtcOffsetInterval, mUtcOffset;
+    bool mUtcOffsetValid;
 
     // reimplemented virtual methods:
     virtual double getTickStep(const QCPRange &range) Q_DECL_OVERRIDE;
     virtual int getSubTickCount(double tickStep) Q_DECL_OVERRIDE;
     virtual QString getTickLabel(double tick, const QLocale &locale, QChar formatChar, int precision) Q_DECL_OVERRIDE;
     virtual QVector<double> createTickVector(double tickStep, const QCPRange &range) Q_DECL_OVERRIDE;
+
+    // non-virtual methods:
+    void compileDateTimeFormat();
+    void updateLocaleTexts(const QLocale &locale);
+    qint64 utcOffset(qint64 msecs);
+    bool renderTickLabel(qint64 msecs, QVarLengthArray<QChar, 64> &buffer);
 };
 
 /* end of 'src/axis/axistickerdatetime.h' */
@@ -1676,7 +1902,14 @@ protected:
 
     // non-property members:
     TimeUnit mSmallestUnit, mBiggestUnit;
-    QHash<TimeUnit, QString> mFormatPattern;
+    QHash<TimeUnit, QString> mFormatPattern; // no longer used internally, kept for subclasses
+    struct FormatToken
+    {
+      int unit; // a TimeUnit, or -1 for literal text
+      int start, length; // character range in mTimeFormat, only used by literal text
+    };
+    QVector<FormatToken> mFormatTokens;
+    int mTokenFieldWidth[tuDays+1];
 
     // reimplemented virtual methods:
     virtual double getTickStep(const QCPRange &range) Q_DECL_OVERRIDE;
@@ -1904,6 +2137,7 @@ protected:
 
     // non-property members:
     QCPAxis *mParentAxis;
+    QCPDrawCache mGridCache;
 
     // reimplemented virtual methods:
     virtual void applyDefaultAntialiasingHint(QCPPainter *painter) const Q_DECL_OVERRIDE;
@@ -1912,6 +2146,8 @@ protected:
     // non-virtual methods:
     void drawGridLines(QCPPainter *painter) const;
     void drawSubGridLines(QCPPainter *painter) const;
+    QByteArray generateGridCacheHash(const QCPPainter *painter) const;
+    QRect gridCacheRect() const;
 
     friend class QCPAxis;
 };
@@ -2230,6 +2466,7 @@ public:
 
     virtual void draw(QCPPainter *painter);
     virtual int size() const;
+    void drawCached(QCPPainter *painter);
     void clearCache();
 
     QRect axisSelectionBox() const { return mAxisSelectionBox; }
@@ -2263,11 +2500,6 @@ public:
     QVector<QString> tickLabels;
 
 protected:
-    struct CachedLabel
-    {
-        QPointF offset;
-        QPixmap pixmap;
-    };
     struct TickLabelData
     {
         QString basePart, expPart, suffixPart;
@@ -2275,17 +2507,26 @@ protected:
         QFont baseFont, expFont;
     };
     QCustomPlot *mParentPlot;
-    QByteArray mLabelParameterHash; // to determine whether mLabelCache needs to be cleared due to changed parameters
-    QCache<QString, CachedLabel> mLabelCache;
+    mutable QByteArray mLabelParameterHash; // prefix of the keys of this axis' labels in the QCPLabelAtlas
+    mutable QByteArray mGlyphSetKey; // key of the glyph set of this axis' tick labels in the QCPLabelAtlas
+    QCPDrawCache mAxisCache;
     QRect mAxisSelectionBox, mTickLabelsSelectionBox, mLabelSelectionBox;
 
     virtual QByteArray generateLabelParameterHash() const;
+    virtual QByteArray generateGlyphSetKey() const;
+    virtual QByteArray generateAxisCacheHash(const QCPPainter *painter) const;
+    virtual QRect axisCacheRect() const;
 
     virtual void placeTickLabel(QCPPainter *painter, double position, int distanceToAxis, const QString &text, QSize *tickLabelsSize);
     virtual void drawTickLabel(QCPPainter *painter, double x, double y, const TickLabelData &labelData) const;
     virtual TickLabelData getTickLabelData(const QFont &font, const QString &text) const;
     virtual QPointF getTickLabelDrawOffset(const TickLabelData &labelData) const;
     virtual void getMaxTickLabelSize(const QFont &font, const QString &text, QSize *tickLabelsSize) const;
+
+    // non-virtual methods:
+    void updateLabelKeys() const;
+    QFont composedLabelFont() const;
+    const QCPLabelAtlas::GlyphSet *composableGlyphs(const QString &text, int *width) const;
 };
 
 /* end of 'src/axis/axis.h' */
@@ -3372,6 +3613,12 @@ protected:
     QCPDataSelection mSelection;
     QCPSelectionDecorator *mSelectionDecorator;
 
+    // non-property members:
+    QPixmap mRangePreviewPixmap;
+    QPoint mRangePreviewPixmapPos;
+    QCPRange mRangePreviewKeyRange, mRangePreviewValueRange; // axis ranges when mRangePreviewPixmap was rendered
+    QPointF mRangePreviewLowerPixel, mRangePreviewUpperPixel; // pixel positions of the lower and upper range bounds at that time
+
     // reimplemented virtual methods:
     virtual QRect clipRect() const Q_DECL_OVERRIDE;
     virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE = 0;
@@ -3387,6 +3634,8 @@ protected:
     // non-virtual methods:
     void applyFillAntialiasingHint(QCPPainter *painter) const;
     void applyScattersAntialiasingHint(QCPPainter *painter) const;
+    bool rangePreviewActive() const;
+    void drawRangePreview(QCPPainter *painter);
 
 private:
     Q_DISABLE_COPY(QCPAbstractPlottable)
@@ -3394,6 +3643,8 @@ private:
     friend class QCustomPlot;
     friend class QCPAxis;
     friend class QCPPlottableLegendItem;
+    friend class QCPLayer;
+    friend class QCPAxisRect;
 };
 
 
@@ -3585,6 +3836,89 @@ private:
 /* end of 'src/item.h' */
 
 
+/* including file 'src/profiler.h'                                           */
+
+class QCP_LIB_DECL QCPReplotProfile
+{
+public:
+    /*!
+    Holds the time spent drawing a single layer or layerable during a replot.
+  */
+    struct Timing
+    {
+        Timing() : nsecs(0) {}
+        Timing(const QString &name, const QString &layerName, qint64 nsecs) : name(name), layerName(layerName), nsecs(nsecs) {}
+        QString name;
+        QString layerName;
+        qint64 nsecs;
+    };
+
+    QCPReplotProfile();
+
+    // non-property methods:
+    bool isEmpty() const { return replotNsecs == 0; }
+    QList<Timing> slowestLayerables(int count) const;
+
+    // public members:
+    qint64 replotNsecs;
+    qint64 updateLayoutNsecs;
+    qint64 tickGenerationNsecs;
+    qint64 setupPaintBuffersNsecs;
+    qint64 compositeNsecs;
+    qint64 samplingPointsIn;
+    qint64 samplingPointsOut;
+    QList<Timing> layerTimings;
+    QList<Timing> layerableTimings;
+
+private:
+    inline static bool lessThanSlower(const Timing &a, const Timing &b) { return a.nsecs > b.nsecs; }
+};
+Q_DECLARE_METATYPE(QCPReplotProfile)
+
+
+class QCP_LIB_DECL QCPProfilerHud : public QCPLayerable
+{
+    Q_OBJECT
+    /// \cond INCLUDE_QPROPERTIES
+    Q_PROPERTY(QFont font READ font WRITE setFont)
+    Q_PROPERTY(QColor textColor READ textColor WRITE setTextColor)
+    Q_PROPERTY(QBrush brush READ brush WRITE setBrush)
+    Q_PROPERTY(int layerableCount READ layerableCount WRITE setLayerableCount)
+    /// \endcond
+public:
+    explicit QCPProfilerHud(QCustomPlot *parentPlot);
+    virtual ~QCPProfilerHud();
+
+    // getters:
+    QFont font() const { return mFont; }
+    QColor textColor() const { return mTextColor; }
+    QBrush brush() const { return mBrush; }
+    int layerableCount() const { return mLayerableCount; }
+
+    // setters:
+    void setFont(const QFont &font);
+    void setTextColor(const QColor &color);
+    void setBrush(const QBrush &brush);
+    void setLayerableCount(int count);
+
+protected:
+    // property members:
+    QFont mFont;
+    QColor mTextColor;
+    QBrush mBrush;
+    int mLayerableCount;
+
+    // reimplemented virtual methods:
+    virtual void applyDefaultAntialiasingHint(QCPPainter *painter) const Q_DECL_OVERRIDE;
+    virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
+
+private:
+    Q_DISABLE_COPY(QCPProfilerHud)
+};
+
+/* end of 'src/profiler.h' */
+
+
 /* including file 'src/core.h', size 14886                                   */
 /* commit ce344b3f96a62e5f652585e55f1ae7c7883cd45b 2018-06-25 01:03:39 +0200 */
 
@@ -3602,6 +3936,7 @@ class QCP_LIB_DECL QCustomPlot : public QWidget
     Q_PROPERTY(bool noAntialiasingOnDrag READ noAntialiasingOnDrag WRITE setNoAntialiasingOnDrag)
     Q_PROPERTY(Qt::KeyboardModifier multiSelectModifier READ multiSelectModifier WRITE setMultiSelectModifier)
     Q_PROPERTY(bool openGl READ openGl WRITE setOpenGl)
+    Q_PROPERTY(bool profiling READ profiling WRITE setProfiling)
     /// \endcond
 public:
     /*!
@@ -3647,6 +3982,8 @@ public:
     QCP::SelectionRectMode selectionRectMode() const { return mSelectionRectMode; }
     QCPSelectionRect *selectionRect() const { return mSelectionRect; }
     bool openGl() const { return mOpenGl; }
+    bool profiling() const { return mProfiling; }
+    QCPReplotProfile replotProfile() const { return mReplotProfile; }
 
     // setters:
     void setViewport(const QRect &rect);
@@ -3671,6 +4008,7 @@ public:
     void setSelectionRectMode(QCP::SelectionRectMode mode);
     void setSelectionRect(QCPSelectionRect *selectionRect);
     void setOpenGl(bool enabled, int multisampling=16);
+    void setProfiling(bool enabled);
 
     // non-property methods:
     // plottable interface:
@@ -3760,6 +4098,7 @@ signals:
     void selectionChangedByUser();
     void beforeReplot();
     void afterReplot();
+    void replotProfiled(const QCPReplotProfile &profile);
 
 protected:
     // property members:
@@ -3786,9 +4125,11 @@ protected:
     QCP::SelectionRectMode mSelectionRectMode;
     QCPSelectionRect *mSelectionRect;
     bool mOpenGl;
+    bool mProfiling;
 
     // non-property members:
     QList<QSharedPointer<QCPAbstractPaintBuffer> > mPaintBuffers;
+    QList<QSharedPointer<QCPAbstractPaintBuffer> > mPaintBufferPool;
     QPoint mMousePressPos;
     bool mMouseHasMoved;
     QPointer<QCPLayerable> mMouseEventLayerable;
@@ -3797,9 +4138,33 @@ protected:
     QVariant mMouseSignalLayerableDetails;
     bool mReplotting;
     bool mReplotQueued;
+    int mLayoutPass; // incremented by every updateLayout call, allows memoizing results within one layout pass
+    struct LayerableBounds
+    {
+      QRectF bounds; // see QCPLayerable::selectTestBounds
+      QCPLayerable *layerable;
+      int order; // position in drawing order over all layers
+    };
+    struct LayerableIndexNode
+    {
+      QRectF bounds; // union of the bounds of all entries in this node
+      int begin, end; // range of entries in mLayerableBounds
+      int left, right; // child node indices, -1 for leaf nodes
+    };
+    mutable QVector<LayerableBounds> mLayerableBounds, mUnboundedLayerables;
+    mutable QVector<LayerableIndexNode> mLayerableIndexNodes; // bounding volume hierarchy over mLayerableBounds, root at index 0
+    mutable bool mLayerableIndexValid;
+    int mRenderStride; // data stride graphs use in the current replot, greater than one for the coarse replots of progressive rendering
+    qint64 mExactReplotNsecs; // estimated duration of drawing all graphs at full detail, extrapolated from the last pass and its stride, determines the initial mRenderStride
+    qint64 mGraphRenderNsecs; // time spent in QCPGraph::draw during the current replot
+    bool mGraphsDecimated; // whether any graph actually skipped data points due to mRenderStride in the current replot
+    bool mRefiningReplot;
+    QTimer *mRefinementTimer;
+    QVector<double> mRefinementRanges; // lower and upper bounds of all axes in the last replot, a pending refinement is continued by replots with unchanged ranges
     int mOpenGlMultisamples;
     QCP::AntialiasedElements mOpenGlAntialiasedElementsBackup;
     bool mOpenGlCacheLabelsBackup;
+    QCPReplotProfile mReplotProfile, mCurrentProfile;
 #ifdef QCP_OPENGL_FBO
     QSharedPointer<QOpenGLContext> mGlContext;
     QSharedPointer<QSurface> mGlSurface;
@@ -3833,12 +4198,22 @@ protected:
     void updateLayerIndices() const;
     QCPLayerable *layerableAt(const QPointF &pos, bool onlySelectable, QVariant *selectionDetails=0) const;
     QList<QCPLayerable*> layerableListAt(const QPointF &pos, bool onlySelectable, QList<QVariant> *selectionDetails=0) const;
+    void updateLayerableIndex() const;
+    int buildLayerableIndexNode(int begin, int end) const;
     void drawBackground(QCPPainter *painter);
     void setupPaintBuffers();
     QCPAbstractPaintBuffer *createPaintBuffer();
+    QSharedPointer<QCPAbstractPaintBuffer> acquirePaintBuffer();
+    void releasePaintBuffer(const QSharedPointer<QCPAbstractPaintBuffer> &buffer);
     bool hasInvalidatedPaintBuffers();
     bool setupOpenGl();
     void freeOpenGl();
+    Q_SLOT void refineReplot();
+
+    // static methods:
+    static bool lessThanBoundsCenterX(const LayerableBounds &a, const LayerableBounds &b);
+    static bool lessThanBoundsCenterY(const LayerableBounds &a, const LayerableBounds &b);
+    static bool greaterThanOrder(const LayerableBounds &a, const LayerableBounds &b);
 
     friend class QCPLegend;
     friend class QCPAxis;
@@ -3847,6 +4222,7 @@ protected:
     friend class QCPAbstractPlottable;
     friend class QCPGraph;
     friend class QCPAbstractItem;
+    friend class QCPMarginGroup;
 };
 Q_DECLARE_METATYPE(QCustomPlot::LayerInsertMode)
 Q_DECLARE_METATYPE(QCustomPlot::RefreshPriority)
@@ -4218,6 +4594,11 @@ bool QCPAbstractPlottable1D<DataType>::sortKeyIsMainKey() const
   point-like. Most subclasses will want to reimplement this method again, to provide a more
   accurate hit test based on the true data visualization geometry.
 
+  If the data is sorted by its main key, the key bounds of \a rect are found by binary search and
+  only the values of the data points in between are tested. Contiguous runs of contained data
+  points are added as one data range each, in ascending order, so the returned selection needs no
+  further simplification.
+
   \seebaseclassmethod
 */
 template <class DataType>
@@ -4241,28 +4622,28 @@ QCPDataSelection QCPAbstractPlottable1D<DataType>::selectTestRect(const QRectF &
     {
         begin = mDataContainer->findBegin(keyRange.lower, false);
         end = mDataContainer->findEnd(keyRange.upper, false);
+        // all data points between begin and end now lie in keyRange, so only the value needs to be tested:
+        keyRange = QCPRange(-(std::numeric_limits<double>::max)(), (std::numeric_limits<double>::max)());
     }
     if (begin == end)
         return result;
 
-    int currentSegmentBegin = -1; // -1 means we're currently not in a segment that's contained in rect
-    for (typename QCPDataContainer<DataType>::const_iterator it=begin; it!=end; ++it)
+    const double valueLower = valueRange.lower, valueUpper = valueRange.upper;
+    const double keyLower = keyRange.lower, keyUpper = keyRange.upper;
+    typename QCPDataContainer<DataType>::const_iterator it = begin;
+    while (it != end)
     {
-        if (currentSegmentBegin == -1)
-        {
-            if (valueRange.contains(it->mainValue()) && keyRange.contains(it->mainKey())) // start segment
-                currentSegmentBegin = it-mDataContainer->constBegin();
-        } else if (!valueRange.contains(it->mainValue()) || !keyRange.contains(it->mainKey())) // segment just ended
-        {
-            result.addDataRange(QCPDataRange(currentSegmentBegin, it-mDataContainer->constBegin()), false);
-            currentSegmentBegin = -1;
-        }
+        // skip data points outside rect:
+        while (it != end && !(it->mainValue() >= valueLower && it->mainValue() <= valueUpper && it->mainKey() >= keyLower && it->mainKey() <= keyUpper))
+            ++it;
+        if (it == end)
+            break;
+        // find end of segment contained in rect:
+        const int segmentBegin = it-mDataContainer->constBegin();
+        while (it != end && it->mainValue() >= valueLower && it->mainValue() <= valueUpper && it->mainKey() >= keyLower && it->mainKey() <= keyUpper)
+            ++it;
+        result.addDataRange(QCPDataRange(segmentBegin, it-mDataContainer->constBegin()), false); // segments are ascending and separated, no simplify necessary
     }
-    // process potential last segment:
-    if (currentSegmentBegin != -1)
-        result.addDataRange(QCPDataRange(currentSegmentBegin, end-mDataContainer->constBegin()), false);
-
-    result.simplify();
     return result;
 }
 
@@ -4494,6 +4875,7 @@ public:
     // non-property methods:
     void colorize(const double *data, const QCPRange &range, QRgb *scanLine, int n, int dataIndexFactor=1, bool logarithmic=false);
     void colorize(const double *data, const unsigned char *alpha, const QCPRange &range, QRgb *scanLine, int n, int dataIndexFactor=1, bool logarithmic=false);
+    static void premultiplyAlpha(const unsigned char *alpha, QRgb *scanLine, int n, int alphaIndexFactor=1);
     QRgb color(double position, const QCPRange &range, bool logarithmic=false);
     void loadPreset(GradientPreset preset);
     void clearColorStops();
@@ -4601,6 +4983,7 @@ class QCP_LIB_DECL QCPAxisRect : public QCPLayoutElement
     Q_PROPERTY(Qt::AspectRatioMode backgroundScaledMode READ backgroundScaledMode WRITE setBackgroundScaledMode)
     Q_PROPERTY(Qt::Orientations rangeDrag READ rangeDrag WRITE setRangeDrag)
     Q_PROPERTY(Qt::Orientations rangeZoom READ rangeZoom WRITE setRangeZoom)
+    Q_PROPERTY(bool rangePreview READ rangePreview WRITE setRangePreview)
     /// \endcond
 public:
     explicit QCPAxisRect(QCustomPlot *parentPlot, bool setupDefaultAxes=true);
@@ -4618,6 +5001,7 @@ public:
     QList<QCPAxis*> rangeDragAxes(Qt::Orientation orientation);
     QList<QCPAxis*> rangeZoomAxes(Qt::Orientation orientation);
     double rangeZoomFactor(Qt::Orientation orientation);
+    bool rangePreview() const { return mRangePreview; }
 
     // setters:
     void setBackground(const QPixmap &pm);
@@ -4635,6 +5019,7 @@ public:
     void setRangeZoomAxes(QList<QCPAxis*> horizontal, QList<QCPAxis*> vertical);
     void setRangeZoomFactor(double horizontalFactor, double verticalFactor);
     void setRangeZoomFactor(double factor);
+    void setRangePreview(bool enabled);
 
     // non-property methods:
     int axisCount(QCPAxis::AxisType type) const;
@@ -4683,14 +5068,18 @@ protected:
     QList<QPointer<QCPAxis> > mRangeDragHorzAxis, mRangeDragVertAxis;
     QList<QPointer<QCPAxis> > mRangeZoomHorzAxis, mRangeZoomVertAxis;
     double mRangeZoomFactorHorz, mRangeZoomFactorVert;
+    bool mRangePreview;
 
     // non-property members:
     QList<QCPRange> mDragStartHorzRange, mDragStartVertRange;
     QCP::AntialiasedElements mAADragBackup, mNotAADragBackup;
     bool mDragging;
     QHash<QCPAxis::AxisType, QList<QCPAxis*> > mAxes;
+    bool mRangePreviewActive; // whether plottables of this axis rect currently draw their range preview instead of themselves
+    QTimer *mRangePreviewTimer; // ends the range preview once the user pauses the drag or zoom gesture
 
     // reimplemented virtual methods:
+    virtual QRect opaqueRect() const Q_DECL_OVERRIDE;
     virtual void applyDefaultAntialiasingHint(QCPPainter *painter) const Q_DECL_OVERRIDE;
     virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
     virtual int calculateAutoMargin(QCP::MarginSide side) Q_DECL_OVERRIDE;
@@ -4704,11 +5093,16 @@ protected:
     // non-property methods:
     void drawBackground(QCPPainter *painter);
     void updateAxesOffset(QCPAxis::AxisType type);
+    void startRangePreview();
+
+protected slots:
+    void finishRangePreview();
 
 private:
     Q_DISABLE_COPY(QCPAxisRect)
 
     friend class QCustomPlot;
+    friend class QCPAbstractPlottable;
 };
 
 
@@ -4998,6 +5392,10 @@ protected:
     QRect mTextBoundingRect;
     bool mSelectable, mSelected;
 
+    // non-property members:
+    mutable QCPCachedText mSizeHintText; // measures mText with mFont for the size hints
+    QCPCachedText mDrawnText;
+
     // reimplemented virtual methods:
     virtual void applyDefaultAntialiasingHint(QCPPainter *painter) const Q_DECL_OVERRIDE;
     virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
@@ -5225,6 +5623,17 @@ protected:
     QPointer<QCPGraph> mChannelFillGraph;
     bool mAdaptiveSampling;
 
+    // non-property members:
+    struct HitTestColumn
+    {
+      int dataBegin, dataEnd; // index range of the data points whose key pixel lies in this column
+      double pointMin, pointMax; // value pixel range of those data points
+      double lineMin, lineMax; // value pixel range covered by the graph line within this column
+    };
+    mutable QVector<HitTestColumn> mHitTestColumns;
+    mutable int mHitTestOrigin; // key pixel of the first column in mHitTestColumns
+    mutable QVector<double> mHitTestParams; // axis and data state mHitTestColumns was built for, empty if invalid
+
     // reimplemented virtual methods:
     virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
     virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const Q_DECL_OVERRIDE;
@@ -5240,8 +5649,9 @@ protected:
 
     // non-virtual methods:
     void getVisibleDataBounds(QCPGraphDataContainer::const_iterator &begin, QCPGraphDataContainer::const_iterator &end, const QCPDataRange &rangeRestriction) const;
-    void getLines(QVector<QPointF> *lines, const QCPDataRange &dataRange) const;
-    void getScatters(QVector<QPointF> *scatters, const QCPDataRange &dataRange) const;
+    void getLines(QVector<QPointF> *lines, const QCPDataRange &dataRange, int stride=1) const;
+    void getScatters(QVector<QPointF> *scatters, const QCPDataRange &dataRange, int stride=1) const;
+    void getSubsampledData(QVector<QCPGraphData> *data, const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end, int stride) const;
     QVector<QPointF> dataToLines(const QVector<QCPGraphData> &data) const;
     QVector<QPointF> dataToStepLeftLines(const QVector<QCPGraphData> &data) const;
     QVector<QPointF> dataToStepRightLines(const QVector<QCPGraphData> &data) const;
@@ -5258,6 +5668,8 @@ protected:
     int findIndexBelowY(const QVector<QPointF> *data, double y) const;
     int findIndexAboveY(const QVector<QPointF> *data, double y) const;
     double pointDistance(const QPointF &pixelPoint, QCPGraphDataContainer::const_iterator &closestData) const;
+    QVector<double> hitTestParams() const;
+    void updateHitTestIndex() const;
 
     friend class QCustomPlot;
     friend class QCPLegend;
@@ -5693,6 +6105,26 @@ protected:
 class QCP_LIB_DECL QCPColorMapData
 {
 public:
+    /*!
+      Defines the type in which the cell values are stored. Smaller types reduce the memory usage
+      of large maps, and the integer types are colorized with a lookup table instead of mapping
+      each cell value to the gradient individually.
+
+      \see setCellType
+    */
+    enum CellType { ctDouble ///< Cells are stored as double (8 bytes per cell)
+                    ,ctFloat ///< Cells are stored as float (4 bytes per cell)
+                    ,ctUInt16 ///< Cells are stored as unsigned 16 bit integers (2 bytes per cell). Values are rounded and clamped to 0..65535
+                    ,ctUInt8 ///< Cells are stored as unsigned 8 bit integers (1 byte per cell). Values are rounded and clamped to 0..255
+                  };
+
+    /*!
+      Defines the memory layout of matrices passed to \ref setCells.
+    */
+    enum MatrixOrder { moRowMajor ///< Consecutive values have consecutive key indices. The rows of constant value index follow each other, separated by the stride. This is the internal storage order, so copying is fastest
+                       ,moColumnMajor ///< Consecutive values have consecutive value indices. The columns of constant key index follow each other, separated by the stride
+                     };
+
     QCPColorMapData(int keySize, int valueSize, const QCPRange &keyRange, const QCPRange &valueRange);
     ~QCPColorMapData();
     QCPColorMapData(const QCPColorMapData &other);
@@ -5704,6 +6136,9 @@ public:
     QCPRange keyRange() const { return mKeyRange; }
     QCPRange valueRange() const { return mValueRange; }
     QCPRange dataBounds() const { return mDataBounds; }
+    bool circular() const { return mCircular; }
+    int writeCursor() const { return mWriteCursor; }
+    CellType cellType() const { return mCellType; }
     double data(double key, double value);
     double cell(int keyIndex, int valueIndex);
     unsigned char alpha(int keyIndex, int valueIndex);
@@ -5718,8 +6153,16 @@ public:
     void setData(double key, double value, double z);
     void setCell(int keyIndex, int valueIndex, double z);
     void setAlpha(int keyIndex, int valueIndex, unsigned char alpha);
+    void setCells(int keyIndex, int valueIndex, int keyCount, int valueCount, const double *values, int stride=0, MatrixOrder order=moRowMajor);
+    void setCells(int keyIndex, int valueIndex, int keyCount, int valueCount, const float *values, int stride=0, MatrixOrder order=moRowMajor);
+    void setCells(int keyIndex, int valueIndex, int keyCount, int valueCount, const quint16 *values, int stride=0, MatrixOrder order=moRowMajor);
+    void setCells(int keyIndex, int valueIndex, int keyCount, int valueCount, const quint8 *values, int stride=0, MatrixOrder order=moRowMajor);
+    void setCircular(bool enabled);
+    void setCellType(CellType type);
 
     // non-property methods:
+    void appendKeyLine(const double *values, bool shiftKeyRange=true);
+    void swap(QCPColorMapData &other);
     void recalculateDataBounds();
     void clear();
     void clearAlpha();
@@ -5734,18 +6177,52 @@ protected:
     int mKeySize, mValueSize;
     QCPRange mKeyRange, mValueRange;
     bool mIsEmpty;
+    bool mCircular;
+    CellType mCellType;
 
     // non-property members:
-    double *mData;
+    char *mData; // cell values of type mCellType
     unsigned char *mAlpha;
     QCPRange mDataBounds;
     bool mDataModified;
+    QRect mModifiedCells; // key index as x, value index as y, in storage order (see storageKeyIndex)
+    QHash<const void*, QRect> mConsumerModifiedCells; // modified cells which the respective consumer hasn't taken yet, see takeModifiedCells
+    int mWriteCursor;
 
     bool createAlpha(bool initializeOpaque=true);
+    void setModified();
+    void setCellModified(int keyIndex, int valueIndex);
+    bool hasModifiedCells(const void *consumer) const;
+    QRect takeModifiedCells(const void *consumer);
+    void releaseModifiedCells(const void *consumer);
+    int storageKeyIndex(int keyIndex) const { return mWriteCursor == 0 ? keyIndex : (keyIndex+mWriteCursor) % mKeySize; }
+    double *doubleData() const { return mCellType == ctDouble ? reinterpret_cast<double*>(mData) : 0; } // typed view of mData for subclasses that used the former double *mData, zero for other cell types
+    double storeCell(int index, double z);
+    void copyCells(int keyIndex, int valueIndex, int keyCount, int valueCount, const char *values, CellType valueType, int stride, MatrixOrder order);
+    static int cellTypeSize(CellType type);
+    static double cellValue(const char *data, CellType type, int index);
 
     friend class QCPColorMap;
+    friend class QCPContour;
 };
 
+/*! \internal
+
+  Returns the value of the cell with the index \a index in the array \a data, which holds cells of
+  type \a type.
+*/
+inline double QCPColorMapData::cellValue(const char *data, CellType type, int index)
+{
+    switch (type)
+    {
+    case ctDouble: return reinterpret_cast<const double*>(data)[index];
+    case ctFloat: return reinterpret_cast<const float*>(data)[index];
+    case ctUInt16: return reinterpret_cast<const quint16*>(data)[index];
+    case ctUInt8: return reinterpret_cast<const quint8*>(data)[index];
+    }
+    return 0;
+}
+
 
 class QCP_LIB_DECL QCPColorMap : public QCPAbstractPlottable
 {
@@ -5757,8 +6234,23 @@ class QCP_LIB_DECL QCPColorMap : public QCPAbstractPlottable
     Q_PROPERTY(bool interpolate READ interpolate WRITE setInterpolate)
     Q_PROPERTY(bool tightBoundary READ tightBoundary WRITE setTightBoundary)
     Q_PROPERTY(QCPColorScale* colorScale READ colorScale WRITE setColorScale)
+    Q_PROPERTY(bool tiledRendering READ tiledRendering WRITE setTiledRendering)
+    Q_PROPERTY(TileAggregation tileAggregation READ tileAggregation WRITE setTileAggregation)
+    Q_PROPERTY(int tileSize READ tileSize WRITE setTileSize)
+    Q_PROPERTY(bool viewportCropping READ viewportCropping WRITE setViewportCropping)
     /// \endcond
 public:
+    /*!
+    Defines how the cells of the reduced resolution levels used by tiled rendering are computed from
+    the cells of the next finer level.
+
+    \see setTiledRendering, setTileAggregation
+  */
+    enum TileAggregation { taMean ///< A cell holds the mean of the (up to four) cells it covers in the next finer level
+                           ,taMax ///< A cell holds the maximum of the (up to four) cells it covers in the next finer level. This preserves narrow peaks.
+                         };
+    Q_ENUMS(TileAggregation)
+
     explicit QCPColorMap(QCPAxis *keyAxis, QCPAxis *valueAxis);
     virtual ~QCPColorMap();
 
@@ -5770,6 +6262,10 @@ public:
     bool tightBoundary() const { return mTightBoundary; }
     QCPColorGradient gradient() const { return mGradient; }
     QCPColorScale *colorScale() const { return mColorScale.data(); }
+    bool tiledRendering() const { return mTiledRendering; }
+    TileAggregation tileAggregation() const { return mTileAggregation; }
+    int tileSize() const { return mTileSize; }
+    bool viewportCropping() const { return mViewportCropping; }
 
     // setters:
     void setData(QCPColorMapData *data, bool copy=false);
@@ -5779,6 +6275,10 @@ public:
     void setInterpolate(bool enabled);
     void setTightBoundary(bool enabled);
     void setColorScale(QCPColorScale *colorScale);
+    void setTiledRendering(bool enabled);
+    void setTileAggregation(TileAggregation aggregation);
+    void setTileSize(int cells);
+    void setViewportCropping(bool enabled);
 
     // non-property methods:
     void rescaleDataRange(bool recalculateDataBounds=false);
@@ -5795,6 +6295,13 @@ signals:
     void gradientChanged(const QCPColorGradient &newGradient);
 
 protected:
+    struct TileLevel
+    {
+        int keySize, valueSize;
+        QVector<double> data;
+        QVector<unsigned char> alpha; // empty if the map data has no alpha map
+    };
+
     // property members:
     QCPRange mDataRange;
     QCPAxis::ScaleType mDataScaleType;
@@ -5803,11 +6310,21 @@ protected:
     bool mInterpolate;
     bool mTightBoundary;
     QPointer<QCPColorScale> mColorScale;
+    bool mTiledRendering;
+    TileAggregation mTileAggregation;
+    int mTileSize;
+    bool mViewportCropping;
 
     // non-property members:
     QImage mMapImage, mUndersampledMapImage;
+    QRect mMapImageCells; // cells covered by mMapImage, key index as x, value index as y
     QPixmap mLegendIcon;
     bool mMapImageInvalidated;
+    QVector<TileLevel> mTileLevels; // reduced resolution levels 1, 2, ... (level 0 is the map data itself)
+    QCache<quint64, QImage> mTileCache;
+    bool mTileLevelsInvalidated;
+    QVector<QRgb> mCellLookup; // colors of all possible values of integer cell types, index is the cell value
+    bool mCellLookupInvalidated;
 
     // introduced virtual methods:
     virtual void updateMapImage();
@@ -5816,13 +6333,364 @@ protected:
     virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
     virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const Q_DECL_OVERRIDE;
 
+    // non-virtual methods:
+    void colorizeLines(uchar *imageBits, int bytesPerLine, int beginLine, int endLine, int beginRow, int endRow);
+    void colorizeCells(const char *data, QCPColorMapData::CellType cellType, const unsigned char *alpha, QRgb *scanLine, int n, int dataIndexFactor);
+    void updateCellLookup();
+    QRect visibleCells() const;
+    void updateMapImageCells();
+    QImage sampledMapImage(int maxCells);
+    bool useTiledRendering() const;
+    void updateTileLevels();
+    void aggregateTileLevel(int level, const QRect &cells);
+    void tileLevelData(int level, const char **data, QCPColorMapData::CellType *cellType, const unsigned char **alpha, int *keySize, int *valueSize) const;
+    void removeTiles(int level, const QRect &cells);
+    QImage *tileImage(int level, int tileKeyIndex, int tileValueIndex);
+    void drawTiles(QCPPainter *painter, bool mirrorX, bool mirrorY);
+
     friend class QCustomPlot;
     friend class QCPLegend;
+    friend class QCPColorMapColorizeTask;
+};
+Q_DECLARE_METATYPE(QCPColorMap::TileAggregation)
+
+
+class QCPColorMapColorizeTask : public QRunnable
+{
+public:
+    QCPColorMapColorizeTask(QCPColorMap *colorMap, uchar *imageBits, int bytesPerLine, int beginLine, int endLine, int beginRow, int endRow, QSemaphore *finished);
+
+    virtual void run() Q_DECL_OVERRIDE;
+
+protected:
+    QCPColorMap *mColorMap;
+    uchar *mImageBits;
+    int mBytesPerLine, mBeginLine, mEndLine, mBeginRow, mEndRow;
+    QSemaphore *mFinished;
 };
 
 /* end of 'src/plottables/plottable-colormap.h' */
 
 
+/* including file 'src/plottables/plottable-contour.h'                       */
+
+class QCP_LIB_DECL QCPContour : public QCPAbstractPlottable
+{
+    Q_OBJECT
+    /// \cond INCLUDE_QPROPERTIES
+    Q_PROPERTY(QVector<double> levels READ levels WRITE setLevels)
+    Q_PROPERTY(QCPColorMap* colorMap READ colorMap WRITE setColorMap)
+    /// \endcond
+public:
+    explicit QCPContour(QCPAxis *keyAxis, QCPAxis *valueAxis);
+    virtual ~QCPContour();
+
+    // getters:
+    QCPColorMapData *data() const;
+    QVector<double> levels() const { return mLevels; }
+    QCPColorMap *colorMap() const { return mColorMap.data(); }
+
+    // setters:
+    void setData(QCPColorMapData *data, bool copy=false);
+    void setColorMap(QCPColorMap *colorMap);
+    void setLevels(const QVector<double> &levels);
+
+    // non-property methods:
+    void setLevels(double lower, double upper, int count);
+    QList<QPolygonF> contourLines(int levelIndex);
+
+    // reimplemented virtual methods:
+    virtual double selectTest(const QPointF &pos, bool onlySelectable, QVariant *details=0) const Q_DECL_OVERRIDE;
+    virtual QCPRange getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain=QCP::sdBoth) const Q_DECL_OVERRIDE;
+    virtual QCPRange getValueRange(bool &foundRange, QCP::SignDomain inSignDomain=QCP::sdBoth, const QCPRange &inKeyRange=QCPRange()) const Q_DECL_OVERRIDE;
+
+protected:
+    struct Segment
+    {
+        qint64 beginEdge, endEdge; // ids of the cell edges the segment connects, see addSegment
+        QPointF begin, end;
+    };
+
+    // property members:
+    QCPColorMapData *mMapData;
+    QPointer<QCPColorMap> mColorMap;
+    QVector<double> mLevels;
+
+    // non-property members:
+    mutable QVector<QVector<QVector<QPolygonF> > > mBandLines; // contour lines by band and level, in cell index coordinates (key index as x, value index as y)
+    mutable const QCPColorMapData *mContouredData; // the data the contour lines were calculated from, only used for comparison
+    mutable int mContouredKeySize, mContouredValueSize;
+    mutable bool mContoursInvalidated;
+    int mBandSize; // number of value indices per band, the unit of parallel and partial recalculation
+
+    // reimplemented virtual methods:
+    virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
+    virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const Q_DECL_OVERRIDE;
+
+    // non-virtual methods:
+    void updateContours() const;
+    void contourBands(const int *bands, int count) const;
+    QPolygonF cellsToPixels(const QPolygonF &cellLine) const;
+    static void addSegment(QVector<Segment> *segments, int beginEdge, int endEdge, int keyIndex, int valueIndex, int keySize, const double *corners, double level);
+    static void joinSegments(const QVector<Segment> &segments, QVector<QPolygonF> *lines);
+
+    friend class QCustomPlot;
+    friend class QCPLegend;
+    friend class QCPContourTask;
+};
+
+
+class QCPContourTask : public QRunnable
+{
+public:
+    QCPContourTask(const QCPContour *contour, const int *bands, int count, QSemaphore *finished);
+
+    virtual void run() Q_DECL_OVERRIDE;
+
+protected:
+    const QCPContour *mContour;
+    const int *mBands;
+    int mCount;
+    QSemaphore *mFinished;
+};
+
+/* end of 'src/plottables/plottable-contour.h' */
+
+
+/* including file 'src/spectrogram.h'                                        */
+
+class QCPSpectrogramTask;
+
+class QCP_LIB_DECL QCPSpectrogram : public QObject
+{
+    Q_OBJECT
+    /// \cond INCLUDE_QPROPERTIES
+    Q_PROPERTY(QCPColorMap* colorMap READ colorMap WRITE setColorMap)
+    Q_PROPERTY(QCPGraph* source READ source WRITE setSource)
+    Q_PROPERTY(int fftSize READ fftSize WRITE setFftSize)
+    Q_PROPERTY(int hop READ hop WRITE setHop)
+    Q_PROPERTY(int averaging READ averaging WRITE setAveraging)
+    Q_PROPERTY(WindowType windowType READ windowType WRITE setWindowType)
+    Q_PROPERTY(MagnitudeScale magnitudeScale READ magnitudeScale WRITE setMagnitudeScale)
+    Q_PROPERTY(double sampleRate READ sampleRate WRITE setSampleRate)
+    Q_PROPERTY(int columnCount READ columnCount WRITE setColumnCount)
+    /// \endcond
+public:
+    /*!
+      Defines the window function which is applied to the samples of each FFT frame, see \ref
+      setWindowType.
+    */
+    enum WindowType { wtRectangular ///< No window, all samples are weighted equally
+                      ,wtHann       ///< Hann window, a good default for most signals
+                      ,wtHamming    ///< Hamming window, lower first side lobe than the Hann window
+                      ,wtBlackman   ///< Blackman window, strong side lobe suppression at the cost of a wider main lobe
+                    };
+    Q_ENUMS(WindowType)
+
+    /*!
+      Defines how the magnitudes of the frequency bins are written to the color map, see \ref
+      setMagnitudeScale.
+    */
+    enum MagnitudeScale { msLinear  ///< The amplitude of the frequency bins, in units of the input samples
+                          ,msDecibel ///< The power of the frequency bins in decibel, 10*log10 of the squared amplitude
+                        };
+    Q_ENUMS(MagnitudeScale)
+
+    /*!
+      The signature of an FFT kernel, see \ref setFftKernel. The kernel transforms the \a n complex
+      values given by \a real and \a imag in place. \a n is always a power of two.
+    */
+    typedef void (*FftKernel)(double *real, double *imag, int n);
+
+    explicit QCPSpectrogram(QCPColorMap *colorMap);
+    virtual ~QCPSpectrogram();
+
+    // getters:
+    QCPColorMap *colorMap() const { return mColorMap.data(); }
+    QCPGraph *source() const { return mSource.data(); }
+    int fftSize() const { return mFftSize; }
+    int hop() const { return mHop; }
+    int averaging() const { return mAveraging; }
+    WindowType windowType() const { return mWindowType; }
+    MagnitudeScale magnitudeScale() const { return mMagnitudeScale; }
+    double sampleRate() const { return mSampleRate; }
+    int columnCount() const { return mColumnCount; }
+    FftKernel fftKernel() const { return mFftKernel; }
+
+    // setters:
+    void setColorMap(QCPColorMap *colorMap);
+    void setSource(QCPGraph *graph);
+    void setFftSize(int size);
+    void setHop(int hop);
+    void setAveraging(int frames);
+    void setWindowType(WindowType type);
+    void setMagnitudeScale(MagnitudeScale scale);
+    void setSampleRate(double sampleRate);
+    void setColumnCount(int count);
+    void setFftKernel(FftKernel kernel);
+
+    // non-property methods:
+    void addSamples(const double *values, int count);
+    void clear();
+    void waitForDone();
+    static void fftRadix2(double *real, double *imag, int n);
+
+public slots:
+    void update();
+
+signals:
+    void columnsAppended(int count);
+
+protected:
+    // property members:
+    QPointer<QCPColorMap> mColorMap;
+    QPointer<QCPGraph> mSource;
+    int mFftSize, mHop, mAveraging;
+    WindowType mWindowType;
+    MagnitudeScale mMagnitudeScale;
+    double mSampleRate;
+    int mColumnCount;
+    FftKernel mFftKernel;
+
+    // non-property members:
+    QVector<double> mPendingSamples; // samples which weren't transformed yet, or are needed again by overlapping frames
+    qint64 mPendingIndex; // stream index of the first sample in mPendingSamples
+    int mSkipSamples; // number of upcoming samples to drop, if the hop is larger than the FFT size
+    bool mStreamStarted;
+    double mStreamKey; // key of the first sample of the stream
+    double mSourceKey; // key of the last sample taken from the source graph
+    double mEstimatedSampleRate; // sample rate estimated from the source graph keys, used if mSampleRate is zero
+    QVector<double> mWindow;
+    double mWindowSum;
+    QVector<double> mAverageSum; // power sum of the frames collected for the next column
+    int mAverageCount;
+    QVector<double> mColumn;
+    bool mColorMapConfigured;
+    QCPSpectrogramTask *mTask; // the task currently running in the thread pool, or 0
+    QSemaphore mTaskFinished;
+
+    // non-virtual methods:
+    double effectiveSampleRate() const;
+    void resetStream();
+    void updateWindow();
+    void dispatchFrames();
+    void collectFrames();
+    void appendColumn(const double *power, double key);
+
+protected slots:
+    void taskFinished(qlonglong firstSampleIndex);
+
+    friend class QCPSpectrogramTask;
+};
+Q_DECLARE_METATYPE(QCPSpectrogram::WindowType)
+Q_DECLARE_METATYPE(QCPSpectrogram::MagnitudeScale)
+
+
+class QCPSpectrogramTask : public QRunnable
+{
+public:
+    QCPSpectrogramTask(QCPSpectrogram *spectrogram, const QVector<double> &samples, qint64 firstSampleIndex, int frameCount);
+
+    virtual void run() Q_DECL_OVERRIDE;
+
+protected:
+    QCPSpectrogram *mSpectrogram;
+    QVector<double> mSamples, mWindow;
+    qint64 mFirstSampleIndex;
+    int mFrameCount, mFftSize, mHop;
+    double mWindowSum;
+    QCPSpectrogram::FftKernel mFftKernel;
+    QVector<double> mPowers; // power spectra of the frames, one after another
+
+    friend class QCPSpectrogram;
+};
+
+/* end of 'src/spectrogram.h' */
+
+
+/* including file 'src/plottables/plottable-persistence.h'                   */
+
+class QCP_LIB_DECL QCPPersistence : public QCPAbstractPlottable
+{
+    Q_OBJECT
+    /// \cond INCLUDE_QPROPERTIES
+    Q_PROPERTY(QCPRange dataRange READ dataRange WRITE setDataRange)
+    Q_PROPERTY(QCPAxis::ScaleType dataScaleType READ dataScaleType WRITE setDataScaleType)
+    Q_PROPERTY(QCPColorGradient gradient READ gradient WRITE setGradient)
+    Q_PROPERTY(bool interpolate READ interpolate WRITE setInterpolate)
+    Q_PROPERTY(double decay READ decay WRITE setDecay)
+    /// \endcond
+public:
+    explicit QCPPersistence(QCPAxis *keyAxis, QCPAxis *valueAxis);
+    virtual ~QCPPersistence();
+
+    // getters:
+    int keySize() const { return mKeySize; }
+    int valueSize() const { return mValueSize; }
+    QCPRange keyRange() const { return mKeyRange; }
+    QCPRange valueRange() const { return mValueRange; }
+    QCPRange dataRange() const { return mDataRange; }
+    QCPAxis::ScaleType dataScaleType() const { return mDataScaleType; }
+    QCPColorGradient gradient() const { return mGradient; }
+    bool interpolate() const { return mInterpolate; }
+    double decay() const { return mDecay; }
+
+    // setters:
+    void setSize(int keySize, int valueSize);
+    void setRange(const QCPRange &keyRange, const QCPRange &valueRange);
+    void setDataRange(const QCPRange &dataRange);
+    void setDataScaleType(QCPAxis::ScaleType scaleType);
+    void setGradient(const QCPColorGradient &gradient);
+    void setInterpolate(bool enabled);
+    void setDecay(double decay);
+
+    // non-property methods:
+    void addSweep(const double *keys, const double *values, int count);
+    void addSweep(const QVector<double> &keys, const QVector<double> &values);
+    void addSweep(const QCPGraphDataContainer &data);
+    double hits(int keyIndex, int valueIndex) const;
+    void clear();
+    void rescaleDataRange();
+
+    // reimplemented virtual methods:
+    virtual double selectTest(const QPointF &pos, bool onlySelectable, QVariant *details=0) const Q_DECL_OVERRIDE;
+    virtual QCPRange getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain=QCP::sdBoth) const Q_DECL_OVERRIDE;
+    virtual QCPRange getValueRange(bool &foundRange, QCP::SignDomain inSignDomain=QCP::sdBoth, const QCPRange &inKeyRange=QCPRange()) const Q_DECL_OVERRIDE;
+
+protected:
+    // property members:
+    int mKeySize, mValueSize;
+    QCPRange mKeyRange, mValueRange;
+    QCPRange mDataRange;
+    QCPAxis::ScaleType mDataScaleType;
+    QCPColorGradient mGradient;
+    bool mInterpolate;
+    double mDecay;
+
+    // non-property members:
+    QVector<float> mHits; // weighted hit counts, key index runs fastest. The decayed hit count is the stored value divided by mHitWeight
+    double mHitWeight; // weight of a hit of the next sweep, grows by 1/mDecay with every sweep
+    QImage mMapImage;
+    bool mMapImageInvalidated;
+    QVector<double> mLineBuffer;
+    QVector<double> mSweepKeys, mSweepValues; // buffers of addSweep for graph data containers
+
+    // reimplemented virtual methods:
+    virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
+    virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const Q_DECL_OVERRIDE;
+
+    // non-virtual methods:
+    void updateMapImage();
+    void addSegment(double x0, double y0, double x1, double y1, bool skipBegin, float weight);
+    void normalizeHits();
+
+    friend class QCustomPlot;
+    friend class QCPLegend;
+};
+
+/* end of 'src/plottables/plottable-persistence.h' */
+
+
 /* including file 'src/plottables/plottable-financial.h', size 8622          */
 /* commit ce344b3f96a62e5f652585e55f1ae7c7883cd45b 2018-06-25 01:03:39 +0200 */
 
@@ -6171,6 +7039,7 @@ protected:
 
     // reimplemented virtual methods:
     virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
+    virtual QRectF selectTestBounds(bool &foundBounds) const Q_DECL_OVERRIDE;
 
     // non-virtual methods:
     QLineF getRectClippedLine(const QCPVector2D &start, const QCPVector2D &end, const QRect &rect) const;
@@ -6223,6 +7092,7 @@ protected:
 
     // reimplemented virtual methods:
     virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
+    virtual QRectF selectTestBounds(bool &foundBounds) const Q_DECL_OVERRIDE;
 
     // non-virtual methods:
     QPen mainPen() const;
@@ -6280,6 +7150,7 @@ protected:
 
     // reimplemented virtual methods:
     virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
+    virtual QRectF selectTestBounds(bool &foundBounds) const Q_DECL_OVERRIDE;
     virtual QPointF anchorPixelPosition(int anchorId) const Q_DECL_OVERRIDE;
 
     // non-virtual methods:
@@ -6372,8 +7243,12 @@ protected:
     double mRotation;
     QMargins mPadding;
 
+    // non-property members:
+    QCPCachedText mDrawnText;
+
     // reimplemented virtual methods:
     virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
+    virtual QRectF selectTestBounds(bool &foundBounds) const Q_DECL_OVERRIDE;
     virtual QPointF anchorPixelPosition(int anchorId) const Q_DECL_OVERRIDE;
 
     // non-virtual methods:
@@ -6439,6 +7314,7 @@ protected:
 
     // reimplemented virtual methods:
     virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
+    virtual QRectF selectTestBounds(bool &foundBounds) const Q_DECL_OVERRIDE;
     virtual QPointF anchorPixelPosition(int anchorId) const Q_DECL_OVERRIDE;
 
     // non-virtual methods:
@@ -6507,6 +7383,7 @@ protected:
 
     // reimplemented virtual methods:
     virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
+    virtual QRectF selectTestBounds(bool &foundBounds) const Q_DECL_OVERRIDE;
     virtual QPointF anchorPixelPosition(int anchorId) const Q_DECL_OVERRIDE;
 
     // non-virtual methods:
@@ -6594,6 +7471,7 @@ protected:
 
     // reimplemented virtual methods:
     virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
+    virtual QRectF selectTestBounds(bool &foundBounds) const Q_DECL_OVERRIDE;
 
     // non-virtual methods:
     QPen mainPen() const;
@@ -6661,6 +7539,7 @@ protected:
 
     // reimplemented virtual methods:
     virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
+    virtual QRectF selectTestBounds(bool &foundBounds) const Q_DECL_OVERRIDE;
     virtual QPointF anchorPixelPosition(int anchorId) const Q_DECL_OVERRIDE;
 
     // non-virtual methods: